@@ -0,0 +1,322 @@
+#include "asset_pack.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include "lz4_block.h"
+#include "thread_pool.h"
+
+namespace vkt {
+
+    uint64_t hashBytes(const void *data, size_t size, uint64_t seed) {
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        uint64_t hash = seed;
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // a + b <= limit, without overflowing
+    static bool fitsIn(uint64_t offset, uint64_t size, uint64_t limit) {
+        return offset <= limit && size <= limit - offset;
+    }
+
+    bool AssetPack::open(AssetData packFile) {
+        file.reset();
+        entryTable.clear();
+
+        const uint8_t *base = packFile.data();
+        const uint64_t fileSize = packFile.size();
+        if (!packFile.valid() || fileSize < sizeof(PackHeader)) {
+            return false;
+        }
+
+        PackHeader header;
+        memcpy(&header, base, sizeof(header));
+        if (memcmp(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0 ||
+            header.version != PACK_VERSION || header.chunkSize != PACK_CHUNK_SIZE) {
+            return false;
+        }
+
+        if (!fitsIn(header.tocOffset, uint64_t(header.entryCount) * sizeof(PackEntry), fileSize) ||
+            header.chunkCount > fileSize / sizeof(PackChunk) ||
+            !fitsIn(header.chunkTableOffset, header.chunkCount * sizeof(PackChunk), fileSize) ||
+            !fitsIn(header.namesOffset, header.namesSize, fileSize)) {
+            return false;
+        }
+
+        entryTable.resize(header.entryCount);
+        memcpy(entryTable.data(), base + header.tocOffset, header.entryCount * sizeof(PackEntry));
+
+        for (const auto &entry: entryTable) {
+            bool valid = fitsIn(entry.nameOffset, entry.nameLength, header.namesSize);
+            if (entry.compression == static_cast<uint32_t>(PackCompression::None)) {
+                valid = valid && entry.storedSize == entry.size &&
+                        fitsIn(entry.dataOffset, entry.size, fileSize);
+            } else {
+                uint64_t expectedChunks = (entry.size + PACK_CHUNK_SIZE - 1) / PACK_CHUNK_SIZE;
+                valid = valid && entry.chunkCount == expectedChunks &&
+                        fitsIn(entry.firstChunk, entry.chunkCount, header.chunkCount);
+            }
+            if (!valid) {
+                entryTable.clear();
+                return false;
+            }
+        }
+
+        chunkTable = base + header.chunkTableOffset;
+        chunkTableSize = header.chunkCount;
+        names = reinterpret_cast<const char *>(base + header.namesOffset);
+        namesSize = header.namesSize;
+        file = std::make_shared<AssetData>(std::move(packFile));
+        return true;
+    }
+
+    std::string AssetPack::entryName(const PackEntry &entry) const {
+        return std::string(names + entry.nameOffset, entry.nameLength);
+    }
+
+    const PackEntry *AssetPack::find(const char *path) const {
+        const size_t pathLength = strlen(path);
+        const uint64_t pathHash = hashBytes(path, pathLength);
+
+        auto it = std::lower_bound(entryTable.begin(), entryTable.end(), pathHash,
+                                   [](const PackEntry &entry, uint64_t hash) {
+                                       return entry.pathHash < hash;
+                                   });
+        for (; it != entryTable.end() && it->pathHash == pathHash; ++it) {
+            if (it->nameLength == pathLength &&
+                memcmp(names + it->nameOffset, path, pathLength) == 0) {
+                return &*it;
+            }
+        }
+        return nullptr;
+    }
+
+    PackChunk AssetPack::chunkAt(uint64_t index) const {
+        PackChunk chunk;
+        memcpy(&chunk, chunkTable + index * sizeof(PackChunk), sizeof(chunk));
+        return chunk;
+    }
+
+    size_t AssetPack::chunkSize(const PackEntry &entry, uint32_t chunk) const {
+        uint64_t start = uint64_t(chunk) * PACK_CHUNK_SIZE;
+        return static_cast<size_t>(std::min<uint64_t>(PACK_CHUNK_SIZE, entry.size - start));
+    }
+
+    bool AssetPack::readChunk(const PackEntry &entry, uint32_t chunkIndex, uint8_t *dst) const {
+        if (chunkIndex >= entry.chunkCount) {
+            return false;
+        }
+        const size_t outputSize = chunkSize(entry, chunkIndex);
+        const PackChunk chunk = chunkAt(uint64_t(entry.firstChunk) + chunkIndex);
+        if (!fitsIn(chunk.offset, chunk.storedSize, file->size())) {
+            return false;
+        }
+        const uint8_t *src = file->data() + chunk.offset;
+
+        if (chunk.raw) {
+            if (chunk.storedSize != outputSize) {
+                return false;
+            }
+            memcpy(dst, src, outputSize);
+            return true;
+        }
+
+        switch (static_cast<PackCompression>(entry.compression)) {
+            case PackCompression::LZ4:
+                return lz4Decompress(src, chunk.storedSize, dst, outputSize);
+            default:
+                return false;  // Zstd or unknown: no decoder in this build
+        }
+    }
+
+    AssetData AssetPack::read(const PackEntry &entry, ThreadPool *pool) const {
+        AssetData data = readStored(entry, pool);
+#ifndef NDEBUG
+        // A corrupted entry reads as missing, so the lookup falls through to the loose assets
+        if (data.valid() && !verify(entry, data.data())) {
+            return {};
+        }
+#endif
+        return data;
+    }
+
+    AssetData AssetPack::readStored(const PackEntry &entry, ThreadPool *pool) const {
+        if (entry.compression == static_cast<uint32_t>(PackCompression::None)) {
+            // View into the pack, holding a reference so the pack mapping outlives the view
+            auto *keepAlive = new std::shared_ptr<AssetData>(file);
+            return AssetData(file->data() + entry.dataOffset, static_cast<size_t>(entry.size),
+                             true, [](void *context, const uint8_t *, size_t) {
+                        delete static_cast<std::shared_ptr<AssetData> *>(context);
+                    }, keepAlive);
+        }
+
+        std::vector<uint8_t> content(static_cast<size_t>(entry.size));
+        std::atomic<bool> ok{true};
+        auto decodeChunk = [&](size_t chunk) {
+            uint8_t *dst = content.data() + chunk * PACK_CHUNK_SIZE;
+            if (!readChunk(entry, static_cast<uint32_t>(chunk), dst)) {
+                ok = false;
+            }
+        };
+
+        if (pool != nullptr && entry.chunkCount > 1) {
+            pool->parallelFor(entry.chunkCount, decodeChunk);
+        } else {
+            for (size_t chunk = 0; chunk < entry.chunkCount; chunk++) {
+                decodeChunk(chunk);
+            }
+        }
+
+        if (!ok) {
+            return {};
+        }
+        return AssetData::fromBuffer(std::move(content));
+    }
+
+    bool AssetPack::verify(const PackEntry &entry, const uint8_t *data) const {
+        return hashBytes(data, static_cast<size_t>(entry.size)) == entry.contentHash;
+    }
+
+    AssetData PackAssetSource::open(const char *path) {
+        const PackEntry *entry = pack->find(path);
+        if (entry == nullptr) {
+            return {};
+        }
+        return pack->read(*entry, pool);
+    }
+
+    void AssetPackWriter::add(const std::string &path, const uint8_t *data, size_t size,
+                              PackCompression compression) {
+        pending.push_back({path, std::vector<uint8_t>(data, data + size), compression});
+    }
+
+    bool AssetPackWriter::write(const char *outputPath, std::string *error) const {
+        auto fail = [error](const std::string &message) {
+            if (error != nullptr) {
+                *error = message;
+            }
+            return false;
+        };
+
+        // Sorted by path hash for the binary search in AssetPack::find
+        std::vector<const PendingEntry *> order;
+        for (const auto &entry: pending) {
+            if (entry.compression == PackCompression::Zstd) {
+                return fail("zstd compression is not available in this build: " + entry.path);
+            }
+            order.push_back(&entry);
+        }
+        std::sort(order.begin(), order.end(), [](const PendingEntry *a, const PendingEntry *b) {
+            uint64_t hashA = hashBytes(a->path.data(), a->path.size());
+            uint64_t hashB = hashBytes(b->path.data(), b->path.size());
+            return hashA != hashB ? hashA < hashB : a->path < b->path;
+        });
+
+        std::vector<uint8_t> output(sizeof(PackHeader), 0);
+        std::vector<PackEntry> entries;
+        std::vector<PackChunk> chunks;
+        std::string names;
+
+        auto align = [&output]() {
+            output.resize((output.size() + PACK_ALIGNMENT - 1) / PACK_ALIGNMENT * PACK_ALIGNMENT,
+                          0);
+        };
+
+        std::vector<uint8_t> scratch(lz4CompressBound(PACK_CHUNK_SIZE));
+        for (const PendingEntry *pendingEntry: order) {
+            const std::vector<uint8_t> &data = pendingEntry->data;
+
+            PackEntry entry{};
+            entry.pathHash = hashBytes(pendingEntry->path.data(), pendingEntry->path.size());
+            entry.contentHash = hashBytes(data.data(), data.size());
+            entry.size = data.size();
+            entry.nameOffset = static_cast<uint32_t>(names.size());
+            entry.nameLength = static_cast<uint32_t>(pendingEntry->path.size());
+            names += pendingEntry->path;
+
+            // Compress chunk by chunk, keep the result only if at least one chunk shrank
+            std::vector<PackChunk> entryChunks;
+            std::vector<uint8_t> entryData;
+            bool anyCompressed = false;
+            if (pendingEntry->compression == PackCompression::LZ4) {
+                for (size_t start = 0; start < data.size(); start += PACK_CHUNK_SIZE) {
+                    size_t length = std::min<size_t>(PACK_CHUNK_SIZE, data.size() - start);
+                    size_t compressed = lz4Compress(data.data() + start, length, scratch.data(),
+                                                    scratch.size());
+                    PackChunk chunk{};
+                    chunk.offset = entryData.size();
+                    if (compressed > 0 && compressed < length) {
+                        chunk.storedSize = static_cast<uint32_t>(compressed);
+                        entryData.insert(entryData.end(), scratch.begin(),
+                                         scratch.begin() + compressed);
+                        anyCompressed = true;
+                    } else {
+                        chunk.storedSize = static_cast<uint32_t>(length);
+                        chunk.raw = 1;
+                        entryData.insert(entryData.end(), data.begin() + start,
+                                         data.begin() + start + length);
+                    }
+                    entryChunks.push_back(chunk);
+                }
+            }
+
+            align();
+            if (anyCompressed) {
+                entry.compression = static_cast<uint32_t>(PackCompression::LZ4);
+                entry.firstChunk = static_cast<uint32_t>(chunks.size());
+                entry.chunkCount = static_cast<uint32_t>(entryChunks.size());
+                entry.storedSize = entryData.size();
+                for (auto &chunk: entryChunks) {
+                    chunk.offset += output.size();
+                    chunks.push_back(chunk);
+                }
+                output.insert(output.end(), entryData.begin(), entryData.end());
+            } else {
+                entry.compression = static_cast<uint32_t>(PackCompression::None);
+                entry.dataOffset = output.size();
+                entry.storedSize = data.size();
+                output.insert(output.end(), data.begin(), data.end());
+            }
+            entries.push_back(entry);
+        }
+
+        PackHeader header{};
+        memcpy(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+        header.version = PACK_VERSION;
+        header.entryCount = static_cast<uint32_t>(entries.size());
+        header.chunkSize = PACK_CHUNK_SIZE;
+        header.alignment = PACK_ALIGNMENT;
+
+        align();
+        header.tocOffset = output.size();
+        const uint8_t *tocBytes = reinterpret_cast<const uint8_t *>(entries.data());
+        output.insert(output.end(), tocBytes, tocBytes + entries.size() * sizeof(PackEntry));
+
+        header.chunkTableOffset = output.size();
+        header.chunkCount = chunks.size();
+        const uint8_t *chunkBytes = reinterpret_cast<const uint8_t *>(chunks.data());
+        output.insert(output.end(), chunkBytes, chunkBytes + chunks.size() * sizeof(PackChunk));
+
+        header.namesOffset = output.size();
+        header.namesSize = names.size();
+        output.insert(output.end(), names.begin(), names.end());
+
+        memcpy(output.data(), &header, sizeof(header));
+
+        FILE *out = fopen(outputPath, "wb");
+        if (out == nullptr) {
+            return fail(std::string("cannot open ") + outputPath);
+        }
+        bool written = fwrite(output.data(), 1, output.size(), out) == output.size();
+        written = fclose(out) == 0 && written;
+        return written ? true : fail(std::string("cannot write ") + outputPath);
+    }
+
+}  // namespace vkt
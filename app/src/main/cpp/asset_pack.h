@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "asset_vfs.h"
+
+namespace vkt {
+
+    class ThreadPool;
+
+    /*
+     * Single file asset archive, read in place from a mapping (APK buffer or mmap):
+     *
+     *   PackHeader | entry data ... | PackEntry[entryCount] | PackChunk[] | names
+     *
+     * - Entries are sorted by path hash so lookups are a binary search over the TOC.
+     * - Every entry carries an FNV-1a hash of its uncompressed content.
+     * - Compressed entries are split in PACK_CHUNK_SIZE chunks compressed independently, so big
+     *   entries can be streamed chunk by chunk or decompressed in parallel.
+     * - Uncompressed entries are a single block aligned to PACK_ALIGNMENT; reading them returns a
+     *   view into the pack, no copy.
+     *
+     * All integers are little-endian, which is what every Android ABI uses.
+     */
+    enum class PackCompression : uint32_t {
+        None = 0,
+        LZ4 = 1,
+        Zstd = 2  // reserved: no zstd decoder is vendored, such entries fail to read
+    };
+
+    const char PACK_MAGIC[8] = {'H', 'V', 'K', 'P', 'A', 'C', 'K', '\0'};
+    const uint32_t PACK_VERSION = 1;
+    const uint32_t PACK_CHUNK_SIZE = 64 * 1024;
+    const uint32_t PACK_ALIGNMENT = 16;
+
+    struct PackHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t entryCount;
+        uint32_t chunkSize;
+        uint32_t alignment;
+        uint64_t tocOffset;         // PackEntry[entryCount]
+        uint64_t chunkTableOffset;  // PackChunk[]
+        uint64_t chunkCount;
+        uint64_t namesOffset;       // entry paths, not null terminated
+        uint64_t namesSize;
+    };
+
+    struct PackEntry {
+        uint64_t pathHash;
+        uint64_t contentHash;   // of the uncompressed bytes
+        uint64_t dataOffset;    // uncompressed entries only
+        uint64_t storedSize;    // bytes in the pack (sum of the chunks when compressed)
+        uint64_t size;          // uncompressed size
+        uint32_t nameOffset;
+        uint32_t nameLength;
+        uint32_t compression;   // PackCompression
+        uint32_t firstChunk;    // index in the chunk table, compressed entries only
+        uint32_t chunkCount;
+        uint32_t reserved;
+    };
+
+    struct PackChunk {
+        uint64_t offset;
+        uint32_t storedSize;
+        uint32_t raw;           // 1 if the chunk didn't compress and is stored as is
+    };
+
+    static_assert(sizeof(PackHeader) == 64, "pack header layout changed");
+    static_assert(sizeof(PackEntry) == 64, "pack entry layout changed");
+    static_assert(sizeof(PackChunk) == 16, "pack chunk layout changed");
+
+    // FNV-1a, used for path lookups and content checks
+    uint64_t hashBytes(const void *data, size_t size, uint64_t seed = 14695981039346656037ull);
+
+    class AssetPack {
+    public:
+        // Validates the header and table bounds, the pack keeps the file view alive
+        bool open(AssetData file);
+
+        bool isOpen() const { return file != nullptr; }
+
+        size_t entryCount() const { return entryTable.size(); }
+
+        const PackEntry &entry(size_t index) const { return entryTable[index]; }
+
+        std::string entryName(const PackEntry &entry) const;
+
+        const PackEntry *find(const char *path) const;
+
+        // Uncompressed size of one chunk, the last one is usually shorter
+        size_t chunkSize(const PackEntry &entry, uint32_t chunk) const;
+
+        // Decodes one chunk into 'dst' (at least chunkSize() bytes), for streaming readers
+        bool readChunk(const PackEntry &entry, uint32_t chunk, uint8_t *dst) const;
+
+        /*
+         * Whole entry: a view into the pack for uncompressed entries, a decompressed buffer
+         * otherwise. Chunks are spread over 'pool' when one is given. Debug builds also check the
+         * content hash and return an invalid AssetData on a mismatch, like for a missing entry.
+         */
+        AssetData read(const PackEntry &entry, ThreadPool *pool = nullptr) const;
+
+        bool verify(const PackEntry &entry, const uint8_t *data) const;
+
+    private:
+        // The mapping may only be 4 byte aligned, chunks are read through memcpy
+        PackChunk chunkAt(uint64_t index) const;
+
+        AssetData readStored(const PackEntry &entry, ThreadPool *pool) const;
+
+        std::shared_ptr<AssetData> file;
+        std::vector<PackEntry> entryTable;  // copied out for the same reason
+        const uint8_t *chunkTable = nullptr;
+        uint64_t chunkTableSize = 0;
+        const char *names = nullptr;
+        uint64_t namesSize = 0;
+    };
+
+    // Mounts a pack into the AssetVfs
+    class PackAssetSource : public AssetSource {
+    public:
+        PackAssetSource(std::shared_ptr<AssetPack> pack, ThreadPool *pool)
+                : pack(std::move(pack)), pool(pool) {}
+
+        AssetData open(const char *path) override;
+
+        const char *name() const override { return "pack"; }
+
+    private:
+        std::shared_ptr<AssetPack> pack;
+        ThreadPool *pool;
+    };
+
+    /*
+     * Builds a pack, used by the host packer tool. Compressed entries whose chunks don't shrink
+     * are stored uncompressed so they can still be read in place.
+     */
+    class AssetPackWriter {
+    public:
+        void add(const std::string &path, const uint8_t *data, size_t size,
+                 PackCompression compression);
+
+        bool write(const char *outputPath, std::string *error) const;
+
+    private:
+        struct PendingEntry {
+            std::string path;
+            std::vector<uint8_t> data;
+            PackCompression compression;
+        };
+
+        std::vector<PendingEntry> pending;
+    };
+
+}  // namespace vkt
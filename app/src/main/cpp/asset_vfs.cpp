@@ -0,0 +1,158 @@
+#include "asset_vfs.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <utility>
+
+namespace vkt {
+
+    AssetData::AssetData(const uint8_t *data, size_t size, bool zeroCopy, ReleaseFn release,
+                         void *context)
+            : bytes(data), length(size), zeroCopy(zeroCopy), releaseFn(release),
+              releaseContext(context) {}
+
+    AssetData AssetData::fromBuffer(std::vector<uint8_t> &&buffer) {
+        auto *owned = new std::vector<uint8_t>(std::move(buffer));
+        // Keep a non-null pointer for empty files so the asset still reads as valid
+        static const uint8_t emptyAsset = 0;
+        const uint8_t *data = owned->empty() ? &emptyAsset : owned->data();
+        return AssetData(data, owned->size(), false,
+                         [](void *context, const uint8_t *, size_t) {
+                             delete static_cast<std::vector<uint8_t> *>(context);
+                         }, owned);
+    }
+
+    AssetData::AssetData(AssetData &&other) noexcept {
+        *this = std::move(other);
+    }
+
+    AssetData &AssetData::operator=(AssetData &&other) noexcept {
+        if (this != &other) {
+            release();
+            bytes = std::exchange(other.bytes, nullptr);
+            length = std::exchange(other.length, 0);
+            zeroCopy = std::exchange(other.zeroCopy, false);
+            releaseFn = std::exchange(other.releaseFn, nullptr);
+            releaseContext = std::exchange(other.releaseContext, nullptr);
+        }
+        return *this;
+    }
+
+    AssetData::~AssetData() {
+        release();
+    }
+
+    void AssetData::release() {
+        if (releaseFn != nullptr) {
+            releaseFn(releaseContext, bytes, length);
+        }
+        bytes = nullptr;
+        length = 0;
+        releaseFn = nullptr;
+        releaseContext = nullptr;
+    }
+
+#ifdef __ANDROID__
+
+    AssetData AndroidAssetSource::open(const char *path) {
+        AAsset *asset = AAssetManager_open(assetManager, path, AASSET_MODE_BUFFER);
+        if (asset == nullptr) {
+            return {};
+        }
+
+        const void *buffer = AAsset_getBuffer(asset);
+        size_t size = static_cast<size_t>(AAsset_getLength64(asset));
+        if (buffer != nullptr) {
+            // The view points into the asset, close it together with the handle
+            return AssetData(static_cast<const uint8_t *>(buffer), size, true,
+                             [](void *context, const uint8_t *, size_t) {
+                                 AAsset_close(static_cast<AAsset *>(context));
+                             }, asset);
+        }
+
+        // Could not get a buffer (shouldn't happen with AASSET_MODE_BUFFER), read a copy instead
+        std::vector<uint8_t> content(size);
+        int bytesRead = AAsset_read(asset, content.data(), size);
+        AAsset_close(asset);
+        if (bytesRead < 0 || static_cast<size_t>(bytesRead) != size) {
+            return {};
+        }
+        return AssetData::fromBuffer(std::move(content));
+    }
+
+#endif
+
+    AssetData MappedFileSource::open(const char *path) {
+        std::string fullPath = root + "/" + path;
+        int fd = ::open(fullPath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return {};
+        }
+
+        struct stat fileStat{};
+        if (fstat(fd, &fileStat) != 0) {
+            ::close(fd);
+            return {};
+        }
+
+        size_t size = static_cast<size_t>(fileStat.st_size);
+        if (size == 0) {
+            ::close(fd);
+            return AssetData::fromBuffer({});
+        }
+
+        // The mapping keeps the file alive, the descriptor isn't needed anymore
+        void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            return {};
+        }
+        return AssetData(static_cast<const uint8_t *>(mapping), size, true,
+                         [](void *, const uint8_t *data, size_t size) {
+                             munmap(const_cast<uint8_t *>(data), size);
+                         }, nullptr);
+    }
+
+    AssetData DirectorySource::open(const char *path) {
+        std::string fullPath = root + "/" + path;
+        FILE *file = fopen(fullPath.c_str(), "rb");
+        if (file == nullptr) {
+            return {};
+        }
+
+        std::vector<uint8_t> content;
+        if (fseek(file, 0, SEEK_END) == 0) {
+            long size = ftell(file);
+            if (size > 0) {
+                content.resize(static_cast<size_t>(size));
+                fseek(file, 0, SEEK_SET);
+                content.resize(fread(content.data(), 1, content.size(), file));
+            }
+        }
+        fclose(file);
+        return AssetData::fromBuffer(std::move(content));
+    }
+
+    void AssetVfs::mount(std::unique_ptr<AssetSource> source) {
+        sources.push_back(std::move(source));
+    }
+
+    void AssetVfs::unmountAll() {
+        sources.clear();
+    }
+
+    AssetData AssetVfs::open(const char *path) const {
+        for (const auto &source: sources) {
+            AssetData asset = source->open(path);
+            if (asset.valid()) {
+                return asset;
+            }
+        }
+        return {};
+    }
+
+}  // namespace vkt
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef __ANDROID__
+#include <android/asset_manager.h>
+#endif
+
+namespace vkt {
+
+    /*
+     * Read-only view of an asset's bytes. The view stays valid as long as the handle is alive, the
+     * backend resource (AAsset, mapping, owned buffer) is released with it. Handles are move-only.
+     *
+     * Zero-copy backends point straight at memory the OS already has (the APK mapping or a file
+     * mapping), so loading a shader or an image no longer pays for a second copy on the heap.
+     */
+    class AssetData {
+    public:
+        using ReleaseFn = void (*)(void *context, const uint8_t *data, size_t size);
+
+        AssetData() = default;
+
+        AssetData(const uint8_t *data, size_t size, bool zeroCopy, ReleaseFn release,
+                  void *context);
+
+        // Takes ownership of a heap buffer, for backends that have to copy or decompress
+        static AssetData fromBuffer(std::vector<uint8_t> &&buffer);
+
+        AssetData(AssetData &&other) noexcept;
+
+        AssetData &operator=(AssetData &&other) noexcept;
+
+        AssetData(const AssetData &) = delete;
+
+        AssetData &operator=(const AssetData &) = delete;
+
+        ~AssetData();
+
+        const uint8_t *data() const { return bytes; }
+
+        size_t size() const { return length; }
+
+        bool empty() const { return length == 0; }
+
+        // False when the asset could not be opened
+        bool valid() const { return bytes != nullptr; }
+
+        // True if no copy of the asset was made to produce this view
+        bool isZeroCopy() const { return zeroCopy; }
+
+    private:
+        void release();
+
+        const uint8_t *bytes = nullptr;
+        size_t length = 0;
+        bool zeroCopy = false;
+        ReleaseFn releaseFn = nullptr;
+        void *releaseContext = nullptr;
+    };
+
+    // A place assets can be loaded from, paths are relative to the source's root
+    class AssetSource {
+    public:
+        virtual ~AssetSource() = default;
+
+        virtual AssetData open(const char *path) = 0;
+
+        virtual const char *name() const = 0;
+    };
+
+#ifdef __ANDROID__
+
+    /*
+     * Assets packed in the APK. AAsset_getBuffer returns a pointer into the APK mapping for
+     * uncompressed entries; compressed entries are inflated by the framework, which we can't avoid.
+     */
+    class AndroidAssetSource : public AssetSource {
+    public:
+        explicit AndroidAssetSource(AAssetManager *assetManager) : assetManager(assetManager) {}
+
+        AssetData open(const char *path) override;
+
+        const char *name() const override { return "apk"; }
+
+    private:
+        AAssetManager *assetManager;
+    };
+
+#endif
+
+    // Files under a directory, mapped read-only with mmap (desktop Linux builds)
+    class MappedFileSource : public AssetSource {
+    public:
+        explicit MappedFileSource(std::string root) : root(std::move(root)) {}
+
+        AssetData open(const char *path) override;
+
+        const char *name() const override { return "mmap"; }
+
+    private:
+        std::string root;
+    };
+
+    // Files under a directory read into memory, portable and handy for tests
+    class DirectorySource : public AssetSource {
+    public:
+        explicit DirectorySource(std::string root) : root(std::move(root)) {}
+
+        AssetData open(const char *path) override;
+
+        const char *name() const override { return "directory"; }
+
+    private:
+        std::string root;
+    };
+
+    /*
+     * Sources are searched in the order they were mounted, the first one that has the path wins.
+     */
+    class AssetVfs {
+    public:
+        void mount(std::unique_ptr<AssetSource> source);
+
+        void unmountAll();
+
+        AssetData open(const char *path) const;
+
+    private:
+        std::vector<std::unique_ptr<AssetSource>> sources;
+    };
+
+}  // namespace vkt
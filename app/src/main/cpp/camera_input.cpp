@@ -0,0 +1,190 @@
+#include "camera_input.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace vkt {
+
+    static const float MAX_PITCH = 1.5f;  // just short of straight up or down
+
+    static const char TRACE_HEADER[] = "# vkt input trace 1";
+
+    void TouchGestures::process(const TouchEvent &event, std::vector<CameraCommand> &commands) {
+        switch (event.action) {
+            case TouchAction::Down:
+                last = event;
+                tracking = event.pointerCount > 0;
+                return;
+            case TouchAction::Up:
+            case TouchAction::Cancel:
+                tracking = false;
+                return;
+            case TouchAction::Move:
+                break;
+        }
+        if (!tracking || event.pointerCount != last.pointerCount) {
+            // A pointer change we weren't told about: start over from here
+            last = event;
+            tracking = event.pointerCount > 0;
+            return;
+        }
+
+        if (event.pointerCount == 1) {
+            float dx = event.x[0] - last.x[0];
+            float dy = event.y[0] - last.y[0];
+            if (dx != 0.0f || dy != 0.0f) {
+                commands.push_back({CameraCommand::Orbit, -dx * radiansPerPixel,
+                                    dy * radiansPerPixel, event.timeNs});
+            }
+        } else {
+            float lastSpan = std::hypot(last.x[1] - last.x[0], last.y[1] - last.y[0]);
+            float span = std::hypot(event.x[1] - event.x[0], event.y[1] - event.y[0]);
+            if (lastSpan > 1.0f && span > 1.0f && span != lastSpan) {
+                // Spreading the fingers brings the camera closer
+                commands.push_back({CameraCommand::Zoom, lastSpan / span, 0.0f, event.timeNs});
+            }
+        }
+        last = event;
+    }
+
+    void CameraInput::push(const std::vector<CameraCommand> &commands) {
+        if (commands.empty()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.insert(pending.end(), commands.begin(), commands.end());
+    }
+
+    int64_t CameraInput::latch(std::vector<CameraCommand> &commands) {
+        commands.clear();
+        {
+            // Swapped, both vectors keep their capacity
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.swap(commands);
+        }
+        int64_t oldest = 0;
+        for (const CameraCommand &command : commands) {
+            if (oldest == 0 || command.timeNs < oldest) {
+                oldest = command.timeNs;
+            }
+        }
+        return oldest;
+    }
+
+    OrbitCamera OrbitCamera::lookingAt(glm::vec3 eye, glm::vec3 target) {
+        OrbitCamera camera;
+        glm::vec3 offset = eye - target;
+        camera.target = target;
+        camera.distance = glm::length(offset);
+        camera.yaw = std::atan2(offset.x, offset.z);
+        camera.pitch = std::asin(offset.y / camera.distance);
+        return camera;
+    }
+
+    void OrbitCamera::apply(const CameraCommand &command) {
+        switch (command.type) {
+            case CameraCommand::Orbit:
+                yaw = std::remainder(yaw + command.a, 2.0f * 3.14159265f);
+                pitch = std::clamp(pitch + command.b, -MAX_PITCH, MAX_PITCH);
+                break;
+            case CameraCommand::Zoom:
+                distance = std::clamp(distance * command.a, minDistance, maxDistance);
+                break;
+        }
+    }
+
+    glm::vec3 OrbitCamera::eye() const {
+        return target + distance * glm::vec3(std::cos(pitch) * std::sin(yaw), std::sin(pitch),
+                                             std::cos(pitch) * std::cos(yaw));
+    }
+
+    glm::mat4 OrbitCamera::view() const {
+        return glm::lookAt(eye(), target, glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+
+    void LatencyStats::add(int64_t fromNs, int64_t toNs) {
+        double ms = static_cast<double>(toNs - fromNs) / 1e6;
+        frames++;
+        totalMs += ms;
+        maxMs = std::max(maxMs, ms);
+    }
+
+    static char actionLetter(TouchAction action) {
+        switch (action) {
+            case TouchAction::Down:
+                return 'D';
+            case TouchAction::Move:
+                return 'M';
+            case TouchAction::Up:
+                return 'U';
+            case TouchAction::Cancel:
+                return 'C';
+        }
+        return '?';
+    }
+
+    std::string formatInputTrace(const std::vector<TouchEvent> &events) {
+        std::string text = TRACE_HEADER;
+        text += '\n';
+        char line[160];
+        for (const TouchEvent &event : events) {
+            int length = snprintf(line, sizeof(line), "%lld %c %u", (long long) event.timeNs,
+                                  actionLetter(event.action), event.pointerCount);
+            for (uint32_t i = 0; i < event.pointerCount && i < MAX_TOUCH_POINTERS; i++) {
+                length += snprintf(line + length, sizeof(line) - length, " %.2f %.2f",
+                                   event.x[i], event.y[i]);
+            }
+            text.append(line, length);
+            text += '\n';
+        }
+        return text;
+    }
+
+    bool parseInputTrace(const std::string &text, std::vector<TouchEvent> &events) {
+        std::istringstream lines(text);
+        std::string line;
+        while (std::getline(lines, line)) {
+            if (line.empty() || line[0] == '#') {
+                continue;
+            }
+            std::istringstream fields(line);
+            TouchEvent event;
+            long long time = 0;
+            char letter = 0;
+            if (!(fields >> time >> letter >> event.pointerCount) ||
+                event.pointerCount > MAX_TOUCH_POINTERS) {
+                return false;
+            }
+            event.timeNs = time;
+            switch (letter) {
+                case 'D':
+                    event.action = TouchAction::Down;
+                    break;
+                case 'M':
+                    event.action = TouchAction::Move;
+                    break;
+                case 'U':
+                    event.action = TouchAction::Up;
+                    break;
+                case 'C':
+                    event.action = TouchAction::Cancel;
+                    break;
+                default:
+                    return false;
+            }
+            for (uint32_t i = 0; i < event.pointerCount; i++) {
+                if (!(fields >> event.x[i] >> event.y[i])) {
+                    return false;
+                }
+            }
+            events.push_back(event);
+        }
+        return true;
+    }
+
+}  // namespace vkt
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace vkt {
+
+    const uint32_t MAX_TOUCH_POINTERS = 2;  // one finger orbits, two pinch
+
+    // Same clock as GameActivity's event times, CLOCK_MONOTONIC
+    inline int64_t monotonicNowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    enum class TouchAction : uint8_t {
+        Down,    // the set of pointers changed (first finger, one more, one lifted): new baseline
+        Move,
+        Up,      // last finger lifted
+        Cancel,
+    };
+
+    // A motion event reduced to what the camera uses, and what an input trace stores
+    struct TouchEvent {
+        int64_t timeNs = 0;
+        TouchAction action = TouchAction::Move;
+        uint32_t pointerCount = 0;
+        float x[MAX_TOUCH_POINTERS] = {};
+        float y[MAX_TOUCH_POINTERS] = {};
+    };
+
+    struct CameraCommand {
+        enum Type : uint8_t {
+            Orbit,  // a: yaw, b: pitch, radians
+            Zoom,   // a: distance factor, below 1 moves closer
+        };
+        Type type;
+        float a;
+        float b;
+        int64_t timeNs;  // of the touch event it came from
+    };
+
+    /*
+     * Turns touch events into camera commands: dragging one finger orbits, pinching zooms.
+     * Only keeps the previous event, so commands go out as soon as their event arrives.
+     */
+    class TouchGestures {
+    public:
+        // A drag across the whole width turns the camera half way round
+        void setViewWidth(float pixels) { radiansPerPixel = 3.14159265f / std::max(pixels, 1.0f); }
+
+        // Appends the commands for 'event' to 'commands'
+        void process(const TouchEvent &event, std::vector<CameraCommand> &commands);
+
+    private:
+        TouchEvent last;
+        bool tracking = false;
+        float radiansPerPixel = 3.14159265f / 1080.0f;
+    };
+
+    /*
+     * Hands camera commands from the event loop to the render thread. The render thread latches
+     * them as late as it can before submitting, and tags the frame with the oldest input the
+     * latch took, which is where its input latency is measured from.
+     */
+    class CameraInput {
+    public:
+        // Event loop thread
+        void push(const std::vector<CameraCommand> &commands);
+
+        // Render thread: moves everything pushed so far into 'commands' (cleared first), returns
+        // the time of the oldest command, 0 with none
+        int64_t latch(std::vector<CameraCommand> &commands);
+
+    private:
+        std::mutex mutex;
+        std::vector<CameraCommand> pending;
+    };
+
+    // Orbits 'target' at 'distance'; yaw 0 looks down -z
+    struct OrbitCamera {
+        glm::vec3 target{0.0f};
+        float yaw = 0.0f;
+        float pitch = 0.0f;
+        float distance = 1.0f;
+        float minDistance = 1.5f;
+        float maxDistance = 50.0f;
+
+        static OrbitCamera lookingAt(glm::vec3 eye, glm::vec3 target);
+
+        void apply(const CameraCommand &command);
+
+        glm::vec3 eye() const;
+
+        glm::mat4 view() const;
+    };
+
+    // Input latency from the event time, accumulated over frames that consumed input
+    struct LatencyStats {
+        uint64_t frames = 0;
+        double totalMs = 0;
+        double maxMs = 0;
+
+        void add(int64_t fromNs, int64_t toNs);
+
+        double averageMs() const { return frames ? totalMs / frames : 0.0; }
+    };
+
+    /*
+     * Input trace, one event per line so a recorded session can be replayed on the host:
+     *
+     *   # vkt input trace 1
+     *   <time ns> <D|M|U|C> <pointer count> <x0> <y0> [<x1> <y1>]
+     */
+    std::string formatInputTrace(const std::vector<TouchEvent> &events);
+
+    // False on a malformed line, 'events' then holds the lines before it
+    bool parseInputTrace(const std::string &text, std::vector<TouchEvent> &events);
+
+}  // namespace vkt
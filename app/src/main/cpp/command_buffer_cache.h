@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace vkt {
+
+    // What made the recorded command stream stale
+    enum class CommandBufferDirty {
+        SceneTopology,  // objects added/removed, different meshes or descriptor sets
+        Pipeline,       // a pipeline or pipeline layout was (re)created
+        Swapchain,      // new framebuffers, extent or pre-rotation
+        Resolution,     // dynamic resolution picked another render scale
+        Count
+    };
+
+    /*
+     * Our scene records the exact same commands every frame, only the uniform buffer contents
+     * change. So instead of re-recording we keep one command buffer per (swapchain image, frame
+     * slot) pair: the framebuffer depends on the image, the descriptor sets on the frame slot.
+     * A buffer is only re-recorded after something marked the cache dirty.
+     *
+     * Reusing a buffer is safe because it is only ever submitted from its own frame slot, and the
+     * slot has been waited on before the buffer is touched again.
+     */
+    class CommandBufferCache {
+    public:
+        void resize(uint32_t newImageCount, uint32_t newFrameSlots) {
+            imageCount = newImageCount;
+            frameSlots = newFrameSlots;
+            dirty.assign(imageCount * frameSlots, true);
+        }
+
+        uint32_t size() const { return imageCount * frameSlots; }
+
+        uint32_t index(uint32_t image, uint32_t slot) const { return image * frameSlots + slot; }
+
+        void invalidate(CommandBufferDirty reason) {
+            invalidations[static_cast<int>(reason)]++;
+            dirty.assign(dirty.size(), true);
+        }
+
+        bool needsRecord(uint32_t image, uint32_t slot) const { return dirty[index(image, slot)]; }
+
+        void markRecorded(uint32_t image, uint32_t slot) {
+            dirty[index(image, slot)] = false;
+            recordCount++;
+        }
+
+        void markReused() { reuseCount++; }
+
+        uint64_t recordCount = 0;  // Command buffers recorded
+        uint64_t reuseCount = 0;   // Frames submitted without recording anything
+        uint64_t invalidations[static_cast<int>(CommandBufferDirty::Count)] = {};
+
+    private:
+        uint32_t imageCount = 0;
+        uint32_t frameSlots = 0;
+        std::vector<bool> dirty;
+    };
+
+}  // namespace vkt
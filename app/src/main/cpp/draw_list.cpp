@@ -0,0 +1,96 @@
+#include "draw_list.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace vkt {
+
+    namespace {
+
+        const size_t SMALL_SORT = 32;
+
+        uint64_t field(uint32_t value, uint32_t bits) {
+            return value & ((1ull << bits) - 1);
+        }
+
+        uint64_t quantizeDepth(float depth) {
+            const uint64_t maxDepth = (1ull << DRAW_KEY_DEPTH_BITS) - 1;
+            float clamped = depth > 0.0f ? std::min(depth, 1.0f) : 0.0f;  // NaN ends up at 0
+            return static_cast<uint64_t>(clamped * maxDepth + 0.5f);
+        }
+
+    }  // namespace
+
+    uint64_t makeDrawKey(DrawLayer layer, uint32_t pipeline, uint32_t material, uint32_t mesh,
+                         float depth) {
+        uint64_t state = field(pipeline, DRAW_KEY_PIPELINE_BITS)
+                << (DRAW_KEY_MATERIAL_BITS + DRAW_KEY_MESH_BITS);
+        state |= field(material, DRAW_KEY_MATERIAL_BITS) << DRAW_KEY_MESH_BITS;
+        state |= field(mesh, DRAW_KEY_MESH_BITS);
+        uint64_t quantized = quantizeDepth(depth);
+        uint64_t key = static_cast<uint64_t>(layer) << 62;
+        if (layer == DrawLayer::Transparent) {
+            const uint64_t maxDepth = (1ull << DRAW_KEY_DEPTH_BITS) - 1;
+            const uint32_t stateBits =
+                    DRAW_KEY_PIPELINE_BITS + DRAW_KEY_MATERIAL_BITS + DRAW_KEY_MESH_BITS;
+            key |= ((maxDepth - quantized) << stateBits) | state;
+        } else {
+            key |= (state << DRAW_KEY_DEPTH_BITS) | quantized;
+        }
+        return key;
+    }
+
+    void DrawList::sort() {
+        sortPasses = 0;
+        size_t count = items.size();
+        if (count <= SMALL_SORT) {
+            // Insertion sort, stable too, beats building histograms for a handful of draws
+            for (size_t i = 1; i < count; i++) {
+                DrawItem item = items[i];
+                size_t j = i;
+                for (; j > 0 && items[j - 1].key > item.key; j--) {
+                    items[j] = items[j - 1];
+                }
+                items[j] = item;
+            }
+            return;
+        }
+
+        // All eight histograms in one read of the keys
+        uint32_t histograms[8][256];
+        memset(histograms, 0, sizeof(histograms));
+        for (const DrawItem &item: items) {
+            for (int byte = 0; byte < 8; byte++) {
+                histograms[byte][(item.key >> (byte * 8)) & 0xff]++;
+            }
+        }
+
+        scratch.resize(count);
+        DrawItem *src = items.data();
+        DrawItem *dst = scratch.data();
+        for (int byte = 0; byte < 8; byte++) {
+            uint32_t *histogram = histograms[byte];
+            // Every key has the same value in this byte, the pass would not move anything
+            if (histogram[(src[0].key >> (byte * 8)) & 0xff] == count) {
+                continue;
+            }
+
+            uint32_t offsets[256];
+            uint32_t sum = 0;
+            for (int digit = 0; digit < 256; digit++) {
+                offsets[digit] = sum;
+                sum += histogram[digit];
+            }
+            for (size_t i = 0; i < count; i++) {
+                dst[offsets[(src[i].key >> (byte * 8)) & 0xff]++] = src[i];
+            }
+            std::swap(src, dst);
+            sortPasses++;
+        }
+
+        if (src != items.data()) {
+            items.swap(scratch);
+        }
+    }
+
+}  // namespace vkt
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vkt {
+
+    enum class DrawLayer : uint32_t {
+        Opaque = 0,       // grouped by state, then front to back
+        Transparent = 1,  // back to front, then by state
+    };
+
+    /*
+     * Sort key layout, most significant bits first. State ids are whatever the caller indexes its
+     * pipelines, materials and meshes with, truncated to their field width. Depth is the view
+     * depth normalized to [0, 1] and quantized.
+     *
+     *   opaque:       layer:2 | pipeline:10 | material:16 | mesh:16 | depth:20
+     *   transparent:  layer:2 | far-to-near depth:20 | pipeline:10 | material:16 | mesh:16
+     */
+    const uint32_t DRAW_KEY_PIPELINE_BITS = 10;
+    const uint32_t DRAW_KEY_MATERIAL_BITS = 16;
+    const uint32_t DRAW_KEY_MESH_BITS = 16;
+    const uint32_t DRAW_KEY_DEPTH_BITS = 20;
+
+    uint64_t makeDrawKey(DrawLayer layer, uint32_t pipeline, uint32_t material, uint32_t mesh,
+                         float depth);
+
+    struct DrawItem {
+        uint64_t key;
+        uint32_t index;  // caller's draw, e.g. into its own array of draw records
+    };
+
+    /*
+     * Draws of one frame, sorted by key so that draws sharing a pipeline, then a material, then a
+     * mesh end up next to each other and their binds can be skipped. The sort is an LSD radix
+     * sort on bytes: one pass builds all eight histograms, bytes every key shares are skipped,
+     * and the scratch buffer is kept between frames.
+     */
+    class DrawList {
+    public:
+        void clear() { items.clear(); }
+
+        void add(DrawLayer layer, uint32_t pipeline, uint32_t material, uint32_t mesh,
+                 float depth, uint32_t index) {
+            items.push_back({makeDrawKey(layer, pipeline, material, mesh, depth), index});
+        }
+
+        void reserve(size_t count) {
+            items.reserve(count);
+            scratch.reserve(count);
+        }
+
+        // Stable, ascending key order
+        void sort();
+
+        size_t size() const { return items.size(); }
+
+        const DrawItem *begin() const { return items.data(); }
+
+        const DrawItem *end() const { return items.data() + items.size(); }
+
+        const DrawItem &operator[](size_t i) const { return items[i]; }
+
+        uint32_t sortPasses = 0;  // byte passes the last sort() needed, 0 for small lists
+
+    private:
+        std::vector<DrawItem> items;
+        std::vector<DrawItem> scratch;
+    };
+
+    /*
+     * Remembers the state bound while recording and tells which binds a draw actually needs.
+     * Ids are compared, so they must identify the bound object (e.g. the VkPipeline handle rather
+     * than the variant, when several variants resolve to one fallback pipeline).
+     */
+    struct DrawBinds {
+        bool pipeline(uint64_t id) { return change(boundPipeline, id, pipelineBinds); }
+
+        bool material(uint64_t id) { return change(boundMaterial, id, materialBinds); }
+
+        bool mesh(uint64_t id) { return change(boundMesh, id, meshBinds); }
+
+        void reset() {
+            boundPipeline = boundMaterial = boundMesh = UINT64_MAX;
+        }
+
+        uint64_t pipelineBinds = 0;
+        uint64_t materialBinds = 0;
+        uint64_t meshBinds = 0;
+        uint64_t skipped = 0;     // binds avoided because the state was already bound
+
+    private:
+        bool change(uint64_t &bound, uint64_t id, uint64_t &binds) {
+            if (bound == id) {
+                skipped++;
+                return false;
+            }
+            bound = id;
+            binds++;
+            return true;
+        }
+
+        uint64_t boundPipeline = UINT64_MAX;
+        uint64_t boundMaterial = UINT64_MAX;
+        uint64_t boundMesh = UINT64_MAX;
+    };
+
+}  // namespace vkt
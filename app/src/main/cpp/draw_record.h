@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+#include "draw_list.h"
+
+namespace vkt {
+
+    /*
+     * One draw of a frame as recordCommandBuffer() builds it, in the slot's frame arena. The
+     * descriptor set handle is a parameter so the record and the code below don't need Vulkan:
+     * the app uses VkDescriptorSet, tools/framearena runs the same frame path with integers.
+     */
+    template<typename DescriptorSet>
+    struct DrawRecord {
+        uint32_t indexCount;
+        uint32_t vertexOffset;
+        uint32_t indexOffset;
+        DescriptorSet descriptorSet;
+        std::optional<DescriptorSet> textureDescriptorSet;
+        uint32_t firstIndex;
+        uint32_t features;                                    // ShaderFeature bits
+        uint32_t mesh;                                        // Same buffers and offsets, same id
+        uint32_t material;                                    // Same descriptor sets, same id
+        DrawLayer layer;
+        float depth;                                          // View depth / CAMERA_FAR_PLANE
+
+        // The object's set, then the texture set if it has one. Returns how many there are
+        uint32_t descriptorSets(DescriptorSet (&sets)[2]) const {
+            sets[0] = descriptorSet;
+            sets[1] = textureDescriptorSet.value_or(DescriptorSet{});
+            return textureDescriptorSet ? 2 : 1;
+        }
+    };
+
+    /*
+     * Sort keys put the pipeline (the feature bits) first, then material, then mesh: each state
+     * change happens once per group. Opaque draws go front to back within a group, transparent
+     * ones after all opaque draws, back to front. The items index 'records'.
+     */
+    template<typename Records>
+    void sortDraws(const Records &records, DrawList &list) {
+        list.clear();
+        for (uint32_t i = 0; i < records.size(); i++) {
+            const auto &record = records[i];
+            list.add(record.layer, record.features, record.material, record.mesh, record.depth, i);
+        }
+        list.sort();
+    }
+
+}  // namespace vkt
@@ -0,0 +1,45 @@
+#include "frame_arena.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace vkt {
+
+    FrameArena::FrameArena(size_t capacity)
+            : block(new uint8_t[capacity]), blockSize(capacity) {}
+
+    void *FrameArena::allocate(size_t size, size_t alignment) {
+        assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+        uintptr_t base = reinterpret_cast<uintptr_t>(block.get());
+        size_t aligned = ((base + offset + alignment - 1) & ~(uintptr_t) (alignment - 1)) - base;
+        if (aligned + size <= blockSize) {
+            offset = aligned + size;
+            peak = std::max(peak, used());
+            return block.get() + aligned;
+        }
+
+        // Out of room: a heap block of its own, freed with the next reset()
+        overflowAllocations++;
+        overflow.emplace_back(new uint8_t[size + alignment]);
+        overflowBytes += size + alignment;
+        peak = std::max(peak, used());
+        uintptr_t address = reinterpret_cast<uintptr_t>(overflow.back().get());
+        return reinterpret_cast<void *>((address + alignment - 1) & ~(uintptr_t) (alignment - 1));
+    }
+
+    void FrameArena::reset() {
+        if (!overflow.empty()) {
+            // Room for the whole of the last frame, rounded up to keep regrowing rare
+            size_t newSize = std::max<size_t>(blockSize, 1);
+            while (newSize < peak) {
+                newSize *= 2;
+            }
+            overflow.clear();
+            overflowBytes = 0;
+            block.reset(new uint8_t[newSize]);
+            blockSize = newSize;
+        }
+        offset = 0;
+    }
+
+}  // namespace vkt
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace vkt {
+
+    /*
+     * Bump allocator for one frame slot. Everything allocated while a slot's frame is built lives
+     * until reset(), which the frame loop calls once the slot's fence or timeline value says the
+     * GPU is done with that frame, so the memory may also back data the GPU work refers to.
+     *
+     * Deallocation does nothing. When a frame needs more than the block holds, the rest comes
+     * from the heap and the next reset() grows the block to the frame's high water mark, so a
+     * steady frame loop stops touching the heap after its first frames.
+     */
+    class FrameArena {
+    public:
+        static const size_t DEFAULT_CAPACITY = 64 * 1024;
+
+        explicit FrameArena(size_t capacity = DEFAULT_CAPACITY);
+
+        FrameArena(const FrameArena &) = delete;
+
+        FrameArena &operator=(const FrameArena &) = delete;
+
+        // alignment must be a power of two
+        void *allocate(size_t size, size_t alignment);
+
+        void reset();
+
+        size_t capacity() const { return blockSize; }
+
+        size_t used() const { return offset + overflowBytes; }
+
+        size_t highWater() const { return peak; }
+
+        uint64_t overflowAllocations = 0;  // allocations that went to the heap, since the start
+
+    private:
+        std::unique_ptr<uint8_t[]> block;
+        size_t blockSize = 0;
+        size_t offset = 0;
+        std::vector<std::unique_ptr<uint8_t[]>> overflow;
+        size_t overflowBytes = 0;
+        size_t peak = 0;
+    };
+
+    /*
+     * Standard allocator over a FrameArena, for containers that don't outlive the frame slot.
+     * Containers that grow leave their old storage in the arena until reset(): reserve() first.
+     */
+    template<typename T>
+    class ArenaAllocator {
+    public:
+        using value_type = T;
+
+        explicit ArenaAllocator(FrameArena &frameArena) : arena(&frameArena) {}
+
+        template<typename U>
+        ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+        T *allocate(size_t count) {
+            return static_cast<T *>(arena->allocate(count * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T *, size_t) {}
+
+        template<typename U>
+        bool operator==(const ArenaAllocator<U> &other) const { return arena == other.arena; }
+
+        template<typename U>
+        bool operator!=(const ArenaAllocator<U> &other) const { return arena != other.arena; }
+
+    private:
+        template<typename U> friend
+        class ArenaAllocator;
+
+        FrameArena *arena;
+    };
+
+    template<typename T>
+    using FrameVector = std::vector<T, ArenaAllocator<T>>;
+
+}  // namespace vkt
@@ -0,0 +1,162 @@
+#ifdef VKT_FRAME_COUNTERS
+
+#include "frame_counters.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "vk_common.h"
+
+namespace vkt {
+
+    namespace frame_counters {
+
+        const size_t COUNTERS = static_cast<size_t>(FrameCounter::Count);
+
+        std::atomic<uint64_t> totals[COUNTERS];
+
+        namespace {
+
+            // Render thread only
+            uint64_t frameStart[COUNTERS];
+            uint64_t lastCounts[COUNTERS];
+            uint64_t intervalCounts[COUNTERS];
+            uint64_t intervalFrames = 0;
+
+            const char *const NAMES[COUNTERS] = {
+                    "allocs", "allocBytes", "maps", "unmaps", "pipelineBinds", "descriptorBinds",
+                    "bufferBinds", "draws", "submits", "barriers"
+            };
+
+            // Appends "name":value pairs, the buffer is on the stack so logging doesn't count
+            int appendObject(char *out, size_t size, const double *values) {
+                int written = snprintf(out, size, "{");
+                for (size_t i = 0; i < COUNTERS && written < (int) size; i++) {
+                    written += snprintf(out + written, size - written, "%s\"%s\":%.1f",
+                                        i ? "," : "", NAMES[i], values[i]);
+                }
+                if (written < (int) size) {
+                    written += snprintf(out + written, size - written, "}");
+                }
+                return written;
+            }
+
+        }  // namespace
+
+        void endFrame() {
+            for (size_t i = 0; i < COUNTERS; i++) {
+                uint64_t total = totals[i].load(std::memory_order_relaxed);
+                lastCounts[i] = total - frameStart[i];
+                intervalCounts[i] += lastCounts[i];
+                frameStart[i] = total;
+            }
+            intervalFrames++;
+        }
+
+        uint64_t lastFrame(FrameCounter counter) {
+            return lastCounts[static_cast<size_t>(counter)];
+        }
+
+        void logInterval(uint64_t frame) {
+            if (intervalFrames == 0) {
+                return;
+            }
+            double average[COUNTERS];
+            double last[COUNTERS];
+            for (size_t i = 0; i < COUNTERS; i++) {
+                average[i] = double(intervalCounts[i]) / intervalFrames;
+                last[i] = double(lastCounts[i]);
+            }
+
+            LOGI("Per frame: %.1f allocs (%.0f bytes), %.1f maps, %.1f unmaps, %.1f pipeline "
+                 "binds, %.1f descriptor binds, %.1f buffer binds, %.1f draws, %.1f submits, "
+                 "%.1f barriers", average[0], average[1], average[2], average[3], average[4],
+                 average[5], average[6], average[7], average[8], average[9]);
+
+            char json[2048];
+            int written = snprintf(json, sizeof(json), "{\"frame\":%llu,\"frames\":%llu,\"avg\":",
+                                   (unsigned long long) frame,
+                                   (unsigned long long) intervalFrames);
+            written += appendObject(json + written, sizeof(json) - written, average);
+            written += snprintf(json + written, sizeof(json) - written, ",\"last\":");
+            written += appendObject(json + written, sizeof(json) - written, last);
+            snprintf(json + written, sizeof(json) - written, "}");
+            LOGI("FrameCounters %s", json);
+
+            for (size_t i = 0; i < COUNTERS; i++) {
+                intervalCounts[i] = 0;
+            }
+            intervalFrames = 0;
+        }
+
+    }  // namespace frame_counters
+
+}  // namespace vkt
+
+/*
+ * Global allocation functions. Every form goes through malloc / aligned_alloc so that each
+ * delete matches its new; only the allocating side is counted.
+ */
+static void *countedAllocate(size_t size, size_t alignment) {
+    vkt::frame_counters::add(vkt::FrameCounter::Allocations);
+    vkt::frame_counters::add(vkt::FrameCounter::AllocatedBytes, size);
+    if (size == 0) {
+        size = 1;
+    }
+    if (alignment <= alignof(std::max_align_t)) {
+        return malloc(size);
+    }
+    // aligned_alloc wants a multiple of the alignment
+    return aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1));
+}
+
+void *operator new(size_t size) {
+    if (void *p = countedAllocate(size, 0)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    return countedAllocate(size, 0);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return countedAllocate(size, 0);
+}
+
+void *operator new(size_t size, std::align_val_t alignment) {
+    if (void *p = countedAllocate(size, static_cast<size_t>(alignment))) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void operator delete(void *p) noexcept { free(p); }
+
+void operator delete[](void *p) noexcept { free(p); }
+
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+void operator delete(void *p, const std::nothrow_t &) noexcept { free(p); }
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept { free(p); }
+
+void operator delete(void *p, std::align_val_t) noexcept { free(p); }
+
+void operator delete[](void *p, std::align_val_t) noexcept { free(p); }
+
+void operator delete(void *p, size_t, std::align_val_t) noexcept { free(p); }
+
+void operator delete[](void *p, size_t, std::align_val_t) noexcept { free(p); }
+
+#endif  // VKT_FRAME_COUNTERS
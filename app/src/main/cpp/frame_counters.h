@@ -0,0 +1,78 @@
+#pragma once
+
+/*
+ * Per-frame counters for heap allocations and the Vulkan calls that cost CPU time in the frame
+ * loop. Built only with -DVKT_FRAME_COUNTERS=ON: otherwise nothing here exists, global operator
+ * new is the library's and the Vulkan calls below are the plain entry points.
+ *
+ * With counters on, global operator new is replaced and the counted Vulkan entry points are
+ * shadowed by macros of the same name in every file that includes vk_common.h: each call bumps
+ * its counter, then calls the real function. Totals are process wide, allocations made by worker
+ * threads count towards the frame they happen in. Command buffers that are reused rather than
+ * re-recorded make no bind or draw calls, so those frames count none.
+ */
+#ifdef VKT_FRAME_COUNTERS
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace vkt {
+
+    enum class FrameCounter : uint32_t {
+        Allocations,
+        AllocatedBytes,
+        MapCalls,
+        UnmapCalls,
+        PipelineBinds,
+        DescriptorBinds,
+        BufferBinds,
+        Draws,
+        Submits,
+        Barriers,
+        Count
+    };
+
+    namespace frame_counters {
+
+        extern std::atomic<uint64_t> totals[static_cast<size_t>(FrameCounter::Count)];
+
+        inline void add(FrameCounter counter, uint64_t amount = 1) {
+            totals[static_cast<size_t>(counter)].fetch_add(amount, std::memory_order_relaxed);
+        }
+
+        // Closes the frame: its counts become lastFrame() and go into the running interval
+        void endFrame();
+
+        uint64_t lastFrame(FrameCounter counter);
+
+        /*
+         * Logs the interval since the previous call, per frame on average and for the last
+         * frame, as a readable line and as one JSON object for benchmark scripts:
+         *   FrameCounters {"frame":N,"frames":K,"avg":{...},"last":{...}}
+         */
+        void logInterval(uint64_t frame);
+
+    }  // namespace frame_counters
+
+}  // namespace vkt
+
+#define VKT_COUNTED_CALL(counter, call) \
+    (vkt::frame_counters::add(vkt::FrameCounter::counter), call)
+
+#define vkMapMemory(...) VKT_COUNTED_CALL(MapCalls, vkMapMemory(__VA_ARGS__))
+#define vkUnmapMemory(...) VKT_COUNTED_CALL(UnmapCalls, vkUnmapMemory(__VA_ARGS__))
+#define vkCmdBindPipeline(...) VKT_COUNTED_CALL(PipelineBinds, vkCmdBindPipeline(__VA_ARGS__))
+#define vkCmdBindDescriptorSets(...) \
+    VKT_COUNTED_CALL(DescriptorBinds, vkCmdBindDescriptorSets(__VA_ARGS__))
+#define vkCmdBindVertexBuffers(...) \
+    VKT_COUNTED_CALL(BufferBinds, vkCmdBindVertexBuffers(__VA_ARGS__))
+#define vkCmdBindIndexBuffer(...) VKT_COUNTED_CALL(BufferBinds, vkCmdBindIndexBuffer(__VA_ARGS__))
+#define vkCmdDraw(...) VKT_COUNTED_CALL(Draws, vkCmdDraw(__VA_ARGS__))
+#define vkCmdDrawIndexed(...) VKT_COUNTED_CALL(Draws, vkCmdDrawIndexed(__VA_ARGS__))
+#define vkQueueSubmit(...) VKT_COUNTED_CALL(Submits, vkQueueSubmit(__VA_ARGS__))
+#define vkCmdPipelineBarrier(...) VKT_COUNTED_CALL(Barriers, vkCmdPipelineBarrier(__VA_ARGS__))
+
+#endif  // VKT_FRAME_COUNTERS
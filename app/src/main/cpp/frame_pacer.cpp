@@ -0,0 +1,56 @@
+#include "frame_pacer.h"
+
+#include <algorithm>
+
+namespace vkt {
+
+    void FramePacer::setTargetInterval(Duration newInterval) {
+        interval = newInterval;
+        hasSchedule = false;
+    }
+
+    FramePacer::TimePoint FramePacer::beginFrame(TimePoint now) {
+        if (interval.count() <= 0) {
+            return now;
+        }
+
+        pacedFrames++;
+        if (!hasSchedule) {
+            nextStart = now;
+            hasSchedule = true;
+        } else if (now > nextStart + interval) {
+            // More than a whole interval behind: don't try to catch up with a burst of frames,
+            // restart the schedule from here
+            missedFrames++;
+            nextStart = now;
+        }
+
+        TimePoint start = std::max(now, nextStart);
+        totalSleep += start - now;
+        nextStart = start + interval;
+        return start;
+    }
+
+    void FramePacer::reportFenceWait(Duration blocked) {
+        totalFenceWait += blocked;
+        if (interval.count() <= 0 || !hasSchedule) {
+            return;
+        }
+
+        // Ignore scheduler noise; anything longer means we woke up before the GPU was done. Move
+        // the schedule by half the difference so it converges without oscillating.
+        const Duration tolerance = interval / 32;
+        if (blocked > tolerance) {
+            nextStart += std::min(blocked / 2, interval);
+        }
+    }
+
+    void FramePacer::reset() {
+        hasSchedule = false;
+        pacedFrames = 0;
+        missedFrames = 0;
+        totalSleep = Duration(0);
+        totalFenceWait = Duration(0);
+    }
+
+}  // namespace vkt
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace vkt {
+
+    /*
+     * The pacer decides when the next frame should start. Instead of letting the render loop block
+     * inside vkWaitForFences (which wakes up at an arbitrary point and then races to record), we
+     * sleep until a target start time spaced by the frame interval. The time still spent blocked in
+     * the fence is reported back and shifts the schedule later, so that in steady state the fence
+     * is already signaled when we get to it.
+     *
+     * Time is passed in explicitly so the scheduling can be driven by a simulated vsync clock
+     * (tools/framepacing). Nothing here depends on Vulkan.
+     */
+    class FramePacer {
+    public:
+        using Duration = std::chrono::nanoseconds;
+        using TimePoint = std::chrono::time_point<std::chrono::steady_clock, Duration>;
+
+        // 0 turns pacing off: beginFrame() returns 'now' and nothing is counted
+        void setTargetInterval(Duration interval);
+
+        Duration targetInterval() const { return interval; }
+
+        // Returns when the frame should start, which is never earlier than 'now'
+        TimePoint beginFrame(TimePoint now);
+
+        // Time spent in vkWaitForFences after waking up at the time returned by beginFrame
+        void reportFenceWait(Duration blocked);
+
+        void reset();
+
+        // After the loop stood still: the next frame starts a new schedule instead of counting
+        // as missed, the counters are kept
+        void restartSchedule() { hasSchedule = false; }
+
+        uint64_t pacedFrames = 0;   // Frames scheduled by beginFrame
+        uint64_t missedFrames = 0;  // Frames that started more than an interval late
+        Duration totalSleep{0};     // Time handed back to the OS instead of spinning/blocking
+        Duration totalFenceWait{0}; // Time still blocked in the fence
+
+    private:
+        Duration interval{0};
+        TimePoint nextStart{};
+        bool hasSchedule = false;
+    };
+
+}  // namespace vkt
@@ -0,0 +1,102 @@
+#include "frame_pacing.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <initializer_list>
+
+namespace vkt {
+
+    static bool isPresentModeSupported(const std::vector<VkPresentModeKHR> &presentModes,
+                                       VkPresentModeKHR mode) {
+        return std::find(presentModes.begin(), presentModes.end(), mode) != presentModes.end();
+    }
+
+    PacingPolicy choosePacingPolicy(PacingMode mode, const VkSurfaceCapabilitiesKHR &capabilities,
+                                    const std::vector<VkPresentModeKHR> &presentModes) {
+        PacingPolicy policy{};
+        uint32_t imageCount = capabilities.minImageCount;
+
+        switch (mode) {
+            case PacingMode::LowLatency:
+                policy.framesInFlight = 1;
+                policy.pacedToRefresh = true;
+                if (isPresentModeSupported(presentModes, VK_PRESENT_MODE_MAILBOX_KHR)) {
+                    // MAILBOX replaces the queued image, it needs one spare to do so
+                    policy.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+                    imageCount = std::max(capabilities.minImageCount + 1, 3u);
+                } else {
+                    policy.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+                }
+                break;
+            case PacingMode::Balanced:
+                policy.framesInFlight = 2;
+                policy.pacedToRefresh = true;
+                policy.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+                imageCount = capabilities.minImageCount + 1;
+                break;
+            case PacingMode::Throughput:
+                policy.framesInFlight = 3;
+                // Back pressure from the swapchain limits the rate, no need to sleep
+                policy.pacedToRefresh = false;
+                policy.presentMode = isPresentModeSupported(presentModes,
+                                                            VK_PRESENT_MODE_FIFO_RELAXED_KHR)
+                                     ? VK_PRESENT_MODE_FIFO_RELAXED_KHR
+                                     : VK_PRESENT_MODE_FIFO_KHR;
+                imageCount = capabilities.minImageCount + 2;
+                break;
+        }
+
+        // A frame in flight always holds a swapchain image, there is no point having more
+        imageCount = std::max(imageCount, policy.framesInFlight);
+        if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount) {
+            imageCount = capabilities.maxImageCount;
+        }
+        policy.swapchainImageCount = imageCount;
+        return policy;
+    }
+
+    std::chrono::nanoseconds pacingInterval(const PacingPolicy &policy,
+                                            std::chrono::nanoseconds refreshPeriod) {
+        return policy.pacedToRefresh ? refreshPeriod : std::chrono::nanoseconds(0);
+    }
+
+    const char *toStringPacingMode(PacingMode mode) {
+        switch (mode) {
+            case PacingMode::LowLatency:
+                return "low-latency";
+            case PacingMode::Balanced:
+                return "balanced";
+            case PacingMode::Throughput:
+                return "throughput";
+        }
+        return "unknown";
+    }
+
+    bool parsePacingMode(const char *name, PacingMode &mode) {
+        for (PacingMode candidate: {PacingMode::LowLatency, PacingMode::Balanced,
+                                    PacingMode::Throughput}) {
+            if (strcmp(name, toStringPacingMode(candidate)) == 0) {
+                mode = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const char *toStringPresentMode(VkPresentModeKHR mode) {
+        switch (mode) {
+            case VK_PRESENT_MODE_IMMEDIATE_KHR:
+                return "IMMEDIATE";
+            case VK_PRESENT_MODE_MAILBOX_KHR:
+                return "MAILBOX";
+            case VK_PRESENT_MODE_FIFO_KHR:
+                return "FIFO";
+            case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+                return "FIFO_RELAXED";
+            default:
+                return "UNKNOWN";
+        }
+    }
+
+}  // namespace vkt
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "frame_pacer.h"
+
+namespace vkt {
+
+    /*
+     * How the swapchain and the CPU side of the frame loop are tuned:
+     * LowLatency: one frame in flight, as few queued images as possible, MAILBOX when available.
+     * Balanced: double buffering with FIFO (classic vsync), the previous default.
+     * Throughput: three frames in flight and an extra image so the GPU never starves; prefers
+     *             FIFO_RELAXED so a late frame tears instead of waiting a whole refresh.
+     */
+    enum class PacingMode {
+        LowLatency,
+        Balanced,
+        Throughput
+    };
+
+    struct PacingPolicy {
+        uint32_t framesInFlight;
+        uint32_t swapchainImageCount;
+        VkPresentModeKHR presentMode;
+        bool pacedToRefresh;  // the pacer sleeps to the display's refresh period
+    };
+
+    /*
+     * Picks frames in flight, image count and present mode from what the surface supports
+     * (querySwapChainSupport). FIFO is always available, every other mode is only used when listed.
+     */
+    PacingPolicy choosePacingPolicy(PacingMode mode, const VkSurfaceCapabilitiesKHR &capabilities,
+                                    const std::vector<VkPresentModeKHR> &presentModes);
+
+    /*
+     * Interval the FramePacer sleeps to. 'refreshPeriod' is the display's as reported by the
+     * swapchain, 0 while it isn't known: guessing 60 Hz would hold a 90 or 120 Hz display back,
+     * so until then the pacer doesn't sleep and the swapchain alone limits the rate.
+     */
+    std::chrono::nanoseconds pacingInterval(const PacingPolicy &policy,
+                                            std::chrono::nanoseconds refreshPeriod);
+
+    const char *toStringPacingMode(PacingMode mode);
+
+    // Inverse of toStringPacingMode, false for an unknown name
+    bool parsePacingMode(const char *name, PacingMode &mode);
+
+    const char *toStringPresentMode(VkPresentModeKHR mode);
+
+}  // namespace vkt
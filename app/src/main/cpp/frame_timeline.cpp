@@ -0,0 +1,158 @@
+#include "frame_timeline.h"
+
+#include <assert.h>
+
+#include <algorithm>
+
+#include "vk_common.h"
+
+namespace vkt {
+
+    void FrameTimeline::init(VkDevice newDevice, uint32_t framesInFlight,
+                             bool useTimelineSemaphore) {
+        device = newDevice;
+        slotValues.assign(framesInFlight, 0);
+        submittedValue = 0;
+        completed = 0;
+
+        if (useTimelineSemaphore) {
+            // Vulkan 1.1 loaders don't export the KHR entry points, fetch them from the device
+            waitSemaphores = (PFN_vkWaitSemaphoresKHR) vkGetDeviceProcAddr(
+                    device, "vkWaitSemaphoresKHR");
+            getSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValueKHR) vkGetDeviceProcAddr(
+                    device, "vkGetSemaphoreCounterValueKHR");
+        }
+
+        if (waitSemaphores != nullptr && getSemaphoreCounterValue != nullptr) {
+            VkSemaphoreTypeCreateInfoKHR typeInfo{};
+            typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+            typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+            typeInfo.initialValue = 0;
+
+            VkSemaphoreCreateInfo semaphoreInfo{};
+            semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            semaphoreInfo.pNext = &typeInfo;
+
+            VK_CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &timelineSemaphore));
+            return;
+        }
+
+        // Fallback: one fence per frame slot, created signaled so the first wait returns
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        slotFences.resize(framesInFlight);
+        for (auto &fence: slotFences) {
+            VK_CHECK(vkCreateFence(device, &fenceInfo, nullptr, &fence));
+        }
+    }
+
+    void FrameTimeline::destroy() {
+        if (timelineSemaphore != VK_NULL_HANDLE) {
+            vkDestroySemaphore(device, timelineSemaphore, nullptr);
+            timelineSemaphore = VK_NULL_HANDLE;
+        }
+        for (auto fence: slotFences) {
+            vkDestroyFence(device, fence, nullptr);
+        }
+        slotFences.clear();
+        waitSemaphores = nullptr;
+        getSemaphoreCounterValue = nullptr;
+    }
+
+    void FrameTimeline::resize(uint32_t framesInFlight) {
+        // Every frame submitted so far has finished, waiting on any slot returns straight away
+        completed = submittedValue;
+        slotValues.assign(framesInFlight, submittedValue);
+        if (usesTimelineSemaphore()) {
+            return;
+        }
+
+        for (auto fence: slotFences) {
+            vkDestroyFence(device, fence, nullptr);
+        }
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        slotFences.resize(framesInFlight);
+        for (auto &fence: slotFences) {
+            VK_CHECK(vkCreateFence(device, &fenceInfo, nullptr, &fence));
+        }
+    }
+
+    void FrameTimeline::waitForSlot(uint32_t slot) {
+        if (usesTimelineSemaphore()) {
+            wait(slotValues[slot]);
+            return;
+        }
+
+        VK_CHECK(vkWaitForFences(device, 1, &slotFences[slot], VK_TRUE, UINT64_MAX));
+        completed = std::max(completed, slotValues[slot]);
+    }
+
+    FrameTimeline::SubmitSignal FrameTimeline::beginSubmit(uint32_t slot) {
+        SubmitSignal signal{};
+        signal.value = ++submittedValue;
+        slotValues[slot] = signal.value;
+
+        if (usesTimelineSemaphore()) {
+            signal.semaphore = timelineSemaphore;
+        } else {
+            VK_CHECK(vkResetFences(device, 1, &slotFences[slot]));
+            signal.fence = slotFences[slot];
+        }
+        return signal;
+    }
+
+    uint64_t FrameTimeline::completedValue() {
+        if (usesTimelineSemaphore()) {
+            uint64_t value = 0;
+            VK_CHECK(getSemaphoreCounterValue(device, timelineSemaphore, &value));
+            completed = std::max(completed, value);
+            return completed;
+        }
+
+        // The queue executes in submission order, so a signaled fence completes every frame
+        // before it as well
+        for (size_t i = 0; i < slotFences.size(); i++) {
+            if (slotValues[i] > completed && vkGetFenceStatus(device, slotFences[i]) == VK_SUCCESS) {
+                completed = slotValues[i];
+            }
+        }
+        return completed;
+    }
+
+    bool FrameTimeline::isComplete(uint64_t frame) {
+        return frame <= completed || frame <= completedValue();
+    }
+
+    void FrameTimeline::wait(uint64_t frame) {
+        if (frame <= completed) {
+            return;
+        }
+        assert(frame <= submittedValue);  // waiting on a frame that was never submitted
+
+        if (usesTimelineSemaphore()) {
+            VkSemaphoreWaitInfoKHR waitInfo{};
+            waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+            waitInfo.semaphoreCount = 1;
+            waitInfo.pSemaphores = &timelineSemaphore;
+            waitInfo.pValues = &frame;
+            VK_CHECK(waitSemaphores(device, &waitInfo, UINT64_MAX));
+            completed = std::max(completed, frame);
+            return;
+        }
+
+        // Wait on the oldest slot that covers the requested frame
+        int oldest = -1;
+        for (size_t i = 0; i < slotValues.size(); i++) {
+            if (slotValues[i] >= frame && (oldest < 0 || slotValues[i] < slotValues[oldest])) {
+                oldest = static_cast<int>(i);
+            }
+        }
+        if (oldest >= 0) {
+            waitForSlot(static_cast<uint32_t>(oldest));
+        }
+    }
+
+}  // namespace vkt
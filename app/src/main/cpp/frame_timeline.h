@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace vkt {
+
+    /*
+     * Frame synchronization for one queue, built around a monotonically increasing frame number.
+     * Every submission that ends a frame signals the next number, so anything that needs to know
+     * "has the GPU finished frame N" (uploads, readback, deferred deletion...) can ask
+     * isComplete(N) or wait(N) without owning a fence of its own.
+     *
+     * With VK_KHR_timeline_semaphore the frame number is the value of a single timeline semaphore:
+     * no fence is waited on or reset per frame. Without it we fall back to one VkFence per frame
+     * slot, which is what the sample used before, and track the completed frame number on the CPU.
+     */
+    class FrameTimeline {
+    public:
+        // Falls back to fences if the timeline path was requested but its entry points are missing
+        void init(VkDevice device, uint32_t framesInFlight, bool useTimelineSemaphore);
+
+        void destroy();
+
+        // With the device idle: 'framesInFlight' slots from now on, the frame numbers carry on
+        void resize(uint32_t framesInFlight);
+
+        bool usesTimelineSemaphore() const { return timelineSemaphore != VK_NULL_HANDLE; }
+
+        // Blocks until the last frame submitted from 'slot' has finished on the GPU
+        void waitForSlot(uint32_t slot);
+
+        /*
+         * Reserves the frame number for the submission about to be made from 'slot'. Fills in what
+         * has to go into vkQueueSubmit: the fence (fallback path, already reset) or the timeline
+         * semaphore and its signal value.
+         */
+        struct SubmitSignal {
+            VkFence fence = VK_NULL_HANDLE;
+            VkSemaphore semaphore = VK_NULL_HANDLE;
+            uint64_t value = 0;
+        };
+
+        SubmitSignal beginSubmit(uint32_t slot);
+
+        // Frame number of the most recent submission (0 before the first frame)
+        uint64_t lastSubmitted() const { return submittedValue; }
+
+        // Highest frame number known to be finished by the GPU
+        uint64_t completedValue();
+
+        bool isComplete(uint64_t frame);
+
+        void wait(uint64_t frame);
+
+    private:
+        VkDevice device = VK_NULL_HANDLE;
+        VkSemaphore timelineSemaphore = VK_NULL_HANDLE;
+        PFN_vkWaitSemaphoresKHR waitSemaphores = nullptr;
+        PFN_vkGetSemaphoreCounterValueKHR getSemaphoreCounterValue = nullptr;
+
+        std::vector<VkFence> slotFences;        // Fallback only
+        std::vector<uint64_t> slotValues;       // Frame number last submitted from each slot
+        uint64_t submittedValue = 0;
+        uint64_t completed = 0;
+    };
+
+}  // namespace vkt
@@ -0,0 +1,117 @@
+#include "gpu_timer.h"
+
+#include "vk_common.h"
+
+namespace vkt {
+
+    bool GpuTimer::init(VkPhysicalDevice physicalDevice, VkDevice newDevice,
+                        uint32_t queueFamilyIndex, uint32_t frameSlots, uint32_t maxScopes) {
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+        uint32_t validBits = families[queueFamilyIndex].timestampValidBits;
+        if (validBits == 0) {
+            return false;
+        }
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        nanosecondsPerTick = properties.limits.timestampPeriod;
+        validMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+        // The frame's first stamp, one per mark() and the last one
+        maxQueries = maxScopes + 2;
+        results.resize(maxQueries);
+        slots.resize(frameSlots);
+        for (auto &slot: slots) {
+            VkQueryPoolCreateInfo poolInfo{};
+            poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            poolInfo.queryCount = maxQueries;
+            VK_CHECK(vkCreateQueryPool(newDevice, &poolInfo, nullptr, &slot.pool));
+        }
+        device = newDevice;
+        return true;
+    }
+
+    void GpuTimer::destroy() {
+        for (auto &slot: slots) {
+            vkDestroyQueryPool(device, slot.pool, nullptr);
+        }
+        slots.clear();
+        labelTimes.clear();
+        frameTime = {};
+        device = VK_NULL_HANDLE;
+    }
+
+    void GpuTimer::beginFrame(VkCommandBuffer commandBuffer, uint32_t slotIndex) {
+        if (!isReady()) {
+            return;
+        }
+        Slot &slot = slots[slotIndex];
+        slot.labels.clear();
+        slot.queries = 1;
+        vkCmdResetQueryPool(commandBuffer, slot.pool, 0, maxQueries);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, slot.pool, 0);
+    }
+
+    void GpuTimer::mark(VkCommandBuffer commandBuffer, uint32_t slotIndex, uint32_t label) {
+        if (!isReady()) {
+            return;
+        }
+        Slot &slot = slots[slotIndex];
+        if (slot.queries + 1 >= maxQueries) {
+            return;  // out of queries, the running stretch keeps its label
+        }
+        // Bottom of pipe: the stamp is taken once the previous draws have fully finished
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, slot.pool,
+                            slot.queries++);
+        slot.labels.push_back(label);
+    }
+
+    void GpuTimer::endFrame(VkCommandBuffer commandBuffer, uint32_t slotIndex) {
+        if (!isReady()) {
+            return;
+        }
+        Slot &slot = slots[slotIndex];
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, slot.pool,
+                            slot.queries++);
+    }
+
+    void GpuTimer::submitted(uint32_t slotIndex) {
+        if (isReady()) {
+            slots[slotIndex].pending = true;
+        }
+    }
+
+    void GpuTimer::collect(uint32_t slotIndex) {
+        if (!isReady() || !slots[slotIndex].pending) {
+            return;
+        }
+        Slot &slot = slots[slotIndex];
+        slot.pending = false;
+
+        VkResult result = vkGetQueryPoolResults(device, slot.pool, 0, slot.queries,
+                                                slot.queries * sizeof(uint64_t), results.data(),
+                                                sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+        if (result != VK_SUCCESS) {
+            return;  // VK_NOT_READY, skip this frame rather than wait
+        }
+
+        auto ticksToMs = [this](uint64_t from, uint64_t to) {
+            return double((to - from) & validMask) * nanosecondsPerTick / 1e6;
+        };
+        // Stamp 0 is the start of the frame, stamp 1 the first mark, the stretch before the first
+        // mark only counts towards the frame
+        for (uint32_t i = 0; i < slot.labels.size(); i++) {
+            Scope &scope = labelTimes[slot.labels[i]];
+            scope.totalMs += ticksToMs(results[i + 1], results[i + 2]);
+            scope.samples++;
+        }
+        lastFrame = ticksToMs(results[0], results[slot.queries - 1]);
+        frameTime.totalMs += lastFrame;
+        frameTime.samples++;
+    }
+
+}  // namespace vkt
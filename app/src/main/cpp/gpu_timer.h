@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace vkt {
+
+    /*
+     * GPU timestamps around labelled stretches of a frame's commands, one query pool per frame
+     * slot. mark() ends the running stretch and starts one with a new label, so consecutive draws
+     * sharing a label are timed together. Results are read back without waiting once the slot's
+     * frame is known to be complete, and accumulated per label.
+     *
+     * The recorded labels belong to the slot, not to the command buffer: every command buffer a
+     * slot submits must have been recorded with the same marks since its last collect().
+     */
+    class GpuTimer {
+    public:
+        struct Scope {
+            double totalMs = 0;
+            uint64_t samples = 0;    // frames the label was measured in
+
+            double averageMs() const { return samples ? totalMs / samples : 0; }
+        };
+
+        // False (and every other call a no-op) when the queue family has no timestamp support
+        bool init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex,
+                  uint32_t frameSlots, uint32_t maxScopes);
+
+        void destroy();
+
+        bool isReady() const { return device != VK_NULL_HANDLE; }
+
+        // Outside a render pass: resets the slot's queries and writes the frame's first stamp
+        void beginFrame(VkCommandBuffer commandBuffer, uint32_t slot);
+
+        void mark(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t label);
+
+        void endFrame(VkCommandBuffer commandBuffer, uint32_t slot);
+
+        // After the slot's command buffer went to the queue
+        void submitted(uint32_t slot);
+
+        // After the slot's fence or timeline value has been waited on
+        void collect(uint32_t slot);
+
+        const std::map<uint32_t, Scope> &scopes() const { return labelTimes; }
+
+        const Scope &frames() const { return frameTime; }
+
+        double lastFrameMs() const { return lastFrame; }
+
+    private:
+        struct Slot {
+            VkQueryPool pool = VK_NULL_HANDLE;
+            std::vector<uint32_t> labels;  // label of the stretch starting at query i + 1
+            uint32_t queries = 0;          // written by the last recording
+            bool pending = false;          // submitted and not collected yet
+        };
+
+        VkDevice device = VK_NULL_HANDLE;
+        double nanosecondsPerTick = 1;
+        uint64_t validMask = ~0ull;
+        uint32_t maxQueries = 0;
+        std::vector<Slot> slots;
+        std::vector<uint64_t> results;
+        std::map<uint32_t, Scope> labelTimes;
+        Scope frameTime;
+        double lastFrame = 0;
+    };
+
+}  // namespace vkt
@@ -1,30 +1,13 @@
 #include "hellovk.h"
 
-#define STB_IMAGE_IMPLEMENTATION
-
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #define GLM_ENABLE_EXPERIMENTAL
 #define GLM_FORCE_LEFT_HANDED
 
-#include <stb_image.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-std::vector<uint8_t> LoadBinaryFileToVector(const char *file_path, AAssetManager *assetManager) {
-    std::vector<uint8_t> file_content;
-    assert(assetManager);
-    AAsset *file =
-            AAssetManager_open(assetManager, file_path, AASSET_MODE_BUFFER);
-    size_t file_length = AAsset_getLength(file);
-
-    file_content.resize(file_length);
-
-    AAsset_read(file, file_content.data(), file_length);
-    AAsset_close(file);
-    return file_content;
-}
-
 const char *toStringMessageSeverity(VkDebugUtilsMessageSeverityFlagBitsEXT s) {
     switch (s) {
         case VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT:
@@ -109,6 +92,98 @@ static void DestroyDebugUtilsMessengerEXT(VkInstance instance,
     }
 }
 
+/*
+ * Only the four rotations matter for pre-rotation; mirrored transforms are not reported by Android
+ * for the built-in display, so they are treated as identity.
+ */
+static vkt::SurfaceRotation toSurfaceRotation(VkSurfaceTransformFlagBitsKHR transform) {
+    switch (transform) {
+        case VK_SURFACE_TRANSFORM_ROTATE_90_BIT_KHR:
+            return vkt::SurfaceRotation::Rotate90;
+        case VK_SURFACE_TRANSFORM_ROTATE_180_BIT_KHR:
+            return vkt::SurfaceRotation::Rotate180;
+        case VK_SURFACE_TRANSFORM_ROTATE_270_BIT_KHR:
+            return vkt::SurfaceRotation::Rotate270;
+        default:
+            return vkt::SurfaceRotation::Identity;
+    }
+}
+
+// View depth of an object's origin, normalized for the draw sort keys
+static float normalizedViewDepth(const vkt::UniformBufferObject &ubo) {
+    glm::vec4 viewPos = ubo.view * ubo.model * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    return viewPos.z / vkt::CAMERA_FAR_PLANE;
+}
+
+/*
+ * Point lights in rings around the cube, each orbiting at its own speed. Positions and colors are
+ * spread with the golden ratio so any count covers the scene evenly, and the colors dim as the
+ * count grows so the scene keeps about the same brightness.
+ */
+static std::vector<vkt::PointLight> scenePointLights(uint32_t count) {
+    const glm::vec3 attenuation(1.0f, 4.0f, 40.0f);  // reaches about 1.2 units
+    const glm::vec3 palette[] = {{1.0f, 0.45f, 0.3f}, {0.3f, 0.6f, 1.0f}, {0.4f, 1.0f, 0.45f},
+                                 {1.0f, 0.85f, 0.3f}, {0.85f, 0.4f, 1.0f}};
+    float dim = std::min(1.0f, 16.0f / std::max(count, 1u));
+    std::vector<vkt::PointLight> lights(count);
+    for (uint32_t i = 0; i < count; i++) {
+        float t = (i + 0.5f) / count;
+        float angle = i * 2.39996323f;  // golden angle
+        float ring = 0.9f + 2.1f * std::sqrt(t);
+        float height = -0.7f + 1.9f * std::fmod(i * 0.618034f, 1.0f);
+        float intensity = 1.0f;
+        lights[i].positionRadius = glm::vec4(ring * std::cos(angle), height,
+                                             ring * std::sin(angle),
+                                             vkt::lightRadius(intensity, attenuation));
+        lights[i].colorIntensity = glm::vec4(palette[i % 5] * dim, intensity);
+        lights[i].attenuation = glm::vec4(attenuation, 0.0f);
+    }
+    return lights;
+}
+
+static const char *loadOpName(VkAttachmentLoadOp op) {
+    switch (op) {
+        case VK_ATTACHMENT_LOAD_OP_LOAD:
+            return "load";
+        case VK_ATTACHMENT_LOAD_OP_CLEAR:
+            return "clear";
+        default:
+            return "dont-care";
+    }
+}
+
+static const char *storeOpName(VkAttachmentStoreOp op) {
+    return op == VK_ATTACHMENT_STORE_OP_STORE ? "store" : "dont-care";
+}
+
+/*
+ * On a tiled GPU every LOAD reads an attachment from memory into tile memory and every STORE
+ * writes it back. No pass here needs an attachment's previous contents, and only the single
+ * sampled color at 'outputIndex' is read after the pass (presented or blitted), so anything else
+ * loaded or stored is bandwidth spent for nothing. Logs every attachment and flags those.
+ */
+static void auditAttachments(const char *pass, const VkAttachmentDescription *attachments,
+                             uint32_t count, uint32_t outputIndex) {
+    for (uint32_t i = 0; i < count; i++) {
+        const VkAttachmentDescription &a = attachments[i];
+        LOGI("Render pass %s, attachment %u: %ux, %s/%s, stencil %s/%s", pass, i,
+             static_cast<uint32_t>(a.samples), loadOpName(a.loadOp), storeOpName(a.storeOp),
+             loadOpName(a.stencilLoadOp), storeOpName(a.stencilStoreOp));
+        if (a.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD ||
+            a.stencilLoadOp == VK_ATTACHMENT_LOAD_OP_LOAD) {
+            LOGE("Render pass %s, attachment %u: needless load", pass, i);
+        }
+        if (i == outputIndex) {
+            if (a.storeOp != VK_ATTACHMENT_STORE_OP_STORE) {
+                LOGE("Render pass %s, attachment %u: output is not stored", pass, i);
+            }
+        } else if (a.storeOp == VK_ATTACHMENT_STORE_OP_STORE ||
+                   a.stencilStoreOp == VK_ATTACHMENT_STORE_OP_STORE) {
+            LOGE("Render pass %s, attachment %u: needless store", pass, i);
+        }
+    }
+}
+
 std::vector<const char *> getRequiredExtensions(bool enableValidationLayers) {
     std::vector<const char *> extensions;
     extensions.push_back("VK_KHR_surface");
@@ -139,18 +214,29 @@ void HelloVK::initVulkan() {
     createRenderPass();              // Sspecifies how rendering is done
     createDescriptorSetLayouts();     // Creates the descriptor set layout to describe how shaders access resources
     createGraphicsPipeline();        // Creates the graphics pipeline, (specifies shaders and their configuration)
+    createDepthResources();          // Depth and MSAA color attachments, kept in tile memory
     createFramebuffers();            // Creates framebuffers for each swap chain image
+    createOffscreenTarget();         // Render target of dynamic resolution
     createCommandPool();             // Creates a command pool for managing command buffers
+    uploads.init(physicalDevice, device, graphicsQueue,
+                 findQueueFamilies(physicalDevice).graphicsFamily.value());
     createCommandBuffers();          // Creates the command buffer to record drawing commands
+    if (!gpuTimer.init(physicalDevice, device,
+                       findQueueFamilies(physicalDevice).graphicsFamily.value(), framesInFlight,
+                       MAX_TIMED_SCOPES)) {
+        LOGI("No timestamp support on the graphics queue, GPU times not measured");
+    }
 
-    decodeImage();
+    decodeTextures();
     createTextureImage();
-    copyBufferToImage();
+    uploadTextureImage();
     createTextureImageViews();
     createTextureSampler();
 
     createVertexBuffer();            // Vertex buffers creation
     createIndexBuffer();             // Index buffers creation
+    submitUploads();                 // One submission for every copy queued above
+    pipelines.wait(fallbackPipeline); // Compiled on a worker meanwhile
     createUniformBuffers();          // Creates uniform buffers for passing data to shaders (MVP matrices)
     createDescriptorPool();          // Creates a descriptor pool to allocate resources like uniform buffers and textures
     createDescriptorSets();          // Creates descriptor sets for shaders to access resources (like uniform buffers)
@@ -247,6 +333,8 @@ void HelloVK::pickPhysicalDevice() {
     }
 
     assert(physicalDevice != VK_NULL_HANDLE);  // failed to find a suitable GPU!
+
+    optionalFeatures = queryOptionalDeviceFeatures(physicalDevice);
 }
 
 /*
@@ -283,6 +371,43 @@ bool HelloVK::checkDeviceExtensionSupport(VkPhysicalDevice device) {
     return requiredExtensions.empty();
 }
 
+/*
+ * Optional extensions need both the extension string and, for most of them, the feature bit
+ * reported through vkGetPhysicalDeviceFeatures2 (core in Vulkan 1.1).
+ */
+OptionalDeviceFeatures HelloVK::queryOptionalDeviceFeatures(VkPhysicalDevice device) {
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                         availableExtensions.data());
+
+    std::set<std::string> extensionNames;
+    for (const auto &extension: availableExtensions) {
+        extensionNames.insert(extension.extensionName);
+    }
+
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures{};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+
+    VkPhysicalDeviceFeatures2 features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &timelineFeatures;
+    vkGetPhysicalDeviceFeatures2(device, &features2);
+
+    OptionalDeviceFeatures features;
+    features.timelineSemaphore = extensionNames.count(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) &&
+                                 timelineFeatures.timelineSemaphore;
+    features.hostImageCopy = HostImageCopy::isSupported(device, extensionNames);
+    features.graphicsPipelineLibrary = PipelineService::isSupported(device, extensionNames);
+    features.displayTiming = extensionNames.count(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+
+    LOGI("Optional features: timeline semaphore %d, host image copy %d, pipeline library %d, "
+         "display timing %d", features.timelineSemaphore, features.hostImageCopy,
+         features.graphicsPipelineLibrary, features.displayTiming);
+    return features;
+}
+
 QueueFamilyIndices HelloVK::findQueueFamilies(VkPhysicalDevice device) const {
     QueueFamilyIndices indices;
 
@@ -335,15 +460,48 @@ void HelloVK::createLogicalDeviceAndQueue() {
 
     VkPhysicalDeviceFeatures deviceFeatures{};
 
+    // Optional extensions are appended to the required ones, their feature structs chained below
+    std::vector<const char *> enabledExtensions = deviceExtensions;
+    void *featureChain = nullptr;
+
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures{};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+    if (optionalFeatures.timelineSemaphore) {
+        enabledExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+        timelineFeatures.timelineSemaphore = VK_TRUE;
+        timelineFeatures.pNext = featureChain;
+        featureChain = &timelineFeatures;
+    }
+
+    if (optionalFeatures.hostImageCopy && preferHostImageCopy) {
+        for (const char *extension: HostImageCopy::deviceExtensions()) {
+            enabledExtensions.push_back(extension);
+        }
+        featureChain = hostImageCopy.chainFeatures(featureChain);
+    }
+
+    if (optionalFeatures.graphicsPipelineLibrary && preferPipelineLibraries) {
+        for (const char *extension: PipelineService::deviceExtensions()) {
+            enabledExtensions.push_back(extension);
+        }
+        featureChain = pipelines.chainFeatures(featureChain);
+    }
+
+    // Only for the display's refresh period, the frame pacer works from it
+    if (optionalFeatures.displayTiming) {
+        enabledExtensions.push_back(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+    }
+
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = featureChain;
     createInfo.queueCreateInfoCount =
             static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.pEnabledFeatures = &deviceFeatures;
     createInfo.enabledExtensionCount =
-            static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+            static_cast<uint32_t>(enabledExtensions.size());
+    createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
     if (enableValidationLayers) {
         createInfo.enabledLayerCount =
@@ -355,6 +513,19 @@ void HelloVK::createLogicalDeviceAndQueue() {
 
     VK_CHECK(vkCreateDevice(physicalDevice, &createInfo, nullptr, &device));
 
+    if (optionalFeatures.hostImageCopy && preferHostImageCopy &&
+        !hostImageCopy.init(physicalDevice, device)) {
+        LOGE("VK_EXT_host_image_copy entry points missing, uploading through staging");
+    }
+    if (optionalFeatures.displayTiming) {
+        getRefreshCycleDuration = (PFN_vkGetRefreshCycleDurationGOOGLE) vkGetDeviceProcAddr(
+                device, "vkGetRefreshCycleDurationGOOGLE");
+    }
+    pipelines.init(physicalDevice, device, &workerPool,
+                   optionalFeatures.graphicsPipelineLibrary && preferPipelineLibraries);
+    // An optimized variant replacing a fast link or the fallback is worth a frame
+    pipelines.setPublishCallback([this]() { redraw.invalidate(REDRAW_PIPELINE); });
+
     vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
     vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
 }
@@ -425,25 +596,99 @@ SwapChainSupportDetails HelloVK::querySwapChainSupport(VkPhysicalDevice device)
 /*
  * Sync objects are objects used for synchronization. Vulkan has VkFence, VkSemaphore, and VkEvent
  * which are used to control resource access across multiple queues. These objects are needed if
- * you're using multiple queues and render passes. For our simple example, we wouldn't be using it.
+ * you're using multiple queues and render passes.
+ *
+ * The swapchain still needs binary semaphores (acquire and present can't use timeline ones). The
+ * CPU side waits on the frame timeline: a single timeline semaphore on the graphics queue when
+ * supported, one fence per frame in flight otherwise.
  */
 void HelloVK::createSyncObjects() {
-    imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+    imageAvailableSemaphores.resize(framesInFlight);
+    renderFinishedSemaphores.resize(framesInFlight);
 
     VkSemaphoreCreateInfo semaphoreInfo{};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    for (size_t i = 0; i < framesInFlight; i++) {
         VK_CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]));
 
         VK_CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]));
+    }
+
+    if (initialized) {
+        // A new number of frames in flight, the frame numbers carry on
+        frameTimeline.resize(framesInFlight);
+        return;
+    }
+    frameTimeline.init(device, framesInFlight,
+                       optionalFeatures.timelineSemaphore && preferTimelineSemaphore);
+    LOGI("Frame synchronization: %s",
+         frameTimeline.usesTimelineSemaphore() ? "timeline semaphore" : "fences");
+}
+
+/*
+ * A pacing mode with another number of frames in flight: everything sized by it is destroyed and
+ * created again for 'count' slots. Textures, pipelines and the device stay. The GPU timer starts
+ * its averages over, the frame arenas keep their blocks.
+ */
+void HelloVK::resizeFrameSlots(uint32_t count) {
+    LOGI("Frames in flight: %u -> %u", framesInFlight, count);
+    for (size_t i = 0; i < framesInFlight; i++) {
+        vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
+        vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
+    }
+    destroyUniformBuffers();
+    // Frees the descriptor sets with it
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(commandBuffers.size()),
+                         commandBuffers.data());
+    gpuTimer.destroy();
+
+    framesInFlight = count;
+    currentFrame = 0;
+    for (FrameArena &arena: frameArenas) {
+        arena.reset();
+    }
+
+    createUniformBuffers();
+    createDescriptorPool();
+    createDescriptorSets();
+    createSyncObjects();
+    createCommandBuffers();
+    if (!gpuTimer.init(physicalDevice, device,
+                       findQueueFamilies(physicalDevice).graphicsFamily.value(), framesInFlight,
+                       MAX_TIMED_SCOPES)) {
+        LOGI("No timestamp support on the graphics queue, GPU times not measured");
+    }
+    resolutionSamples = 0;
+}
 
-        VK_CHECK(vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]));
+void HelloVK::updateRefreshPeriod() {
+    std::chrono::nanoseconds period(0);
+    VkRefreshCycleDurationGOOGLE refreshCycle{};
+    if (getRefreshCycleDuration != nullptr && swapChain != VK_NULL_HANDLE &&
+        getRefreshCycleDuration(device, swapChain, &refreshCycle) == VK_SUCCESS) {
+        period = std::chrono::nanoseconds(refreshCycle.refreshDuration);
+    }
+    std::chrono::nanoseconds interval = pacingInterval(pacingPolicy, period);
+    if (period == displayRefreshPeriod && interval == framePacer.targetInterval()) {
+        return;
+    }
+
+    if (period != displayRefreshPeriod) {
+        if (period.count() > 0) {
+            LOGI("Display refresh period %.3f ms",
+                 std::chrono::duration<double, std::milli>(period).count());
+        } else {
+            LOGI("Display refresh period unknown: frames not paced, resolution not scaled");
+        }
+    }
+    displayRefreshPeriod = period;
+    framePacer.setTargetInterval(interval);
+    // The GPU gets most of a refresh, the rest is slack for the timer's noise
+    if (period.count() > 0) {
+        resolution.setTargetMs(std::chrono::duration<double, std::milli>(period).count() *
+                               GPU_FRAME_BUDGET);
     }
 }
 
@@ -470,16 +715,26 @@ void HelloVK::createSwapChain() {
 
     VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
 
-    // VK_PRESENT_MODE_FIFO_KHR = Hard Vsync --> https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkPresentModeKHR.html
-    // This is always supported on Android phones
-    VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
-
-    uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
-    if (swapChainSupport.capabilities.maxImageCount > 0 &&
-        imageCount > swapChainSupport.capabilities.maxImageCount) {
-        imageCount = swapChainSupport.capabilities.maxImageCount;
+    // Present mode and image count come from the pacing policy, VK_PRESENT_MODE_FIFO_KHR (hard
+    // vsync) is the fallback since it is always supported on Android phones
+    // --> https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkPresentModeKHR.html
+    pacingMode = requestedPacingMode.load(std::memory_order_relaxed);
+    pacingPolicy = choosePacingPolicy(pacingMode, swapChainSupport.capabilities,
+                                      swapChainSupport.presentModes);
+    if (!initialized) {
+        // Per frame resources (command buffers, uniforms, descriptor sets, sync objects) are
+        // created after the swapchain and sized with this value, later changes are made by
+        // recreateSwapChain()
+        framesInFlight = pacingPolicy.framesInFlight;
     }
+    LOGI("Pacing %s: %u frames in flight, %u images, %s", toStringPacingMode(pacingMode),
+         pacingPolicy.framesInFlight, pacingPolicy.swapchainImageCount,
+         toStringPresentMode(pacingPolicy.presentMode));
+
+    VkPresentModeKHR presentMode = pacingPolicy.presentMode;
+    uint32_t imageCount = pacingPolicy.swapchainImageCount;
     pretransformFlag = swapChainSupport.capabilities.currentTransform;
+    surfaceRotation = toSurfaceRotation(pretransformFlag);
 
     VkSwapchainCreateInfoKHR createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
@@ -492,6 +747,22 @@ void HelloVK::createSwapChain() {
     createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
     createInfo.preTransform = pretransformFlag;
 
+    // Dynamic resolution blits the offscreen target into the swapchain images: both sides of the
+    // blit have the surface format
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, surfaceFormat.format, &formatProperties);
+    VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+    dynamicResolution = preferDynamicResolution &&
+                        (swapChainSupport.capabilities.supportedUsageFlags &
+                         VK_IMAGE_USAGE_TRANSFER_DST_BIT) &&
+                        (formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures;
+    blitFilter = (formatProperties.optimalTilingFeatures &
+                  VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR
+                                                                     : VK_FILTER_NEAREST;
+    if (dynamicResolution) {
+        createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    }
+
     QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
     uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(), indices.presentFamily.value()};
 
@@ -517,24 +788,110 @@ void HelloVK::createSwapChain() {
 
     swapChainImageFormat = surfaceFormat.format;
     swapChainExtent = displaySizeIdentity;
+
+    // The pacer sleeps to the refresh period of this swapchain's display
+    updateRefreshPeriod();
 }
 
-void HelloVK::reset(ANativeWindow *newWindow, AAssetManager *newManager) {
-    window.reset(newWindow);
+void HelloVK::setAssetManager(AAssetManager *newManager) {
     assetManager = newManager;
 
-    if (initialized) {
-        createSurface();
-        recreateSwapChain();
+    // Assets are read through views into the APK mapping instead of copies
+    assert(assetManager);
+    assets.unmountAll();
+    mountAssetPack(PACK_FILE_NAME);
+    assets.mount(std::make_unique<AndroidAssetSource>(assetManager));
+}
+
+// The glue's window reference only lasts until APP_CMD_TERM_WINDOW returns: hold our own
+void HelloVK::setWindow(ANativeWindow *newWindow) {
+    if (newWindow != nullptr) {
+        ANativeWindow_acquire(newWindow);
     }
+    window.reset(newWindow);
+}
+
+void HelloVK::createDevice(ANativeWindow *newWindow) {
+    setWindow(newWindow);
+    initVulkan();
+    redraw.invalidate(REDRAW_LIFECYCLE);
+}
+
+/*
+ * Instance, device, buffers, textures, pipelines and descriptors survive the window: only what
+ * refers to the surface is rebuilt. The render pass is kept, which assumes the new surface
+ * offers the same format as the first one (same display, same device).
+ */
+void HelloVK::attachSurface(ANativeWindow *newWindow) {
+    assert(initialized && surface == VK_NULL_HANDLE);
+    setWindow(newWindow);
+    createSurface();
+    // Also checks that the present queue can present to the new surface
+    assert(findQueueFamilies(physicalDevice).isComplete());
+    recreateSwapChain();
+    orientationChanged = false;
+    redraw.invalidate(REDRAW_LIFECYCLE);
+}
+
+void HelloVK::detachSurface() {
+    vkDeviceWaitIdle(device);
+    cleanupSwapChain();
+    vkDestroySurfaceKHR(instance, surface, nullptr);
+    surface = VK_NULL_HANDLE;
+    window.reset();
+}
+
+void HelloVK::destroyDevice() {
+    cleanup();
+    window.reset();
+}
+
+/*
+ * Mounts a packed archive in front of the loose APK assets when the APK ships one, lookups that
+ * miss the pack still fall through to the loose files.
+ */
+void HelloVK::mountAssetPack(const char *packName) {
+    AndroidAssetSource apk(assetManager);
+    auto pack = std::make_shared<AssetPack>();
+    auto start = std::chrono::steady_clock::now();
+    if (!pack->open(apk.open(packName))) {
+        return;
+    }
+    auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+    LOGI("Mounted %s: %zu entries, opened in %.2f ms", packName, pack->entryCount(), elapsed.count());
+    assets.mount(std::make_unique<PackAssetSource>(std::move(pack), &workerPool));
+}
+
+void HelloVK::setPacingMode(PacingMode mode) {
+    requestedPacingMode.store(mode, std::memory_order_relaxed);
+    // render() sees it differs from the swapchain's and recreates it
+    redraw.invalidate(REDRAW_SWAPCHAIN);
+}
+
+void HelloVK::setMsaaSamples(VkSampleCountFlagBits samples) {
+    requestedMsaaSamples = samples;
 }
 
 void HelloVK::recreateSwapChain() {
     vkDeviceWaitIdle(device);
     cleanupSwapChain();
+    establishDisplaySizeIdentity();
     createSwapChain();
+    if (pacingPolicy.framesInFlight != framesInFlight) {
+        resizeFrameSlots(pacingPolicy.framesInFlight);
+    }
     createImageViews();
+    createDepthResources();
     createFramebuffers();
+    createOffscreenTarget();
+
+    // Framebuffers, extent and pre-rotation all end up in the recorded commands
+    if (reuseCommandBuffers && commandBuffers.size() != swapChainImages.size() * framesInFlight) {
+        vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(commandBuffers.size()),
+                             commandBuffers.data());
+        createCommandBuffers();
+    }
+    commandBufferCache.invalidate(CommandBufferDirty::Swapchain);
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -581,43 +938,116 @@ void HelloVK::createImageViews() {
  * A framebuffer (image views container) is bound to this render pass.
  */
 void HelloVK::createRenderPass() {
+    msaaSamples = supportedSampleCount(requestedMsaaSamples);
+    bool multisampled = msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+
+    // With MSAA the color attachment is the multisampled image, which only lives in tile memory:
+    // it is resolved at the end of the subpass and never written back
     VkAttachmentDescription colorAttachment{};
     colorAttachment.format = swapChainImageFormat;
-    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.samples = msaaSamples;
     colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.storeOp = multisampled ? VK_ATTACHMENT_STORE_OP_DONT_CARE
+                                           : VK_ATTACHMENT_STORE_OP_STORE;
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    colorAttachment.finalLayout = multisampled ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+                                               : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    // Depth only lives during the pass: cleared on load, never written back to memory
+    depthFormat = findDepthFormat();
+    VkAttachmentDescription depthAttachment{};
+    depthAttachment.format = depthFormat;
+    depthAttachment.samples = msaaSamples;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    // The resolve target is written whole by the resolve, so its old contents are never loaded
+    VkAttachmentDescription resolveAttachment{};
+    resolveAttachment.format = swapChainImageFormat;
+    resolveAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    resolveAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    resolveAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    resolveAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    resolveAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    resolveAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    resolveAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
     VkAttachmentReference colorAttachmentRef{};
     colorAttachmentRef.attachment = 0;
     colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+    VkAttachmentReference depthAttachmentRef{};
+    depthAttachmentRef.attachment = 1;
+    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference resolveAttachmentRef{};
+    resolveAttachmentRef.attachment = 2;
+    resolveAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
     VkSubpassDescription subpass{};
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     subpass.colorAttachmentCount = 1;
     subpass.pColorAttachments = &colorAttachmentRef;
+    subpass.pResolveAttachments = multisampled ? &resolveAttachmentRef : nullptr;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
+    // The depth and multisampled color images are shared by all frames in flight: the previous
+    // frame's writes to them must be done before this frame clears them
     VkSubpassDependency dependency{};
     dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
     dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                              VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                               VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                              VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                               VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    std::array<VkAttachmentDescription, 3> attachments = {colorAttachment, depthAttachment,
+                                                          resolveAttachment};
+    uint32_t attachmentCount = multisampled ? 3 : 2;
+    // The one attachment read after the pass: presented, or blitted with dynamic resolution
+    VkAttachmentDescription &output = attachments[multisampled ? 2 : 0];
 
     VkRenderPassCreateInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.attachmentCount = 1;
-    renderPassInfo.pAttachments = &colorAttachment;
+    renderPassInfo.attachmentCount = attachmentCount;
+    renderPassInfo.pAttachments = attachments.data();
     renderPassInfo.subpassCount = 1;
     renderPassInfo.pSubpasses = &subpass;
     renderPassInfo.dependencyCount = 1;
     renderPassInfo.pDependencies = &dependency;
 
+    auditAttachments("scene", attachments.data(), attachmentCount, multisampled ? 2 : 0);
     VK_CHECK(vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass));
+
+    // The same pass into the offscreen target of dynamic resolution, compatible with the one above
+    // so the pipelines work with both. The target is shared by the frames in flight: clearing it
+    // waits for the previous frame's blit to have read it, and the blit waits for the color writes
+    output.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    dependency.srcStageMask |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+    VkSubpassDependency toBlit{};
+    toBlit.srcSubpass = 0;
+    toBlit.dstSubpass = VK_SUBPASS_EXTERNAL;
+    toBlit.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    toBlit.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    toBlit.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    toBlit.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+    std::array<VkSubpassDependency, 2> offscreenDependencies = {dependency, toBlit};
+    renderPassInfo.dependencyCount = static_cast<uint32_t>(offscreenDependencies.size());
+    renderPassInfo.pDependencies = offscreenDependencies.data();
+    auditAttachments("offscreen", attachments.data(), attachmentCount, multisampled ? 2 : 0);
+    VK_CHECK(vkCreateRenderPass(device, &renderPassInfo, nullptr, &offscreenRenderPass));
 }
 
 /*
@@ -631,13 +1061,13 @@ void HelloVK::createFramebuffers() {
     swapChainFramebuffers.resize(swapChainImageViews.size());
 
     for (size_t i = 0; i < swapChainImageViews.size(); i++) {
-        VkImageView attachments[] = {swapChainImageViews[i]};
+        std::vector<VkImageView> attachments = sceneAttachments(swapChainImageViews[i]);
 
         VkFramebufferCreateInfo framebufferInfo{};
         framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
         framebufferInfo.renderPass = renderPass;
-        framebufferInfo.attachmentCount = 1;
-        framebufferInfo.pAttachments = attachments;
+        framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+        framebufferInfo.pAttachments = attachments.data();
         framebufferInfo.width = swapChainExtent.width;
         framebufferInfo.height = swapChainExtent.height;
         framebufferInfo.layers = 1;
@@ -646,6 +1076,187 @@ void HelloVK::createFramebuffers() {
     }
 }
 
+// In the order of the render pass attachments, 'target' being the image the frame ends up in
+std::vector<VkImageView> HelloVK::sceneAttachments(VkImageView target) const {
+    if (msaaSamples == VK_SAMPLE_COUNT_1_BIT) {
+        return {target, depthImageView};
+    }
+    return {msaaColorImageView, depthImageView, target};
+}
+
+/*
+ * Dynamic resolution renders into a target as large as the swapchain and only uses the top left
+ * renderExtent() of it, so changing the scale never reallocates anything: the render area and
+ * viewport shrink, and the blit scales that corner up.
+ */
+void HelloVK::createOffscreenTarget() {
+    if (!dynamicResolution) {
+        return;
+    }
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = {swapChainExtent.width, swapChainExtent.height, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = swapChainImageFormat;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VK_CHECK(vkCreateImage(device, &imageInfo, nullptr, &offscreenImage));
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, offscreenImage, &memRequirements);
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits,
+                                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VK_CHECK(vkAllocateMemory(device, &allocInfo, nullptr, &offscreenImageMemory));
+    vkBindImageMemory(device, offscreenImage, offscreenImageMemory, 0);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = offscreenImage;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = swapChainImageFormat;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+    VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &offscreenImageView));
+
+    std::vector<VkImageView> attachments = sceneAttachments(offscreenImageView);
+    VkFramebufferCreateInfo framebufferInfo{};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = offscreenRenderPass;
+    framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    framebufferInfo.pAttachments = attachments.data();
+    framebufferInfo.width = swapChainExtent.width;
+    framebufferInfo.height = swapChainExtent.height;
+    framebufferInfo.layers = 1;
+    VK_CHECK(vkCreateFramebuffer(device, &framebufferInfo, nullptr, &offscreenFramebuffer));
+}
+
+VkExtent2D HelloVK::renderExtent() const {
+    if (!dynamicResolution) {
+        return swapChainExtent;
+    }
+    return {scaledSize(swapChainExtent.width, renderScale),
+            scaledSize(swapChainExtent.height, renderScale)};
+}
+
+VkFormat HelloVK::findDepthFormat() {
+    for (VkFormat format: {VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32,
+                           VK_FORMAT_D24_UNORM_S8_UINT, VK_FORMAT_D16_UNORM}) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+        if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+            return format;
+        }
+    }
+    assert(false);  // D16 support is mandatory
+    return VK_FORMAT_D16_UNORM;
+}
+
+/*
+ * Attachments that are never loaded or stored can stay in tile memory on tiled GPUs: their images
+ * are transient and backed by lazily allocated memory when the device has such a type, so no
+ * physical memory is committed for them at all.
+ */
+void HelloVK::createTransientAttachment(VkFormat format, VkImageUsageFlags usage,
+                                        VkImageAspectFlags aspect, VkImage &image,
+                                        VkDeviceMemory &memory, VkImageView &view) {
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = {swapChainExtent.width, swapChainExtent.height, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = usage | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    imageInfo.samples = msaaSamples;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VK_CHECK(vkCreateImage(device, &imageInfo, nullptr, &image));
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+    uint32_t memoryType = UINT32_MAX;
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((memRequirements.memoryTypeBits & (1 << i)) &&
+            (memProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+            memoryType = i;
+            break;
+        }
+    }
+    if (memoryType == UINT32_MAX) {
+        memoryType = findMemoryType(memRequirements.memoryTypeBits,
+                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    } else {
+        lazilyAllocatedAttachments++;
+    }
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = memoryType;
+    VK_CHECK(vkAllocateMemory(device, &allocInfo, nullptr, &memory));
+    vkBindImageMemory(device, image, memory, 0);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange.aspectMask = aspect;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+    VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &view));
+}
+
+// Depth, and with MSAA the multisampled color image, both cleared on load and dropped on store
+void HelloVK::createDepthResources() {
+    lazilyAllocatedAttachments = 0;
+    createTransientAttachment(depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                              VK_IMAGE_ASPECT_DEPTH_BIT, depthImage, depthImageMemory,
+                              depthImageView);
+    if (msaaSamples != VK_SAMPLE_COUNT_1_BIT) {
+        createTransientAttachment(swapChainImageFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                                  VK_IMAGE_ASPECT_COLOR_BIT, msaaColorImage,
+                                  msaaColorImageMemory, msaaColorImageView);
+    }
+    LOGI("MSAA %ux (%ux requested), %u transient attachment(s) lazily allocated",
+         static_cast<uint32_t>(msaaSamples), static_cast<uint32_t>(requestedMsaaSamples),
+         lazilyAllocatedAttachments);
+}
+
+/*
+ * The highest sample count up to 'requested' that both color and depth framebuffer attachments
+ * support. Every device supports 1 and 4.
+ */
+VkSampleCountFlagBits HelloVK::supportedSampleCount(VkSampleCountFlagBits requested) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    VkSampleCountFlags supported = properties.limits.framebufferColorSampleCounts &
+                                   properties.limits.framebufferDepthSampleCounts;
+    for (uint32_t count = requested; count > VK_SAMPLE_COUNT_1_BIT; count >>= 1) {
+        if (supported & count) {
+            return static_cast<VkSampleCountFlagBits>(count);
+        }
+    }
+    return VK_SAMPLE_COUNT_1_BIT;
+}
+
 // -------------------------------------------------------------------------------------------------
 // Create Shader and Pipeline
 // -------------------------------------------------------------------------------------------------
@@ -688,18 +1299,22 @@ void HelloVK::createDescriptorSetLayouts() {
     VK_CHECK(vkCreateDescriptorSetLayout(device, &textureLayoutInfo, nullptr,
                                          &textureDescriptorSetLayout));
 
-    // Set 2: Light UBO
-    VkDescriptorSetLayoutBinding lightLayoutBinding{};
-    lightLayoutBinding.binding = 0;  // Binding = 0 for set = 2
-    lightLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    lightLayoutBinding.descriptorCount = 1;
-    lightLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-    lightLayoutBinding.pImmutableSamplers = nullptr;
+    // Set 2: Lighting UBO, point lights and cluster lists, all read by the fragment shader
+    std::array<VkDescriptorSetLayoutBinding, 3> lightLayoutBindings{};
+    for (uint32_t binding = 0; binding < lightLayoutBindings.size(); binding++) {
+        lightLayoutBindings[binding].binding = binding;
+        lightLayoutBindings[binding].descriptorType = binding == 0
+                                                      ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+                                                      : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        lightLayoutBindings[binding].descriptorCount = 1;
+        lightLayoutBindings[binding].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        lightLayoutBindings[binding].pImmutableSamplers = nullptr;
+    }
 
     VkDescriptorSetLayoutCreateInfo lightLayoutInfo{};
     lightLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    lightLayoutInfo.bindingCount = 1;
-    lightLayoutInfo.pBindings = &lightLayoutBinding;
+    lightLayoutInfo.bindingCount = static_cast<uint32_t>(lightLayoutBindings.size());
+    lightLayoutInfo.pBindings = lightLayoutBindings.data();
 
     VK_CHECK(vkCreateDescriptorSetLayout(device, &lightLayoutInfo, nullptr,
                                          &lightDescriptorSetLayout));
@@ -712,13 +1327,23 @@ void HelloVK::createDescriptorSetLayouts() {
  * operations on graphics data, such as transforming cubeVertices, shading pixels, and computing
  * global effects.
  */
-VkShaderModule HelloVK::createShaderModule(const std::vector<uint8_t> &code) {
+VkShaderModule HelloVK::createShaderModule(const AssetData &code) {
+    assert(code.valid() && code.size() % sizeof(uint32_t) == 0);  // missing or truncated SPIR-V
+
     VkShaderModuleCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
     createInfo.codeSize = code.size();
 
-    // The allocator in vector ensures worst case requirements
-    createInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+    // pCode must be 4 byte aligned. Uncompressed APK entries and file mappings are, copy the words
+    // out otherwise
+    std::vector<uint32_t> alignedCode;
+    if (reinterpret_cast<uintptr_t>(code.data()) % alignof(uint32_t) == 0) {
+        createInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+    } else {
+        alignedCode.resize(code.size() / sizeof(uint32_t));
+        memcpy(alignedCode.data(), code.data(), code.size());
+        createInfo.pCode = alignedCode.data();
+    }
     VkShaderModule shaderModule;
     VK_CHECK(vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule));
 
@@ -737,82 +1362,11 @@ VkShaderModule HelloVK::createShaderModule(const std::vector<uint8_t> &code) {
  * - and the shader modules
  */
 void HelloVK::createGraphicsPipeline() {
-    auto vertShaderCode = LoadBinaryFileToVector("shaders/shader.vert.spv", assetManager);
-    auto fragShaderCode = LoadBinaryFileToVector("shaders/shader.frag.spv", assetManager);
-
-    VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-    VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
-
-    VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-    vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertShaderStageInfo.module = vertShaderModule;
-    vertShaderStageInfo.pName = "main";
+    AssetData vertShaderCode = assets.open("shaders/shader.vert.spv");
+    AssetData fragShaderCode = assets.open("shaders/shader.frag.spv");
 
-    VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-    fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragShaderStageInfo.module = fragShaderModule;
-    fragShaderStageInfo.pName = "main";
-
-    VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
-
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo{}; // pass te cubeVertices to shader
-    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    auto bindingDescription = Vertex::getBindingDescription();
-    auto attributeDescriptions = Vertex::getAttributeDescriptions();
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-
-    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-    VkPipelineViewportStateCreateInfo viewportState{};
-    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportState.viewportCount = 1;
-    viewportState.scissorCount = 1;
-
-    VkPipelineRasterizationStateCreateInfo rasterizer{};
-    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rasterizer.depthClampEnable = VK_FALSE;
-    rasterizer.rasterizerDiscardEnable = VK_FALSE;
-    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-    rasterizer.lineWidth = 1.0f;
-    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-    rasterizer.depthBiasEnable = VK_FALSE;
-    rasterizer.depthBiasConstantFactor = 0.0f;
-    rasterizer.depthBiasClamp = 0.0f;
-    rasterizer.depthBiasSlopeFactor = 0.0f;
-
-    VkPipelineMultisampleStateCreateInfo multisampling{};
-    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampling.sampleShadingEnable = VK_FALSE;
-    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-    multisampling.minSampleShading = 1.0f;
-    multisampling.pSampleMask = nullptr;
-    multisampling.alphaToCoverageEnable = VK_FALSE;
-    multisampling.alphaToOneEnable = VK_FALSE;
-
-    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-                                          VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    colorBlendAttachment.blendEnable = VK_FALSE;
-
-    VkPipelineColorBlendStateCreateInfo colorBlending{};
-    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    colorBlending.logicOpEnable = VK_FALSE;
-    colorBlending.logicOp = VK_LOGIC_OP_COPY;
-    colorBlending.attachmentCount = 1;
-    colorBlending.pAttachments = &colorBlendAttachment;
-    colorBlending.blendConstants[0] = 0.0f;
-    colorBlending.blendConstants[1] = 0.0f;
-    colorBlending.blendConstants[2] = 0.0f;
-    colorBlending.blendConstants[3] = 0.0f;
+    vertShaderModule = createShaderModule(vertShaderCode);
+    fragShaderModule = createShaderModule(fragShaderCode);
 
     std::vector<VkDescriptorSetLayout> setLayouts = {objectDescriptorSetLayout,
                                                      textureDescriptorSetLayout,
@@ -825,35 +1379,60 @@ void HelloVK::createGraphicsPipeline() {
     pipelineLayoutInfo.pPushConstantRanges = nullptr;
     VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout));
 
-    std::vector<VkDynamicState> dynamicStateEnables = {VK_DYNAMIC_STATE_VIEWPORT,
-                                                       VK_DYNAMIC_STATE_SCISSOR};
-    VkPipelineDynamicStateCreateInfo dynamicStateCI{};
-    dynamicStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-    dynamicStateCI.pDynamicStates = dynamicStateEnables.data();
-    dynamicStateCI.dynamicStateCount = static_cast<uint32_t>(dynamicStateEnables.size());
-
-    VkGraphicsPipelineCreateInfo pipelineInfo{};
-    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount = 2;
-    pipelineInfo.pStages = shaderStages;
-    pipelineInfo.pVertexInputState = &vertexInputInfo;
-    pipelineInfo.pInputAssemblyState = &inputAssembly;
-    pipelineInfo.pViewportState = &viewportState;
-    pipelineInfo.pRasterizationState = &rasterizer;
-    pipelineInfo.pMultisampleState = &multisampling;
-    pipelineInfo.pDepthStencilState = nullptr;
-    pipelineInfo.pColorBlendState = &colorBlending;
-    pipelineInfo.pDynamicState = &dynamicStateCI;
-    pipelineInfo.layout = pipelineLayout;
-    pipelineInfo.renderPass = renderPass;
-    pipelineInfo.subpass = 0;
-    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-    pipelineInfo.basePipelineIndex = -1;
-
-    VK_CHECK(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo,
-                                       nullptr, &graphicsPipeline));
-    vkDestroyShaderModule(device, fragShaderModule, nullptr);
-    vkDestroyShaderModule(device, vertShaderModule, nullptr);
+    // Fixed-function state (triangle list, back face culling, no blending, dynamic viewport and
+    // scissor) is filled in by the pipeline service
+    auto attributeDescriptions = Vertex::getAttributeDescriptions();
+    sceneDesc = {};
+    sceneDesc.vertexShader = vertShaderModule;
+    sceneDesc.fragmentShader = fragShaderModule;
+    sceneDesc.bindings = {Vertex::getBindingDescription()};
+    sceneDesc.attributes.assign(attributeDescriptions.begin(), attributeDescriptions.end());
+    sceneDesc.depthTest = true;
+    sceneDesc.layout = pipelineLayout;
+    sceneDesc.renderPass = renderPass;
+    sceneDesc.subpass = 0;
+    sceneDesc.samples = msaaSamples;
+    variantPipelines.clear();
+
+    // All variants compile on the workers while textures and buffers load. The dynamic branch one
+    // can draw any object, initVulkan() waits for it at the end and draws fall back to it until
+    // their own variant is ready
+    fallbackPipeline = pipelineVariant(FALLBACK_SHADER_FEATURES);
+    pipelineVariant(SHADER_LIT);
+    pipelineVariant(SHADER_TEXTURED);
+}
+
+/*
+ * Pipelines are cached by their ShaderFeature bits, the first call for a set of features starts
+ * compiling it.
+ */
+PipelineId HelloVK::pipelineVariant(uint32_t features) {
+    auto found = variantPipelines.find(features);
+    if (found != variantPipelines.end()) {
+        return found->second;
+    }
+
+    PipelineDesc desc = sceneDesc;
+    char name[32];
+    snprintf(name, sizeof(name), "scene variant 0x%x", features);
+    desc.name = name;
+    for (uint32_t bit = 0; bit < SHADER_FEATURE_COUNT; bit++) {
+        VkSpecializationMapEntry entry{};
+        entry.constantID = bit;
+        entry.offset = bit * sizeof(VkBool32);
+        entry.size = sizeof(VkBool32);
+        desc.specializationEntries.push_back(entry);
+    }
+    desc.specializationData.resize(SHADER_FEATURE_COUNT * sizeof(VkBool32));
+    for (uint32_t bit = 0; bit < SHADER_FEATURE_COUNT; bit++) {
+        VkBool32 enabled = (features >> bit) & 1 ? VK_TRUE : VK_FALSE;
+        memcpy(desc.specializationData.data() + bit * sizeof(VkBool32), &enabled,
+               sizeof(VkBool32));
+    }
+
+    PipelineId id = pipelines.request(desc);
+    variantPipelines.emplace(features, id);
+    return id;
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -870,19 +1449,22 @@ void HelloVK::createGraphicsPipeline() {
  * that can be accessed by all shaders in a pipeline.
  */
 void HelloVK::createDescriptorPool() {
-    VkDescriptorPoolSize poolSizes[2];
+    VkDescriptorPoolSize poolSizes[3];
     poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT *
+    poolSizes[0].descriptorCount = static_cast<uint32_t>(framesInFlight *
                                                          (DESCRIPTOR_SETS_PER_FRAME -
                                                           1)); // less textures
     poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT * 1);
+    poolSizes[1].descriptorCount = static_cast<uint32_t>(framesInFlight * 1);
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[2].descriptorCount = static_cast<uint32_t>(framesInFlight *
+                                                         STORAGE_BUFFERS_PER_FRAME);
 
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.poolSizeCount = 2;
+    poolInfo.poolSizeCount = 3;
     poolInfo.pPoolSizes = poolSizes;
-    poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT * DESCRIPTOR_SETS_PER_FRAME);
+    poolInfo.maxSets = static_cast<uint32_t>(framesInFlight * DESCRIPTOR_SETS_PER_FRAME);
 
     VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool));
 }
@@ -895,13 +1477,13 @@ void HelloVK::createDescriptorPool() {
  */
 void HelloVK::createDescriptorSets() {
     // Resize descriptor sets arrays
-    cubeDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
-    planeDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
-    textureDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
-    lightDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+    cubeDescriptorSets.resize(framesInFlight);
+    planeDescriptorSets.resize(framesInFlight);
+    textureDescriptorSets.resize(framesInFlight);
+    lightDescriptorSets.resize(framesInFlight);
 
     // Allocate descriptor sets for object UBO (set = 0)
-    std::vector<VkDescriptorSetLayout> objectLayouts(MAX_FRAMES_IN_FLIGHT,
+    std::vector<VkDescriptorSetLayout> objectLayouts(framesInFlight,
                                                      objectDescriptorSetLayout);
     VkDescriptorSetAllocateInfo cubeAllocInfo{};
     cubeAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -911,7 +1493,7 @@ void HelloVK::createDescriptorSets() {
     VK_CHECK(vkAllocateDescriptorSets(device, &cubeAllocInfo, cubeDescriptorSets.data()));
 
     // Allocate descriptor sets for plane UBO (set = 0, similar to cube)
-    std::vector<VkDescriptorSetLayout> planeLayouts(MAX_FRAMES_IN_FLIGHT,
+    std::vector<VkDescriptorSetLayout> planeLayouts(framesInFlight,
                                                     objectDescriptorSetLayout);
     VkDescriptorSetAllocateInfo planeAllocInfo{};
     planeAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -921,7 +1503,7 @@ void HelloVK::createDescriptorSets() {
     VK_CHECK(vkAllocateDescriptorSets(device, &planeAllocInfo, planeDescriptorSets.data()));
 
     // Allocate descriptor sets for textures (set = 1)
-    std::vector<VkDescriptorSetLayout> textureLayouts(MAX_FRAMES_IN_FLIGHT,
+    std::vector<VkDescriptorSetLayout> textureLayouts(framesInFlight,
                                                       textureDescriptorSetLayout);
     VkDescriptorSetAllocateInfo textureAllocInfo{};
     textureAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -931,7 +1513,7 @@ void HelloVK::createDescriptorSets() {
     VK_CHECK(vkAllocateDescriptorSets(device, &textureAllocInfo, textureDescriptorSets.data()));
 
     // Allocate descriptor sets for light UBO (set = 2)
-    std::vector<VkDescriptorSetLayout> lightLayouts(MAX_FRAMES_IN_FLIGHT,
+    std::vector<VkDescriptorSetLayout> lightLayouts(framesInFlight,
                                                     lightDescriptorSetLayout);
     VkDescriptorSetAllocateInfo lightAllocInfo{};
     lightAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -941,7 +1523,7 @@ void HelloVK::createDescriptorSets() {
     VK_CHECK(vkAllocateDescriptorSets(device, &lightAllocInfo, lightDescriptorSets.data()));
 
     // Write descriptor sets
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    for (size_t i = 0; i < framesInFlight; i++) {
         // Object UBO (set = 0)
         VkDescriptorBufferInfo cubeBufferInfo{};
         cubeBufferInfo.buffer = cubeUniformBuffers[i]; // Assuming cubeUniformBuffers holds object data
@@ -976,7 +1558,7 @@ void HelloVK::createDescriptorSets() {
         VkDescriptorImageInfo textureImageInfo{};
         textureImageInfo.imageView = textureImageView;
         textureImageInfo.sampler = textureSampler;
-        textureImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        textureImageInfo.imageLayout = textureLayout;
 
         VkWriteDescriptorSet textureDescriptorWrite{};
         textureDescriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -987,11 +1569,14 @@ void HelloVK::createDescriptorSets() {
         textureDescriptorWrite.descriptorCount = 1;
         textureDescriptorWrite.pImageInfo = &textureImageInfo;
 
-        // Light UBO (set = 2)
-        VkDescriptorBufferInfo lightBufferInfo{};
-        lightBufferInfo.buffer = lightUniformBuffers[i];
-        lightBufferInfo.offset = 0;
-        lightBufferInfo.range = sizeof(LightUBO);
+        // Lighting UBO, point lights and cluster lists (set = 2)
+        std::array<VkDescriptorBufferInfo, 3> lightBufferInfos{};
+        lightBufferInfos[0].buffer = lightUniformBuffers[i];
+        lightBufferInfos[0].range = sizeof(LightingUBO);
+        lightBufferInfos[1].buffer = lightStorageBuffers[i];
+        lightBufferInfos[1].range = VK_WHOLE_SIZE;
+        lightBufferInfos[2].buffer = clusterStorageBuffers[i];
+        lightBufferInfos[2].range = VK_WHOLE_SIZE;
 
         VkWriteDescriptorSet lightDescriptorWrite{};
         lightDescriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -1000,38 +1585,64 @@ void HelloVK::createDescriptorSets() {
         lightDescriptorWrite.dstArrayElement = 0;
         lightDescriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
         lightDescriptorWrite.descriptorCount = 1;
-        lightDescriptorWrite.pBufferInfo = &lightBufferInfo;
+        lightDescriptorWrite.pBufferInfo = &lightBufferInfos[0];
+
+        // Bindings 1 and 2 are consecutive storage buffers, one write covers both
+        VkWriteDescriptorSet lightStorageDescriptorWrite = lightDescriptorWrite;
+        lightStorageDescriptorWrite.dstBinding = 1;
+        lightStorageDescriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        lightStorageDescriptorWrite.descriptorCount = STORAGE_BUFFERS_PER_FRAME;
+        lightStorageDescriptorWrite.pBufferInfo = &lightBufferInfos[1];
 
         // Update descriptor sets for cube, plane, light, and texture
-        std::array<VkWriteDescriptorSet, DESCRIPTOR_SETS_PER_FRAME> descriptorWrites = {
+        std::array<VkWriteDescriptorSet, DESCRIPTOR_SETS_PER_FRAME + 1> descriptorWrites = {
                 vertexsDescriptorWrite,
                 planeDescriptorWrite,
                 textureDescriptorWrite,
-                lightDescriptorWrite,};
+                lightDescriptorWrite,
+                lightStorageDescriptorWrite,};
 
         vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()),
                                descriptorWrites.data(), 0, nullptr);
     }
+    // Recorded draws bind the sets by handle, new sets mean new recordings
+    commandBufferCache.invalidate(CommandBufferDirty::SceneTopology);
 }
 
 /*
  * Specify our Uniform Buffer struct and create the uniform buffers. 'createBuffer' will allocate
  * the memory from the VkDeviceMemory using vkAllocateMemory and bind the buffer to the memory using
  * vkBindBufferMemory.
+ *
+ * The buffers are HOST_COHERENT and stay mapped for their whole lifetime, updates are a memcpy.
  */
 void HelloVK::createUniformBuffers() {
     VkDeviceSize bufferSize = sizeof(UniformBufferObject);
 
-    cubeUniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-    cubeUniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    cubeUniformBuffers.resize(framesInFlight);
+    cubeUniformBuffersMemory.resize(framesInFlight);
+
+    planeUniformBuffers.resize(framesInFlight);
+    planeUniformBuffersMemory.resize(framesInFlight);
 
-    planeUniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-    planeUniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    lightUniformBuffers.resize(framesInFlight);
+    lightUniformBuffersMemory.resize(framesInFlight);
 
-    lightUniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-    lightUniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    cubeUniformBuffersMapped.resize(framesInFlight);
+    planeUniformBuffersMapped.resize(framesInFlight);
+    lightUniformBuffersMapped.resize(framesInFlight);
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    VkDeviceSize lightsSize = sizeof(PointLight) * MAX_POINT_LIGHTS;
+    VkDeviceSize clustersSize = sizeof(ClusterCell) * CLUSTER_COUNT +
+                                sizeof(uint32_t) * MAX_CLUSTER_LIGHT_INDICES;
+    lightStorageBuffers.resize(framesInFlight);
+    lightStorageBuffersMemory.resize(framesInFlight);
+    lightStorageBuffersMapped.resize(framesInFlight);
+    clusterStorageBuffers.resize(framesInFlight);
+    clusterStorageBuffersMemory.resize(framesInFlight);
+    clusterStorageBuffersMapped.resize(framesInFlight);
+
+    for (size_t i = 0; i < framesInFlight; i++) {
         // Cube uniform buffer
         createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
@@ -1042,11 +1653,35 @@ void HelloVK::createUniformBuffers() {
                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
                      planeUniformBuffers[i], planeUniformBuffersMemory[i]);
 
-        // LightUBO uniform buffer
-        createBuffer(sizeof(LightUBO), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        // Lighting uniform buffer
+        createBuffer(sizeof(LightingUBO), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
                      lightUniformBuffers[i], lightUniformBuffersMemory[i]);
+
+        VK_CHECK(vkMapMemory(device, cubeUniformBuffersMemory[i], 0, bufferSize, 0,
+                             &cubeUniformBuffersMapped[i]));
+        VK_CHECK(vkMapMemory(device, planeUniformBuffersMemory[i], 0, bufferSize, 0,
+                             &planeUniformBuffersMapped[i]));
+        VK_CHECK(vkMapMemory(device, lightUniformBuffersMemory[i], 0, sizeof(LightingUBO), 0,
+                             &lightUniformBuffersMapped[i]));
+
+        // Point lights and cluster lists, rewritten every frame
+        createBuffer(lightsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     lightStorageBuffers[i], lightStorageBuffersMemory[i]);
+        createBuffer(clustersSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     clusterStorageBuffers[i], clusterStorageBuffersMemory[i]);
+        VK_CHECK(vkMapMemory(device, lightStorageBuffersMemory[i], 0, lightsSize, 0,
+                             &lightStorageBuffersMapped[i]));
+        VK_CHECK(vkMapMemory(device, clusterStorageBuffersMemory[i], 0, clustersSize, 0,
+                             &clusterStorageBuffersMapped[i]));
     }
+
+    // Fresh buffers hold garbage, every slot needs a first upload
+    cubeUniform.invalidateSlots();
+    planeUniform.invalidateSlots();
+    lightUniform.invalidateSlots();
 }
 
 /*
@@ -1102,26 +1737,13 @@ void HelloVK::createVertexBuffer() {
     VkDeviceSize planeBufferSize = sizeof(planeVertices[0]) * planeVertices.size();
     VkDeviceSize bufferSize = cubeBufferSize + planeBufferSize;
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 stagingBuffer, stagingBufferMemory);
-
-    void *data;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, planeVertices.data(), (size_t) planeBufferSize);
-    memcpy(static_cast<char *>(data) + planeBufferSize, cubeVertices.data(),
-           (size_t) cubeBufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
-
     createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
 
-    copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
-
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    uploads.uploadBuffer(vertexBuffer, 0, planeVertices.data(), planeBufferSize,
+                         VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+    uploads.uploadBuffer(vertexBuffer, planeBufferSize, cubeVertices.data(), cubeBufferSize,
+                         VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
 }
 
 void HelloVK::createIndexBuffer() {
@@ -1129,69 +1751,13 @@ void HelloVK::createIndexBuffer() {
     VkDeviceSize planeBufferSize = sizeof(planeIndices[0]) * planeIndices.size();
     VkDeviceSize bufferSize = cubeBufferSize + planeBufferSize;
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 stagingBuffer, stagingBufferMemory);
-
-    void *data;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, planeIndices.data(), (size_t) planeBufferSize);
-    memcpy(static_cast<char *>(data) + planeBufferSize, cubeIndices.data(),
-           (size_t) cubeBufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
-
     createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
 
-    copyBuffer(stagingBuffer, indexBuffer, bufferSize);
-
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
-}
-
-void HelloVK::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-    VkBufferCopy copyRegion{};
-    copyRegion.size = size;
-    vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-    endSingleTimeCommands(commandBuffer);
-}
-
-VkCommandBuffer HelloVK::beginSingleTimeCommands() {
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool = commandPool;
-    allocInfo.commandBufferCount = 1;
-
-    VkCommandBuffer commandBuffer;
-    vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
-
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-    return commandBuffer;
-}
-
-void HelloVK::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
-    vkEndCommandBuffer(commandBuffer);
-
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue);
-
-    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+    uploads.uploadBuffer(indexBuffer, 0, planeIndices.data(), planeBufferSize,
+                         VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+    uploads.uploadBuffer(indexBuffer, planeBufferSize, cubeIndices.data(), cubeBufferSize,
+                         VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -1215,9 +1781,13 @@ void HelloVK::createCommandPool() {
 /*
  * A VkCommandBuffer is a Vulkan object that represents a list of commands that the GPU will execute.
  * It is a low-level object that provides fine-grained control over the GPU.
+ *
+ * When reusing command buffers there is one per (swapchain image, frame slot) pair, otherwise one
+ * per frame slot that is recorded every frame.
  */
 void HelloVK::createCommandBuffers() {
-    commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    commandBufferCache.resize(static_cast<uint32_t>(swapChainImages.size()), framesInFlight);
+    commandBuffers.resize(reuseCommandBuffers ? commandBufferCache.size() : framesInFlight);
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocInfo.commandPool = commandPool;
@@ -1240,46 +1810,88 @@ void HelloVK::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageI
     beginInfo.pInheritanceInfo = nullptr;
 
     VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+    gpuTimer.beginFrame(commandBuffer, currentFrame);
 
+    // With dynamic resolution the scene only covers the scaled corner of the offscreen target
+    VkExtent2D extent = renderExtent();
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = renderPass;
-    renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
+    renderPassInfo.renderPass = dynamicResolution ? offscreenRenderPass : renderPass;
+    renderPassInfo.framebuffer = dynamicResolution ? offscreenFramebuffer
+                                                   : swapChainFramebuffers[imageIndex];
     renderPassInfo.renderArea.offset = {0, 0};
-    renderPassInfo.renderArea.extent = swapChainExtent;
-    renderPassInfo.clearValueCount = 1;
-    VkClearValue clearColor = {{{0.2588f, 0.2863f, 0.2863f, 1.0f}}};
-    renderPassInfo.pClearValues = &clearColor;
+    renderPassInfo.renderArea.extent = extent;
+    std::array<VkClearValue, 2> clearValues{};
+    clearValues[0].color = {{0.2588f, 0.2863f, 0.2863f, 1.0f}};
+    clearValues[1].depthStencil = {1.0f, 0};
+    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    renderPassInfo.pClearValues = clearValues.data();
 
     vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+    // Texture and light sets are the same for every draw, bound once. Any variant may be drawn
+    // first, the sets it statically uses must already be there
+    VkDescriptorSet sharedSets[] = {textureDescriptorSets[currentFrame],
+                                    lightDescriptorSets[currentFrame]};
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 2,
+                            sharedSets, 0, nullptr);
+
+    // Viewport and scissor are described in the rotated (visible) space and mapped back onto the
+    // identity sized framebuffer, the same way the projection is pre-rotated
+    PreRotatedRect visibleRect{0, 0,
+                               swapsAxes(surfaceRotation) ? extent.height : extent.width,
+                               swapsAxes(surfaceRotation) ? extent.width : extent.height};
+    PreRotatedRect identityRect = preRotateRect(visibleRect, extent.width, extent.height,
+                                                surfaceRotation);
 
     VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float) swapChainExtent.width;
-    viewport.height = (float) swapChainExtent.height;
+    viewport.x = (float) identityRect.x;
+    viewport.y = (float) identityRect.y;
+    viewport.width = (float) identityRect.width;
+    viewport.height = (float) identityRect.height;
     viewport.minDepth = 0.0f;
     viewport.maxDepth = 1.0f;
     vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
     VkRect2D scissor{};
-    scissor.offset = {0, 0};
-    scissor.extent = swapChainExtent;
+    scissor.offset = {identityRect.x, identityRect.y};
+    scissor.extent = {identityRect.width, identityRect.height};
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
     VkBuffer vertexBuffers[] = {vertexBuffer};
     VkDeviceSize offsets[] = {0};
-    // Array of DrawObjects for plane and cube
-    std::vector<DrawObject> drawObjects = {
+    // The uniforms are latched after recording, so this sorts by the previous frame's transforms:
+    // the depth test keeps the image right, a stale order only costs some overdraw
+    float planeDepth = normalizedViewDepth(planeUniform.get());
+    float cubeDepth = normalizedViewDepth(cubeUniform.get());
+    // Array of DrawObjects for plane and cube. The plane's textured top face is its own draw so
+    // that each draw has a single shader variant
+    FrameVector<DrawObject> drawObjects({
+            {
+                    PLANE_SIDE_INDEX_COUNT,
+                    0,
+                    0,
+                    planeDescriptorSets[currentFrame],
+                    std::nullopt,
+                    0,
+                    SHADER_LIT,
+                    0,  // plane mesh
+                    0,  // plane material
+                    DrawLayer::Opaque,
+                    planeDepth
+            },
             {
-                    static_cast<uint32_t>(planeIndices.size()),
+                    static_cast<uint32_t>(planeIndices.size()) - PLANE_SIDE_INDEX_COUNT,
                     0,
                     0,
                     planeDescriptorSets[currentFrame],
                     textureDescriptorSets[currentFrame], // Texture descriptor set for the plane
-                    0
+                    PLANE_SIDE_INDEX_COUNT,
+                    SHADER_TEXTURED,
+                    0,  // plane mesh
+                    1,  // textured plane material
+                    DrawLayer::Opaque,
+                    planeDepth
             },
             {
                     static_cast<uint32_t>(cubeIndices.size()),
@@ -1287,47 +1899,102 @@ void HelloVK::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageI
                     static_cast<uint32_t>(sizeof(uint16_t) * planeIndices.size()),
                     cubeDescriptorSets[currentFrame],
                     std::nullopt,
-                    0
+                    0,
+                    SHADER_LIT,
+                    1,  // cube mesh
+                    2,  // cube material
+                    DrawLayer::Opaque,
+                    cubeDepth
             }
-    };
-
-    // Iterate over the objects and draw them
-    for (const auto &object: drawObjects) {
-        offsets[0] = object.vertexOffset;
+    }, ArenaAllocator<DrawObject>(frameArenas[currentFrame]));
+
+    sortDraws(drawObjects, drawList);
+
+    // Iterate over the sorted draws, binding only the state that differs from the previous draw
+    drawBinds.reset();
+    for (const DrawItem &item: drawList) {
+        const DrawObject &object = drawObjects[item.index];
+        PipelineId variant = useShaderVariants ? pipelineVariant(object.features)
+                                               : fallbackPipeline;
+        VkPipeline pipeline = pipelines.resolve(variant, fallbackPipeline);
+        if (drawBinds.pipeline((uint64_t) pipeline)) {
+            bool fallback = pipeline == pipelines.get(fallbackPipeline);
+            gpuTimer.mark(commandBuffer, currentFrame,
+                          fallback ? FALLBACK_SHADER_FEATURES : object.features);
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        }
 
         // Bind vertex and index buffers for the object
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-        vkCmdBindIndexBuffer(commandBuffer, indexBuffer, object.indexOffset, VK_INDEX_TYPE_UINT16);
-
-        // Prepare descriptor sets to bind
-        std::vector<VkDescriptorSet> descriptorSets = {object.descriptorSet};
-
-        // If there is a texture descriptor set, add it to the list
-        if (object.textureDescriptorSet) {
-            descriptorSets.push_back(*object.textureDescriptorSet);
+        if (drawBinds.mesh(object.mesh)) {
+            offsets[0] = object.vertexOffset;
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+            vkCmdBindIndexBuffer(commandBuffer, indexBuffer, object.indexOffset,
+                                 VK_INDEX_TYPE_UINT16);
         }
 
         // Bind the descriptor sets (object + texture, if any)
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0,
-                                static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(),
-                                0, nullptr);
+        if (drawBinds.material(object.material)) {
+            VkDescriptorSet descriptorSets[2];
+            uint32_t setCount = object.descriptorSets(descriptorSets);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
+                                    0, setCount, descriptorSets, 0, nullptr);
+        }
 
         // Draw the object
         vkCmdDrawIndexed(commandBuffer, object.indexCount, 1, object.firstIndex, 0, 0);
     }
 
+    gpuTimer.endFrame(commandBuffer, currentFrame);
     vkCmdEndRenderPass(commandBuffer);
+    if (dynamicResolution) {
+        blitToSwapchain(commandBuffer, swapChainImages[imageIndex], extent);
+    }
     VK_CHECK(vkEndCommandBuffer(commandBuffer));
 }
 
-void HelloVK::updateCubeUniformBuffer(glm::mat4 model, glm::mat4 view, glm::mat4 proj,
-                                      uint32_t currentImage) {
-    // Prepare cube transformation
-    UniformBufferObject cubeUbo{};
-    static auto startTime = std::chrono::high_resolution_clock::now();
-    auto currentTime = std::chrono::high_resolution_clock::now();
-    float time = std::chrono::duration<float, std::chrono::seconds::period>(
-            currentTime - startTime).count();
+/*
+ * Scales the rendered corner of the offscreen target up into the whole swapchain image. Both are
+ * in the identity orientation, so the pre-rotation carries over. The image's first use is here,
+ * the acquire semaphore is waited on at the transfer stage.
+ */
+void HelloVK::blitToSwapchain(VkCommandBuffer commandBuffer, VkImage swapchainImage,
+                              VkExtent2D extent) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = swapchainImage;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkImageBlit blit{};
+    blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    blit.srcOffsets[1] = {static_cast<int32_t>(extent.width), static_cast<int32_t>(extent.height),
+                          1};
+    blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    blit.dstOffsets[1] = {static_cast<int32_t>(swapChainExtent.width),
+                          static_cast<int32_t>(swapChainExtent.height), 1};
+    vkCmdBlitImage(commandBuffer, offscreenImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   swapchainImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, blitFilter);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1,
+                         &barrier);
+}
+
+void HelloVK::simulate(double seconds) {
+    SceneSnapshot &snapshot = sceneSnapshots.back();
+    snapshot.time = seconds;
+    float time = static_cast<float>(seconds);
     float amplitude = glm::radians(90.0f); // 90 degrees
     float frequency = 0.5f; // 0.5 Hz (full cycle every 2 seconds)
     float phaseShift = 0.0f; // Start from the left
@@ -1336,21 +2003,28 @@ void HelloVK::updateCubeUniformBuffer(glm::mat4 model, glm::mat4 view, glm::mat4
     if (phaseTime < 2.0f) {
         float angle =
                 amplitude * glm::sin(2.0f * glm::pi<float>() * frequency * phaseTime + phaseShift);
-        cubeUbo.model = model * glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 1.0f, 0.0f));
+        snapshot.cubeRotation = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 1.0f, 0.0f));
     } else {
         float angle = amplitude * glm::sin(
                 2.0f * glm::pi<float>() * frequency * (phaseTime - 2.0f) + phaseShift);
-        cubeUbo.model = model * glm::rotate(glm::mat4(1.0f), angle, glm::vec3(1.0f, 0.0f, 0.0f));
+        snapshot.cubeRotation = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(1.0f, 0.0f, 0.0f));
     }
+    sceneSnapshots.publish();
+    redraw.invalidate(REDRAW_ANIMATION);
+}
+
+void HelloVK::updateCubeUniformBuffer(glm::mat4 model, glm::mat4 view, glm::mat4 proj,
+                                      uint32_t currentImage) {
+    // Prepare cube transformation, swung by the simulation thread
+    UniformBufferObject cubeUbo{};
+    cubeUbo.model = model * sceneSnapshots.latest().cubeRotation;
     // cubeUbo.model = glm::mat4(1.0f);
     cubeUbo.view = view;
     cubeUbo.proj = proj;
 
     // Update cube uniform buffer
-    void *data;
-    vkMapMemory(device, cubeUniformBuffersMemory[currentImage], 0, sizeof(cubeUbo), 0, &data);
-    memcpy(data, &cubeUbo, sizeof(cubeUbo));
-    vkUnmapMemory(device, cubeUniformBuffersMemory[currentImage]);
+    cubeUniform.set(cubeUbo);
+    uniformBytesLastFrame += cubeUniform.upload(currentImage, cubeUniformBuffersMapped[currentImage]);
 }
 
 void HelloVK::updatePlaneUniformBuffer(glm::mat4 model, glm::mat4 view, glm::mat4 proj,
@@ -1362,66 +2036,135 @@ void HelloVK::updatePlaneUniformBuffer(glm::mat4 model, glm::mat4 view, glm::mat
     planeUbo.view = view;
     planeUbo.proj = proj;
 
-    // Update plane uniform buffer
-    void *data;
-    vkMapMemory(device, planeUniformBuffersMemory[currentImage], 0, sizeof(planeUbo), 0, &data);
-    memcpy(data, &planeUbo, sizeof(planeUbo));
-    vkUnmapMemory(device, planeUniformBuffersMemory[currentImage]);
+    // Update plane uniform buffer, only copied when the transform (or the camera) changed since
+    // this frame slot was last written
+    planeUniform.set(planeUbo);
+    uniformBytesLastFrame += planeUniform.upload(currentImage,
+                                                 planeUniformBuffersMapped[currentImage]);
 }
 
-void HelloVK::updateLightBuffer(uint32_t currentImage) {
-    // Define light properties (directional light in this example)
-    LightUBO light{};
-    light.position = glm::vec3(0.0f, 5.0f, 0.0f);   // Position (only used for point/spot light)
-    light.direction = glm::vec3(0.0f, 1.0f, 0.0f);  // Direction for directional light
-    light.color = glm::vec3(1.0f, 1.0f, 1.0f);      // White light
-    light.intensity = 1.0f;                                  // Full intensity
-    light.constant = 1.0f;                                   // Attenuation constants (for point light)
-    light.linear = 0.09f;
-    light.quadratic = 0.032f;
-
-    // Update light uniform buffer
-    void *data;
-    vkMapMemory(device, lightUniformBuffersMemory[currentImage], 0, sizeof(LightUBO), 0, &data);
-    memcpy(data, &light, sizeof(LightUBO));
-    vkUnmapMemory(device, lightUniformBuffersMemory[currentImage]);
+/*
+ * Moves the lights, bins them into the clusters of 'view' and copies lights and cluster lists into
+ * the frame slot's storage buffers. Too much work for the late latch window: it runs just before
+ * the latch with the view latched for the previous frame, so the lights trail camera moves by a
+ * frame while the transforms keep the newest input.
+ */
+void HelloVK::updateLights(const glm::mat4 &view, float fovY, float aspect,
+                           uint32_t currentImage) {
+    uint32_t count = pointLightCount;
+    if (sceneLights.size() != count) {
+        sceneLights = scenePointLights(count);
+        viewLights.resize(count);
+    }
+    auto cullStart = std::chrono::steady_clock::now();
+    float time = static_cast<float>(sceneSnapshots.latest().time);
+    for (uint32_t i = 0; i < count; i++) {
+        glm::vec4 position = sceneLights[i].positionRadius;
+        // Around the y axis, inner rings faster
+        float turn = time * 0.6f / glm::length(glm::vec2(position.x, position.z));
+        float cosTurn = std::cos(turn);
+        float sinTurn = std::sin(turn);
+        glm::vec3 world(position.x * cosTurn + position.z * sinTurn, position.y,
+                        position.z * cosTurn - position.x * sinTurn);
+        viewLights[i] = sceneLights[i];
+        viewLights[i].positionRadius = glm::vec4(glm::vec3(view * glm::vec4(world, 1.0f)),
+                                                 position.w);
+    }
+    lightClusters.setProjection(fovY, aspect, CAMERA_NEAR_PLANE, CAMERA_FAR_PLANE);
+    lightClusters.cull(viewLights.data(), count);
+    double cullMs = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - cullStart).count();
+    lightCullFrames++;
+    lightCullTotalMs += cullMs;
+    lightCullMaxMs = std::max(lightCullMaxMs, cullMs);
+
+    // Only what the shader can reach is copied: the lights, every cell, the used indices
+    auto *clusters = static_cast<uint8_t *>(clusterStorageBuffersMapped[currentImage]);
+    size_t lightBytes = sizeof(PointLight) * count;
+    size_t cellBytes = sizeof(ClusterCell) * CLUSTER_COUNT;
+    size_t indexBytes = sizeof(uint32_t) * lightClusters.indices().size();
+    memcpy(lightStorageBuffersMapped[currentImage], viewLights.data(), lightBytes);
+    memcpy(clusters, lightClusters.cells().data(), cellBytes);
+    memcpy(clusters + cellBytes, lightClusters.indices().data(), indexBytes);
+    lightBytesLastFrame = lightBytes + cellBytes + indexBytes;
+
+    LightingUBO lighting{};
+    lighting.ambient = glm::vec4(0.35f, 0.35f, 0.35f, 0.0f);
+    lighting.clusterParams = glm::vec4(lightClusters.tileScale(), lightClusters.sliceParams());
+    // The projection only changes with the surface, so does this
+    lightUniform.set(lighting);
+    uniformBytesLastFrame += lightUniform.upload(currentImage,
+                                                 lightUniformBuffersMapped[currentImage]);
 }
 
 /*
  * You may also need to update the Uniform Buffer as for all the vertices we're rendering
  */
+float HelloVK::visibleAspectRatio() const {
+    return getPreRotatedAspectRatio(swapChainExtent.width, swapChainExtent.height,
+                                    surfaceRotation);
+}
+
 void HelloVK::updateUniformBuffer(uint32_t currentImage) {
     // "Global" parameters
     glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(0.1f, 0.3f, 0.0f));
-    glm::mat4 view = glm::lookAt(glm::vec3(2.0f, 2.0f, 6.0f),
-                                 glm::vec3(0.0f, 0.0f, 0.0f),
-                                 glm::vec3(0.0f, 1.0f, 0.0f));
-
-    float FOV = glm::radians(65.0f);
-    float ratio = static_cast<float>(swapChainExtent.width) /
-                  static_cast<float>(swapChainExtent.height);
-    glm::mat4 proj = glm::perspective(FOV, ratio, 0.1f, 100.0f);
+    glm::mat4 view = camera.view();
+
+    float FOV = glm::radians(CAMERA_FOV_Y_DEGREES);
+    float ratio = visibleAspectRatio();
+    glm::mat4 proj = glm::perspective(FOV, ratio, CAMERA_NEAR_PLANE, CAMERA_FAR_PLANE);
     proj[1][1] *= -1;// invert the Y-axis component
+    // Rotate clip space to match the surface transform so the compositor doesn't have to
+    proj = getPreRotationMatrix(surfaceRotation) * proj;
 
     updatePlaneUniformBuffer(model, view, proj, currentImage);
     updateCubeUniformBuffer(model, view, proj, currentImage);
-    updateLightBuffer(currentImage);
+
+    uniformBytesUploaded += uniformBytesLastFrame;
 }
 
 /*
  * Get the command buffer you've composed and submit it to the queue.
  */
-void HelloVK::render() { // or draw frame
+bool HelloVK::render() { // or draw frame
     if (!initialized) {
-        return;
+        return false;
     }
-    if (orientationChanged) {
+    // createSwapChain() picks a new pacing mode up
+    bool pacingModeChanged = requestedPacingMode.load(std::memory_order_relaxed) != pacingMode;
+    if (orientationChanged || pacingModeChanged) {
         recreateSwapChain();
         orientationChanged = false;
     }
 
-    // Wait until the previous frame's rendering is complete (prevFrame)
-    vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+    // Sleep until the frame is due instead of blocking inside the driver
+    if (redraw.resumedFromIdle()) {
+        framePacer.restartSchedule();
+    }
+    auto now = std::chrono::steady_clock::now();
+    auto frameStart = framePacer.beginFrame(now);
+    if (frameStart > now) {
+        std::this_thread::sleep_until(frameStart);
+    }
+
+    // Wait until the previous frame's rendering is complete (prevFrame), with the pacer this
+    // should normally return straight away
+    auto fenceWaitStart = std::chrono::steady_clock::now();
+    frameTimeline.waitForSlot(currentFrame);
+    framePacer.reportFenceWait(std::chrono::steady_clock::now() - fenceWaitStart);
+    gpuTimer.collect(currentFrame);
+    // A new GPU frame time moves the render scale, the command buffers have it baked in
+    // Without the refresh period there is no target to hold
+    if (dynamicResolution && displayRefreshPeriod.count() > 0 &&
+        gpuTimer.frames().samples != resolutionSamples) {
+        resolutionSamples = gpuTimer.frames().samples;
+        if (resolution.update(gpuTimer.lastFrameMs())) {
+            renderScale = resolution.scale();
+            commandBufferCache.invalidate(CommandBufferDirty::Resolution);
+        }
+    }
+    // Nothing the slot's last frame allocated is in use anymore
+    frameArenas[currentFrame].reset();
     uint32_t imageIndex;
     // Acquire the next available image from the swap chain
     VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX,
@@ -1431,20 +2174,33 @@ void HelloVK::render() { // or draw frame
     // Handle swap chain recreation if the window is resized or becomes outdated
     if (result == VK_ERROR_OUT_OF_DATE_KHR) {
         recreateSwapChain();
-        return;
+        redraw.invalidate(REDRAW_SWAPCHAIN);
+        return false;
     }
     // failed to acquire swap chain image
     assert(result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR);
 
-    // Update the uniform buffer for the current frame
-    updateUniformBuffer(currentFrame);
+    // Where the transforms used to be sampled, before recording
+    int64_t acquiredTime = monotonicNowNs();
 
-    // Reset the fence to mark the frame as in progress
-    vkResetFences(device, 1, &inFlightFences[currentFrame]);
-    vkResetCommandBuffer(commandBuffers[currentFrame], 0);
+    // Pipelines finished on the workers replace the ones the command buffers were recorded with
+    if (pipelines.update()) {
+        commandBufferCache.invalidate(CommandBufferDirty::Pipeline);
+    }
 
-    // Record drawing commands into the command buffer
-    recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+    // Record drawing commands into the command buffer, unless the one for this image and frame
+    // slot still holds an up to date recording
+    VkCommandBuffer commandBuffer = reuseCommandBuffers
+                                    ? commandBuffers[commandBufferCache.index(imageIndex,
+                                                                              currentFrame)]
+                                    : commandBuffers[currentFrame];
+    if (!reuseCommandBuffers || commandBufferCache.needsRecord(imageIndex, currentFrame)) {
+        vkResetCommandBuffer(commandBuffer, 0);
+        recordCommandBuffer(commandBuffer, imageIndex);
+        commandBufferCache.markRecorded(imageIndex, currentFrame);
+    } else {
+        commandBufferCache.markReused();
+    }
 
     // Submit the command buffer for execution
     VkSubmitInfo submitInfo{};
@@ -1452,22 +2208,64 @@ void HelloVK::render() { // or draw frame
 
     // Specify synchronization: wait for the image to be available
     VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+    // With dynamic resolution the swapchain image is only touched by the blit, the scene can be
+    // rendered before the image is available
+    VkPipelineStageFlags waitStages[] = {dynamicResolution
+                                         ? VK_PIPELINE_STAGE_TRANSFER_BIT
+                                         : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
     submitInfo.waitSemaphoreCount = 1;
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
 
     // Specify the command buffer to execute
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
+    submitInfo.pCommandBuffers = &commandBuffer;
 
-    // Signal that rendering is finished
-    VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-    submitInfo.signalSemaphoreCount = 1;
+    // Signal that rendering is finished, and that this frame number is complete: either through
+    // the timeline semaphore value or through the frame slot's fence
+    FrameTimeline::SubmitSignal frameSignal = frameTimeline.beginSubmit(currentFrame);
+    VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame], frameSignal.semaphore};
+    submitInfo.signalSemaphoreCount = frameSignal.semaphore != VK_NULL_HANDLE ? 2 : 1;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
+    // Values for binary semaphores are ignored
+    uint64_t waitValues[] = {0};
+    uint64_t signalValues[] = {0, frameSignal.value};
+    VkTimelineSemaphoreSubmitInfoKHR timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+    timelineInfo.waitSemaphoreValueCount = 1;
+    timelineInfo.pWaitSemaphoreValues = waitValues;
+    timelineInfo.signalSemaphoreValueCount = 2;
+    timelineInfo.pSignalSemaphoreValues = signalValues;
+    if (frameSignal.semaphore != VK_NULL_HANDLE) {
+        submitInfo.pNext = &timelineInfo;
+    }
+
+    // Lights and clusters ahead of the latch, with the view the previous frame latched. The
+    // clusters are laid over the projection the user sees, before pre-rotation
+    uniformBytesLastFrame = 0;
+    updateLights(camera.view(), glm::radians(CAMERA_FOV_Y_DEGREES), visibleAspectRatio(),
+                 currentFrame);
+
+    // Late latch: the command buffer only references this frame slot's uniform buffers, which stay
+    // mapped, so the camera and transforms are written last, from the newest input and simulation
+    // snapshot. The memory is host coherent and the submit makes the writes visible. The frame is
+    // tagged with the oldest input it took.
+    int64_t latchTime = monotonicNowNs();
+    int64_t frameInputTime = cameraCommands.latch(latchedCommands);
+    for (const CameraCommand &command : latchedCommands) {
+        camera.apply(command);
+    }
+    updateUniformBuffer(currentFrame);
+    lateLatchGain.add(acquiredTime, latchTime);
+    latchToSubmit.add(latchTime, monotonicNowNs());
+
     // Submit the command buffer to the graphics queue
-    VK_CHECK(vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]));
+    VK_CHECK(vkQueueSubmit(graphicsQueue, 1, &submitInfo, frameSignal.fence));
+    gpuTimer.submitted(currentFrame);
+    if (frameInputTime != 0) {
+        inputToSubmit.add(frameInputTime, monotonicNowNs());
+    }
 
     // Present the rendered image to the screen
     VkPresentInfoKHR presentInfo{};
@@ -1482,69 +2280,167 @@ void HelloVK::render() { // or draw frame
 
     // Handle presentation result and swap chain status
     result = vkQueuePresentKHR(presentQueue, &presentInfo);
+    if (frameInputTime != 0) {
+        // Handed to the presentation engine, scan-out is later still
+        inputToPresent.add(frameInputTime, monotonicNowNs());
+    }
     if (result == VK_SUBOPTIMAL_KHR) {
         orientationChanged = true;
+        redraw.invalidate(REDRAW_SWAPCHAIN);
     } else if (result == VK_ERROR_OUT_OF_DATE_KHR) {
         recreateSwapChain();
+        redraw.invalidate(REDRAW_SWAPCHAIN);
     } else {
         assert(result == VK_SUCCESS);  // failed to present swap chain image!
     }
-    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    currentFrame = (currentFrame + 1) % framesInFlight;
+#ifdef VKT_FRAME_COUNTERS
+    frame_counters::endFrame();
+#endif
+
+    if (frameTimeline.lastSubmitted() % FRAME_STATS_INTERVAL == 0) {
+        // Displays switch rates at run time (power saving, apps asking for 120 Hz)
+        updateRefreshPeriod();
+        logFrameStats();
+    }
+    return true;
+}
+
+/*
+ * Counters accumulated since the start, printed every FRAME_STATS_INTERVAL frames.
+ */
+void HelloVK::logFrameStats() {
+    LOGI("Frame %llu: paced to %.3f ms %llu (missed %llu, slept %lld ms, fence wait %lld ms)",
+         (unsigned long long) frameTimeline.lastSubmitted(),
+         std::chrono::duration<double, std::milli>(framePacer.targetInterval()).count(),
+         (unsigned long long) framePacer.pacedFrames,
+         (unsigned long long) framePacer.missedFrames,
+         (long long) std::chrono::duration_cast<std::chrono::milliseconds>(
+                 framePacer.totalSleep).count(),
+         (long long) std::chrono::duration_cast<std::chrono::milliseconds>(
+                 framePacer.totalFenceWait).count());
+    LOGI("Command buffers: %llu recorded, %llu frames reused",
+         (unsigned long long) commandBufferCache.recordCount,
+         (unsigned long long) commandBufferCache.reuseCount);
+    LOGI("Uniforms: %llu bytes last frame, %llu bytes total",
+         (unsigned long long) uniformBytesLastFrame, (unsigned long long) uniformBytesUploaded);
+    LOGI("Pipelines: %llu requested, %llu published, %llu library parts, %llu fallback binds",
+         (unsigned long long) pipelines.stats().requested,
+         (unsigned long long) pipelines.stats().published,
+         (unsigned long long) pipelines.stats().libraryParts,
+         (unsigned long long) pipelines.stats().fallbackBinds);
+    LOGI("Draw binds: %llu pipeline, %llu material, %llu mesh, %llu skipped",
+         (unsigned long long) drawBinds.pipelineBinds,
+         (unsigned long long) drawBinds.materialBinds,
+         (unsigned long long) drawBinds.meshBinds, (unsigned long long) drawBinds.skipped);
+    size_t arenaPeak = 0;
+    uint64_t arenaOverflows = 0;
+    for (uint32_t slot = 0; slot < framesInFlight; slot++) {
+        arenaPeak = std::max(arenaPeak, frameArenas[slot].highWater());
+        arenaOverflows += frameArenas[slot].overflowAllocations;
+    }
+    LOGI("Frame arenas: %zu bytes peak per slot, %llu heap fallbacks", arenaPeak,
+         (unsigned long long) arenaOverflows);
+    const RedrawScheduler::Stats &redrawStats = redraw.stats();
+    LOGI("Redraw: %llu frames (lifecycle %llu, input %llu, upload %llu, pipeline %llu, "
+         "swapchain %llu, animation %llu, animation only %llu), %llu idle wakeups",
+         (unsigned long long) redrawStats.renderedFrames,
+         (unsigned long long) redrawStats.framesByReason[0],
+         (unsigned long long) redrawStats.framesByReason[1],
+         (unsigned long long) redrawStats.framesByReason[2],
+         (unsigned long long) redrawStats.framesByReason[3],
+         (unsigned long long) redrawStats.framesByReason[4],
+         (unsigned long long) redrawStats.framesByReason[5],
+         (unsigned long long) redrawStats.animationFrames,
+         (unsigned long long) redrawStats.idleWakeups);
+    LOGI("Input latency: %llu frames with input, to submit %.2f ms (max %.2f), to present "
+         "%.2f ms (max %.2f)", (unsigned long long) inputToSubmit.frames,
+         inputToSubmit.averageMs(), inputToSubmit.maxMs, inputToPresent.averageMs(),
+         inputToPresent.maxMs);
+    if (dynamicResolution) {
+        const ResolutionController::Stats &resolutionStats = resolution.stats();
+        LOGI("Resolution: scale %.2f (lowest %.2f, %llu changes over %llu GPU samples), GPU "
+             "%.2f ms last frame for a %.2f ms target", renderScale, resolutionStats.lowestScale,
+             (unsigned long long) resolutionStats.changes,
+             (unsigned long long) resolutionStats.samples, gpuTimer.lastFrameMs(),
+             resolution.targetMs());
+    }
+    LOGI("Late latch: transforms sampled %.2f ms (max %.2f) closer to submit than after acquire, "
+         "%.3f ms (max %.3f) before submit", lateLatchGain.averageMs(), lateLatchGain.maxMs,
+         latchToSubmit.averageMs(), latchToSubmit.maxMs);
+    // Shading cost is the lit variant's line of the GPU times below
+    const LightClusters::Stats &lightStats = lightClusters.stats();
+    LOGI("Lights: %u (%u visible), moved and culled in %.3f ms (max %.3f) by %s, %u indices in "
+         "%u clusters (max %u, %u dropped), %llu bytes last frame", lightStats.lights,
+         lightStats.visibleLights, lightCullFrames ? lightCullTotalMs / lightCullFrames : 0.0,
+         lightCullMaxMs, lightCullKernels().name, lightStats.indices, lightStats.litClusters,
+         lightStats.maxPerCluster, lightStats.dropped, (unsigned long long) lightBytesLastFrame);
+#ifdef VKT_FRAME_COUNTERS
+    frame_counters::logInterval(frameTimeline.lastSubmitted());
+#endif
+    if (gpuTimer.isReady()) {
+        // Per variant: average GPU time in the frames it was drawn in
+        std::string variants;
+        for (const auto &scope: gpuTimer.scopes()) {
+            char variant[48];
+            snprintf(variant, sizeof(variant), " 0x%x %.3f ms", scope.first,
+                     scope.second.averageMs());
+            variants += variant;
+        }
+        LOGI("GPU: %.3f ms per frame, by shader variant:%s", gpuTimer.frames().averageMs(),
+             variants.c_str());
+    }
 }
 
 // ---------------------------------------------------------------------------------------------
 // Validation layer support and Cleaning
 // ---------------------------------------------------------------------------------------------
 
-void vkt::HelloVK::decodeImage() {
-    std::vector<uint8_t> imageData = LoadBinaryFileToVector("img.png", assetManager);
-    if (imageData.empty()) {
+/*
+ * Decodes every texture of the scene at once: the headers give the size of each image, so one
+ * staging buffer is allocated for the whole batch and the workers decode straight into its slices.
+ */
+void vkt::HelloVK::decodeTextures() {
+    TextureBatch batch;
+    if (!batch.probe(assets, texturePaths)) {
+        for (const auto &texture: batch.textures()) {
+            if (texture.error != nullptr) {
+                LOGE("Fail to load image %s, %s", texture.path.c_str(), texture.error);
+            }
+        }
+    }
+    if (batch.arenaSize() == 0) {
         LOGE("Fail to load image.");
         return;
     }
 
-    const int requiredChannels = 4;
-    unsigned char *decodedData = stbi_load_from_memory(imageData.data(),
-                                                       imageData.size(), &textureWidth,
-                                                       &textureHeight, &textureChannels,
-                                                       requiredChannels);
-    if (decodedData == nullptr) {
-        LOGE("Fail to load image to memory, %s", stbi_failure_reason());
-        return;
+    // Host image copies read the pixels from ordinary memory, only the staging path needs a buffer
+    useHostImageCopy = hostImageCopy.supportsImage(VK_FORMAT_R8G8B8A8_UNORM,
+                                                   VK_IMAGE_USAGE_SAMPLED_BIT);
+    uint8_t *data;
+    if (useHostImageCopy) {
+        hostTextureArena.resize(batch.arenaSize());
+        data = hostTextureArena.data();
+    } else {
+        textureStaging = uploads.allocate(batch.arenaSize());
+        data = textureStaging.data;
     }
 
-    if (textureChannels != requiredChannels) {
-        textureChannels = requiredChannels;
+    if (!batch.decode(data, &workerPool)) {
+        for (const auto &texture: batch.textures()) {
+            if (!texture.decoded && texture.size > 0) {
+                LOGE("Fail to load image %s to memory, %s", texture.path.c_str(), texture.error);
+            }
+        }
     }
-
-    size_t imageSize = textureWidth * textureHeight * textureChannels;
-
-    VkBufferCreateInfo createInfo{};
-    createInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    createInfo.size = imageSize;
-    createInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    VK_CHECK(vkCreateBuffer(device, &createInfo, nullptr, &imgStagingBuffer));
-
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(device, imgStagingBuffer, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits,
-                                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                               VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-    VK_CHECK(vkAllocateMemory(device, &allocInfo, nullptr, &imgStagingMemory));
-    VK_CHECK(vkBindBufferMemory(device, imgStagingBuffer, imgStagingMemory, 0));
-
-    uint8_t *data;
-    VK_CHECK(vkMapMemory(device, imgStagingMemory, 0, memRequirements.size, 0, (void **) &data));
-    memcpy(data, decodedData, imageSize);
-    vkUnmapMemory(device, imgStagingMemory);
-
-    stbi_image_free(decodedData);
+    LOGI("Decoded %zu textures, %.2f MP in %.2f ms (%.1f MP/s, %zu workers, %s kernels)",
+         batch.textures().size(), batch.pixelCount() / 1e6, batch.decodeSeconds() * 1e3,
+         batch.megapixelsPerSecond(), workerPool.threadCount() + 1, pixelKernels().name);
+
+    textures = batch.textures();
+    textureWidth = textures[0].width;
+    textureHeight = textures[0].height;
+    textureChannels = TEXTURE_CHANNELS;
 }
 
 void HelloVK::createTextureImage() {
@@ -1559,7 +2455,9 @@ void HelloVK::createTextureImage() {
     imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT |
+                      (useHostImageCopy ? HostImageCopy::imageUsage()
+                                        : VK_IMAGE_USAGE_TRANSFER_DST_BIT);
     imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
@@ -1579,71 +2477,54 @@ void HelloVK::createTextureImage() {
     vkBindImageMemory(device, textureImage, textureImageMemory, 0);
 }
 
-void HelloVK::copyBufferToImage() {
-    VkImageSubresourceRange subresourceRange{};
-    subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    subresourceRange.baseMipLevel = 0;
-    subresourceRange.levelCount = 1;
-
-    VkImageMemoryBarrier imageMemoryBarrier{};
-    imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    imageMemoryBarrier.image = textureImage;
-    imageMemoryBarrier.subresourceRange = subresourceRange;
-    imageMemoryBarrier.srcAccessMask = 0;
-    imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-
-    VkCommandBuffer cmd;
-    VkCommandBufferAllocateInfo cmdAllocInfo{};
-    cmdAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    cmdAllocInfo.commandPool = commandPool;
-    cmdAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    cmdAllocInfo.commandBufferCount = 1;
-
-    VK_CHECK(vkAllocateCommandBuffers(device, &cmdAllocInfo, &cmd));
-
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    vkBeginCommandBuffer(cmd, &beginInfo);
-
-    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
-                         nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-
-    VkBufferImageCopy bufferImageCopy{};
-    bufferImageCopy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    bufferImageCopy.imageSubresource.mipLevel = 0;
-    bufferImageCopy.imageSubresource.baseArrayLayer = 0;
-    bufferImageCopy.imageSubresource.layerCount = 1;
-    bufferImageCopy.imageExtent.width = textureWidth;
-    bufferImageCopy.imageExtent.height = textureHeight;
-    bufferImageCopy.imageExtent.depth = 1;
-    bufferImageCopy.bufferOffset = 0;
-
-    vkCmdCopyBufferToImage(cmd, imgStagingBuffer, textureImage,
-                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                           1, &bufferImageCopy);
-
-    imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-    imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
-                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr,
-                         0, nullptr, 1, &imageMemoryBarrier);
-
-    vkEndCommandBuffer(cmd);
-
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &cmd;
+/*
+ * Host image copies write the pixels into the image from the CPU right away, with no command
+ * buffer or queue wait, and free the pixels. Otherwise the copy joins the upload batch and the
+ * staging memory is released when the batch is submitted.
+ */
+void HelloVK::uploadTextureImage() {
+    const DecodedTexture &texture = textures[0];
+    if (useHostImageCopy) {
+        auto start = std::chrono::steady_clock::now();
+        hostImageCopy.copyToImage(textureImage, hostTextureArena.data() + texture.offset,
+                                  texture.width, texture.height);
+        textureLayout = hostImageCopy.imageLayout();
+        auto elapsed = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start);
+        LOGI("Texture upload through host image copy: %.2f ms, peak %.1f KiB of heap memory",
+             elapsed.count(), hostTextureArena.size() / 1024.0);
+        std::vector<uint8_t>().swap(hostTextureArena);
+    } else {
+        uploads.copyToImage(textureStaging, texture.offset, textureImage, texture.width,
+                            texture.height, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+        textureLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        LOGI("Texture upload through staging: %.1f KiB of host-visible device memory, "
+             "submitted with the upload batch", textureStaging.size / 1024.0);
+    }
+}
 
-    VK_CHECK(vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE));
-    vkQueueWaitIdle(graphicsQueue);
+/*
+ * Everything queued on the upload batcher while loading goes to the GPU in one submission. The
+ * log compares it with one submission and queue wait per resource, what loading used to cost.
+ */
+void HelloVK::submitUploads() {
+    UploadBatcher::Stats before = uploads.stats();
+    uploads.submit();
+    const UploadBatcher::Stats &after = uploads.stats();
+
+    uint64_t copies = (after.bufferCopies - before.bufferCopies) +
+                      (after.imageCopies - before.imageCopies);
+    LOGI("Uploads: %llu copies in %llu commands, %.1f KiB staged in %llu blocks, "
+         "%llu submit and %llu fence wait in %.2f ms (one by one: %llu submits and queue idles)",
+         (unsigned long long) copies,
+         (unsigned long long) (after.copyCommands - before.copyCommands),
+         (after.stagedBytes - before.stagedBytes) / 1024.0,
+         (unsigned long long) (after.stagingBlocks - before.stagingBlocks),
+         (unsigned long long) (after.submits - before.submits),
+         (unsigned long long) (after.fenceWaits - before.fenceWaits), after.lastSubmitMs,
+         (unsigned long long) copies);
+    redraw.invalidate(REDRAW_UPLOAD);
 }
 
 void HelloVK::createTextureImageViews() {
@@ -1714,16 +2595,61 @@ bool HelloVK::checkValidationLayerSupport() {
     return true;
 }
 
+/*
+ * Leaves null handles behind: the surface level may already be gone when the swapchain is
+ * recreated for a new window, or when the device is destroyed.
+ */
 void HelloVK::cleanupSwapChain() {
     for (size_t i = 0; i < swapChainFramebuffers.size(); i++) {
         vkDestroyFramebuffer(device, swapChainFramebuffers[i], nullptr);
     }
+    swapChainFramebuffers.clear();
 
     for (size_t i = 0; i < swapChainImageViews.size(); i++) {
         vkDestroyImageView(device, swapChainImageViews[i], nullptr);
     }
+    swapChainImageViews.clear();
+
+    vkDestroyImageView(device, depthImageView, nullptr);
+    vkDestroyImage(device, depthImage, nullptr);
+    vkFreeMemory(device, depthImageMemory, nullptr);
+    depthImageView = VK_NULL_HANDLE;
+    depthImage = VK_NULL_HANDLE;
+    depthImageMemory = VK_NULL_HANDLE;
+
+    vkDestroyImageView(device, msaaColorImageView, nullptr);
+    vkDestroyImage(device, msaaColorImage, nullptr);
+    vkFreeMemory(device, msaaColorImageMemory, nullptr);
+    msaaColorImageView = VK_NULL_HANDLE;
+    msaaColorImage = VK_NULL_HANDLE;
+    msaaColorImageMemory = VK_NULL_HANDLE;
+
+    vkDestroyFramebuffer(device, offscreenFramebuffer, nullptr);
+    vkDestroyImageView(device, offscreenImageView, nullptr);
+    vkDestroyImage(device, offscreenImage, nullptr);
+    vkFreeMemory(device, offscreenImageMemory, nullptr);
+    offscreenFramebuffer = VK_NULL_HANDLE;
+    offscreenImageView = VK_NULL_HANDLE;
+    offscreenImage = VK_NULL_HANDLE;
+    offscreenImageMemory = VK_NULL_HANDLE;
 
     vkDestroySwapchainKHR(device, swapChain, nullptr);
+    swapChain = VK_NULL_HANDLE;
+}
+
+void HelloVK::destroyUniformBuffers() {
+    for (size_t i = 0; i < framesInFlight; i++) {
+        vkDestroyBuffer(device, cubeUniformBuffers[i], nullptr);
+        vkFreeMemory(device, cubeUniformBuffersMemory[i], nullptr);
+        vkDestroyBuffer(device, planeUniformBuffers[i], nullptr);
+        vkFreeMemory(device, planeUniformBuffersMemory[i], nullptr);
+        vkDestroyBuffer(device, lightUniformBuffers[i], nullptr);
+        vkFreeMemory(device, lightUniformBuffersMemory[i], nullptr);
+        vkDestroyBuffer(device, lightStorageBuffers[i], nullptr);
+        vkFreeMemory(device, lightStorageBuffersMemory[i], nullptr);
+        vkDestroyBuffer(device, clusterStorageBuffers[i], nullptr);
+        vkFreeMemory(device, clusterStorageBuffersMemory[i], nullptr);
+    }
 }
 
 void HelloVK::cleanup() {
@@ -1738,37 +2664,35 @@ void HelloVK::cleanup() {
     vkDestroyDescriptorSetLayout(device, objectDescriptorSetLayout, nullptr);
     vkDestroyDescriptorSetLayout(device, lightDescriptorSetLayout, nullptr);
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) { // destroy uniforms
-        vkDestroyBuffer(device, cubeUniformBuffers[i], nullptr);
-        vkFreeMemory(device, cubeUniformBuffersMemory[i], nullptr);
-        vkDestroyBuffer(device, planeUniformBuffers[i], nullptr);
-        vkFreeMemory(device, planeUniformBuffersMemory[i], nullptr);
-        vkDestroyBuffer(device, lightUniformBuffers[i], nullptr);
-        vkFreeMemory(device, lightUniformBuffersMemory[i], nullptr);
-    }
-    vkDestroyBuffer(device, imgStagingBuffer, nullptr);
-    vkFreeMemory(device, imgStagingMemory, nullptr);
+    destroyUniformBuffers();
     vkFreeMemory(device, textureImageMemory, nullptr);
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    for (size_t i = 0; i < framesInFlight; i++) {
         vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
         vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
-        vkDestroyFence(device, inFlightFences[i], nullptr);
     }
+    frameTimeline.destroy();
+    gpuTimer.destroy();
     vkDestroyCommandPool(device, commandPool, nullptr);
+    uploads.destroy();
 
-    vkDestroyPipeline(device, graphicsPipeline, nullptr);
+    pipelines.destroy();
+    vkDestroyShaderModule(device, fragShaderModule, nullptr);
+    vkDestroyShaderModule(device, vertShaderModule, nullptr);
     vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 
     vkDestroyRenderPass(device, renderPass, nullptr);
+    vkDestroyRenderPass(device, offscreenRenderPass, nullptr);
 
     vkDestroyDevice(device, nullptr);
+    getRefreshCycleDuration = nullptr;
 
     if (enableValidationLayers) {
         DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
     }
 
     vkDestroySurfaceKHR(instance, surface, nullptr);
+    surface = VK_NULL_HANDLE;
 
     vkDestroyInstance(instance, nullptr);
 
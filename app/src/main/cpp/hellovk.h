@@ -5,32 +5,48 @@
 #include <assert.h>
 #include <vulkan/vulkan.h>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <fstream>
 #include <map>
 #include <optional>
 #include <set>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-namespace vkt {
-#define LOG_TAG "hellovkjni"
-#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
-#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
-#define VK_CHECK(x)                           \
-  do {                                        \
-    VkResult err = x;                         \
-    if (err) {                                \
-      LOGE("Detected Vulkan error: %d", err); \
-      abort();                                \
-    }                                         \
-  } while (0)
+#include "asset_pack.h"
+#include "asset_vfs.h"
+#include "camera_input.h"
+#include "command_buffer_cache.h"
+#include "draw_list.h"
+#include "draw_record.h"
+#include "frame_arena.h"
+#include "frame_pacing.h"
+#include "frame_timeline.h"
+#include "gpu_timer.h"
+#include "host_image_copy.h"
+#include "lifecycle.h"
+#include "light_clusters.h"
+#include "pipeline_service.h"
+#include "pretransform.h"
+#include "redraw.h"
+#include "render_thread.h"
+#include "resolution_scale.h"
+#include "texture_loader.h"
+#include "thread_pool.h"
+#include "tracked_uniform.h"
+#include "upload_batcher.h"
+#include "vk_common.h"
 
+namespace vkt {
     /*
      * Each GPU has several families of queues that process different types of commands. Queue Types:
      * Graphics (GRAPHICS): Processes graphics commands such as drawing and rendering.
@@ -62,32 +78,67 @@ namespace vkt {
         std::vector<VkPresentModeKHR> presentModes;
     };
 
+    /*
+     * Extensions and features used when the device has them, with a fallback otherwise. Filled in
+     * by pickPhysicalDevice() and enabled in createLogicalDeviceAndQueue().
+     */
+    struct OptionalDeviceFeatures {
+        bool timelineSemaphore = false;  // VK_KHR_timeline_semaphore
+        bool hostImageCopy = false;      // VK_EXT_host_image_copy
+        bool graphicsPipelineLibrary = false;  // VK_EXT_graphics_pipeline_library
+        bool displayTiming = false;      // VK_GOOGLE_display_timing
+    };
+
     struct ANativeWindowDeleter {
         void operator()(ANativeWindow *window) { ANativeWindow_release(window); }
     };
 
-    // for double buffering
-    const int MAX_FRAMES_IN_FLIGHT = 2;
+    // upper bound for the frames in flight chosen by the pacing policy (triple buffering)
+    const int MAX_FRAMES_IN_FLIGHT = 3;
+    // optional packed archive mounted in front of the loose APK assets (tools/assetpack)
+    const char *const PACK_FILE_NAME = "assets.pak";
+    // how often (in frames) render() logs its counters
+    const uint64_t FRAME_STATS_INTERVAL = 600;
     // separate descriptor sets for the cube, plane, texture and light for each frame
     const int DESCRIPTOR_SETS_PER_FRAME = 4;
+    // the light set also has the point lights and the cluster lists as storage buffers
+    const int STORAGE_BUFFERS_PER_FRAME = 2;
+
+    // point lights of the scene unless setPointLightCount() says otherwise
+    const uint32_t DEFAULT_POINT_LIGHTS = 256;
 
-    struct DrawObject {
-        uint32_t indexCount;
-        uint32_t vertexOffset;
-        uint32_t indexOffset;
-        VkDescriptorSet descriptorSet;
-        std::optional<VkDescriptorSet> textureDescriptorSet;  // Use std::optional
-        uint32_t firstIndex;
+    // vertical field of view of the scene projection, in degrees
+    const float CAMERA_FOV_Y_DEGREES = 65.0f;
+    // near plane of the scene projection, where the light clusters start
+    const float CAMERA_NEAR_PLANE = 0.1f;
+    // far plane of the scene projection, also normalizes view depth in draw sort keys
+    const float CAMERA_FAR_PLANE = 100.0f;
+
+    // share of the frame interval dynamic resolution lets the GPU take
+    const double GPU_FRAME_BUDGET = 0.85;
+    // GPU timestamps per frame slot: one stretch per pipeline bound
+    const uint32_t MAX_TIMED_SCOPES = 16;
+
+    /*
+     * Features of shader.frag, each one a boolean specialization constant whose constant_id is
+     * the bit index. A set of features is one pipeline variant with no branches left on them.
+     */
+    enum ShaderFeature : uint32_t {
+        SHADER_TEXTURED = 1u << 0,        // sampled texture instead of the vertex color
+        SHADER_LIT = 1u << 1,             // lighting applied to the vertex color
+        SHADER_DYNAMIC_BRANCH = 1u << 2,  // textured or not decided per fragment (fallback)
     };
+    const uint32_t SHADER_FEATURE_COUNT = 3;
+    // Features of the variant every draw falls back to: lit, so lit objects look the same while
+    // their own variant compiles (textured faces take the unlit texture path either way)
+    const uint32_t FALLBACK_SHADER_FEATURES = SHADER_DYNAMIC_BRANCH | SHADER_LIT;
 
-    struct LightUBO {
-        glm::vec3 position;   // For point light (not needed for directional)
-        glm::vec3 direction;  // For directional light (only needed for directional)
-        glm::vec3 color;      // LightUBO color (typically RGB)
-        float intensity;      // LightUBO intensity
-        float constant;       // Point light attenuation (constant)
-        float linear;         // Point light attenuation (linear)
-        float quadratic;      // Point light attenuation (quadratic)
+    using DrawObject = DrawRecord<VkDescriptorSet>;
+
+    // std140 (set 2, binding 0): vec4 members only, so the C++ and GLSL layouts are the same
+    struct LightingUBO {
+        glm::vec4 ambient;        // rgb
+        glm::vec4 clusterParams;  // xy LightClusters::tileScale(), zw LightClusters::sliceParams()
     };
 
     struct UniformBufferObject {
@@ -96,6 +147,12 @@ namespace vkt {
         glm::mat4 proj;
     };
 
+    // What the simulation thread hands the renderer each step
+    struct SceneSnapshot {
+        double time = 0;                       // seconds of simulation
+        glm::mat4 cubeRotation = glm::mat4(1.0f);
+    };
+
     struct Vertex {
         glm::vec3 pos;
         glm::vec3 color;
@@ -222,21 +279,71 @@ namespace vkt {
             4, 5, 6, 6, 7, 4,
             8, 9, 10, 10, 11, 8,
             12, 13, 14, 14, 15, 12,
-            16, 17, 18, 18, 19, 16,
-            20, 21, 22, 22, 23, 20
+            20, 21, 22, 22, 23, 20,
+            // Top face last: the only textured one, drawn on its own with the textured variant
+            16, 17, 18, 18, 19, 16
     };
+    // Untextured faces come first in planeIndices
+    const uint32_t PLANE_SIDE_INDEX_COUNT = 30;
 
-    class HelloVK {
+    class HelloVK : public LifecycleHost {
     public:
         void initVulkan();
 
-        void render();
+        // False when no frame was presented
+        bool render();
 
         void cleanup();
 
         void cleanupSwapChain();
 
-        void reset(ANativeWindow *newWindow, AAssetManager *newManager);
+        // Mounts the APK's assets, once before the first window
+        void setAssetManager(AAssetManager *newManager);
+
+        // Everything is built on the first window, later windows only rebuild the surface,
+        // swapchain, depth buffer and framebuffers
+        void createDevice(ANativeWindow *newWindow) override;
+
+        void attachSurface(ANativeWindow *newWindow) override;
+
+        void detachSurface() override;
+
+        void destroyDevice() override;
+
+        // Any thread, any time: the next frame rebuilds the swapchain for the new present mode
+        // and image count, and the per frame slot resources if the frames in flight changed
+        void setPacingMode(PacingMode mode);
+
+        // 1 (off), 2 or 4, lowered to what the device supports. Changes the render pass and the
+        // pipelines, which live as long as the device: call it before the first window
+        void setMsaaSamples(VkSampleCountFlagBits samples);
+
+        // Lights orbiting the scene, up to MAX_POINT_LIGHTS, from the next frame on
+        void setPointLightCount(uint32_t count) {
+            pointLightCount = std::min(count, MAX_POINT_LIGHTS);
+        }
+
+        // Frame numbers on the graphics queue, usable by anything that needs to know when the GPU
+        // is done with a frame (uploads, readback, deferred deletion)
+        uint64_t lastSubmittedFrame() const { return frameTimeline.lastSubmitted(); }
+
+        bool isFrameComplete(uint64_t frame) { return frameTimeline.isComplete(frame); }
+
+        void waitForFrame(uint64_t frame) { frameTimeline.wait(frame); }
+
+        // Forces the pre-recorded command buffers to be recorded again before their next use
+        void invalidateCommandBuffers(CommandBufferDirty reason) {
+            commandBufferCache.invalidate(reason);
+        }
+
+        // Whether the loop has anything new to show, producers outside the renderer invalidate it
+        RedrawScheduler &redrawScheduler() { return redraw; }
+
+        // Simulation thread: advances the scene to 'seconds' and publishes it for the next frame
+        void simulate(double seconds);
+
+        // Camera commands from touch input, pushed by the event loop and latched by render()
+        CameraInput &cameraInput() { return cameraCommands; }
 
         bool initialized = false;
 
@@ -245,6 +352,8 @@ namespace vkt {
 
         void createSurface();
 
+        void setWindow(ANativeWindow *newWindow);
+
         void setupDebugMessenger();
 
         void pickPhysicalDevice();
@@ -261,36 +370,66 @@ namespace vkt {
 
         void createGraphicsPipeline();
 
+        PipelineId pipelineVariant(uint32_t features);
+
+        VkFormat findDepthFormat();
+
+        void createTransientAttachment(VkFormat format, VkImageUsageFlags usage,
+                                       VkImageAspectFlags aspect, VkImage &image,
+                                       VkDeviceMemory &memory, VkImageView &view);
+
+        void createDepthResources();
+
+        VkSampleCountFlagBits supportedSampleCount(VkSampleCountFlagBits requested);
+
+        std::vector<VkImageView> sceneAttachments(VkImageView target) const;
+
         void createFramebuffers();
 
+        void createOffscreenTarget();
+
+        // Scaled render area, in the identity oriented space of the swapchain
+        VkExtent2D renderExtent() const;
+
+        void blitToSwapchain(VkCommandBuffer commandBuffer, VkImage swapchainImage,
+                             VkExtent2D extent);
+
         void createCommandPool();
 
         void createCommandBuffers();
 
         void createSyncObjects();
 
+        // Everything sized by the frames in flight: sync objects, uniform and storage buffers,
+        // descriptor sets, command buffers and GPU timer pools. The device must be idle
+        void resizeFrameSlots(uint32_t count);
+
+        // The display refresh period from VK_GOOGLE_display_timing, retargets the pacer and
+        // dynamic resolution when it changed
+        void updateRefreshPeriod();
+
+        void logFrameStats();
+
+        void mountAssetPack(const char *packName);
+
         QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device) const;
 
         bool checkDeviceExtensionSupport(VkPhysicalDevice device);
 
+        OptionalDeviceFeatures queryOptionalDeviceFeatures(VkPhysicalDevice device);
+
         bool isDeviceSuitable(VkPhysicalDevice device);
 
         bool checkValidationLayerSupport();
 
         SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device) const;
 
-        VkShaderModule createShaderModule(const std::vector<uint8_t> &code);
+        VkShaderModule createShaderModule(const AssetData &code);
 
         void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
 
         void recreateSwapChain();
 
-        VkCommandBuffer beginSingleTimeCommands();
-
-        void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-
-        void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-
         uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
         void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
@@ -299,6 +438,8 @@ namespace vkt {
 
         void createUniformBuffers();
 
+        void destroyUniformBuffers();
+
         void updateUniformBuffer(uint32_t currentImage);
 
         void createDescriptorPool();
@@ -317,11 +458,16 @@ namespace vkt {
         void updatePlaneUniformBuffer(glm::mat4 model, glm::mat4 view, glm::mat4 proj,
                                       uint32_t currentImage);
 
-        void updateLightBuffer(uint32_t currentImage);
+        void updateLights(const glm::mat4 &view, float fovY, float aspect, uint32_t currentImage);
+
+        // Aspect ratio of the screen the user sees, the swapchain keeps the identity size
+        float visibleAspectRatio() const;
+
+        void decodeTextures();
 
-        void decodeImage();
+        void uploadTextureImage();
 
-        void copyBufferToImage();
+        void submitUploads();
 
         void createTextureImageViews();
 
@@ -332,14 +478,17 @@ namespace vkt {
         // Native window and asset manager
         std::unique_ptr<ANativeWindow, ANativeWindowDeleter> window; // Android native window
         AAssetManager *assetManager;                                // Android asset manager
+        AssetVfs assets;                                            // Read-only asset views (pack, then APK)
+        ThreadPool workerPool;                                      // Workers for asset and texture decoding
 
         // Vulkan instance and debug utilities
         VkInstance instance;                                        // Vulkan instance
         VkDebugUtilsMessengerEXT debugMessenger;                    // Debug messenger for validation layers
 
         // Surface and physical device
-        VkSurfaceKHR surface;                                       // Surface for presenting
+        VkSurfaceKHR surface = VK_NULL_HANDLE;                      // Surface for presenting
         VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;           // Selected physical device (GPU)
+        OptionalDeviceFeatures optionalFeatures;                    // Optional features enabled on the device
 
         // Logical device and queues
         VkDevice device;                                            // Logical device
@@ -347,17 +496,43 @@ namespace vkt {
         VkQueue presentQueue;                                       // Queue for presenting commands
 
         // Swapchain and related objects
-        VkSwapchainKHR swapChain;                                   // Swapchain for presenting images
+        VkSwapchainKHR swapChain = VK_NULL_HANDLE;                  // Swapchain for presenting images
         std::vector<VkImage> swapChainImages;                       // Images in the swapchain
         VkFormat swapChainImageFormat;                              // Format of swapchain images
         VkExtent2D swapChainExtent;                                 // Extent (resolution) of the swapchain
         VkExtent2D displaySizeIdentity;                             // Identity resolution for display scaling
         std::vector<VkImageView> swapChainImageViews;               // Image views for swapchain images
         std::vector<VkFramebuffer> swapChainFramebuffers;           // Framebuffers for rendering to the swapchain
+        VkFormat depthFormat;                                       // Depth attachment format
+        VkImage depthImage = VK_NULL_HANDLE;                        // Depth attachment, shared by the framebuffers
+        VkDeviceMemory depthImageMemory = VK_NULL_HANDLE;           // Lazily allocated when the GPU supports it
+        VkImageView depthImageView = VK_NULL_HANDLE;                // View for the framebuffers
+        VkSampleCountFlagBits requestedMsaaSamples = VK_SAMPLE_COUNT_4_BIT;
+        VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;  // Of the scene render pass, depth and pipelines
+        VkImage msaaColorImage = VK_NULL_HANDLE;                    // Multisampled color, resolved in the subpass
+        VkDeviceMemory msaaColorImageMemory = VK_NULL_HANDLE;       // Lazily allocated when the GPU supports it
+        VkImageView msaaColorImageView = VK_NULL_HANDLE;
+        uint32_t lazilyAllocatedAttachments = 0;                    // Of the transient attachments
+
+        // Dynamic resolution: the scene goes into a full size offscreen target at renderScale,
+        // which is blitted up into the swapchain image
+        bool preferDynamicResolution = true;                        // Used when the swapchain images can be blitted into
+        bool dynamicResolution = false;                             // On for the current swapchain
+        ResolutionController resolution;                            // Picks the scale from the GPU frame times
+        float renderScale = MAX_RESOLUTION_SCALE;                   // Scale the command buffers are recorded with
+        uint64_t resolutionSamples = 0;                             // GPU frame times fed to the controller so far
+        VkFilter blitFilter = VK_FILTER_LINEAR;                     // Nearest when the format can't filter
+        VkRenderPass offscreenRenderPass = VK_NULL_HANDLE;          // Compatible with renderPass, ends ready to blit
+        VkImage offscreenImage = VK_NULL_HANDLE;                    // Shared by the frames in flight, like depth
+        VkDeviceMemory offscreenImageMemory = VK_NULL_HANDLE;
+        VkImageView offscreenImageView = VK_NULL_HANDLE;
+        VkFramebuffer offscreenFramebuffer = VK_NULL_HANDLE;
 
         // Command buffers and command pool
         VkCommandPool commandPool;                                  // Command pool for allocating command buffers
         std::vector<VkCommandBuffer> commandBuffers;                // Command buffers for recording drawing commands
+        CommandBufferCache commandBufferCache;                      // Tracks which command buffers are stale
+        bool reuseCommandBuffers = true;                            // One buffer per (image, frame slot), recorded on demand
 
         // Render pass and pipeline
         VkRenderPass renderPass;                                    // Render pass configuration
@@ -365,12 +540,26 @@ namespace vkt {
         VkDescriptorSetLayout lightDescriptorSetLayout;             // Layout for descriptor sets
         VkDescriptorSetLayout textureDescriptorSetLayout;           // Layout for descriptor sets
         VkPipelineLayout pipelineLayout;                            // Layout for graphics pipeline
-        VkPipeline graphicsPipeline;                                // Graphics pipeline
+        VkShaderModule vertShaderModule;                            // Read by pipeline compiles on the workers
+        VkShaderModule fragShaderModule;                            // Read by pipeline compiles on the workers
+        PipelineService pipelines;                                  // Compiles pipelines on workerPool
+        PipelineDesc sceneDesc;                                     // State shared by the shader variants
+        std::map<uint32_t, PipelineId> variantPipelines;            // Variants by ShaderFeature bits
+        PipelineId fallbackPipeline = INVALID_PIPELINE;             // Dynamic branch variant, waited for at init
+        bool useShaderVariants = true;                              // Draw everything with the fallback if false
+        GpuTimer gpuTimer;                                          // GPU time per bound pipeline variant
+        RedrawScheduler redraw;                                     // Render on demand, animation capped
+        SnapshotBuffer<SceneSnapshot> sceneSnapshots;               // Written by simulate(), read by the frame
+        DrawList drawList;                                          // Draws of the command buffer being recorded
+        std::array<FrameArena, MAX_FRAMES_IN_FLIGHT> frameArenas;   // Frame path temporaries, reset with the slot's fence
+        DrawBinds drawBinds;                                        // Binds emitted and skipped while recording
+        bool preferPipelineLibraries = true;                        // Use graphics pipeline libraries when supported
 
         // Synchronization primitives
         std::vector<VkSemaphore> imageAvailableSemaphores;          // Semaphores for image availability
         std::vector<VkSemaphore> renderFinishedSemaphores;          // Semaphores for rendering completion
-        std::vector<VkFence> inFlightFences;                        // Fences for GPU-CPU synchronization
+        FrameTimeline frameTimeline;                                // Frame numbers for GPU-CPU synchronization
+        bool preferTimelineSemaphore = true;                        // Use the timeline semaphore when supported
 
         // Uniform buffers
         std::vector<VkBuffer> cubeUniformBuffers;                   // Uniform buffers for the cube
@@ -379,6 +568,38 @@ namespace vkt {
         std::vector<VkDeviceMemory> planeUniformBuffersMemory;      // Memory for plane uniform buffers
         std::vector<VkBuffer> lightUniformBuffers;                  // Uniform buffers for the light
         std::vector<VkDeviceMemory> lightUniformBuffersMemory;      // Memory for light uniform buffers
+        std::vector<void *> cubeUniformBuffersMapped;               // Persistently mapped cube uniforms
+        std::vector<void *> planeUniformBuffersMapped;              // Persistently mapped plane uniforms
+        std::vector<void *> lightUniformBuffersMapped;              // Persistently mapped light uniforms
+        TrackedUniform<UniformBufferObject, MAX_FRAMES_IN_FLIGHT> cubeUniform;   // Cube data + per slot versions
+        TrackedUniform<UniformBufferObject, MAX_FRAMES_IN_FLIGHT> planeUniform;  // Plane data + per slot versions
+        TrackedUniform<LightingUBO, MAX_FRAMES_IN_FLIGHT> lightUniform;          // Light data + per slot versions
+        uint64_t uniformBytesUploaded = 0;                          // Bytes copied into uniform buffers so far
+        uint64_t uniformBytesLastFrame = 0;                         // Bytes copied for the last frame
+
+        // Clustered lighting: the CPU bins the lights every frame, the fragment shader walks the
+        // list of its cluster
+        std::vector<VkBuffer> lightStorageBuffers;                  // PointLight array, view space
+        std::vector<VkDeviceMemory> lightStorageBuffersMemory;
+        std::vector<void *> lightStorageBuffersMapped;
+        std::vector<VkBuffer> clusterStorageBuffers;                // ClusterCells, then the light indices
+        std::vector<VkDeviceMemory> clusterStorageBuffersMemory;
+        std::vector<void *> clusterStorageBuffersMapped;
+        std::atomic<uint32_t> pointLightCount{DEFAULT_POINT_LIGHTS};
+        std::vector<PointLight> sceneLights;                        // World space at time 0
+        std::vector<PointLight> viewLights;                         // Where they are this frame, view space
+        LightClusters lightClusters;
+        uint64_t lightCullFrames = 0;
+        double lightCullTotalMs = 0;
+        double lightCullMaxMs = 0;
+        uint64_t lightBytesLastFrame = 0;                           // Lights and clusters copied for the last frame
+        CameraInput cameraCommands;                                 // Touch input waiting for the next frame
+        std::vector<CameraCommand> latchedCommands;                 // Taken by the current frame
+        OrbitCamera camera = OrbitCamera::lookingAt(glm::vec3(2.0f, 2.0f, 6.0f), glm::vec3(0.0f));
+        LatencyStats inputToSubmit;                                 // Oldest input of a frame to its vkQueueSubmit
+        LatencyStats inputToPresent;                                // ... to vkQueuePresentKHR returning
+        LatencyStats lateLatchGain;                                 // Acquire to the late latch before submit
+        LatencyStats latchToSubmit;                                 // Late latch to vkQueueSubmit
 
         // Descriptor pool and sets
         VkDescriptorPool descriptorPool;                            // Descriptor pool for allocation
@@ -394,8 +615,15 @@ namespace vkt {
         VkDeviceMemory indexBufferMemory;                           // Memory for index buffer
 
         // Textures
-        VkBuffer imgStagingBuffer;
-        VkDeviceMemory imgStagingMemory;
+        UploadBatcher uploads;                                      // Load-time copies, submitted together
+        UploadBatcher::Allocation textureStaging;                   // Staging arena shared by the texture batch
+        std::vector<uint8_t> hostTextureArena;                      // Decoded pixels for host image copies
+        std::vector<std::string> texturePaths = {"img.png"};       // Decoded together on workerPool
+        std::vector<DecodedTexture> textures;                       // Slices of the staging or host arena
+        HostImageCopy hostImageCopy;                                // Staging-free uploads (VK_EXT_host_image_copy)
+        bool preferHostImageCopy = true;                            // Use host image copies when supported
+        bool useHostImageCopy = false;                              // Chosen for the current textures
+        VkImageLayout textureLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
         int textureWidth, textureHeight, textureChannels;
         VkImage textureImage;
         VkDeviceMemory textureImageMemory;
@@ -404,8 +632,18 @@ namespace vkt {
 
         // Frame tracking and orientation
         uint32_t currentFrame = 0;                                  // Current frame index
+        uint32_t framesInFlight = 2;                                // Frames the CPU may run ahead
+
+        // Frame pacing
+        std::atomic<PacingMode> requestedPacingMode{PacingMode::Balanced}; // Set by setPacingMode()
+        PacingMode pacingMode = PacingMode::Balanced;               // Mode of the current swapchain
+        PacingPolicy pacingPolicy{};                                // Policy resolved against the surface
+        FramePacer framePacer;                                      // Sleeps to the target frame interval
+        std::chrono::nanoseconds displayRefreshPeriod{0};           // 0 until the swapchain reports it
+        PFN_vkGetRefreshCycleDurationGOOGLE getRefreshCycleDuration = nullptr;
         bool orientationChanged = false;                            // Flag for orientation changes
         VkSurfaceTransformFlagBitsKHR pretransformFlag;             // Surface pre-transform flag
+        SurfaceRotation surfaceRotation = SurfaceRotation::Identity; // Rotation folded into the projection
 
         // Validation layers and extensions
         bool enableValidationLayers = true;                        // Enable or disable validation layers
@@ -0,0 +1,176 @@
+#include "host_image_copy.h"
+
+#include <algorithm>
+
+#include "vk_common.h"
+
+namespace vkt {
+
+#ifdef VK_EXT_host_image_copy
+
+    bool HostImageCopy::isSupported(VkPhysicalDevice physicalDevice,
+                                    const std::set<std::string> &availableExtensions) {
+        for (const char *extension: deviceExtensions()) {
+            if (!availableExtensions.count(extension)) {
+                return false;
+            }
+        }
+
+        VkPhysicalDeviceHostImageCopyFeaturesEXT hostImageCopyFeatures{};
+        hostImageCopyFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT;
+
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &hostImageCopyFeatures;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+        return hostImageCopyFeatures.hostImageCopy;
+    }
+
+    std::vector<const char *> HostImageCopy::deviceExtensions() {
+        // The app targets Vulkan 1.1, where these two are not core yet
+        return {VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME,
+                VK_KHR_COPY_COMMANDS_2_EXTENSION_NAME,
+                VK_KHR_FORMAT_FEATURE_FLAGS_2_EXTENSION_NAME};
+    }
+
+    VkImageUsageFlags HostImageCopy::imageUsage() {
+        return VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT;
+    }
+
+    void *HostImageCopy::chainFeatures(void *next) {
+        features = {};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT;
+        features.hostImageCopy = VK_TRUE;
+        features.pNext = next;
+        return &features;
+    }
+
+    bool HostImageCopy::init(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice) {
+        copyMemoryToImage = (PFN_vkCopyMemoryToImageEXT) vkGetDeviceProcAddr(
+                newDevice, "vkCopyMemoryToImageEXT");
+        transitionImageLayout = (PFN_vkTransitionImageLayoutEXT) vkGetDeviceProcAddr(
+                newDevice, "vkTransitionImageLayoutEXT");
+        if (copyMemoryToImage == nullptr || transitionImageLayout == nullptr) {
+            return false;
+        }
+
+        // Copy straight into the sampling layout when the driver allows it, GENERAL otherwise
+        VkPhysicalDeviceHostImageCopyPropertiesEXT copyProperties{};
+        copyProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_PROPERTIES_EXT;
+        VkPhysicalDeviceProperties2 properties2{};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &copyProperties;
+        vkGetPhysicalDeviceProperties2(newPhysicalDevice, &properties2);
+
+        std::vector<VkImageLayout> dstLayouts(copyProperties.copyDstLayoutCount);
+        copyProperties.pCopyDstLayouts = dstLayouts.data();
+        copyProperties.copySrcLayoutCount = 0;
+        vkGetPhysicalDeviceProperties2(newPhysicalDevice, &properties2);
+
+        bool shaderReadOnly = std::find(dstLayouts.begin(), dstLayouts.end(),
+                                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) != dstLayouts.end();
+        layout = shaderReadOnly ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+        physicalDevice = newPhysicalDevice;
+        device = newDevice;
+        return true;
+    }
+
+    bool HostImageCopy::supportsImage(VkFormat format, VkImageUsageFlags usage) const {
+        if (!isReady()) {
+            return false;
+        }
+
+        VkFormatProperties3KHR formatProperties3{};
+        formatProperties3.sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_3_KHR;
+        VkFormatProperties2 formatProperties2{};
+        formatProperties2.sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_2;
+        formatProperties2.pNext = &formatProperties3;
+        vkGetPhysicalDeviceFormatProperties2(physicalDevice, format, &formatProperties2);
+        if (!(formatProperties3.optimalTilingFeatures & VK_FORMAT_FEATURE_2_HOST_IMAGE_TRANSFER_BIT_EXT)) {
+            return false;
+        }
+
+        VkHostImageCopyDevicePerformanceQueryEXT performance{};
+        performance.sType = VK_STRUCTURE_TYPE_HOST_IMAGE_COPY_DEVICE_PERFORMANCE_QUERY_EXT;
+        VkImageFormatProperties2 imageProperties{};
+        imageProperties.sType = VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2;
+        imageProperties.pNext = &performance;
+
+        VkPhysicalDeviceImageFormatInfo2 imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2;
+        imageInfo.format = format;
+        imageInfo.type = VK_IMAGE_TYPE_2D;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = usage | VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT;
+        if (vkGetPhysicalDeviceImageFormatProperties2(physicalDevice, &imageInfo,
+                                                      &imageProperties) != VK_SUCCESS) {
+            return false;
+        }
+        return performance.optimalDeviceAccess || performance.identicalMemoryLayout;
+    }
+
+    void HostImageCopy::copyToImage(VkImage image, const uint8_t *pixels, uint32_t width,
+                                    uint32_t height) const {
+        VkImageSubresourceRange subresourceRange{};
+        subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        subresourceRange.levelCount = 1;
+        subresourceRange.layerCount = 1;
+
+        VkHostImageLayoutTransitionInfoEXT transition{};
+        transition.sType = VK_STRUCTURE_TYPE_HOST_IMAGE_LAYOUT_TRANSITION_INFO_EXT;
+        transition.image = image;
+        transition.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        transition.newLayout = layout;
+        transition.subresourceRange = subresourceRange;
+        VK_CHECK(transitionImageLayout(device, 1, &transition));
+
+        VkMemoryToImageCopyEXT region{};
+        region.sType = VK_STRUCTURE_TYPE_MEMORY_TO_IMAGE_COPY_EXT;
+        region.pHostPointer = pixels;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = {width, height, 1};
+
+        VkCopyMemoryToImageInfoEXT copyInfo{};
+        copyInfo.sType = VK_STRUCTURE_TYPE_COPY_MEMORY_TO_IMAGE_INFO_EXT;
+        copyInfo.dstImage = image;
+        copyInfo.dstImageLayout = layout;
+        copyInfo.regionCount = 1;
+        copyInfo.pRegions = &region;
+        VK_CHECK(copyMemoryToImage(device, &copyInfo));
+    }
+
+#else  // VK_EXT_host_image_copy
+
+    bool HostImageCopy::isSupported(VkPhysicalDevice, const std::set<std::string> &) {
+        return false;
+    }
+
+    std::vector<const char *> HostImageCopy::deviceExtensions() {
+        return {};
+    }
+
+    VkImageUsageFlags HostImageCopy::imageUsage() {
+        return 0;
+    }
+
+    void *HostImageCopy::chainFeatures(void *next) {
+        return next;
+    }
+
+    bool HostImageCopy::init(VkPhysicalDevice, VkDevice) {
+        return false;
+    }
+
+    bool HostImageCopy::supportsImage(VkFormat, VkImageUsageFlags) const {
+        return false;
+    }
+
+    void HostImageCopy::copyToImage(VkImage, const uint8_t *, uint32_t, uint32_t) const {
+        abort();
+    }
+
+#endif  // VK_EXT_host_image_copy
+
+}  // namespace vkt
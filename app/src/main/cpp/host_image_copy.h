@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace vkt {
+
+    /*
+     * VK_EXT_host_image_copy: the CPU writes pixels straight into an optimal-tiled image, no
+     * staging buffer, command buffer or queue submission involved. Images need
+     * VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT and are transitioned on the host as well.
+     *
+     * The extension is recent and older NDK headers don't declare it; without them this compiles
+     * to a stub that always reports the extension as unsupported, and callers keep the staging path.
+     */
+    class HostImageCopy {
+    public:
+        // Extension and hostImageCopy feature, plus the extensions it depends on before Vulkan 1.3
+        static bool isSupported(VkPhysicalDevice physicalDevice,
+                                const std::set<std::string> &availableExtensions);
+
+        static std::vector<const char *> deviceExtensions();
+
+        // Usage bit images written by copyToImage() must be created with
+        static VkImageUsageFlags imageUsage();
+
+        // Appends the feature struct enabling hostImageCopy to a VkDeviceCreateInfo pNext chain
+        void *chainFeatures(void *next);
+
+        // Loads the entry points and picks the layout images are copied in and sampled from
+        bool init(VkPhysicalDevice physicalDevice, VkDevice device);
+
+        bool isReady() const { return device != VK_NULL_HANDLE; }
+
+        /*
+         * True if images of 'format' can be host copied without making GPU access slower, images
+         * whose layout changes with host transfers enabled are better uploaded through staging.
+         */
+        bool supportsImage(VkFormat format, VkImageUsageFlags usage) const;
+
+        VkImageLayout imageLayout() const { return layout; }
+
+        // Transitions a freshly created image to imageLayout() and writes 'pixels' (tightly packed)
+        void copyToImage(VkImage image, const uint8_t *pixels, uint32_t width,
+                         uint32_t height) const;
+
+    private:
+        VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+        VkDevice device = VK_NULL_HANDLE;
+        VkImageLayout layout = VK_IMAGE_LAYOUT_GENERAL;
+#ifdef VK_EXT_host_image_copy
+        VkPhysicalDeviceHostImageCopyFeaturesEXT features{};
+        PFN_vkCopyMemoryToImageEXT copyMemoryToImage = nullptr;
+        PFN_vkTransitionImageLayoutEXT transitionImageLayout = nullptr;
+#endif
+    };
+
+}  // namespace vkt
@@ -0,0 +1,88 @@
+#include "lifecycle.h"
+
+namespace vkt {
+
+    namespace {
+
+        double millisecondsBetween(Lifecycle::Clock::time_point from,
+                                   Lifecycle::Clock::time_point to) {
+            return std::chrono::duration<double, std::milli>(to - from).count();
+        }
+
+    }  // namespace
+
+    const char *toStringLifecycleState(LifecycleState state) {
+        switch (state) {
+            case LifecycleState::NoDevice:
+                return "no device";
+            case LifecycleState::NoSurface:
+                return "no surface";
+            case LifecycleState::Ready:
+                return "ready";
+        }
+        return "unknown";
+    }
+
+    void Lifecycle::onWindowCreated(ANativeWindow *window, Clock::time_point now) {
+        if (window == nullptr) {
+            return;
+        }
+        windowTime = now;
+        awaitingFirstFrame = true;
+        switch (currentState) {
+            case LifecycleState::NoDevice:
+                host.createDevice(window);
+                counters.deviceCreates++;
+                coldStart = true;
+                break;
+            case LifecycleState::Ready:
+                // A new window without the old one being terminated first: swap the surface
+                host.detachSurface();
+                counters.surfaceDetaches++;
+                [[fallthrough]];
+            case LifecycleState::NoSurface: {
+                auto start = Clock::now();
+                host.attachSurface(window);
+                counters.surfaceAttaches++;
+                counters.lastSurfaceMs = millisecondsBetween(start, Clock::now());
+                coldStart = false;
+                break;
+            }
+        }
+        currentState = LifecycleState::Ready;
+    }
+
+    void Lifecycle::onWindowDestroyed() {
+        if (currentState != LifecycleState::Ready) {
+            return;
+        }
+        host.detachSurface();
+        counters.surfaceDetaches++;
+        awaitingFirstFrame = false;
+        currentState = LifecycleState::NoSurface;
+    }
+
+    void Lifecycle::onDestroy() {
+        onWindowDestroyed();
+        if (currentState == LifecycleState::NoSurface) {
+            host.destroyDevice();
+        }
+        currentState = LifecycleState::NoDevice;
+    }
+
+    bool Lifecycle::framePresented(Clock::time_point now) {
+        if (!awaitingFirstFrame) {
+            return false;
+        }
+        awaitingFirstFrame = false;
+        double elapsed = millisecondsBetween(windowTime, now);
+        if (coldStart) {
+            counters.coldStartMs = elapsed;
+        } else {
+            counters.lastResumeMs = elapsed;
+        }
+        counters.lastWasColdStart = coldStart;
+        return true;
+    }
+
+}  // namespace vkt
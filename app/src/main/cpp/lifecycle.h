@@ -0,0 +1,92 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+struct ANativeWindow;
+
+namespace vkt {
+
+    /*
+     * What the lifecycle asks of the renderer. The device level covers instance, device, buffers,
+     * textures and pipelines; the surface level only the surface, swapchain, depth buffer and
+     * framebuffers, which are all that depend on the window.
+     */
+    class LifecycleHost {
+    public:
+        virtual ~LifecycleHost() = default;
+
+        // Full init on the first window, surface level included
+        virtual void createDevice(ANativeWindow *window) = 0;
+
+        virtual void attachSurface(ANativeWindow *window) = 0;
+
+        virtual void detachSurface() = 0;
+
+        // Surface level is already gone
+        virtual void destroyDevice() = 0;
+    };
+
+    enum class LifecycleState {
+        NoDevice,   // before the first window, and after APP_CMD_DESTROY
+        NoSurface,  // device alive, backgrounded: no window to render to
+        Ready,      // surface and swapchain built
+    };
+
+    const char *toStringLifecycleState(LifecycleState state);
+
+    /*
+     * Maps the activity's lifecycle commands onto the renderer so that losing the window only
+     * costs the surface level: the first window brings the whole device up, later windows only
+     * rebuild the surface level, and the device level lives until the activity is destroyed.
+     * Start and stop only gate rendering, they never create or destroy anything.
+     *
+     * Also times how long each window takes to get its first frame presented, from the command
+     * to framePresented(). Time is passed in explicitly so a test can drive it.
+     */
+    class Lifecycle {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        struct Stats {
+            uint64_t deviceCreates = 0;
+            uint64_t surfaceAttaches = 0;  // without the ones done by createDevice
+            uint64_t surfaceDetaches = 0;
+            double coldStartMs = 0;        // first window to its first frame
+            double lastResumeMs = 0;       // last resumed window to its first frame
+            double lastSurfaceMs = 0;      // of which rebuilding the surface level
+            bool lastWasColdStart = false; // the last window measured brought the device up
+        };
+
+        explicit Lifecycle(LifecycleHost &host) : host(host) {}
+
+        void onStart() { started = true; }
+
+        void onStop() { started = false; }
+
+        void onWindowCreated(ANativeWindow *window, Clock::time_point now = Clock::now());
+
+        void onWindowDestroyed();
+
+        void onDestroy();
+
+        bool canRender() const { return started && currentState == LifecycleState::Ready; }
+
+        // True when this was the first frame of a window, Stats then has its latency
+        bool framePresented(Clock::time_point now = Clock::now());
+
+        LifecycleState state() const { return currentState; }
+
+        const Stats &stats() const { return counters; }
+
+    private:
+        LifecycleHost &host;
+        LifecycleState currentState = LifecycleState::NoDevice;
+        bool started = false;
+        bool awaitingFirstFrame = false;
+        bool coldStart = false;
+        Clock::time_point windowTime;
+        Stats counters;
+    };
+
+}  // namespace vkt
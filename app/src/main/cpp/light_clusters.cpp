@@ -0,0 +1,361 @@
+#include "light_clusters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define LIGHT_CULL_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define LIGHT_CULL_NEON 1
+#include <arm_neon.h>
+#endif
+
+// The vector kernels multiply and add separately, the scalar one must not be contracted into
+// fused multiply-adds or the results could differ in the last bit
+#ifdef __clang__
+#pragma clang fp contract(off)
+#endif
+
+namespace vkt {
+
+    // A row of tiles fits a mask, clusters and lights fit RowHits
+    static_assert(CLUSTER_TILES_X <= 32, "row masks are 32 bit");
+    static_assert(CLUSTER_COUNT <= 65536 && MAX_POINT_LIGHTS <= 65536, "16 bit cluster and light");
+
+    float lightRadius(float intensity, glm::vec3 attenuation) {
+        // intensity / cutoff = constant + linear d + quadratic d^2
+        float c = attenuation.x - intensity / LIGHT_CUTOFF;
+        if (c >= 0.0f) {
+            return 0.0f;  // never brighter than the cutoff
+        }
+        float linear = attenuation.y;
+        float quadratic = attenuation.z;
+        if (quadratic > 0.0f) {
+            return (-linear + std::sqrt(linear * linear - 4.0f * quadratic * c)) /
+                   (2.0f * quadratic);
+        }
+        if (linear > 0.0f) {
+            return -c / linear;
+        }
+        return std::numeric_limits<float>::infinity();  // no falloff: everywhere
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // Scalar reference
+    // ---------------------------------------------------------------------------------------------
+
+    static uint32_t overlapMaskScalar(const ClusterBounds &bounds, uint32_t first, uint32_t count,
+                                      const glm::vec4 &sphere) {
+        float radiusSquared = sphere.w * sphere.w;
+        uint32_t mask = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t c = first + i;
+            // Distance from the center to the box along each axis, 0 inside
+            float dx = std::max(std::max(bounds.minX[c] - sphere.x, sphere.x - bounds.maxX[c]),
+                                0.0f);
+            float dy = std::max(std::max(bounds.minY[c] - sphere.y, sphere.y - bounds.maxY[c]),
+                                0.0f);
+            float dz = std::max(std::max(bounds.minZ[c] - sphere.z, sphere.z - bounds.maxZ[c]),
+                                0.0f);
+            if (dx * dx + dy * dy + dz * dz <= radiusSquared) {
+                mask |= 1u << i;
+            }
+        }
+        return mask;
+    }
+
+    static const LightCullKernels SCALAR_KERNELS = {
+            "scalar",
+            overlapMaskScalar,
+    };
+
+#ifdef LIGHT_CULL_SSE2
+
+    // ---------------------------------------------------------------------------------------------
+    // SSE2, baseline on x86-64 and on the NDK's x86 ABI
+    // ---------------------------------------------------------------------------------------------
+
+    static inline __m128 axisDistanceSse2(const float *minimum, const float *maximum,
+                                          __m128 center) {
+        __m128 below = _mm_sub_ps(_mm_loadu_ps(minimum), center);
+        __m128 above = _mm_sub_ps(center, _mm_loadu_ps(maximum));
+        return _mm_max_ps(_mm_max_ps(below, above), _mm_setzero_ps());
+    }
+
+    static uint32_t overlapMaskSse2(const ClusterBounds &bounds, uint32_t first, uint32_t count,
+                                    const glm::vec4 &sphere) {
+        const __m128 x = _mm_set1_ps(sphere.x);
+        const __m128 y = _mm_set1_ps(sphere.y);
+        const __m128 z = _mm_set1_ps(sphere.z);
+        const __m128 radiusSquared = _mm_set1_ps(sphere.w * sphere.w);
+        uint32_t mask = 0;
+        uint32_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            uint32_t c = first + i;
+            __m128 dx = axisDistanceSse2(&bounds.minX[c], &bounds.maxX[c], x);
+            __m128 dy = axisDistanceSse2(&bounds.minY[c], &bounds.maxY[c], y);
+            __m128 dz = axisDistanceSse2(&bounds.minZ[c], &bounds.maxZ[c], z);
+            __m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+                                                _mm_mul_ps(dz, dz));
+            uint32_t hits = _mm_movemask_ps(_mm_cmple_ps(distanceSquared, radiusSquared));
+            mask |= hits << i;
+        }
+        if (i < count) {
+            mask |= overlapMaskScalar(bounds, first + i, count - i, sphere) << i;
+        }
+        return mask;
+    }
+
+    static const LightCullKernels SSE2_KERNELS = {
+            "sse2",
+            overlapMaskSse2,
+    };
+
+#endif  // LIGHT_CULL_SSE2
+
+#ifdef LIGHT_CULL_NEON
+
+    // ---------------------------------------------------------------------------------------------
+    // NEON, always available on arm64-v8a and required by the NDK for armeabi-v7a
+    // ---------------------------------------------------------------------------------------------
+
+    static inline float32x4_t axisDistanceNeon(const float *minimum, const float *maximum,
+                                               float32x4_t center) {
+        float32x4_t below = vsubq_f32(vld1q_f32(minimum), center);
+        float32x4_t above = vsubq_f32(center, vld1q_f32(maximum));
+        return vmaxq_f32(vmaxq_f32(below, above), vdupq_n_f32(0.0f));
+    }
+
+    // One bit per lane of an all-ones/all-zeros comparison result, without arm64-only vaddvq
+    static inline uint32_t laneMaskNeon(uint32x4_t lanes) {
+        static const uint32_t LANE_BITS[4] = {1, 2, 4, 8};
+        uint32x4_t bits = vandq_u32(lanes, vld1q_u32(LANE_BITS));
+        uint32x2_t sum = vpadd_u32(vget_low_u32(bits), vget_high_u32(bits));
+        sum = vpadd_u32(sum, sum);
+        return vget_lane_u32(sum, 0);
+    }
+
+    static uint32_t overlapMaskNeon(const ClusterBounds &bounds, uint32_t first, uint32_t count,
+                                    const glm::vec4 &sphere) {
+        const float32x4_t x = vdupq_n_f32(sphere.x);
+        const float32x4_t y = vdupq_n_f32(sphere.y);
+        const float32x4_t z = vdupq_n_f32(sphere.z);
+        const float32x4_t radiusSquared = vdupq_n_f32(sphere.w * sphere.w);
+        uint32_t mask = 0;
+        uint32_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            uint32_t c = first + i;
+            float32x4_t dx = axisDistanceNeon(&bounds.minX[c], &bounds.maxX[c], x);
+            float32x4_t dy = axisDistanceNeon(&bounds.minY[c], &bounds.maxY[c], y);
+            float32x4_t dz = axisDistanceNeon(&bounds.minZ[c], &bounds.maxZ[c], z);
+            float32x4_t distanceSquared = vaddq_f32(vaddq_f32(vmulq_f32(dx, dx), vmulq_f32(dy, dy)),
+                                                    vmulq_f32(dz, dz));
+            mask |= laneMaskNeon(vcleq_f32(distanceSquared, radiusSquared)) << i;
+        }
+        if (i < count) {
+            mask |= overlapMaskScalar(bounds, first + i, count - i, sphere) << i;
+        }
+        return mask;
+    }
+
+    static const LightCullKernels NEON_KERNELS = {
+            "neon",
+            overlapMaskNeon,
+    };
+
+#endif  // LIGHT_CULL_NEON
+
+    const LightCullKernels &scalarLightCullKernels() {
+        return SCALAR_KERNELS;
+    }
+
+    std::vector<const LightCullKernels *> supportedLightCullKernels() {
+        std::vector<const LightCullKernels *> kernels = {&SCALAR_KERNELS};
+#ifdef LIGHT_CULL_SSE2
+        kernels.push_back(&SSE2_KERNELS);
+#endif
+#ifdef LIGHT_CULL_NEON
+        kernels.push_back(&NEON_KERNELS);
+#endif
+        return kernels;
+    }
+
+    const LightCullKernels &lightCullKernels() {
+        static const LightCullKernels &best = *supportedLightCullKernels().back();
+        return best;
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // Clusters
+    // ---------------------------------------------------------------------------------------------
+
+    // Clamped before the conversion, the bounds of an infinite light are infinite
+    static uint32_t clampedIndex(float value, uint32_t count) {
+        float index = std::floor(value);
+        if (!(index > 0.0f)) {
+            return 0;
+        }
+        return index >= static_cast<float>(count - 1) ? count - 1 : static_cast<uint32_t>(index);
+    }
+
+    static uint32_t tileOf(float ndc, uint32_t tiles) {
+        return clampedIndex((ndc * 0.5f + 0.5f) * static_cast<float>(tiles), tiles);
+    }
+
+    /*
+     * Tiles along one axis covered by a sphere's bounding box between two depths, false when it is
+     * off screen. For a fixed offset from the view axis, offset / depth only grows or shrinks with
+     * depth, so the extremes are at the near or the far depth.
+     */
+    static bool tileRange(float center, float radius, float nearDepth, float farDepth, float scale,
+                          uint32_t tiles, uint32_t &first, uint32_t &last) {
+        float low = std::min((center - radius) / nearDepth, (center - radius) / farDepth) * scale;
+        float high = std::max((center + radius) / nearDepth, (center + radius) / farDepth) * scale;
+        if (high < -1.0f || low > 1.0f) {
+            return false;
+        }
+        first = tileOf(low, tiles);
+        last = tileOf(high, tiles);
+        return true;
+    }
+
+    uint32_t LightClusters::sliceOf(float depth) const {
+        return clampedIndex(std::log(depth) * slice.x + slice.y, CLUSTER_SLICES);
+    }
+
+    void LightClusters::setProjection(float fovY, float aspect, float nearPlane, float farPlane) {
+        if (fovY == fov && aspect == aspectRatio && nearPlane == zNear && farPlane == zFar) {
+            return;
+        }
+        fov = fovY;
+        aspectRatio = aspect;
+        zNear = nearPlane;
+        zFar = farPlane;
+        float tanHalfFov = std::tan(fovY / 2.0f);
+        scale = glm::vec2(1.0f / (aspect * tanHalfFov), 1.0f / tanHalfFov);
+        float logDepthRange = std::log(farPlane / nearPlane);
+        slice = glm::vec2(CLUSTER_SLICES / logDepthRange,
+                          -(CLUSTER_SLICES * std::log(nearPlane)) / logDepthRange);
+
+        for (std::vector<float> *v : {&clusterBounds.minX, &clusterBounds.maxX,
+                                      &clusterBounds.minY, &clusterBounds.maxY,
+                                      &clusterBounds.minZ, &clusterBounds.maxZ}) {
+            v->resize(CLUSTER_COUNT);
+        }
+        sliceDepths.resize(CLUSTER_SLICES + 1);
+        for (uint32_t s = 0; s <= CLUSTER_SLICES; s++) {
+            sliceDepths[s] = nearPlane * std::pow(farPlane / nearPlane,
+                                                  static_cast<float>(s) / CLUSTER_SLICES);
+        }
+        for (uint32_t s = 0; s < CLUSTER_SLICES; s++) {
+            float nearDepth = sliceDepths[s];
+            float farDepth = sliceDepths[s + 1];
+            for (uint32_t y = 0; y < CLUSTER_TILES_Y; y++) {
+                float bottom = -1.0f + 2.0f * y / CLUSTER_TILES_Y;
+                float top = -1.0f + 2.0f * (y + 1) / CLUSTER_TILES_Y;
+                for (uint32_t x = 0; x < CLUSTER_TILES_X; x++) {
+                    float left = -1.0f + 2.0f * x / CLUSTER_TILES_X;
+                    float right = -1.0f + 2.0f * (x + 1) / CLUSTER_TILES_X;
+                    uint32_t c = (s * CLUSTER_TILES_Y + y) * CLUSTER_TILES_X + x;
+                    // A froxel widens with depth, its box spans both of its depth planes
+                    clusterBounds.minX[c] = std::min(left * nearDepth, left * farDepth) / scale.x;
+                    clusterBounds.maxX[c] = std::max(right * nearDepth, right * farDepth) / scale.x;
+                    clusterBounds.minY[c] = std::min(bottom * nearDepth, bottom * farDepth) /
+                                            scale.y;
+                    clusterBounds.maxY[c] = std::max(top * nearDepth, top * farDepth) / scale.y;
+                    clusterBounds.minZ[c] = -farDepth;
+                    clusterBounds.maxZ[c] = -nearDepth;
+                }
+            }
+        }
+    }
+
+    uint32_t LightClusters::clusterAt(glm::vec3 viewPos) const {
+        float depth = std::max(-viewPos.z, zNear);
+        glm::vec2 ndc = glm::vec2(viewPos.x, viewPos.y) * scale / depth;
+        return (sliceOf(depth) * CLUSTER_TILES_Y + tileOf(ndc.y, CLUSTER_TILES_Y)) *
+               CLUSTER_TILES_X + tileOf(ndc.x, CLUSTER_TILES_X);
+    }
+
+    void LightClusters::cull(const PointLight *lights, uint32_t count,
+                             const LightCullKernels &kernels) {
+        count = std::min(count, MAX_POINT_LIGHTS);
+        counters = Stats{};
+        counters.lights = count;
+        clusterCells.assign(CLUSTER_COUNT, ClusterCell{0, 0});
+        rowHits.clear();
+
+        for (uint32_t light = 0; light < count; light++) {
+            const glm::vec4 &sphere = lights[light].positionRadius;
+            float radius = sphere.w;
+            float depth = -sphere.z;
+            if (!(radius > 0.0f) || depth + radius < zNear || depth - radius > zFar) {
+                continue;
+            }
+            float nearDepth = std::max(depth - radius, zNear);
+            float farDepth = std::min(depth + radius, zFar);
+            uint32_t lastSlice = sliceOf(farDepth);
+
+            bool visible = false;
+            for (uint32_t s = sliceOf(nearDepth); s <= lastSlice; s++) {
+                // The part of the sphere inside the slice: its depth range, and the radius of its
+                // widest cross section there
+                float bandNear = std::max(nearDepth, sliceDepths[s]);
+                float bandFar = std::min(farDepth, sliceDepths[s + 1]);
+                float dz = depth < bandNear ? bandNear - depth
+                                            : depth > bandFar ? depth - bandFar : 0.0f;
+                float bandRadius = std::sqrt(std::max(radius * radius - dz * dz, 0.0f));
+                uint32_t firstTile, lastTile, firstRow, lastRow;
+                if (!tileRange(sphere.x, bandRadius, bandNear, bandFar, scale.x, CLUSTER_TILES_X,
+                               firstTile, lastTile) ||
+                    !tileRange(sphere.y, bandRadius, bandNear, bandFar, scale.y, CLUSTER_TILES_Y,
+                               firstRow, lastRow)) {
+                    continue;
+                }
+                for (uint32_t y = firstRow; y <= lastRow; y++) {
+                    uint32_t first = (s * CLUSTER_TILES_Y + y) * CLUSTER_TILES_X + firstTile;
+                    uint32_t mask = kernels.overlapMask(clusterBounds, first,
+                                                        lastTile - firstTile + 1, sphere);
+                    if (mask == 0) {
+                        continue;
+                    }
+                    visible = true;
+                    rowHits.push_back({mask, static_cast<uint16_t>(first),
+                                       static_cast<uint16_t>(light)});
+                    for (; mask != 0; mask &= mask - 1) {
+                        clusterCells[first + __builtin_ctz(mask)].count++;
+                    }
+                }
+            }
+            counters.visibleLights += visible;
+        }
+
+        // Counting sort by cluster: offsets from the counts, then the lights go in their
+        // cluster's range in the order they were binned
+        uint32_t offset = 0;
+        for (ClusterCell &cell : clusterCells) {
+            cell.offset = offset;
+            offset += cell.count;
+            counters.maxPerCluster = std::max(counters.maxPerCluster, cell.count);
+            counters.litClusters += cell.count != 0;
+            cell.count = 0;
+        }
+        lightIndices.resize(std::min(offset, MAX_CLUSTER_LIGHT_INDICES));
+        for (const RowHits &hits : rowHits) {
+            for (uint32_t mask = hits.mask; mask != 0; mask &= mask - 1) {
+                ClusterCell &cell = clusterCells[hits.first + __builtin_ctz(mask)];
+                uint32_t index = cell.offset + cell.count;
+                if (index >= MAX_CLUSTER_LIGHT_INDICES) {
+                    counters.dropped++;
+                    continue;
+                }
+                lightIndices[index] = hits.light;
+                cell.count++;
+            }
+        }
+        counters.indices = static_cast<uint32_t>(lightIndices.size());
+    }
+
+}  // namespace vkt
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace vkt {
+
+    // Froxel grid over the view frustum: screen tiles times exponential depth slices. The same
+    // numbers are in shader.frag
+    const uint32_t CLUSTER_TILES_X = 16;
+    const uint32_t CLUSTER_TILES_Y = 8;
+    const uint32_t CLUSTER_SLICES = 24;
+    const uint32_t CLUSTER_COUNT = CLUSTER_TILES_X * CLUSTER_TILES_Y * CLUSTER_SLICES;
+
+    const uint32_t MAX_POINT_LIGHTS = 1024;
+    // Capacity of the per-cluster light index list; what doesn't fit is dropped and counted
+    const uint32_t MAX_CLUSTER_LIGHT_INDICES = 256 * 1024;
+    // Attenuated intensity subtracted from every light so it reaches 0 at its radius, also in
+    // shader.frag
+    const float LIGHT_CUTOFF = 1.0f / 64.0f;
+
+    // std430, lights[] in shader.frag
+    struct PointLight {
+        glm::vec4 positionRadius;  // xyz position (view space once culled), w lightRadius()
+        glm::vec4 colorIntensity;  // rgb color, a intensity
+        glm::vec4 attenuation;     // constant, linear, quadratic, unused
+    };
+
+    // Distance at which intensity / (constant + linear d + quadratic d^2) falls to LIGHT_CUTOFF
+    float lightRadius(float intensity, glm::vec3 attenuation);
+
+    // std430 uvec2 per cluster: first entry in the index list and the number of lights
+    struct ClusterCell {
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    // View space bounding box of every cluster, as separate arrays so a row of clusters can be
+    // tested against a light a few at a time
+    struct ClusterBounds {
+        std::vector<float> minX, maxX, minY, maxY, minZ, maxZ;
+    };
+
+    /*
+     * Sphere against cluster box tests. All implementations give the same result as the scalar
+     * one: the same operations in the same order, no fused multiply-adds.
+     */
+    struct LightCullKernels {
+        const char *name;
+
+        // Bit i set when the sphere (xyz center, w radius) overlaps the box of cluster first + i,
+        // count <= 32
+        uint32_t (*overlapMask)(const ClusterBounds &bounds, uint32_t first, uint32_t count,
+                                const glm::vec4 &sphere);
+    };
+
+    // Best implementation for this CPU
+    const LightCullKernels &lightCullKernels();
+
+    const LightCullKernels &scalarLightCullKernels();
+
+    // Every implementation this CPU can run, scalar first (for tests and benchmarks)
+    std::vector<const LightCullKernels *> supportedLightCullKernels();
+
+    /*
+     * Clustered light culling on the CPU. Each frame the view space lights are binned into the
+     * froxels their sphere of influence touches: slice by slice, a light only visits the tiles
+     * its cross section there projects to, and tests their boxes a vector at a time. The
+     * result is a light index list grouped by cluster, plus an offset and count per cluster,
+     * which the fragment shader walks for the cluster it falls in.
+     *
+     * The grid is laid over the projection before pre-rotation and Y flip, and the shader finds
+     * its cluster from the view space position rather than the pixel, so the same grid works for
+     * any surface rotation and render scale.
+     */
+    class LightClusters {
+    public:
+        struct Stats {
+            uint32_t lights = 0;
+            uint32_t visibleLights = 0;   // touching at least one cluster
+            uint32_t indices = 0;         // entries in the index list
+            uint32_t dropped = 0;         // didn't fit MAX_CLUSTER_LIGHT_INDICES
+            uint32_t maxPerCluster = 0;
+            uint32_t litClusters = 0;     // with at least one light
+        };
+
+        // Symmetric perspective projection, rebuilds the cluster boxes when it changed
+        void setProjection(float fovY, float aspect, float nearPlane, float farPlane);
+
+        // ndc.xy = view.xy * tileScale() / depth, depth being -view.z
+        glm::vec2 tileScale() const { return scale; }
+
+        // slice = log(depth) * sliceParams().x + sliceParams().y
+        glm::vec2 sliceParams() const { return slice; }
+
+        // Bins 'count' lights whose positionRadius is in view space
+        void cull(const PointLight *lights, uint32_t count,
+                  const LightCullKernels &kernels = lightCullKernels());
+
+        const std::vector<ClusterCell> &cells() const { return clusterCells; }
+
+        const std::vector<uint32_t> &indices() const { return lightIndices; }
+
+        const Stats &stats() const { return counters; }
+
+        // The cluster the fragment shader picks for a view space position
+        uint32_t clusterAt(glm::vec3 viewPos) const;
+
+        const ClusterBounds &bounds() const { return clusterBounds; }
+
+    private:
+        uint32_t sliceOf(float depth) const;
+
+        float fov = 0.0f;
+        float aspectRatio = 0.0f;
+        float zNear = 0.0f;
+        float zFar = 0.0f;
+        glm::vec2 scale{1.0f};
+        glm::vec2 slice{0.0f};
+        std::vector<float> sliceDepths;  // CLUSTER_SLICES + 1 planes
+        ClusterBounds clusterBounds;
+        std::vector<ClusterCell> clusterCells;
+        std::vector<uint32_t> lightIndices;
+        // Clusters a light touches in one row of tiles, in the order the lights were binned
+        struct RowHits {
+            uint32_t mask;    // bit i: cluster first + i
+            uint16_t first;
+            uint16_t light;
+        };
+        std::vector<RowHits> rowHits;
+        Stats counters;
+    };
+
+}  // namespace vkt
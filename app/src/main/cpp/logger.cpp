@@ -0,0 +1,137 @@
+#include "logger.h"
+
+#include <chrono>
+
+#ifdef __ANDROID__
+
+#include <android/log.h>
+
+#endif
+
+namespace vkt {
+
+    namespace {
+
+        const char *const LOG_TAG = "hellovkjni";
+
+        // Longest line handed to a sink, longer ones are cut
+        const size_t LINE_SIZE = 1024;
+
+        // The consumer also looks for records this often, producers never wake it
+        const auto POLL_INTERVAL = std::chrono::milliseconds(5);
+
+    }  // namespace
+
+    Logger &Logger::instance() {
+#ifdef __ANDROID__
+        static Logger logger(LOG_SINK_LOGCAT);
+#else
+        static Logger logger(LOG_SINK_STDOUT);
+#endif
+        return logger;
+    }
+
+    Logger::Logger(uint32_t sinks) : slots(new Slot[SLOT_COUNT]), sinkMask(sinks) {
+        for (size_t i = 0; i < SLOT_COUNT; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        consumer = std::thread([this]() { consume(); });
+    }
+
+    Logger::~Logger() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        consumer.join();
+    }
+
+    /*
+     * Bounded MPMC queue in the style of Vyukov's, with the single consumer. A slot is free for
+     * position p when its sequence is p, and readable when it is p + 1.
+     */
+    Logger::Slot *Logger::claim(uint64_t &position) {
+        position = tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot *slot = &slots[position & (SLOT_COUNT - 1)];
+            uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+            int64_t difference = int64_t(sequence) - int64_t(position);
+            if (difference == 0) {
+                if (tail.compare_exchange_weak(position, position + 1,
+                                               std::memory_order_relaxed)) {
+                    return slot;
+                }
+            } else if (difference < 0) {
+                // The consumer hasn't read this slot a lap ago: full
+                droppedCount.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            } else {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void Logger::flush() {
+        uint64_t target = tail.load(std::memory_order_acquire);
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.notify_one();
+        drained.wait(lock, [this, target]() {
+            return head.load(std::memory_order_acquire) >= target || stopping;
+        });
+    }
+
+    void Logger::consume() {
+        char line[LINE_SIZE];
+        uint64_t reportedDrops = 0;
+        uint64_t position = head.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot &slot = slots[position & (SLOT_COUNT - 1)];
+            if (slot.sequence.load(std::memory_order_acquire) == position + 1) {
+                slot.formatArgs(slot.format, slot.payload, line, sizeof(line));
+                LogLevel level = slot.level;
+                // Hand the slot back before the slow part
+                slot.sequence.store(position + SLOT_COUNT, std::memory_order_release);
+                head.store(++position, std::memory_order_release);
+                write(level, line);
+                continue;
+            }
+
+            uint64_t drops = dropped();
+            if (drops != reportedDrops) {
+                snprintf(line, sizeof(line), "Logger: %llu messages dropped, ring full",
+                         (unsigned long long) (drops - reportedDrops));
+                write(LogLevel::Error, line);
+                reportedDrops = drops;
+            }
+
+            // Caught up: release flush() callers, then sleep until woken or the next poll
+            std::unique_lock<std::mutex> lock(mutex);
+            drained.notify_all();
+            if (stopping) {
+                return;
+            }
+            // flush() notifies under the lock, a record it waits for is visible by now
+            if (slot.sequence.load(std::memory_order_acquire) == position + 1) {
+                continue;
+            }
+            wake.wait_for(lock, POLL_INTERVAL);
+        }
+    }
+
+    void Logger::write(LogLevel level, const char *text) {
+        uint32_t sinks = sinkMask.load(std::memory_order_relaxed);
+#ifdef __ANDROID__
+        if (sinks & LOG_SINK_LOGCAT) {
+            __android_log_write(level == LogLevel::Error ? ANDROID_LOG_ERROR : ANDROID_LOG_INFO,
+                                LOG_TAG, text);
+        }
+#endif
+        if (sinks & LOG_SINK_STDOUT) {
+            FILE *stream = level == LogLevel::Error ? stderr : stdout;
+            fputs(text, stream);
+            fputc('\n', stream);
+        }
+    }
+
+}  // namespace vkt
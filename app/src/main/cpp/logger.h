@@ -0,0 +1,190 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+
+namespace vkt {
+
+    enum class LogLevel : uint8_t {
+        Info,
+        Error,
+    };
+
+    enum LogSink : uint32_t {
+        LOG_SINK_LOGCAT = 1,
+        LOG_SINK_STDOUT = 2,
+    };
+
+    /*
+     * Logger that keeps formatting and the write syscall off the calling thread. log() copies the
+     * format string pointer and the arguments into a slot of a bounded lock-free multi-producer
+     * ring; a background thread formats the records in order and hands them to the sinks. When
+     * the ring is full the record is dropped and counted, the caller never waits.
+     *
+     * The format string must be a literal (it is read later). String arguments are copied into
+     * the slot, truncated to what is left of it; other arguments must be scalars or pointers.
+     */
+    class Logger {
+    public:
+        static const size_t SLOT_COUNT = 512;    // power of two
+        static const size_t PAYLOAD_SIZE = 480;  // arguments and copied strings
+
+        static Logger &instance();
+
+        explicit Logger(uint32_t sinks);
+
+        ~Logger();
+
+        Logger(const Logger &) = delete;
+
+        Logger &operator=(const Logger &) = delete;
+
+        template<typename... Args>
+        void log(LogLevel level, const char *format, Args... args);
+
+        // Blocks until everything logged before the call went to the sinks
+        void flush();
+
+        // LogSink bits, 0 formats and discards
+        void setSinks(uint32_t sinks) { sinkMask.store(sinks, std::memory_order_relaxed); }
+
+        uint64_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+
+    private:
+        using FormatFn = int (*)(const char *format, const uint8_t *payload, char *out,
+                                 size_t size);
+
+        struct alignas(64) Slot {
+            std::atomic<uint64_t> sequence;
+            const char *format;
+            FormatFn formatArgs;
+            LogLevel level;
+            alignas(16) uint8_t payload[PAYLOAD_SIZE];
+        };
+
+        // Copies string arguments behind the argument tuple, everything else as is
+        template<typename T>
+        struct Captured {
+            using Type = T;
+
+            static Type store(T value, uint8_t *, size_t &) { return value; }
+
+            static T load(Type value, const uint8_t *) { return value; }
+        };
+
+        template<typename Tuple, typename... Args, size_t... I>
+        static int formatTuple(const char *format, const uint8_t *payload, char *out,
+                               size_t size, std::index_sequence<I...>) {
+            const Tuple &values = *reinterpret_cast<const Tuple *>(payload);
+            return snprintf(out, size, format,
+                            Captured<Args>::load(std::get<I>(values), payload)...);
+        }
+
+        template<typename... Args>
+        static int formatRecord(const char *format, const uint8_t *payload, char *out,
+                                size_t size) {
+            if constexpr (sizeof...(Args) == 0) {
+                return snprintf(out, size, "%s", format);
+            } else {
+                using Tuple = std::tuple<typename Captured<Args>::Type...>;
+                return formatTuple<Tuple, Args...>(format, payload, out, size,
+                                                   std::index_sequence_for<Args...>{});
+            }
+        }
+
+        Slot *claim(uint64_t &position);
+
+        void publish(Slot *slot, uint64_t position) {
+            slot->sequence.store(position + 1, std::memory_order_release);
+        }
+
+        void consume();
+
+        void write(LogLevel level, const char *text);
+
+        std::unique_ptr<Slot[]> slots;
+        alignas(64) std::atomic<uint64_t> tail{0};   // next position producers claim
+        alignas(64) std::atomic<uint64_t> head{0};   // next position the consumer reads
+        std::atomic<uint64_t> droppedCount{0};
+        std::atomic<uint32_t> sinkMask;
+        std::atomic<bool> stopping{false};
+        std::mutex mutex;
+        std::condition_variable wake;     // consumer: new records or stop, also polled
+        std::condition_variable drained;  // flush(): the consumer caught up
+        std::thread consumer;
+    };
+
+    // C strings: stored as the offset of a copy in the payload. The last payload byte is always
+    // 0, strings that don't fit at all point there
+    template<>
+    struct Logger::Captured<const char *> {
+        using Type = uint16_t;
+
+        static Type store(const char *value, uint8_t *payload, size_t &used) {
+            const Type empty = PAYLOAD_SIZE - 1;
+            size_t room = PAYLOAD_SIZE - 1 - used;
+            if (value == nullptr || room < 2) {
+                return empty;
+            }
+            // Copied while looking for the end: the string may be shorter than the room left
+            uint8_t *text = payload + used;
+            size_t length = 0;
+            while (length < room - 1 && value[length] != 0) {
+                text[length] = value[length];
+                length++;
+            }
+            text[length] = 0;
+            Type offset = static_cast<Type>(used);
+            used += length + 1;
+            return offset;
+        }
+
+        static const char *load(Type offset, const uint8_t *payload) {
+            return reinterpret_cast<const char *>(payload + offset);
+        }
+    };
+
+    template<>
+    struct Logger::Captured<char *> : Logger::Captured<const char *> {
+    };
+
+    template<typename... Args>
+    void Logger::log(LogLevel level, const char *format, Args... args) {
+        using Tuple = std::tuple<typename Captured<Args>::Type...>;
+        static_assert(sizeof(Tuple) + 1 <= PAYLOAD_SIZE, "too many log arguments");
+
+        uint64_t position;
+        Slot *slot = claim(position);
+        if (slot == nullptr) {
+            return;
+        }
+        slot->format = format;
+        slot->formatArgs = &formatRecord<Args...>;
+        slot->level = level;
+        if constexpr (sizeof...(Args) > 0) {
+            size_t used = sizeof(Tuple);
+            slot->payload[PAYLOAD_SIZE - 1] = 0;
+            new(slot->payload) Tuple{Captured<Args>::store(args, slot->payload, used)...};
+        }
+        publish(slot, position);
+    }
+
+    // Never called: lets the compiler check LOGI / LOGE arguments against the format
+    __attribute__((format(printf, 1, 2))) inline void checkLogFormat(const char *, ...) {}
+
+}  // namespace vkt
+
+#define VKT_LOG(level, ...)                                             \
+    do {                                                                \
+        if (false) vkt::checkLogFormat(__VA_ARGS__);                    \
+        vkt::Logger::instance().log(level, __VA_ARGS__);                \
+    } while (0)
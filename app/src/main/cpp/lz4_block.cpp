@@ -0,0 +1,196 @@
+#include "lz4_block.h"
+
+#include <cstring>
+#include <vector>
+
+namespace vkt {
+
+    static const size_t MIN_MATCH = 4;
+    static const size_t LAST_LITERALS = 5;    // the block must end with at least 5 literals
+    static const size_t MATCH_FIND_LIMIT = 12; // the last match starts at least 12 bytes before the end
+    static const size_t MAX_OFFSET = 65535;
+    static const int HASH_BITS = 16;
+
+    static uint32_t read32(const uint8_t *p) {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    static uint32_t hashSequence(uint32_t sequence) {
+        return (sequence * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    // Writes the 255 + 255 + ... + remainder tail of a length that didn't fit in its 4 bits
+    static bool writeLength(size_t length, uint8_t *dst, size_t dstCapacity, size_t &op) {
+        while (length >= 255) {
+            if (op >= dstCapacity) {
+                return false;
+            }
+            dst[op++] = 255;
+            length -= 255;
+        }
+        if (op >= dstCapacity) {
+            return false;
+        }
+        dst[op++] = static_cast<uint8_t>(length);
+        return true;
+    }
+
+    static bool writeSequence(const uint8_t *literals, size_t literalLength, size_t offset,
+                              size_t matchLength, uint8_t *dst, size_t dstCapacity, size_t &op) {
+        if (op >= dstCapacity) {
+            return false;
+        }
+        size_t tokenPos = op++;
+        uint8_t token = 0;
+
+        if (literalLength >= 15) {
+            token = 15 << 4;
+            if (!writeLength(literalLength - 15, dst, dstCapacity, op)) {
+                return false;
+            }
+        } else {
+            token = static_cast<uint8_t>(literalLength << 4);
+        }
+
+        if (literalLength > dstCapacity - op) {
+            return false;
+        }
+        memcpy(dst + op, literals, literalLength);
+        op += literalLength;
+
+        if (matchLength == 0) {
+            dst[tokenPos] = token;  // last sequence, literals only
+            return true;
+        }
+
+        if (dstCapacity - op < 2) {
+            return false;
+        }
+        dst[op++] = static_cast<uint8_t>(offset & 0xff);
+        dst[op++] = static_cast<uint8_t>(offset >> 8);
+
+        size_t encodedMatch = matchLength - MIN_MATCH;
+        if (encodedMatch >= 15) {
+            token |= 15;
+            if (!writeLength(encodedMatch - 15, dst, dstCapacity, op)) {
+                return false;
+            }
+        } else {
+            token |= static_cast<uint8_t>(encodedMatch);
+        }
+        dst[tokenPos] = token;
+        return true;
+    }
+
+    size_t lz4Compress(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity) {
+        size_t op = 0;
+        size_t anchor = 0;
+
+        if (srcSize > MATCH_FIND_LIMIT) {
+            std::vector<int32_t> table(size_t(1) << HASH_BITS, -1);
+            const size_t matchLimit = srcSize - LAST_LITERALS;
+            const size_t inputLimit = srcSize - MATCH_FIND_LIMIT;
+
+            size_t ip = 0;
+            while (ip < inputLimit) {
+                uint32_t sequence = read32(src + ip);
+                uint32_t h = hashSequence(sequence);
+                int32_t ref = table[h];
+                table[h] = static_cast<int32_t>(ip);
+
+                if (ref < 0 || ip - ref > MAX_OFFSET || read32(src + ref) != sequence) {
+                    ip++;
+                    continue;
+                }
+
+                size_t matchLength = MIN_MATCH;
+                while (ip + matchLength < matchLimit && src[ref + matchLength] == src[ip + matchLength]) {
+                    matchLength++;
+                }
+
+                if (!writeSequence(src + anchor, ip - anchor, ip - ref, matchLength, dst,
+                                   dstCapacity, op)) {
+                    return 0;
+                }
+                ip += matchLength;
+                anchor = ip;
+            }
+        }
+
+        if (!writeSequence(src + anchor, srcSize - anchor, 0, 0, dst, dstCapacity, op)) {
+            return 0;
+        }
+        return op;
+    }
+
+    bool lz4Decompress(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstSize) {
+        size_t ip = 0;
+        size_t op = 0;
+
+        while (ip < srcSize) {
+            uint8_t token = src[ip++];
+
+            size_t literalLength = token >> 4;
+            if (literalLength == 15) {
+                uint8_t extra;
+                do {
+                    if (ip >= srcSize) {
+                        return false;
+                    }
+                    extra = src[ip++];
+                    literalLength += extra;
+                } while (extra == 255);
+            }
+            if (literalLength > srcSize - ip || literalLength > dstSize - op) {
+                return false;
+            }
+            memcpy(dst + op, src + ip, literalLength);
+            ip += literalLength;
+            op += literalLength;
+
+            if (ip == srcSize) {
+                return op == dstSize;  // the last sequence has no match
+            }
+
+            if (srcSize - ip < 2) {
+                return false;
+            }
+            size_t offset = src[ip] | (src[ip + 1] << 8);
+            ip += 2;
+            if (offset == 0 || offset > op) {
+                return false;
+            }
+
+            size_t matchLength = token & 15;
+            if (matchLength == 15) {
+                uint8_t extra;
+                do {
+                    if (ip >= srcSize) {
+                        return false;
+                    }
+                    extra = src[ip++];
+                    matchLength += extra;
+                } while (extra == 255);
+            }
+            matchLength += MIN_MATCH;
+            if (matchLength > dstSize - op) {
+                return false;
+            }
+
+            // Matches may overlap their own output (offset < length), copy forward byte by byte
+            const uint8_t *match = dst + op - offset;
+            if (offset >= matchLength) {
+                memcpy(dst + op, match, matchLength);
+            } else {
+                for (size_t i = 0; i < matchLength; i++) {
+                    dst[op + i] = match[i];
+                }
+            }
+            op += matchLength;
+        }
+        return false;  // an empty block, or one that ended right after a match
+    }
+
+}  // namespace vkt
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace vkt {
+
+    /*
+     * Minimal implementation of the LZ4 block format (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md),
+     * enough for asset packs: a greedy single-hash compressor for the host packer and a bounds
+     * checked decoder for the app. The output is a plain LZ4 block, any LZ4 decoder can read it.
+     */
+
+    // Worst case compressed size for 'size' input bytes
+    inline size_t lz4CompressBound(size_t size) {
+        return size + size / 255 + 16;
+    }
+
+    // Returns the compressed size, or 0 if 'dstCapacity' is too small
+    size_t lz4Compress(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity);
+
+    // Returns true only if the block decodes to exactly 'dstSize' bytes without reading past 'src'
+    bool lz4Decompress(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstSize);
+
+}  // namespace vkt
@@ -0,0 +1,484 @@
+#include "pipeline_service.h"
+
+#include <cassert>
+
+#include "asset_pack.h"
+#include "vk_common.h"
+
+namespace vkt {
+
+    namespace {
+
+        // Fixed-function state shared by the monolithic and the pipeline library paths
+        struct FixedFunctionState {
+            explicit FixedFunctionState(const PipelineDesc &desc) {
+                stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+                stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+                stages[0].module = desc.vertexShader;
+                stages[0].pName = "main";
+                stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+                stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+                stages[1].module = desc.fragmentShader;
+                stages[1].pName = "main";
+                if (!desc.specializationEntries.empty()) {
+                    specialization.mapEntryCount =
+                            static_cast<uint32_t>(desc.specializationEntries.size());
+                    specialization.pMapEntries = desc.specializationEntries.data();
+                    specialization.dataSize = desc.specializationData.size();
+                    specialization.pData = desc.specializationData.data();
+                    stages[1].pSpecializationInfo = &specialization;
+                }
+
+                vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+                vertexInput.vertexBindingDescriptionCount =
+                        static_cast<uint32_t>(desc.bindings.size());
+                vertexInput.pVertexBindingDescriptions = desc.bindings.data();
+                vertexInput.vertexAttributeDescriptionCount =
+                        static_cast<uint32_t>(desc.attributes.size());
+                vertexInput.pVertexAttributeDescriptions = desc.attributes.data();
+
+                inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+                inputAssembly.topology = desc.topology;
+
+                viewport.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+                viewport.viewportCount = 1;
+                viewport.scissorCount = 1;
+
+                rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+                rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+                rasterizer.lineWidth = 1.0f;
+                rasterizer.cullMode = desc.cullMode;
+                rasterizer.frontFace = desc.frontFace;
+
+                multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+                multisampling.rasterizationSamples = desc.samples;
+                multisampling.minSampleShading = 1.0f;
+
+                depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+                depthStencil.depthTestEnable = desc.depthTest ? VK_TRUE : VK_FALSE;
+                depthStencil.depthWriteEnable = desc.depthTest ? VK_TRUE : VK_FALSE;
+                depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+                depthStencil.maxDepthBounds = 1.0f;
+
+                blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                                 VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+                blendAttachment.blendEnable = VK_FALSE;
+
+                colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+                colorBlending.logicOp = VK_LOGIC_OP_COPY;
+                colorBlending.attachmentCount = 1;
+                colorBlending.pAttachments = &blendAttachment;
+
+                dynamic.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+                dynamic.dynamicStateCount = 2;
+                dynamic.pDynamicStates = dynamicStates;
+            }
+
+            FixedFunctionState(const FixedFunctionState &) = delete;
+
+            FixedFunctionState &operator=(const FixedFunctionState &) = delete;
+
+            VkPipelineShaderStageCreateInfo stages[2]{};
+            VkSpecializationInfo specialization{};
+            VkPipelineVertexInputStateCreateInfo vertexInput{};
+            VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+            VkPipelineViewportStateCreateInfo viewport{};
+            VkPipelineRasterizationStateCreateInfo rasterizer{};
+            VkPipelineMultisampleStateCreateInfo multisampling{};
+            VkPipelineDepthStencilStateCreateInfo depthStencil{};
+            VkPipelineColorBlendAttachmentState blendAttachment{};
+            VkPipelineColorBlendStateCreateInfo colorBlending{};
+            VkDynamicState dynamicStates[2] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+            VkPipelineDynamicStateCreateInfo dynamic{};
+        };
+
+        double millisecondsSince(std::chrono::steady_clock::time_point start) {
+            return std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start).count();
+        }
+
+        template<typename T>
+        uint64_t hashValue(const T &value, uint64_t seed) {
+            return hashBytes(&value, sizeof(value), seed);
+        }
+
+    }  // namespace
+
+    PipelineId PipelineService::request(const PipelineDesc &desc) {
+        assert(device != VK_NULL_HANDLE);
+
+        auto entry = std::make_unique<Entry>();
+        entry->desc = desc;
+        entry->requestTime = Clock::now();
+        Entry *compiled = entry.get();
+        entry->job = pool->submit([this, compiled]() { compile(*compiled); });
+
+        entries.push_back(std::move(entry));
+        counters.requested++;
+        return static_cast<PipelineId>(entries.size() - 1);
+    }
+
+    void PipelineService::wait(PipelineId id) {
+        Entry &entry = *entries[id];
+        std::unique_lock<std::mutex> lock(readyMutex);
+        readyChanged.wait(lock, [&entry]() { return entry.pipeline.load() != VK_NULL_HANDLE; });
+    }
+
+    VkPipeline PipelineService::get(PipelineId id) const {
+        return id < entries.size() ? entries[id]->pipeline.load() : VK_NULL_HANDLE;
+    }
+
+    VkPipeline PipelineService::resolve(PipelineId id, PipelineId fallback) {
+        VkPipeline pipeline = get(id);
+        if (pipeline != VK_NULL_HANDLE) {
+            return pipeline;
+        }
+        counters.fallbackBinds++;
+        return get(fallback);
+    }
+
+    bool PipelineService::update() {
+        bool changed = false;
+        for (auto &entry: entries) {
+            uint32_t generation = entry->generation.load(std::memory_order_acquire);
+            if (generation == entry->seenGeneration) {
+                continue;
+            }
+            entry->seenGeneration = generation;
+            changed = true;
+
+            double optimizedMs = entry->optimizedMs.load();
+            if (optimizedMs > 0) {
+                LOGI("Pipeline %s: first usable after %.2f ms, optimized after %.2f ms "
+                     "(queued %.2f ms)", entry->desc.name.c_str(), entry->firstMs.load(),
+                     optimizedMs, entry->queuedMs);
+            } else {
+                LOGI("Pipeline %s: ready after %.2f ms (queued %.2f ms)",
+                     entry->desc.name.c_str(), entry->firstMs.load(), entry->queuedMs);
+            }
+        }
+        counters.libraryParts = partsCompiled.load();
+        counters.published = publishedCount.load();
+        return changed;
+    }
+
+    /*
+     * Runs on a worker. The first publish makes the pipeline drawable; with pipeline libraries a
+     * second one swaps the fast link for the optimized link. The fast-linked pipeline may still be
+     * referenced by recorded command buffers, so it is only destroyed with the service.
+     */
+    void PipelineService::compile(Entry &entry) {
+        entry.queuedMs = millisecondsSince(entry.requestTime);
+
+        if (!pipelineLibraries) {
+            publish(entry, createMonolithic(entry.desc), &entry.firstMs);
+            return;
+        }
+
+        VkPipeline pipelineParts[4];
+        uint32_t partCount = 0;
+        for (uint32_t part = 0; part < 4; part++) {
+            pipelineParts[partCount++] = libraryPart(1u << part, entry.desc);
+        }
+
+        if (fastLinking) {
+            entry.fastLinked = link(pipelineParts, partCount, entry.desc.layout, false);
+            publish(entry, entry.fastLinked, &entry.firstMs);
+        }
+        VkPipeline optimized = link(pipelineParts, partCount, entry.desc.layout, true);
+        publish(entry, optimized, fastLinking ? &entry.optimizedMs : &entry.firstMs);
+    }
+
+    void PipelineService::publish(Entry &entry, VkPipeline pipeline,
+                                  std::atomic<double> *latencyMs) {
+        latencyMs->store(millisecondsSince(entry.requestTime));
+        {
+            std::lock_guard<std::mutex> lock(readyMutex);
+            entry.pipeline.store(pipeline);
+        }
+        entry.generation.fetch_add(1, std::memory_order_release);
+        publishedCount++;
+        readyChanged.notify_all();
+        if (onPublish) {
+            onPublish();
+        }
+    }
+
+    VkPipeline PipelineService::createMonolithic(const PipelineDesc &desc) const {
+        FixedFunctionState state(desc);
+
+        VkGraphicsPipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipelineInfo.stageCount = 2;
+        pipelineInfo.pStages = state.stages;
+        pipelineInfo.pVertexInputState = &state.vertexInput;
+        pipelineInfo.pInputAssemblyState = &state.inputAssembly;
+        pipelineInfo.pViewportState = &state.viewport;
+        pipelineInfo.pRasterizationState = &state.rasterizer;
+        pipelineInfo.pMultisampleState = &state.multisampling;
+        pipelineInfo.pDepthStencilState = &state.depthStencil;
+        pipelineInfo.pColorBlendState = &state.colorBlending;
+        pipelineInfo.pDynamicState = &state.dynamic;
+        pipelineInfo.layout = desc.layout;
+        pipelineInfo.renderPass = desc.renderPass;
+        pipelineInfo.subpass = desc.subpass;
+        pipelineInfo.basePipelineIndex = -1;
+
+        VkPipeline pipeline;
+        VK_CHECK(vkCreateGraphicsPipelines(device, cache, 1, &pipelineInfo, nullptr, &pipeline));
+        return pipeline;
+    }
+
+    /*
+     * Returns the cached part, compiling it first if no pipeline needed it yet. The key only
+     * covers the state the part depends on.
+     */
+    VkPipeline PipelineService::libraryPart(uint32_t part, const PipelineDesc &desc) {
+        uint64_t key = hashBytes(&part, sizeof(part));
+        switch (part) {
+            case 1u << 0:  // vertex input interface
+                key = hashBytes(desc.bindings.data(),
+                                desc.bindings.size() * sizeof(desc.bindings[0]), key);
+                key = hashBytes(desc.attributes.data(),
+                                desc.attributes.size() * sizeof(desc.attributes[0]), key);
+                key = hashValue(desc.topology, key);
+                break;
+            case 1u << 1:  // pre-rasterization shaders
+                key = hashValue(desc.vertexShader, key);
+                key = hashValue(desc.cullMode, key);
+                key = hashValue(desc.frontFace, key);
+                key = hashValue(desc.layout, key);
+                break;
+            case 1u << 2:  // fragment shader
+                key = hashValue(desc.fragmentShader, key);
+                key = hashBytes(desc.specializationEntries.data(),
+                                desc.specializationEntries.size() *
+                                sizeof(desc.specializationEntries[0]), key);
+                key = hashBytes(desc.specializationData.data(), desc.specializationData.size(),
+                                key);
+                key = hashValue(desc.samples, key);
+                key = hashValue(desc.depthTest, key);
+                key = hashValue(desc.layout, key);
+                break;
+            default:       // fragment output interface
+                key = hashValue(desc.samples, key);
+                break;
+        }
+        if (part != 1u << 0) {
+            key = hashValue(desc.renderPass, key);
+            key = hashValue(desc.subpass, key);
+        }
+
+        std::promise<VkPipeline> compiled;
+        std::shared_future<VkPipeline> result;
+        bool owner = false;
+        {
+            std::lock_guard<std::mutex> lock(partsMutex);
+            auto found = parts.find(key);
+            if (found != parts.end()) {
+                result = found->second;
+            } else {
+                result = compiled.get_future().share();
+                parts.emplace(key, result);
+                owner = true;
+            }
+        }
+        if (owner) {
+            compiled.set_value(createLibraryPart(part, desc));
+            partsCompiled++;
+        }
+        return result.get();
+    }
+
+#ifdef VK_EXT_graphics_pipeline_library
+
+    bool PipelineService::isSupported(VkPhysicalDevice physicalDevice,
+                                      const std::set<std::string> &availableExtensions) {
+        for (const char *extension: deviceExtensions()) {
+            if (!availableExtensions.count(extension)) {
+                return false;
+            }
+        }
+
+        VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT libraryFeatures{};
+        libraryFeatures.sType =
+                VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &libraryFeatures;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+        return libraryFeatures.graphicsPipelineLibrary;
+    }
+
+    std::vector<const char *> PipelineService::deviceExtensions() {
+        return {VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME,
+                VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME};
+    }
+
+    void *PipelineService::chainFeatures(void *next) {
+        features = {};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+        features.graphicsPipelineLibrary = VK_TRUE;
+        features.pNext = next;
+        return &features;
+    }
+
+    VkPipeline PipelineService::createLibraryPart(uint32_t part, const PipelineDesc &desc) const {
+        FixedFunctionState state(desc);
+
+        VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo{};
+        libraryInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+        libraryInfo.flags = part;
+
+        VkGraphicsPipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipelineInfo.pNext = &libraryInfo;
+        pipelineInfo.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR |
+                             VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+        pipelineInfo.basePipelineIndex = -1;
+
+        switch (part) {
+            case VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT:
+                pipelineInfo.pVertexInputState = &state.vertexInput;
+                pipelineInfo.pInputAssemblyState = &state.inputAssembly;
+                break;
+            case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT:
+                pipelineInfo.stageCount = 1;
+                pipelineInfo.pStages = &state.stages[0];
+                pipelineInfo.pViewportState = &state.viewport;
+                pipelineInfo.pRasterizationState = &state.rasterizer;
+                pipelineInfo.pDynamicState = &state.dynamic;
+                pipelineInfo.layout = desc.layout;
+                pipelineInfo.renderPass = desc.renderPass;
+                pipelineInfo.subpass = desc.subpass;
+                break;
+            case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT:
+                pipelineInfo.stageCount = 1;
+                pipelineInfo.pStages = &state.stages[1];
+                pipelineInfo.pMultisampleState = &state.multisampling;
+                pipelineInfo.pDepthStencilState = &state.depthStencil;
+                pipelineInfo.layout = desc.layout;
+                pipelineInfo.renderPass = desc.renderPass;
+                pipelineInfo.subpass = desc.subpass;
+                break;
+            default:
+                assert(part == VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT);
+                pipelineInfo.pColorBlendState = &state.colorBlending;
+                pipelineInfo.pMultisampleState = &state.multisampling;
+                pipelineInfo.renderPass = desc.renderPass;
+                pipelineInfo.subpass = desc.subpass;
+                break;
+        }
+
+        VkPipeline pipeline;
+        VK_CHECK(vkCreateGraphicsPipelines(device, cache, 1, &pipelineInfo, nullptr, &pipeline));
+        return pipeline;
+    }
+
+    VkPipeline PipelineService::link(const VkPipeline *pipelineParts, uint32_t partCount,
+                                     VkPipelineLayout layout, bool optimize) const {
+        VkPipelineLibraryCreateInfoKHR libraryInfo{};
+        libraryInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+        libraryInfo.libraryCount = partCount;
+        libraryInfo.pLibraries = pipelineParts;
+
+        VkGraphicsPipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipelineInfo.pNext = &libraryInfo;
+        pipelineInfo.flags = optimize ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0;
+        pipelineInfo.layout = layout;
+        pipelineInfo.basePipelineIndex = -1;
+
+        VkPipeline pipeline;
+        VK_CHECK(vkCreateGraphicsPipelines(device, cache, 1, &pipelineInfo, nullptr, &pipeline));
+        return pipeline;
+    }
+
+    void PipelineService::init(VkPhysicalDevice physicalDevice, VkDevice newDevice,
+                               ThreadPool *newPool, bool usePipelineLibraries) {
+        device = newDevice;
+        pool = newPool;
+        pipelineLibraries = usePipelineLibraries;
+
+        if (pipelineLibraries) {
+            // Without fast linking a link is not much cheaper than a full compile, so only the
+            // optimized link is made
+            VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT libraryProperties{};
+            libraryProperties.sType =
+                    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT;
+            VkPhysicalDeviceProperties2 properties2{};
+            properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+            properties2.pNext = &libraryProperties;
+            vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+            fastLinking = libraryProperties.graphicsPipelineLibraryFastLinking;
+        }
+
+        VkPipelineCacheCreateInfo cacheInfo{};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        VK_CHECK(vkCreatePipelineCache(device, &cacheInfo, nullptr, &cache));
+    }
+
+#else  // VK_EXT_graphics_pipeline_library
+
+    bool PipelineService::isSupported(VkPhysicalDevice, const std::set<std::string> &) {
+        return false;
+    }
+
+    std::vector<const char *> PipelineService::deviceExtensions() {
+        return {};
+    }
+
+    void *PipelineService::chainFeatures(void *next) {
+        return next;
+    }
+
+    VkPipeline PipelineService::createLibraryPart(uint32_t, const PipelineDesc &) const {
+        abort();
+    }
+
+    VkPipeline PipelineService::link(const VkPipeline *, uint32_t, VkPipelineLayout, bool) const {
+        abort();
+    }
+
+    void PipelineService::init(VkPhysicalDevice, VkDevice newDevice, ThreadPool *newPool, bool) {
+        device = newDevice;
+        pool = newPool;
+        pipelineLibraries = false;
+
+        VkPipelineCacheCreateInfo cacheInfo{};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        VK_CHECK(vkCreatePipelineCache(device, &cacheInfo, nullptr, &cache));
+    }
+
+#endif  // VK_EXT_graphics_pipeline_library
+
+    void PipelineService::destroy() {
+        if (device == VK_NULL_HANDLE) {
+            return;
+        }
+
+        for (auto &entry: entries) {
+            entry->job.wait();
+        }
+        for (auto &entry: entries) {
+            if (entry->fastLinked != VK_NULL_HANDLE && entry->fastLinked != entry->pipeline.load()) {
+                vkDestroyPipeline(device, entry->fastLinked, nullptr);
+            }
+            vkDestroyPipeline(device, entry->pipeline.load(), nullptr);
+        }
+        for (auto &part: parts) {
+            vkDestroyPipeline(device, part.second.get(), nullptr);
+        }
+        vkDestroyPipelineCache(device, cache, nullptr);
+
+        entries.clear();
+        parts.clear();
+        counters = {};
+        partsCompiled = 0;
+        publishedCount = 0;
+        cache = VK_NULL_HANDLE;
+        device = VK_NULL_HANDLE;
+    }
+
+}  // namespace vkt
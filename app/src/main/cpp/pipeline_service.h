@@ -0,0 +1,166 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "thread_pool.h"
+
+namespace vkt {
+
+    using PipelineId = uint32_t;
+
+    const PipelineId INVALID_PIPELINE = UINT32_MAX;
+
+    /*
+     * Everything that goes into one graphics pipeline. Viewport and scissor are always dynamic,
+     * blending is off. The shader modules must stay alive until the service is destroyed,
+     * compilation reads them on the workers.
+     */
+    struct PipelineDesc {
+        std::string name;                                           // For the latency log
+        VkShaderModule vertexShader = VK_NULL_HANDLE;
+        VkShaderModule fragmentShader = VK_NULL_HANDLE;
+        std::vector<VkVertexInputBindingDescription> bindings;
+        std::vector<VkVertexInputAttributeDescription> attributes;
+        VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+        VkFrontFace frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+        VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+        bool depthTest = false;                                     // Test and write, LESS
+        // Fragment shader specialization constants, the entries' offsets index into the data
+        std::vector<VkSpecializationMapEntry> specializationEntries;
+        std::vector<uint8_t> specializationData;
+        VkPipelineLayout layout = VK_NULL_HANDLE;
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        uint32_t subpass = 0;
+    };
+
+    /*
+     * Creates graphics pipelines on the worker pool so that a new pipeline never stalls a frame.
+     * request() returns right away with an id, draws resolve() that id to the real pipeline once
+     * it has been published and to a fallback pipeline until then.
+     *
+     * With VK_EXT_graphics_pipeline_library each pipeline is built from four parts: vertex input,
+     * pre-rasterization shaders, fragment shader and fragment output. Parts are cached by the
+     * state they depend on, so pipelines sharing e.g. a vertex format or a vertex shader only pay
+     * for what differs. Once its parts exist, a pipeline is published as a fast link first, and
+     * replaced by a link-time optimized version when that is done. Without the extension each
+     * pipeline is one monolithic vkCreateGraphicsPipelines call on a worker.
+     *
+     * All calls except the compilation itself happen on the thread that owns the service.
+     */
+    class PipelineService {
+    public:
+        struct Stats {
+            uint64_t requested = 0;
+            uint64_t published = 0;      // fast links, optimized links and monolithic pipelines
+            uint64_t libraryParts = 0;   // parts actually compiled, not found in the part cache
+            uint64_t fallbackBinds = 0;  // resolve() calls answered with the fallback
+        };
+
+        // VK_EXT_graphics_pipeline_library extension and feature, and the extension it needs
+        static bool isSupported(VkPhysicalDevice physicalDevice,
+                                const std::set<std::string> &availableExtensions);
+
+        static std::vector<const char *> deviceExtensions();
+
+        // Appends the feature struct enabling graphicsPipelineLibrary to a VkDeviceCreateInfo chain
+        void *chainFeatures(void *next);
+
+        void init(VkPhysicalDevice physicalDevice, VkDevice device, ThreadPool *pool,
+                  bool usePipelineLibraries);
+
+        // Waits for every compilation in flight, then destroys all pipelines, parts and the cache
+        void destroy();
+
+        // Called on the worker after every publish, set before the first request
+        void setPublishCallback(std::function<void()> callback) {
+            onPublish = std::move(callback);
+        }
+
+        bool usesPipelineLibraries() const { return pipelineLibraries; }
+
+        // Starts compiling on a worker
+        PipelineId request(const PipelineDesc &desc);
+
+        // Blocks until 'id' has a pipeline to draw with (the fast link, with pipeline libraries)
+        void wait(PipelineId id);
+
+        // VK_NULL_HANDLE while 'id' is still compiling
+        VkPipeline get(PipelineId id) const;
+
+        VkPipeline resolve(PipelineId id, PipelineId fallback);
+
+        /*
+         * Logs the latency of the pipelines published since the last call. Returns true if any
+         * was, command buffers recorded with the previous pipeline or the fallback are stale then.
+         */
+        bool update();
+
+        const Stats &stats() const { return counters; }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Entry {
+            PipelineDesc desc;
+            Clock::time_point requestTime;
+            std::future<void> job;
+            std::atomic<VkPipeline> pipeline{VK_NULL_HANDLE};
+            std::atomic<uint32_t> generation{0};  // bumped by the worker on every publish
+            uint32_t seenGeneration = 0;          // owner thread only
+            VkPipeline fastLinked = VK_NULL_HANDLE;
+            double queuedMs = 0;                  // time before a worker picked the job up
+            std::atomic<double> firstMs{0};       // request to first publish
+            std::atomic<double> optimizedMs{0};   // request to optimized link, 0 if none
+        };
+
+        void compile(Entry &entry);
+
+        void publish(Entry &entry, VkPipeline pipeline, std::atomic<double> *latencyMs);
+
+        VkPipeline createMonolithic(const PipelineDesc &desc) const;
+
+        VkPipeline libraryPart(uint32_t part, const PipelineDesc &desc);
+
+        VkPipeline createLibraryPart(uint32_t part, const PipelineDesc &desc) const;
+
+        VkPipeline link(const VkPipeline *parts, uint32_t partCount, VkPipelineLayout layout,
+                        bool optimize) const;
+
+        VkDevice device = VK_NULL_HANDLE;
+        ThreadPool *pool = nullptr;
+        VkPipelineCache cache = VK_NULL_HANDLE;
+        bool pipelineLibraries = false;
+        bool fastLinking = false;
+        std::vector<std::unique_ptr<Entry>> entries;
+        Stats counters;
+        std::atomic<uint64_t> partsCompiled{0};
+        std::atomic<uint64_t> publishedCount{0};
+        std::function<void()> onPublish;
+
+        // Parts keyed by the hash of the state they depend on; the first worker to need a part
+        // compiles it, the others wait on the same future
+        std::mutex partsMutex;
+        std::map<uint64_t, std::shared_future<VkPipeline>> parts;
+
+        std::mutex readyMutex;
+        std::condition_variable readyChanged;
+#ifdef VK_EXT_graphics_pipeline_library
+        VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT features{};
+#endif
+    };
+
+}  // namespace vkt
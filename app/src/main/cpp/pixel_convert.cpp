@@ -0,0 +1,374 @@
+#include "pixel_convert.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PIXEL_KERNELS_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define PIXEL_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace vkt {
+
+    // Pixels converted per step of convertPixels, the scratch block stays in L1
+    static const size_t CONVERT_BLOCK_PIXELS = 1024;
+
+    struct SrgbTables {
+        uint8_t toLinear[256];
+        uint8_t toSrgb[256];
+
+        SrgbTables() {
+            for (int i = 0; i < 256; i++) {
+                double c = i / 255.0;
+                double linear = c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+                double srgb = c <= 0.0031308 ? c * 12.92 : 1.055 * std::pow(c, 1.0 / 2.4) - 0.055;
+                toLinear[i] = static_cast<uint8_t>(std::lround(linear * 255.0));
+                toSrgb[i] = static_cast<uint8_t>(std::lround(srgb * 255.0));
+            }
+        }
+    };
+
+    static const SrgbTables &srgbTables() {
+        static const SrgbTables tables;
+        return tables;
+    }
+
+    // round(c * a / 255) without a division, exact for every 8 bit input
+    static inline uint8_t mulDiv255(uint32_t c, uint32_t a) {
+        uint32_t t = c * a + 128;
+        return static_cast<uint8_t>((t + (t >> 8)) >> 8);
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // Scalar reference
+    // ---------------------------------------------------------------------------------------------
+
+    static void expandRgbToRgbaScalar(const uint8_t *src, uint8_t *dst, size_t pixels) {
+        for (size_t i = 0; i < pixels; i++) {
+            dst[i * 4 + 0] = src[i * 3 + 0];
+            dst[i * 4 + 1] = src[i * 3 + 1];
+            dst[i * 4 + 2] = src[i * 3 + 2];
+            dst[i * 4 + 3] = 255;
+        }
+    }
+
+    static void swapRedBlueScalar(const uint8_t *src, uint8_t *dst, size_t pixels) {
+        for (size_t i = 0; i < pixels * 4; i += 4) {
+            uint8_t r = src[i + 0];
+            uint8_t g = src[i + 1];
+            uint8_t b = src[i + 2];
+            uint8_t a = src[i + 3];
+            dst[i + 0] = b;
+            dst[i + 1] = g;
+            dst[i + 2] = r;
+            dst[i + 3] = a;
+        }
+    }
+
+    static void premultiplyAlphaScalar(const uint8_t *src, uint8_t *dst, size_t pixels) {
+        for (size_t i = 0; i < pixels * 4; i += 4) {
+            uint8_t a = src[i + 3];
+            dst[i + 0] = mulDiv255(src[i + 0], a);
+            dst[i + 1] = mulDiv255(src[i + 1], a);
+            dst[i + 2] = mulDiv255(src[i + 2], a);
+            dst[i + 3] = a;
+        }
+    }
+
+    static void applyColorTable(const uint8_t *table, const uint8_t *src, uint8_t *dst,
+                                size_t pixels) {
+        for (size_t i = 0; i < pixels * 4; i += 4) {
+            dst[i + 0] = table[src[i + 0]];
+            dst[i + 1] = table[src[i + 1]];
+            dst[i + 2] = table[src[i + 2]];
+            dst[i + 3] = src[i + 3];
+        }
+    }
+
+    static void srgbToLinearTable(const uint8_t *src, uint8_t *dst, size_t pixels) {
+        applyColorTable(srgbTables().toLinear, src, dst, pixels);
+    }
+
+    static void linearToSrgbTable(const uint8_t *src, uint8_t *dst, size_t pixels) {
+        applyColorTable(srgbTables().toSrgb, src, dst, pixels);
+    }
+
+    static const PixelKernels SCALAR_KERNELS = {
+            "scalar",
+            expandRgbToRgbaScalar,
+            swapRedBlueScalar,
+            premultiplyAlphaScalar,
+            srgbToLinearTable,
+            linearToSrgbTable,
+    };
+
+#ifdef PIXEL_KERNELS_X86
+
+    // ---------------------------------------------------------------------------------------------
+    // SSE4.1 and AVX2, compiled per function so the rest of the library keeps the baseline ISA
+    // ---------------------------------------------------------------------------------------------
+
+    __attribute__((target("sse4.1")))
+    static void expandRgbToRgbaSse41(const uint8_t *src, uint8_t *dst, size_t pixels) {
+        const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xff000000));
+        size_t i = 0;
+        // 16 byte loads for 4 pixels (12 bytes), stop early so the last load stays in bounds
+        for (; i + 6 <= pixels; i += 4) {
+            __m128i rgb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 3));
+            __m128i rgba = _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 4), rgba);
+        }
+        expandRgbToRgbaScalar(src + i * 3, dst + i * 4, pixels - i);
+    }
+
+    __attribute__((target("sse4.1")))
+    static void swapRedBlueSse41(const uint8_t *src, uint8_t *dst, size_t pixels) {
+        const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+        size_t i = 0;
+        for (; i + 4 <= pixels; i += 4) {
+            __m128i rgba = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 4),
+                             _mm_shuffle_epi8(rgba, shuffle));
+        }
+        swapRedBlueScalar(src + i * 4, dst + i * 4, pixels - i);
+    }
+
+    // Two pixels widened to 16 bits: c * a with the alpha lane multiplied by 255, which
+    // mulDiv255 maps back to a
+    __attribute__((target("sse4.1")))
+    static inline __m128i premultiplyWideSse41(__m128i wide) {
+        __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(wide, 0xff), 0xff);
+        alpha = _mm_blend_epi16(alpha, _mm_set1_epi16(255), 0x88);
+        __m128i t = _mm_add_epi16(_mm_mullo_epi16(wide, alpha), _mm_set1_epi16(128));
+        return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+    }
+
+    __attribute__((target("sse4.1")))
+    static void premultiplyAlphaSse41(const uint8_t *src, uint8_t *dst, size_t pixels) {
+        const __m128i zero = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 4 <= pixels; i += 4) {
+            __m128i rgba = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4));
+            __m128i low = premultiplyWideSse41(_mm_unpacklo_epi8(rgba, zero));
+            __m128i high = premultiplyWideSse41(_mm_unpackhi_epi8(rgba, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 4),
+                             _mm_packus_epi16(low, high));
+        }
+        premultiplyAlphaScalar(src + i * 4, dst + i * 4, pixels - i);
+    }
+
+    __attribute__((target("avx2")))
+    static void expandRgbToRgbaAvx2(const uint8_t *src, uint8_t *dst, size_t pixels) {
+        // Moves bytes 12..27 to the upper lane so each lane holds 4 whole pixels
+        const __m256i spread = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+        const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                                 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xff000000));
+        size_t i = 0;
+        // 32 byte loads for 8 pixels (24 bytes)
+        for (; i + 11 <= pixels; i += 8) {
+            __m256i rgb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i * 3));
+            rgb = _mm256_permutevar8x32_epi32(rgb, spread);
+            __m256i rgba = _mm256_or_si256(_mm256_shuffle_epi8(rgb, shuffle), alpha);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 4), rgba);
+        }
+        expandRgbToRgbaSse41(src + i * 3, dst + i * 4, pixels - i);
+    }
+
+    __attribute__((target("avx2")))
+    static void swapRedBlueAvx2(const uint8_t *src, uint8_t *dst, size_t pixels) {
+        const __m256i shuffle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                                 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+        size_t i = 0;
+        for (; i + 8 <= pixels; i += 8) {
+            __m256i rgba = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i * 4));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 4),
+                                _mm256_shuffle_epi8(rgba, shuffle));
+        }
+        swapRedBlueScalar(src + i * 4, dst + i * 4, pixels - i);
+    }
+
+    __attribute__((target("avx2")))
+    static inline __m256i premultiplyWideAvx2(__m256i wide) {
+        __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(wide, 0xff), 0xff);
+        alpha = _mm256_blend_epi16(alpha, _mm256_set1_epi16(255), 0x88);
+        __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(wide, alpha), _mm256_set1_epi16(128));
+        return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+    }
+
+    __attribute__((target("avx2")))
+    static void premultiplyAlphaAvx2(const uint8_t *src, uint8_t *dst, size_t pixels) {
+        const __m256i zero = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 8 <= pixels; i += 8) {
+            __m256i rgba = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i * 4));
+            // unpack and pack both work per 128 bit lane, so the pixel order is preserved
+            __m256i low = premultiplyWideAvx2(_mm256_unpacklo_epi8(rgba, zero));
+            __m256i high = premultiplyWideAvx2(_mm256_unpackhi_epi8(rgba, zero));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 4),
+                                _mm256_packus_epi16(low, high));
+        }
+        premultiplyAlphaScalar(src + i * 4, dst + i * 4, pixels - i);
+    }
+
+    static const PixelKernels SSE41_KERNELS = {
+            "sse4.1",
+            expandRgbToRgbaSse41,
+            swapRedBlueSse41,
+            premultiplyAlphaSse41,
+            srgbToLinearTable,
+            linearToSrgbTable,
+    };
+
+    static const PixelKernels AVX2_KERNELS = {
+            "avx2",
+            expandRgbToRgbaAvx2,
+            swapRedBlueAvx2,
+            premultiplyAlphaAvx2,
+            srgbToLinearTable,
+            linearToSrgbTable,
+    };
+
+#endif  // PIXEL_KERNELS_X86
+
+#ifdef PIXEL_KERNELS_NEON
+
+    // ---------------------------------------------------------------------------------------------
+    // NEON, always available on arm64-v8a and required by the NDK for armeabi-v7a
+    // ---------------------------------------------------------------------------------------------
+
+    static void expandRgbToRgbaNeon(const uint8_t *src, uint8_t *dst, size_t pixels) {
+        size_t i = 0;
+        for (; i + 16 <= pixels; i += 16) {
+            uint8x16x3_t rgb = vld3q_u8(src + i * 3);
+            uint8x16x4_t rgba;
+            rgba.val[0] = rgb.val[0];
+            rgba.val[1] = rgb.val[1];
+            rgba.val[2] = rgb.val[2];
+            rgba.val[3] = vdupq_n_u8(255);
+            vst4q_u8(dst + i * 4, rgba);
+        }
+        expandRgbToRgbaScalar(src + i * 3, dst + i * 4, pixels - i);
+    }
+
+    static void swapRedBlueNeon(const uint8_t *src, uint8_t *dst, size_t pixels) {
+        size_t i = 0;
+        for (; i + 16 <= pixels; i += 16) {
+            uint8x16x4_t rgba = vld4q_u8(src + i * 4);
+            uint8x16_t red = rgba.val[0];
+            rgba.val[0] = rgba.val[2];
+            rgba.val[2] = red;
+            vst4q_u8(dst + i * 4, rgba);
+        }
+        swapRedBlueScalar(src + i * 4, dst + i * 4, pixels - i);
+    }
+
+    // (t + ((t + 128) >> 8) + 128) >> 8 with t = c * a, the same rounding as mulDiv255
+    static inline uint8x8_t mulDiv255Neon(uint8x8_t c, uint8x8_t a) {
+        uint16x8_t t = vmull_u8(c, a);
+        return vraddhn_u16(t, vrshrq_n_u16(t, 8));
+    }
+
+    static inline uint8x16_t premultiplyChannelNeon(uint8x16_t c, uint8x16_t a) {
+        return vcombine_u8(mulDiv255Neon(vget_low_u8(c), vget_low_u8(a)),
+                           mulDiv255Neon(vget_high_u8(c), vget_high_u8(a)));
+    }
+
+    static void premultiplyAlphaNeon(const uint8_t *src, uint8_t *dst, size_t pixels) {
+        size_t i = 0;
+        for (; i + 16 <= pixels; i += 16) {
+            uint8x16x4_t rgba = vld4q_u8(src + i * 4);
+            rgba.val[0] = premultiplyChannelNeon(rgba.val[0], rgba.val[3]);
+            rgba.val[1] = premultiplyChannelNeon(rgba.val[1], rgba.val[3]);
+            rgba.val[2] = premultiplyChannelNeon(rgba.val[2], rgba.val[3]);
+            vst4q_u8(dst + i * 4, rgba);
+        }
+        premultiplyAlphaScalar(src + i * 4, dst + i * 4, pixels - i);
+    }
+
+    static const PixelKernels NEON_KERNELS = {
+            "neon",
+            expandRgbToRgbaNeon,
+            swapRedBlueNeon,
+            premultiplyAlphaNeon,
+            srgbToLinearTable,
+            linearToSrgbTable,
+    };
+
+#endif  // PIXEL_KERNELS_NEON
+
+    const PixelKernels &scalarPixelKernels() {
+        return SCALAR_KERNELS;
+    }
+
+    std::vector<const PixelKernels *> supportedPixelKernels() {
+        std::vector<const PixelKernels *> kernels = {&SCALAR_KERNELS};
+#ifdef PIXEL_KERNELS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("sse4.1")) {
+            kernels.push_back(&SSE41_KERNELS);
+        }
+        if (__builtin_cpu_supports("avx2")) {
+            kernels.push_back(&AVX2_KERNELS);
+        }
+#endif
+#ifdef PIXEL_KERNELS_NEON
+        kernels.push_back(&NEON_KERNELS);
+#endif
+        return kernels;
+    }
+
+    const PixelKernels &pixelKernels() {
+        static const PixelKernels &best = *supportedPixelKernels().back();
+        return best;
+    }
+
+    void convertPixels(const PixelConversion &conversion, const uint8_t *src, int srcChannels,
+                       uint8_t *dst, size_t pixels, const PixelKernels &kernels) {
+        using Kernel = void (*)(const uint8_t *, uint8_t *, size_t);
+        Kernel steps[5];
+        int stepCount = 0;
+        if (srcChannels == 3) {
+            steps[stepCount++] = kernels.expandRgbToRgba;
+        }
+        if (conversion.srgbToLinear) {
+            steps[stepCount++] = kernels.srgbToLinear;
+        }
+        if (conversion.linearToSrgb) {
+            steps[stepCount++] = kernels.linearToSrgb;
+        }
+        if (conversion.premultiplyAlpha) {
+            steps[stepCount++] = kernels.premultiplyAlpha;
+        }
+        if (conversion.swapRedBlue) {
+            steps[stepCount++] = kernels.swapRedBlue;
+        }
+
+        if (stepCount == 0) {
+            memcpy(dst, src, pixels * 4);
+            return;
+        }
+        if (stepCount == 1) {
+            steps[0](src, dst, pixels);
+            return;
+        }
+
+        // First step reads the source, the others run in place in the scratch block, which is
+        // then written out once
+        alignas(64) uint8_t scratch[CONVERT_BLOCK_PIXELS * 4];
+        for (size_t start = 0; start < pixels; start += CONVERT_BLOCK_PIXELS) {
+            size_t count = pixels - start < CONVERT_BLOCK_PIXELS ? pixels - start
+                                                                 : CONVERT_BLOCK_PIXELS;
+            steps[0](src + start * srcChannels, scratch, count);
+            for (int step = 1; step < stepCount - 1; step++) {
+                steps[step](scratch, scratch, count);
+            }
+            steps[stepCount - 1](scratch, dst + start * 4, count);
+        }
+    }
+
+}  // namespace vkt
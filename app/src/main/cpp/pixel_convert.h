@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vkt {
+
+    /*
+     * Pixel conversion kernels for texture ingestion. Every kernel writes RGBA8 and may run in
+     * place (dst == src) except expandRgbToRgba. All implementations are bit-exact with the scalar
+     * one: premultiplication rounds c * a / 255 to nearest with the same integer formula, and
+     * the sRGB transfer functions are tables shared by every implementation (gathers are not
+     * faster than scalar lookups on the CPUs we target).
+     */
+    struct PixelKernels {
+        const char *name;
+
+        void (*expandRgbToRgba)(const uint8_t *src, uint8_t *dst, size_t pixels);
+
+        // RGBA <-> BGRA, for VK_FORMAT_B8G8R8A8_* textures
+        void (*swapRedBlue)(const uint8_t *src, uint8_t *dst, size_t pixels);
+
+        void (*premultiplyAlpha)(const uint8_t *src, uint8_t *dst, size_t pixels);
+
+        // Color channels only, alpha is always linear
+        void (*srgbToLinear)(const uint8_t *src, uint8_t *dst, size_t pixels);
+
+        void (*linearToSrgb)(const uint8_t *src, uint8_t *dst, size_t pixels);
+    };
+
+    // Best implementation for this CPU, picked once at first use
+    const PixelKernels &pixelKernels();
+
+    const PixelKernels &scalarPixelKernels();
+
+    // Every implementation this CPU can run, scalar first (for tests and benchmarks)
+    std::vector<const PixelKernels *> supportedPixelKernels();
+
+    /*
+     * What a texture needs on its way to the staging buffer, the order of the steps is fixed:
+     * expand, transfer function, premultiply, swizzle.
+     */
+    struct PixelConversion {
+        bool srgbToLinear = false;
+        bool linearToSrgb = false;
+        bool premultiplyAlpha = false;
+        bool swapRedBlue = false;
+
+        bool isIdentity() const {
+            return !srgbToLinear && !linearToSrgb && !premultiplyAlpha && !swapRedBlue;
+        }
+    };
+
+    /*
+     * Converts 'pixels' pixels of 3 or 4 channel 'src' into RGBA8 'dst'. Work is done a block at a
+     * time in a small scratch buffer, so 'dst' (usually uncached staging memory) is written once
+     * and never read back.
+     */
+    void convertPixels(const PixelConversion &conversion, const uint8_t *src, int srcChannels,
+                       uint8_t *dst, size_t pixels, const PixelKernels &kernels = pixelKernels());
+
+}  // namespace vkt
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+namespace vkt {
+
+    /*
+     * Android reports the display orientation through the surface's currentTransform. If the
+     * swapchain is created with that same preTransform, the compositor can scan our images out
+     * as-is; otherwise it has to rotate every frame with an extra full-screen pass. Doing the
+     * rotation ourselves means:
+     * 1. The swapchain images (and framebuffers, viewport, scissor) keep the identity (native)
+     *    resolution of the display.
+     * 2. The projection uses the aspect ratio the user actually sees (identity size swapped for
+     *    90/270 degrees).
+     * 3. The clip space result is rotated around Z by the surface transform.
+     *
+     * This file only depends on glm so the math can be exercised on the host.
+     */
+    enum class SurfaceRotation {
+        Identity,
+        Rotate90,
+        Rotate180,
+        Rotate270
+    };
+
+    // True when the visible image is the identity image turned sideways
+    inline bool swapsAxes(SurfaceRotation rotation) {
+        return rotation == SurfaceRotation::Rotate90 || rotation == SurfaceRotation::Rotate270;
+    }
+
+    /*
+     * Rotation around the Z axis applied after the projection. The entries are written out by
+     * hand instead of calling glm::rotate so that 90/180/270 degrees are exact (no -4.37e-8
+     * leftovers from cos(pi / 2)).
+     */
+    inline glm::mat4 getPreRotationMatrix(SurfaceRotation rotation) {
+        float c = 1.0f;
+        float s = 0.0f;
+        switch (rotation) {
+            case SurfaceRotation::Identity:
+                break;
+            case SurfaceRotation::Rotate90:
+                c = 0.0f;
+                s = 1.0f;
+                break;
+            case SurfaceRotation::Rotate180:
+                c = -1.0f;
+                s = 0.0f;
+                break;
+            case SurfaceRotation::Rotate270:
+                c = 0.0f;
+                s = -1.0f;
+                break;
+        }
+
+        // Same layout as glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0, 0, 1)) (column major)
+        glm::mat4 rotationMatrix(1.0f);
+        rotationMatrix[0][0] = c;
+        rotationMatrix[0][1] = s;
+        rotationMatrix[1][0] = -s;
+        rotationMatrix[1][1] = c;
+        return rotationMatrix;
+    }
+
+    /*
+     * Aspect ratio for the projection matrix. 'identityWidth' and 'identityHeight' are the native
+     * (unrotated) swapchain size; the user sees them swapped when the device is turned sideways.
+     */
+    inline float getPreRotatedAspectRatio(uint32_t identityWidth, uint32_t identityHeight,
+                                          SurfaceRotation rotation) {
+        if (swapsAxes(rotation)) {
+            return static_cast<float>(identityHeight) / static_cast<float>(identityWidth);
+        }
+        return static_cast<float>(identityWidth) / static_cast<float>(identityHeight);
+    }
+
+    /*
+     * Maps a rectangle given in the rotated (user visible) space into the identity framebuffer the
+     * swapchain was created with. Used for scissors and viewports that do not cover the whole
+     * screen; a full screen rect maps onto the full identity rect.
+     */
+    struct PreRotatedRect {
+        int32_t x;
+        int32_t y;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    inline PreRotatedRect preRotateRect(const PreRotatedRect &rect, uint32_t identityWidth,
+                                        uint32_t identityHeight, SurfaceRotation rotation) {
+        // Size of the screen as seen by the user
+        const int32_t visibleWidth = static_cast<int32_t>(swapsAxes(rotation) ? identityHeight
+                                                                               : identityWidth);
+        const int32_t visibleHeight = static_cast<int32_t>(swapsAxes(rotation) ? identityWidth
+                                                                                : identityHeight);
+        const int32_t w = static_cast<int32_t>(rect.width);
+        const int32_t h = static_cast<int32_t>(rect.height);
+
+        switch (rotation) {
+            case SurfaceRotation::Rotate90:
+                // Visible x runs along identity y; visible y runs against identity x
+                return {visibleHeight - rect.y - h, rect.x, rect.height, rect.width};
+            case SurfaceRotation::Rotate180:
+                return {visibleWidth - rect.x - w, visibleHeight - rect.y - h, rect.width,
+                        rect.height};
+            case SurfaceRotation::Rotate270:
+                return {rect.y, visibleWidth - rect.x - w, rect.height, rect.width};
+            case SurfaceRotation::Identity:
+            default:
+                return rect;
+        }
+    }
+
+}  // namespace vkt
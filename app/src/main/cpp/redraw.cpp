@@ -0,0 +1,73 @@
+#include "redraw.h"
+
+namespace vkt {
+
+    constexpr RedrawScheduler::Duration RedrawScheduler::FOREVER;
+
+    void RedrawScheduler::invalidate(uint32_t reasons) {
+        uint32_t previous = pending.fetch_or(reasons, std::memory_order_release);
+        if (previous != 0) {
+            return;  // someone already woke the loop
+        }
+        {
+            // Pairs with the predicate check in waitUntilDue()
+            std::lock_guard<std::mutex> lock(mutex);
+        }
+        invalidated.notify_one();
+        if (wake) {
+            wake();
+        }
+    }
+
+    RedrawScheduler::Duration RedrawScheduler::timeUntilDue(Clock::time_point now) const {
+        if (!onDemand || pending.load(std::memory_order_acquire) != 0) {
+            return Duration::zero();
+        }
+        if (!animating) {
+            return FOREVER;
+        }
+        Clock::time_point due = lastFrame + animationInterval;
+        return due > now ? std::chrono::duration_cast<Duration>(due - now) : Duration::zero();
+    }
+
+    void RedrawScheduler::waitUntilDue() {
+        Duration timeout = timeUntilDue(Clock::now());
+        if (timeout == Duration::zero()) {
+            return;
+        }
+        idle = true;
+        std::unique_lock<std::mutex> lock(mutex);
+        auto due = [this]() { return pending.load(std::memory_order_acquire) != 0; };
+        if (timeout == FOREVER) {
+            invalidated.wait(lock, due);
+        } else {
+            invalidated.wait_for(lock, timeout, due);
+        }
+    }
+
+    bool RedrawScheduler::beginFrame(Clock::time_point now) {
+        uint32_t reasons = pending.exchange(0, std::memory_order_acquire);
+        bool animationDue = animating && now >= lastFrame + animationInterval;
+        if (onDemand && reasons == 0 && !animationDue) {
+            counters.idleWakeups++;
+            idle = true;
+            return false;
+        }
+
+        counters.renderedFrames++;
+        for (uint32_t bit = 0; bit < REDRAW_REASON_COUNT; bit++) {
+            if (reasons & (1u << bit)) {
+                counters.framesByReason[bit]++;
+            }
+        }
+        if (reasons == 0 && animationDue) {
+            counters.animationFrames++;
+        }
+        // Frames spaced by the animation interval also come after the loop slept
+        idleBeforeFrame = idle || (onDemand && reasons == 0 && animationInterval.count() > 0);
+        idle = false;
+        lastFrame = now;
+        return true;
+    }
+
+}  // namespace vkt
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+namespace vkt {
+
+    // Why a frame was asked for, one bit per producer
+    enum RedrawReason : uint32_t {
+        REDRAW_LIFECYCLE = 1,   // new window, resize, configuration change
+        REDRAW_INPUT = 2,
+        REDRAW_UPLOAD = 4,      // new data on the GPU
+        REDRAW_PIPELINE = 8,    // a better pipeline variant got published
+        REDRAW_SWAPCHAIN = 16,  // suboptimal or out of date, the next frame rebuilds it
+        REDRAW_ANIMATION = 32,  // the simulation published a new snapshot
+    };
+
+    const uint32_t REDRAW_REASON_COUNT = 6;
+
+    // 30 fps for frames only the animation wants
+    const std::chrono::nanoseconds DEFAULT_ANIMATION_INTERVAL{33333333};
+
+    /*
+     * Decides whether the frame loop renders or sleeps. Producers invalidate() from any thread;
+     * when nothing is pending and no animation is running the loop blocks until the next
+     * invalidation instead of rendering the same image again. A running animation only asks for
+     * a frame once per animation interval, frames asked for by anything else are not held back.
+     *
+     * The loop either blocks in its own event wait for timeUntilDue() and lets the wake callback
+     * interrupt it (ALooper_wake on Android), or blocks in waitUntilDue(). Time is passed in
+     * explicitly so a test can drive it.
+     */
+    class RedrawScheduler {
+    public:
+        using Clock = std::chrono::steady_clock;
+        using Duration = std::chrono::nanoseconds;
+
+        static constexpr Duration FOREVER = Duration::max();
+
+        struct Stats {
+            uint64_t renderedFrames = 0;
+            uint64_t idleWakeups = 0;                         // beginFrame() said no
+            uint64_t framesByReason[REDRAW_REASON_COUNT] = {};
+            uint64_t animationFrames = 0;                     // only the animation asked
+        };
+
+        // Off: every loop iteration renders, as without the scheduler
+        void setOnDemand(bool enabled) { onDemand = enabled; }
+
+        void setAnimating(bool enabled) { animating = enabled; }
+
+        void setAnimationInterval(Duration interval) { animationInterval = interval; }
+
+        // Called by invalidate(), on the invalidating thread
+        void setWakeCallback(std::function<void()> callback) { wake = std::move(callback); }
+
+        // Any thread
+        void invalidate(uint32_t reasons);
+
+        // How long the loop may block before a frame is due, zero if one is due now
+        Duration timeUntilDue(Clock::time_point now) const;
+
+        // Blocks until a frame is due or an invalidation arrives, for loops without an event wait
+        void waitUntilDue();
+
+        // True if the loop should render now, which takes the pending reasons
+        bool beginFrame(Clock::time_point now);
+
+        // The frame beginFrame() just allowed follows time spent idle, rather than the previous
+        // frame: anything pacing frames against the display should start over
+        bool resumedFromIdle() const { return idleBeforeFrame; }
+
+        const Stats &stats() const { return counters; }
+
+    private:
+        std::atomic<uint32_t> pending{REDRAW_LIFECYCLE};  // the first frame is always due
+        std::function<void()> wake;
+        std::mutex mutex;
+        std::condition_variable invalidated;
+        bool onDemand = true;
+        bool animating = false;
+        Duration animationInterval = DEFAULT_ANIMATION_INTERVAL;
+        Clock::time_point lastFrame{};
+        bool idle = false;
+        bool idleBeforeFrame = false;
+        Stats counters;
+    };
+
+}  // namespace vkt
@@ -0,0 +1,198 @@
+#include "render_thread.h"
+
+namespace vkt {
+
+    RenderThread::RenderThread(Lifecycle &lifecycle, RedrawScheduler &redraw,
+                               std::function<bool()> renderFrame)
+            : lifecycle(lifecycle), redraw(redraw), renderFrame(std::move(renderFrame)) {}
+
+    RenderThread::~RenderThread() {
+        stop();
+    }
+
+    void RenderThread::start() {
+        stopping = false;
+        thread = std::thread([this]() { run(); });
+    }
+
+    void RenderThread::stop() {
+        if (!thread.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        commandPosted.notify_one();
+        redraw.invalidate(REDRAW_LIFECYCLE);
+        thread.join();
+    }
+
+    void RenderThread::post(RenderCommand command, ANativeWindow *window) {
+        uint64_t position = tail.load(std::memory_order_relaxed);
+        // Lifecycle commands come a few at a time, a full ring means the render thread is stuck
+        // in a long frame: wait for it rather than lose a window command
+        while (position - head.load(std::memory_order_acquire) >= QUEUE_SIZE) {
+            std::this_thread::yield();
+        }
+        queue[position & (QUEUE_SIZE - 1)] = {command, window, ++posted, Clock::now()};
+        tail.store(position + 1, std::memory_order_release);
+
+        {
+            // Pairs with the predicate check of the render thread's wait
+            std::lock_guard<std::mutex> lock(mutex);
+        }
+        commandPosted.notify_one();
+        redraw.invalidate(REDRAW_LIFECYCLE);
+    }
+
+    void RenderThread::postAndWait(RenderCommand command, ANativeWindow *window) {
+        post(command, window);
+        uint64_t sequence = posted;
+        std::unique_lock<std::mutex> lock(mutex);
+        commandExecuted.wait(lock, [this, sequence]() {
+            return executed.load(std::memory_order_acquire) >= sequence;
+        });
+    }
+
+    void RenderThread::drainCommands() {
+        uint64_t position = head.load(std::memory_order_relaxed);
+        uint64_t end = tail.load(std::memory_order_acquire);
+        if (position == end) {
+            return;
+        }
+        for (; position < end; position++) {
+            Entry entry = queue[position & (QUEUE_SIZE - 1)];
+            head.store(position + 1, std::memory_order_release);
+            execute(entry);
+            executed.store(entry.sequence, std::memory_order_release);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+        }
+        commandExecuted.notify_all();
+
+        bool canRender = lifecycle.canRender();
+        if (canRender != renderable) {
+            renderable = canRender;
+            if (onRenderable) {
+                onRenderable(canRender);
+            }
+        }
+    }
+
+    void RenderThread::execute(const Entry &entry) {
+        switch (entry.command) {
+            case RenderCommand::Start:
+                lifecycle.onStart();
+                break;
+            case RenderCommand::Stop:
+                lifecycle.onStop();
+                break;
+            case RenderCommand::WindowCreated:
+                lifecycle.onWindowCreated(entry.window, entry.time);
+                break;
+            case RenderCommand::WindowDestroyed:
+                lifecycle.onWindowDestroyed();
+                break;
+            case RenderCommand::Destroy:
+                lifecycle.onDestroy();
+                break;
+        }
+    }
+
+    void RenderThread::run() {
+        for (;;) {
+            drainCommands();
+            if (stopping.load(std::memory_order_acquire) &&
+                head.load(std::memory_order_relaxed) == tail.load(std::memory_order_acquire)) {
+                return;
+            }
+
+            if (!lifecycle.canRender()) {
+                // Nothing to render to: only a command can change that
+                std::unique_lock<std::mutex> lock(mutex);
+                commandPosted.wait(lock, [this]() {
+                    return stopping.load(std::memory_order_relaxed) ||
+                           head.load(std::memory_order_relaxed) !=
+                           tail.load(std::memory_order_acquire);
+                });
+                continue;
+            }
+
+            redraw.waitUntilDue();
+            drainCommands();
+            if (stopping.load(std::memory_order_acquire)) {
+                continue;  // no frame after stop(), the top of the loop returns
+            }
+            if (lifecycle.canRender() && redraw.beginFrame(Clock::now()) && renderFrame() &&
+                lifecycle.framePresented() && onFirstFrame) {
+                onFirstFrame(lifecycle.stats());
+            }
+        }
+    }
+
+    SimulationThread::SimulationThread(std::chrono::nanoseconds interval,
+                                       std::function<void(double)> step)
+            : interval(interval), step(std::move(step)) {}
+
+    SimulationThread::~SimulationThread() {
+        stop();
+    }
+
+    void SimulationThread::start() {
+        stopping = false;
+        thread = std::thread([this]() { run(); });
+    }
+
+    void SimulationThread::stop() {
+        if (!thread.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_one();
+        thread.join();
+    }
+
+    void SimulationThread::setPaused(bool pause) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            paused = pause;
+        }
+        changed.notify_one();
+    }
+
+    void SimulationThread::run() {
+        Clock::time_point startTime = Clock::now();
+        Clock::time_point next = startTime;
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            // Sleeps until the next step, wakes early for stop() and pause changes
+            changed.wait_until(lock, next, [this]() { return stopping || paused; });
+            if (stopping) {
+                return;
+            }
+            if (paused) {
+                changed.wait(lock, [this]() { return stopping || !paused; });
+                // Steps missed while paused are not made up for
+                next = Clock::now();
+                continue;
+            }
+
+            lock.unlock();
+            step(std::chrono::duration<double>(Clock::now() - startTime).count());
+            stepCount.fetch_add(1, std::memory_order_relaxed);
+            lock.lock();
+
+            next += interval;
+            Clock::time_point now = Clock::now();
+            if (next < now) {
+                next = now;  // late: no burst of steps to catch up
+            }
+        }
+    }
+
+}  // namespace vkt
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "lifecycle.h"
+#include "redraw.h"
+
+namespace vkt {
+
+    /*
+     * Latest-value hand-off from one writer thread to one reader thread, e.g. simulation state
+     * to the renderer. The writer fills back() and publishes it; the reader's latest() returns
+     * the newest published value and keeps returning it until a newer one is there. Neither side
+     * ever waits: a third slot sits between the two buffers each side works on, so the writer can
+     * publish again while the reader is still on the previous value.
+     */
+    template<typename T>
+    class SnapshotBuffer {
+    public:
+        // Writer
+        T &back() { return slots[writeIndex]; }
+
+        void publish() {
+            uint32_t previous = middle.exchange(writeIndex | FRESH, std::memory_order_acq_rel);
+            writeIndex = previous & INDEX_MASK;
+        }
+
+        // Reader
+        const T &latest() {
+            if (middle.load(std::memory_order_relaxed) & FRESH) {
+                uint32_t previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+                readIndex = previous & INDEX_MASK;
+            }
+            return slots[readIndex];
+        }
+
+    private:
+        static const uint32_t FRESH = 4;
+        static const uint32_t INDEX_MASK = 3;
+
+        std::array<T, 3> slots{};
+        uint32_t writeIndex = 0;
+        uint32_t readIndex = 1;
+        std::atomic<uint32_t> middle{2};
+    };
+
+    enum class RenderCommand : uint8_t {
+        Start,
+        Stop,
+        WindowCreated,
+        WindowDestroyed,
+        Destroy,
+    };
+
+    /*
+     * Runs the Lifecycle and the frame loop on a thread of their own, so that a frame stuck in
+     * the fence wait or in present doesn't hold up the event loop, and a slow lifecycle command
+     * doesn't hold up frames more than it has to.
+     *
+     * The event loop post()s lifecycle commands into a lock-free single-producer ring and moves
+     * on. postAndWait() also waits until the render thread has carried the command out; window
+     * teardown needs it, the window must not be in use anymore once APP_CMD_TERM_WINDOW returns.
+     * Between commands the render thread blocks in the RedrawScheduler, posting a command also
+     * invalidates it.
+     */
+    class RenderThread {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        static const size_t QUEUE_SIZE = 64;  // power of two
+
+        RenderThread(Lifecycle &lifecycle, RedrawScheduler &redraw,
+                     std::function<bool()> renderFrame);
+
+        ~RenderThread();
+
+        RenderThread(const RenderThread &) = delete;
+
+        RenderThread &operator=(const RenderThread &) = delete;
+
+        // Called on the render thread: after the first frame of each window, with the lifecycle's
+        // stats, and when rendering starts or stops being possible
+        void setFirstFrameCallback(std::function<void(const Lifecycle::Stats &)> callback) {
+            onFirstFrame = std::move(callback);
+        }
+
+        void setRenderableCallback(std::function<void(bool)> callback) {
+            onRenderable = std::move(callback);
+        }
+
+        void start();
+
+        // Carries out the commands already posted, then joins the thread
+        void stop();
+
+        // Event loop thread only
+        void post(RenderCommand command, ANativeWindow *window = nullptr);
+
+        void postAndWait(RenderCommand command, ANativeWindow *window = nullptr);
+
+    private:
+        struct Entry {
+            RenderCommand command;
+            ANativeWindow *window;
+            uint64_t sequence;
+            Clock::time_point time;  // posted, window latency counts the time spent queued
+        };
+
+        void run();
+
+        // Render thread: carries out everything posted so far
+        void drainCommands();
+
+        void execute(const Entry &entry);
+
+        Lifecycle &lifecycle;
+        RedrawScheduler &redraw;
+        std::function<bool()> renderFrame;
+        std::function<void(const Lifecycle::Stats &)> onFirstFrame;
+        std::function<void(bool)> onRenderable;
+
+        std::array<Entry, QUEUE_SIZE> queue{};
+        alignas(64) std::atomic<uint64_t> tail{0};       // written by post()
+        alignas(64) std::atomic<uint64_t> head{0};       // written by the render thread
+        uint64_t posted = 0;                             // event loop thread only
+        std::atomic<uint64_t> executed{0};               // sequence of the last command carried out
+
+        std::mutex mutex;
+        std::condition_variable commandPosted;           // render thread, while it can't render
+        std::condition_variable commandExecuted;         // postAndWait()
+        std::atomic<bool> stopping{false};
+        bool renderable = false;                         // render thread only
+        std::thread thread;
+    };
+
+    /*
+     * Steps the simulation at a fixed rate on its own thread; the step publishes its result,
+     * typically into a SnapshotBuffer, and invalidates the RedrawScheduler. Paused while nothing
+     * can be rendered.
+     */
+    class SimulationThread {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        // 'step' gets the seconds since start()
+        SimulationThread(std::chrono::nanoseconds interval, std::function<void(double)> step);
+
+        ~SimulationThread();
+
+        void start();
+
+        void stop();
+
+        void setPaused(bool paused);
+
+        uint64_t steps() const { return stepCount.load(std::memory_order_relaxed); }
+
+    private:
+        void run();
+
+        std::chrono::nanoseconds interval;
+        std::function<void(double)> step;
+        std::mutex mutex;
+        std::condition_variable changed;
+        bool paused = false;
+        bool stopping = false;
+        std::atomic<uint64_t> stepCount{0};
+        std::thread thread;
+    };
+
+}  // namespace vkt
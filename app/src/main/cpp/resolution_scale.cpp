@@ -0,0 +1,69 @@
+#include "resolution_scale.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace vkt {
+
+    static const float MIN_AREA = MIN_RESOLUTION_SCALE * MIN_RESOLUTION_SCALE;
+    static const float MAX_AREA = MAX_RESOLUTION_SCALE * MAX_RESOLUTION_SCALE;
+    // A scale step changes the area by 10% to 20%
+    static const float ERROR_DEAD_BAND = 0.08f;
+
+    uint32_t scaledSize(uint32_t size, float scale) {
+        return std::max<uint32_t>(1, static_cast<uint32_t>(std::lround(size * scale)));
+    }
+
+    void ResolutionController::setGains(float proportional, float integralGain, float derivative) {
+        // Keep the output where it is
+        float output = ki * integral;
+        kp = proportional;
+        ki = integralGain;
+        kd = derivative;
+        integral = output / ki;
+    }
+
+    void ResolutionController::reset() {
+        integral = MAX_AREA / ki;
+        previousError = 0.0f;
+        hasPrevious = false;
+        current = MAX_RESOLUTION_SCALE;
+    }
+
+    bool ResolutionController::update(double gpuMs) {
+        if (gpuMs <= 0.0 || target <= 0.0) {
+            return false;
+        }
+        counters.samples++;
+
+        // Positive with headroom to spare
+        float error = static_cast<float>((target - gpuMs) / target);
+        float derivative = hasPrevious ? error - previousError : 0.0f;
+        previousError = error;
+        hasPrevious = true;
+
+        // Within the dead band the scale step the controller is on is as close as it gets: the
+        // steps on either side would each miss the target the other way
+        if (std::fabs(error) > ERROR_DEAD_BAND) {
+            integral += error;
+        }
+        // No wind up past the bounds
+        integral = std::clamp(integral, MIN_AREA / ki, MAX_AREA / ki);
+        float area = std::clamp(kp * error + ki * integral + kd * derivative, MIN_AREA, MAX_AREA);
+
+        float wanted = std::sqrt(area);
+        if (std::fabs(wanted - current) < RESOLUTION_SCALE_STEP) {
+            return false;
+        }
+        float stepped = std::round(wanted / RESOLUTION_SCALE_STEP) * RESOLUTION_SCALE_STEP;
+        stepped = std::clamp(stepped, MIN_RESOLUTION_SCALE, MAX_RESOLUTION_SCALE);
+        if (stepped == current) {
+            return false;
+        }
+        current = stepped;
+        counters.changes++;
+        counters.lowestScale = std::min(counters.lowestScale, current);
+        return true;
+    }
+
+}  // namespace vkt
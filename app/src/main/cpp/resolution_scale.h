@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+
+namespace vkt {
+
+    const float MIN_RESOLUTION_SCALE = 0.5f;
+    const float MAX_RESOLUTION_SCALE = 1.0f;
+    // Scales are applied in steps, each change costs re-recording the command buffers
+    const float RESOLUTION_SCALE_STEP = 0.05f;
+
+    // Pixels along one axis of the scaled render area, never 0
+    uint32_t scaledSize(uint32_t size, float scale);
+
+    /*
+     * PID controller holding the GPU frame time at a target by scaling the render resolution.
+     * GPU time grows with the pixel count, so the controller works on the rendered area (the
+     * square of the scale) and the error is relative to the target, which keeps the gains the same
+     * for any target. The integral carries the steady state; it is clamped to the area bounds and
+     * ignores errors within a small dead band. The output only moves in RESOLUTION_SCALE_STEP
+     * steps, and only once the controller wants a whole step away from the current one, so timer
+     * noise doesn't flip the scale back and forth.
+     *
+     * Samples arrive a few frames late (the timestamps of a frame slot are read when the slot comes
+     * round again), the default gains are low enough for that delay.
+     */
+    class ResolutionController {
+    public:
+        struct Stats {
+            uint64_t samples = 0;
+            uint64_t changes = 0;           // times scale() changed
+            float lowestScale = MAX_RESOLUTION_SCALE;
+        };
+
+        void setTargetMs(double ms) { target = ms; }
+
+        double targetMs() const { return target; }
+
+        void setGains(float proportional, float integralGain, float derivative);
+
+        // Back to full resolution, forgetting the history
+        void reset();
+
+        // One measured GPU frame time, true when scale() changed
+        bool update(double gpuMs);
+
+        float scale() const { return current; }
+
+        const Stats &stats() const { return counters; }
+
+    private:
+        double target = 16.0;
+        float kp = 0.25f;
+        float ki = 0.08f;
+        float kd = 0.05f;
+        float integral = 1.0f / 0.08f;   // output starts at the full area
+        float previousError = 0.0f;
+        bool hasPrevious = false;
+        float current = MAX_RESOLUTION_SCALE;
+        Stats counters;
+    };
+
+}  // namespace vkt
@@ -0,0 +1,285 @@
+#include "texture_loader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+#include "thread_pool.h"
+
+namespace vkt {
+    namespace {
+        void *stbMalloc(size_t size);
+
+        void *stbRealloc(void *p, size_t oldSize, size_t newSize);
+
+        void stbFree(void *p);
+    }  // namespace
+}  // namespace vkt
+
+#define STBI_MALLOC(sz) vkt::stbMalloc(sz)
+#define STBI_REALLOC_SIZED(p, oldsz, newsz) vkt::stbRealloc(p, oldsz, newsz)
+#define STBI_FREE(p) vkt::stbFree(p)
+#define STB_IMAGE_IMPLEMENTATION
+
+#include <stb_image.h>
+
+namespace vkt {
+
+    namespace {
+        const size_t SCRATCH_ALIGNMENT = 16;
+
+        size_t alignScratch(size_t size) {
+            return (size + SCRATCH_ALIGNMENT - 1) / SCRATCH_ALIGNMENT * SCRATCH_ALIGNMENT;
+        }
+
+        /*
+         * Bump allocator behind stb_image's allocations during one decode. stb_image grows its
+         * zlib and IDAT buffers with realloc and frees them in roughly reverse order, so growing the
+         * last allocation in place and rolling back a free of the last allocation keeps the peak
+         * close to what malloc would use. Anything else that's freed stays used until reset().
+         *
+         * Requests that don't fit go to the heap and count towards the demand, reset() grows the
+         * block to the biggest demand seen so later images of the batch decode without mallocs.
+         */
+        class DecodeScratch {
+        public:
+            // Starts a new image, everything allocated before is dropped
+            void reset(size_t sizeHint) {
+                size_t wanted = std::max(peak, alignScratch(sizeHint));
+                if (wanted > capacity) {
+                    block.reset(new uint8_t[wanted]);
+                    capacity = wanted;
+                }
+                used = 0;
+                last = 0;
+                overflow = 0;
+            }
+
+            void *allocate(size_t size) {
+                size_t aligned = alignScratch(size);
+                if (aligned <= capacity - used) {
+                    last = used;
+                    used += aligned;
+                    peak = std::max(peak, used + overflow);
+                    return block.get() + last;
+                }
+                overflow += aligned;
+                peak = std::max(peak, used + overflow);
+                return std::malloc(size);
+            }
+
+            void *reallocate(void *p, size_t oldSize, size_t newSize) {
+                if (p == nullptr) {
+                    return allocate(newSize);
+                }
+                if (!owns(p)) {
+                    overflow += alignScratch(newSize);
+                    peak = std::max(peak, used + overflow);
+                    return std::realloc(p, newSize);
+                }
+                auto *bytes = static_cast<uint8_t *>(p);
+                if (bytes == block.get() + last && alignScratch(newSize) <= capacity - last) {
+                    used = last + alignScratch(newSize);
+                    peak = std::max(peak, used + overflow);
+                    return p;
+                }
+                void *moved = allocate(newSize);
+                if (moved != nullptr) {
+                    memcpy(moved, p, std::min(oldSize, newSize));
+                }
+                return moved;
+            }
+
+            void release(void *p) {
+                if (p == nullptr) {
+                    return;
+                }
+                if (!owns(p)) {
+                    std::free(p);
+                } else if (static_cast<uint8_t *>(p) == block.get() + last) {
+                    used = last;
+                }
+            }
+
+        private:
+            bool owns(const void *p) const {
+                auto *bytes = static_cast<const uint8_t *>(p);
+                return bytes >= block.get() && bytes < block.get() + capacity;
+            }
+
+            std::unique_ptr<uint8_t[]> block;
+            size_t capacity = 0;
+            size_t used = 0;
+            size_t last = 0;      // offset of the most recent allocation
+            size_t overflow = 0;  // bytes that went to the heap since reset()
+            size_t peak = 0;
+        };
+
+        // Set while a worker decodes, stb_image calls outside of decode() use the heap
+        thread_local DecodeScratch *threadScratch = nullptr;
+
+        void *stbMalloc(size_t size) {
+            return threadScratch != nullptr ? threadScratch->allocate(size) : std::malloc(size);
+        }
+
+        void *stbRealloc(void *p, size_t oldSize, size_t newSize) {
+            return threadScratch != nullptr ? threadScratch->reallocate(p, oldSize, newSize)
+                                            : std::realloc(p, newSize);
+        }
+
+        void stbFree(void *p) {
+            if (threadScratch != nullptr) {
+                threadScratch->release(p);
+            } else {
+                std::free(p);
+            }
+        }
+
+        // Lends a scratch to the calling thread for one image
+        class ScratchScope {
+        public:
+            explicit ScratchScope(DecodeScratch *scratch) { threadScratch = scratch; }
+
+            ~ScratchScope() { threadScratch = nullptr; }
+        };
+    }  // namespace
+
+    bool TextureBatch::probe(AssetVfs &assets, const std::vector<std::string> &paths,
+                             const PixelConversion &conversion) {
+        entries.clear();
+        sources.clear();
+        totalSize = 0;
+
+        bool ok = true;
+        for (const auto &path: paths) {
+            DecodedTexture texture;
+            texture.path = path;
+            texture.conversion = conversion;
+            AssetData data = assets.open(path.c_str());
+
+            int channels = 0;
+            if (!data.valid() || data.empty()) {
+                texture.error = "asset not found";
+                ok = false;
+            } else if (!stbi_info_from_memory(data.data(), static_cast<int>(data.size()),
+                                              &texture.width, &texture.height, &channels)) {
+                texture.error = stbi_failure_reason();
+                texture.width = texture.height = 0;
+                ok = false;
+            }
+            // Grey and grey-alpha images are rare enough to let stb_image expand them
+            texture.sourceChannels = channels == 3 ? 3 : TEXTURE_CHANNELS;
+
+            totalSize = (totalSize + TEXTURE_SLICE_ALIGNMENT - 1) / TEXTURE_SLICE_ALIGNMENT *
+                        TEXTURE_SLICE_ALIGNMENT;
+            texture.offset = totalSize;
+            texture.size = size_t(texture.width) * texture.height * TEXTURE_CHANNELS;
+            totalSize += texture.size;
+
+            entries.push_back(std::move(texture));
+            sources.push_back(std::move(data));
+        }
+        return ok;
+    }
+
+    bool TextureBatch::decode(uint8_t *arena, ThreadPool *pool) {
+        auto start = std::chrono::steady_clock::now();
+        std::atomic<bool> ok{true};
+
+        // One scratch per concurrent decode, handed back after each image so the next one reuses
+        // the memory. They live as long as this call, idle workers don't keep any of it.
+        std::vector<std::unique_ptr<DecodeScratch>> idleScratches;
+        std::mutex scratchMutex;
+
+        auto decodeInto = [&](DecodedTexture &texture, const AssetData &data,
+                              DecodeScratch *scratch) {
+            // A PNG holds its IDAT copy, the inflated rows and the output at once
+            scratch->reset(data.size() + size_t(texture.width + 1) * texture.height *
+                                         texture.sourceChannels * 2);
+            ScratchScope scope(scratch);
+
+            int width, height, channels;
+            stbi_uc *pixels = stbi_load_from_memory(data.data(), static_cast<int>(data.size()),
+                                                    &width, &height, &channels,
+                                                    texture.sourceChannels);
+            if (pixels == nullptr || width != texture.width || height != texture.height) {
+                texture.error = pixels == nullptr ? stbi_failure_reason() : "size changed";
+                stbi_image_free(pixels);
+                return false;
+            }
+            convertPixels(texture.conversion, pixels, texture.sourceChannels,
+                          arena + texture.offset, size_t(width) * height);
+            stbi_image_free(pixels);
+            return true;
+        };
+
+        auto decodeOne = [&](size_t index) {
+            DecodedTexture &texture = entries[index];
+            texture.decoded = false;
+            if (texture.size == 0) {
+                ok = false;
+                return;
+            }
+
+            std::unique_ptr<DecodeScratch> scratch;
+            {
+                std::lock_guard<std::mutex> lock(scratchMutex);
+                if (!idleScratches.empty()) {
+                    scratch = std::move(idleScratches.back());
+                    idleScratches.pop_back();
+                }
+            }
+            if (!scratch) {
+                scratch.reset(new DecodeScratch());
+            }
+
+            texture.decoded = decodeInto(texture, sources[index], scratch.get());
+            if (!texture.decoded) {
+                ok = false;
+            }
+
+            std::lock_guard<std::mutex> lock(scratchMutex);
+            idleScratches.push_back(std::move(scratch));
+        };
+
+        // Biggest images first so a large one doesn't end up alone at the tail of the batch
+        std::vector<size_t> order(entries.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+            return entries[a].size > entries[b].size;
+        });
+
+        if (pool != nullptr && entries.size() > 1) {
+            pool->parallelFor(order.size(), [&](size_t i) { decodeOne(order[i]); });
+        } else {
+            for (size_t index: order) {
+                decodeOne(index);
+            }
+        }
+
+        lastDecodeSeconds = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+        return ok;
+    }
+
+    uint64_t TextureBatch::pixelCount() const {
+        uint64_t pixels = 0;
+        for (const auto &texture: entries) {
+            if (texture.decoded) {
+                pixels += uint64_t(texture.width) * texture.height;
+            }
+        }
+        return pixels;
+    }
+
+    double TextureBatch::megapixelsPerSecond() const {
+        return lastDecodeSeconds > 0 ? pixelCount() / lastDecodeSeconds / 1e6 : 0;
+    }
+
+}  // namespace vkt
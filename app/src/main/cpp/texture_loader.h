@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "asset_vfs.h"
+#include "pixel_convert.h"
+
+namespace vkt {
+
+    class ThreadPool;
+
+    // Every texture is expanded to RGBA8 (VK_FORMAT_R8G8B8A8_*)
+    const int TEXTURE_CHANNELS = 4;
+    // Slice alignment in the staging arena, covers bufferOffset rules and cache lines
+    const size_t TEXTURE_SLICE_ALIGNMENT = 64;
+
+    struct DecodedTexture {
+        std::string path;
+        int width = 0;
+        int height = 0;
+        int sourceChannels = 0;  // as decoded, 3 or 4, expanded to RGBA while copied
+        PixelConversion conversion;
+        size_t offset = 0;   // slice in the staging arena
+        size_t size = 0;     // width * height * TEXTURE_CHANNELS
+        bool decoded = false;
+        const char *error = nullptr;  // static string, set when probe or decode failed
+    };
+
+    /*
+     * Decodes a batch of textures concurrently into one shared staging arena:
+     *
+     *   TextureBatch batch;
+     *   batch.probe(assets, paths);          // header only: sizes and arena slices
+     *   void *arena = map(batch.arenaSize());
+     *   batch.decode(arena, &pool);          // full decodes spread over the pool
+     *
+     * The arena is usually the mapped staging buffer, so decoded pixels land where the copy to the
+     * image reads them. stb_image's allocations are served from a scratch block reused from one image
+     * to the next, the worker converts its output (RGB expansion, transfer function,
+     * premultiplication, swizzle) while copying it into its slice.
+     */
+    class TextureBatch {
+    public:
+        // Opens the assets and reads their headers, returns false if any of them is unusable. Failed
+        // entries keep an empty slice and their error, the rest of the batch is still usable.
+        bool probe(AssetVfs &assets, const std::vector<std::string> &paths,
+                   const PixelConversion &conversion = PixelConversion());
+
+        size_t arenaSize() const { return totalSize; }
+
+        const std::vector<DecodedTexture> &textures() const { return entries; }
+
+        // Returns false if any image failed to decode, the others are still written
+        bool decode(uint8_t *arena, ThreadPool *pool);
+
+        // Decode stats of the last decode() call
+        uint64_t pixelCount() const;
+
+        double decodeSeconds() const { return lastDecodeSeconds; }
+
+        double megapixelsPerSecond() const;
+
+        // Releases the compressed asset data once the batch has been decoded
+        void releaseSources() { sources.clear(); }
+
+    private:
+        std::vector<DecodedTexture> entries;
+        std::vector<AssetData> sources;
+        size_t totalSize = 0;
+        double lastDecodeSeconds = 0;
+    };
+
+}  // namespace vkt
@@ -0,0 +1,96 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace vkt {
+
+    ThreadPool::ThreadPool(unsigned threadCount) {
+        if (threadCount == 0) {
+            unsigned cores = std::thread::hardware_concurrency();
+            threadCount = cores > 1 ? cores - 1 : 1;
+        }
+        workers.reserve(threadCount);
+        for (unsigned i = 0; i < threadCount; i++) {
+            workers.emplace_back([this]() { workerLoop(); });
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for (auto &worker: workers) {
+            worker.join();
+        }
+    }
+
+    void ThreadPool::enqueue(std::function<void()> job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push(std::move(job));
+        }
+        wakeUp.notify_one();
+    }
+
+    void ThreadPool::workerLoop() {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeUp.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                if (jobs.empty()) {
+                    return;  // stopping and nothing left to do
+                }
+                job = std::move(jobs.front());
+                jobs.pop();
+            }
+            job();
+        }
+    }
+
+    void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)> &fn) {
+        if (count == 0) {
+            return;
+        }
+
+        // Helpers may only start after the call returned (queued behind other jobs), so what they
+        // share lives on the heap. 'fn' is only touched for an index that was still unclaimed,
+        // and the call doesn't return before every claimed index is done.
+        struct Range {
+            std::atomic<size_t> next{0};
+            std::atomic<size_t> done{0};
+            size_t count = 0;
+            const std::function<void(size_t)> *fn = nullptr;
+            std::mutex mutex;
+            std::condition_variable finished;
+        };
+        auto range = std::make_shared<Range>();
+        range->count = count;
+        range->fn = &fn;
+        auto drain = [](Range &r) {
+            for (size_t i = r.next++; i < r.count; i = r.next++) {
+                (*r.fn)(i);
+                if (++r.done == r.count) {
+                    std::lock_guard<std::mutex> lock(r.mutex);
+                    r.finished.notify_all();
+                }
+            }
+        };
+
+        // The calling thread takes part, so one helper fewer than the number of items is enough.
+        // A helper that only gets a worker once every index is claimed returns straight away
+        size_t helperCount = std::min(workers.size(), count - 1);
+        for (size_t i = 0; i < helperCount; i++) {
+            enqueue([range, drain]() { drain(*range); });
+        }
+        drain(*range);
+
+        // Only indices helpers are running right now are left: the caller never waits for a
+        // helper that hasn't started, which also makes calling this from a worker safe
+        std::unique_lock<std::mutex> lock(range->mutex);
+        range->finished.wait(lock, [&range]() { return range->done == range->count; });
+    }
+
+}  // namespace vkt
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace vkt {
+
+    /*
+     * Fixed set of worker threads fed from a single job queue. Used for work that is naturally
+     * parallel and happens off the frame loop: decompressing asset chunks, decoding textures,
+     * compiling pipelines.
+     */
+    class ThreadPool {
+    public:
+        // 0 picks one thread per core, minus the calling thread
+        explicit ThreadPool(unsigned threadCount = 0);
+
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        size_t threadCount() const { return workers.size(); }
+
+        template<typename F>
+        auto submit(F &&job) -> std::future<decltype(job())> {
+            using Result = decltype(job());
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(job));
+            std::future<Result> future = task->get_future();
+            enqueue([task]() { (*task)(); });
+            return future;
+        }
+
+        /*
+         * Runs fn(0) ... fn(count - 1) across the workers and the calling thread, returns when all
+         * of them are done. Indices are handed out one at a time so uneven jobs balance out. Workers
+         * busy with other jobs don't hold the call up, the calling thread does their share, so it
+         * may also be called from a job on this pool.
+         */
+        void parallelFor(size_t count, const std::function<void(size_t)> &fn);
+
+    private:
+        void enqueue(std::function<void()> job);
+
+        void workerLoop();
+
+        std::vector<std::thread> workers;
+        std::queue<std::function<void()>> jobs;
+        std::mutex mutex;
+        std::condition_variable wakeUp;
+        bool stopping = false;
+    };
+
+}  // namespace vkt
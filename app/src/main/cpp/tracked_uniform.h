@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+namespace vkt {
+
+    /*
+     * Wraps the CPU copy of a uniform struct that has one buffer per frame slot. Setting a value
+     * only bumps the version when the bytes actually changed, and each slot remembers the version
+     * it last received, so upload() copies nothing for data that is already in that slot's buffer.
+     *
+     * The comparison is a memcmp: structs with padding may report a change that isn't one, which
+     * only costs an extra upload.
+     */
+    template<typename T, size_t MaxSlots>
+    class TrackedUniform {
+    public:
+        // Returns true if the value changed
+        bool set(const T &newValue) {
+            if (version != 0 && memcmp(&value, &newValue, sizeof(T)) == 0) {
+                return false;
+            }
+            value = newValue;
+            version++;
+            return true;
+        }
+
+        const T &get() const { return value; }
+
+        uint64_t currentVersion() const { return version; }
+
+        bool needsUpload(uint32_t slot) const { return slotVersions[slot] != version; }
+
+        // Copies the value into the slot's mapped buffer if needed, returns the bytes written
+        size_t upload(uint32_t slot, void *mapped) {
+            if (!needsUpload(slot)) {
+                return 0;
+            }
+            memcpy(mapped, &value, sizeof(T));
+            slotVersions[slot] = version;
+            return sizeof(T);
+        }
+
+        // The buffers were recreated: every slot needs the data again
+        void invalidateSlots() { slotVersions.fill(UINT64_MAX); }
+
+    private:
+        T value{};
+        uint64_t version = 0;  // 0 until the first set()
+        std::array<uint64_t, MaxSlots> slotVersions{};
+    };
+
+}  // namespace vkt
@@ -0,0 +1,301 @@
+#include "upload_batcher.h"
+
+#include <assert.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "vk_common.h"
+
+namespace vkt {
+
+    // Staging blocks are at least this big, larger resources get a block of their own
+    static const VkDeviceSize STAGING_BLOCK_SIZE = 4 * 1024 * 1024;
+
+    void UploadBatcher::init(VkPhysicalDevice physicalDevice, VkDevice newDevice,
+                             VkQueue newQueue, uint32_t queueFamilyIndex) {
+        device = newDevice;
+        queue = newQueue;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        alignment = std::max<VkDeviceSize>(16, properties.limits.optimalBufferCopyOffsetAlignment);
+
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        poolInfo.queueFamilyIndex = queueFamilyIndex;
+        VK_CHECK(vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool));
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VK_CHECK(vkCreateFence(device, &fenceInfo, nullptr, &fence));
+    }
+
+    void UploadBatcher::destroy() {
+        if (device == VK_NULL_HANDLE) {
+            return;
+        }
+        releaseStaging();
+        bufferCopies.clear();
+        imageCopies.clear();
+        vkDestroyFence(device, fence, nullptr);
+        vkDestroyCommandPool(device, commandPool, nullptr);
+        fence = VK_NULL_HANDLE;
+        commandPool = VK_NULL_HANDLE;
+        device = VK_NULL_HANDLE;
+    }
+
+    uint32_t UploadBatcher::findMemoryType(uint32_t typeFilter,
+                                           VkMemoryPropertyFlags properties) const {
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+            if ((typeFilter & (1 << i)) &&
+                (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+                return i;
+            }
+        }
+
+        assert(false);
+        return -1;
+    }
+
+    UploadBatcher::StagingBlock UploadBatcher::createBlock(VkDeviceSize size) {
+        StagingBlock block;
+        block.size = size;
+
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        VK_CHECK(vkCreateBuffer(device, &bufferInfo, nullptr, &block.buffer));
+
+        VkMemoryRequirements memRequirements;
+        vkGetBufferMemoryRequirements(device, block.buffer, &memRequirements);
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits,
+                                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        VK_CHECK(vkAllocateMemory(device, &allocInfo, nullptr, &block.memory));
+        VK_CHECK(vkBindBufferMemory(device, block.buffer, block.memory, 0));
+        VK_CHECK(vkMapMemory(device, block.memory, 0, memRequirements.size, 0,
+                             (void **) &block.mapped));
+
+        counters.stagingBlocks++;
+        return block;
+    }
+
+    void UploadBatcher::releaseStaging() {
+        for (auto &block: blocks) {
+            vkUnmapMemory(device, block.memory);
+            vkDestroyBuffer(device, block.buffer, nullptr);
+            vkFreeMemory(device, block.memory, nullptr);
+        }
+        blocks.clear();
+    }
+
+    UploadBatcher::Allocation UploadBatcher::allocate(VkDeviceSize size) {
+        StagingBlock *block = nullptr;
+        VkDeviceSize offset = 0;
+        if (!blocks.empty()) {
+            offset = (blocks.back().used + alignment - 1) / alignment * alignment;
+            if (offset + size <= blocks.back().size) {
+                block = &blocks.back();
+            }
+        }
+        if (block == nullptr) {
+            blocks.push_back(createBlock(std::max(STAGING_BLOCK_SIZE, size)));
+            block = &blocks.back();
+            offset = 0;
+        }
+        block->used = offset + size;
+        counters.stagedBytes += size;
+
+        Allocation allocation;
+        allocation.buffer = block->buffer;
+        allocation.offset = offset;
+        allocation.data = block->mapped + offset;
+        allocation.size = size;
+        return allocation;
+    }
+
+    void UploadBatcher::uploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void *data,
+                                     VkDeviceSize size, VkPipelineStageFlags dstStage,
+                                     VkAccessFlags dstAccess) {
+        Allocation staging = allocate(size);
+        memcpy(staging.data, data, size);
+        copyToBuffer(staging, dst, dstOffset, dstStage, dstAccess);
+    }
+
+    void UploadBatcher::copyToBuffer(const Allocation &src, VkBuffer dst, VkDeviceSize dstOffset,
+                                     VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+        BufferCopy copy;
+        copy.src = src.buffer;
+        copy.dst = dst;
+        copy.region.srcOffset = src.offset;
+        copy.region.dstOffset = dstOffset;
+        copy.region.size = src.size;
+        bufferCopies.push_back(copy);
+
+        pendingDstStages |= dstStage;
+        pendingBufferAccess |= dstAccess;
+    }
+
+    void UploadBatcher::copyToImage(const Allocation &src, VkDeviceSize srcOffset, VkImage dst,
+                                    uint32_t width, uint32_t height, VkImageLayout finalLayout,
+                                    VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+        ImageCopy copy;
+        copy.src = src.buffer;
+        copy.dst = dst;
+        copy.region = {};
+        copy.region.bufferOffset = src.offset + srcOffset;
+        copy.region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        copy.region.imageSubresource.mipLevel = 0;
+        copy.region.imageSubresource.baseArrayLayer = 0;
+        copy.region.imageSubresource.layerCount = 1;
+        copy.region.imageExtent = {width, height, 1};
+        copy.finalLayout = finalLayout;
+        copy.dstAccess = dstAccess;
+        imageCopies.push_back(copy);
+
+        pendingDstStages |= dstStage;
+    }
+
+    void UploadBatcher::submit() {
+        if (!hasPendingWork()) {
+            releaseStaging();
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = commandPool;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer cmd;
+        VK_CHECK(vkAllocateCommandBuffers(device, &allocInfo, &cmd));
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        VK_CHECK(vkBeginCommandBuffer(cmd, &beginInfo));
+
+        // One barrier for every image: UNDEFINED -> TRANSFER_DST, then the reverse set after the
+        // copies. An image with several copies only gets one transition.
+        std::vector<VkImageMemoryBarrier> toTransfer;
+        std::vector<VkImageMemoryBarrier> toFinal;
+        for (const auto &copy: imageCopies) {
+            bool seen = std::any_of(toTransfer.begin(), toTransfer.end(),
+                                    [&copy](const VkImageMemoryBarrier &barrier) {
+                                        return barrier.image == copy.dst;
+                                    });
+            if (seen) {
+                continue;
+            }
+
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = copy.dst;
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.levelCount = 1;
+            barrier.subresourceRange.layerCount = 1;
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            toTransfer.push_back(barrier);
+
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = copy.dstAccess;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = copy.finalLayout;
+            toFinal.push_back(barrier);
+        }
+
+        if (!toTransfer.empty()) {
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+                                 static_cast<uint32_t>(toTransfer.size()), toTransfer.data());
+        }
+
+        // Consecutive copies between the same pair of resources become one command
+        std::vector<VkBufferCopy> regions;
+        for (size_t i = 0; i < bufferCopies.size(); i++) {
+            regions.push_back(bufferCopies[i].region);
+            bool last = i + 1 == bufferCopies.size() ||
+                        bufferCopies[i + 1].src != bufferCopies[i].src ||
+                        bufferCopies[i + 1].dst != bufferCopies[i].dst;
+            if (last) {
+                vkCmdCopyBuffer(cmd, bufferCopies[i].src, bufferCopies[i].dst,
+                                static_cast<uint32_t>(regions.size()), regions.data());
+                regions.clear();
+                counters.copyCommands++;
+            }
+        }
+
+        std::vector<VkBufferImageCopy> imageRegions;
+        for (size_t i = 0; i < imageCopies.size(); i++) {
+            imageRegions.push_back(imageCopies[i].region);
+            bool last = i + 1 == imageCopies.size() ||
+                        imageCopies[i + 1].src != imageCopies[i].src ||
+                        imageCopies[i + 1].dst != imageCopies[i].dst;
+            if (last) {
+                vkCmdCopyBufferToImage(cmd, imageCopies[i].src, imageCopies[i].dst,
+                                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                       static_cast<uint32_t>(imageRegions.size()),
+                                       imageRegions.data());
+                imageRegions.clear();
+                counters.copyCommands++;
+            }
+        }
+
+        // Buffers only need their writes made visible, a global memory barrier covers all of them
+        VkMemoryBarrier bufferBarrier{};
+        bufferBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        bufferBarrier.dstAccessMask = pendingBufferAccess;
+        uint32_t bufferBarrierCount = bufferCopies.empty() ? 0 : 1;
+
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             pendingDstStages ? pendingDstStages
+                                              : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             0, bufferBarrierCount, &bufferBarrier, 0, nullptr,
+                             static_cast<uint32_t>(toFinal.size()), toFinal.data());
+
+        VK_CHECK(vkEndCommandBuffer(cmd));
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &cmd;
+        VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, fence));
+        counters.submits++;
+
+        VK_CHECK(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
+        VK_CHECK(vkResetFences(device, 1, &fence));
+        counters.fenceWaits++;
+
+        vkFreeCommandBuffers(device, commandPool, 1, &cmd);
+
+        counters.bufferCopies += bufferCopies.size();
+        counters.imageCopies += imageCopies.size();
+        counters.lastSubmitMs = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+
+        bufferCopies.clear();
+        imageCopies.clear();
+        pendingDstStages = 0;
+        pendingBufferAccess = 0;
+        releaseStaging();
+    }
+
+}  // namespace vkt
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace vkt {
+
+    /*
+     * Collects every buffer and image upload made while loading and runs them as one batch:
+     *
+     *   - one staging arena: persistently mapped blocks, sub-allocated linearly, so hundreds of
+     *     small resources don't each create, map and destroy a staging buffer;
+     *   - one command buffer: a single barrier moves every image to TRANSFER_DST, consecutive
+     *     copies between the same pair of resources are merged into one command, and a single
+     *     barrier makes all the results visible to the stages that consume them;
+     *   - one submission and one fence wait, instead of a vkQueueWaitIdle per resource.
+     *
+     * Staging memory is released once the batch has completed.
+     */
+    class UploadBatcher {
+    public:
+        struct Allocation {
+            VkBuffer buffer = VK_NULL_HANDLE;
+            VkDeviceSize offset = 0;
+            uint8_t *data = nullptr;    // write here before submit()
+            VkDeviceSize size = 0;
+        };
+
+        struct Stats {
+            uint64_t submits = 0;
+            uint64_t fenceWaits = 0;
+            uint64_t bufferCopies = 0;
+            uint64_t imageCopies = 0;
+            uint64_t copyCommands = 0;  // vkCmdCopy* calls after merging
+            uint64_t stagedBytes = 0;
+            uint64_t stagingBlocks = 0;
+            double lastSubmitMs = 0;    // record, submit and wait of the last batch
+        };
+
+        void init(VkPhysicalDevice physicalDevice, VkDevice device, VkQueue queue,
+                  uint32_t queueFamilyIndex);
+
+        void destroy();
+
+        // Staging space the caller fills itself, e.g. to decode straight into it
+        Allocation allocate(VkDeviceSize size);
+
+        // Copies 'data' into staging and queues the copy to 'dst'
+        void uploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void *data,
+                          VkDeviceSize size, VkPipelineStageFlags dstStage,
+                          VkAccessFlags dstAccess);
+
+        // Queues a copy from staging the caller already filled
+        void copyToBuffer(const Allocation &src, VkBuffer dst, VkDeviceSize dstOffset,
+                          VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+
+        /*
+         * Queues a copy of tightly packed pixels at 'srcOffset' in 'src' to mip 0 of a color image
+         * in UNDEFINED layout, which ends up in 'finalLayout'.
+         */
+        void copyToImage(const Allocation &src, VkDeviceSize srcOffset, VkImage dst,
+                         uint32_t width, uint32_t height, VkImageLayout finalLayout,
+                         VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+
+        bool hasPendingWork() const { return !bufferCopies.empty() || !imageCopies.empty(); }
+
+        // Records and submits everything queued, waits for it and releases the staging memory
+        void submit();
+
+        const Stats &stats() const { return counters; }
+
+    private:
+        struct StagingBlock {
+            VkBuffer buffer = VK_NULL_HANDLE;
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            uint8_t *mapped = nullptr;
+            VkDeviceSize size = 0;
+            VkDeviceSize used = 0;
+        };
+
+        struct BufferCopy {
+            VkBuffer src;
+            VkBuffer dst;
+            VkBufferCopy region;
+        };
+
+        struct ImageCopy {
+            VkBuffer src;
+            VkImage dst;
+            VkBufferImageCopy region;
+            VkImageLayout finalLayout;
+            VkAccessFlags dstAccess;
+        };
+
+        uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+        StagingBlock createBlock(VkDeviceSize size);
+
+        void releaseStaging();
+
+        VkDevice device = VK_NULL_HANDLE;
+        VkQueue queue = VK_NULL_HANDLE;
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        VkPhysicalDeviceMemoryProperties memoryProperties{};
+        VkDeviceSize alignment = 16;
+
+        std::vector<StagingBlock> blocks;
+        std::vector<BufferCopy> bufferCopies;
+        std::vector<ImageCopy> imageCopies;
+        VkPipelineStageFlags pendingDstStages = 0;
+        VkAccessFlags pendingBufferAccess = 0;
+        Stats counters;
+    };
+
+}  // namespace vkt
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdlib.h>
+#include <vulkan/vulkan.h>
+
+#include "frame_counters.h"
+#include "logger.h"
+
+// Formatted and written on the logger's thread, see Logger
+#define LOGI(...) VKT_LOG(vkt::LogLevel::Info, __VA_ARGS__)
+#define LOGE(...) VKT_LOG(vkt::LogLevel::Error, __VA_ARGS__)
+#define VK_CHECK(x)                           \
+  do {                                        \
+    VkResult err = x;                         \
+    if (err) {                                \
+      LOGE("Detected Vulkan error: %d", err); \
+      vkt::Logger::instance().flush();        \
+      abort();                                \
+    }                                         \
+  } while (0)
@@ -4,11 +4,15 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/system_properties.h>
 
 #include <iostream>
 
 #include "hellovk.h"
 
+// Input arrives on the UI thread through the event filters, which have no engine to reach
+static ALooper *inputLooper = nullptr;
+
 /*
  * Shared state for the app. This will be accessed within lifecycle callbacks such as APP_CMD_START
  * or APP_CMD_INIT_WINDOW.
@@ -16,67 +20,181 @@
  * We store:
  * struct android_app - a pointer to the Android application handle
  * vkt::HelloVK - a pointer to our (this) Vulkan application in order to call the rendering logic
- * bool canRender - a flag which signals that we are ready to call the vulkan rendering logic
+ * vkt::RenderThread - where the lifecycle commands go, it renders and owns the Lifecycle
+ * vkt::TouchGestures - turns touch events into camera commands
  */
 struct VulkanEngine {
     struct android_app *app;
     vkt::HelloVK *app_backend;
-    bool canRender = false;
+    vkt::RenderThread *render_thread;
+    vkt::TouchGestures gestures;
+    std::vector<vkt::CameraCommand> camera_commands;
+    std::vector<vkt::TouchEvent> input_trace;
 };
 
+// Records the touch events of the session into <internal data>/input.trace when the app stops,
+// for replaying on the host (tools/inputtrace)
+static const bool RECORD_INPUT_TRACE = false;
+
+static void WriteInputTrace(struct android_app *app, const std::vector<vkt::TouchEvent> &trace) {
+    std::string path = std::string(app->activity->internalDataPath) + "/input.trace";
+    FILE *file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        LOGE("Can't write %s", path.c_str());
+        return;
+    }
+    std::string text = vkt::formatInputTrace(trace);
+    fwrite(text.data(), 1, text.size(), file);
+    fclose(file);
+    LOGI("Input trace: %zu events in %s", trace.size(), path.c_str());
+}
+
+/*
+ * Developer settings, read from system properties so they change without a rebuild:
+ *   adb shell setprop debug.hellovk.pacing low-latency|balanced|throughput
+ *   adb shell setprop debug.hellovk.msaa 1|2|4
+ * The pacing mode is read again each time the app comes to the foreground. MSAA only at launch:
+ * it is built into the render pass and pipelines, which live as long as the device.
+ */
+static const char *PACING_PROPERTY = "debug.hellovk.pacing";
+static const char *MSAA_PROPERTY = "debug.hellovk.msaa";
+
+static void ApplyPacingProperty(vkt::HelloVK &backend) {
+    char value[PROP_VALUE_MAX] = {};
+    if (__system_property_get(PACING_PROPERTY, value) <= 0) {
+        return;
+    }
+    vkt::PacingMode mode;
+    if (vkt::parsePacingMode(value, mode)) {
+        backend.setPacingMode(mode);
+    } else {
+        LOGE("%s: unknown pacing mode %s", PACING_PROPERTY, value);
+    }
+}
+
+static void ApplyMsaaProperty(vkt::HelloVK &backend) {
+    char value[PROP_VALUE_MAX] = {};
+    if (__system_property_get(MSAA_PROPERTY, value) <= 0) {
+        return;
+    }
+    int samples = atoi(value);
+    if (samples == 1 || samples == 2 || samples == 4) {
+        backend.setMsaaSamples(static_cast<VkSampleCountFlagBits>(samples));
+    } else {
+        LOGE("%s: %s samples not supported, use 1, 2 or 4", MSAA_PROPERTY, value);
+    }
+}
+
 /*
- * Called by the Android runtime whenever events happen so the app can react to it.
+ * Called by the Android runtime whenever events happen so the app can react to it. Lifecycle
+ * commands are handed to the render thread, only window teardown waits for it.
  */
 static void HandleCmd(struct android_app *app, int32_t cmd) {
     auto *engine = (VulkanEngine *) app->userData;
+    vkt::RenderThread *renderThread = engine->render_thread;
     switch (cmd) {
         case APP_CMD_START:
-            if (engine->app->window != nullptr) {
-                engine->app_backend->reset(app->window, app->activity->assetManager);
-                engine->app_backend->initVulkan();
-                engine->canRender = true;
-            }
+            ApplyPacingProperty(*engine->app_backend);
+            renderThread->post(vkt::RenderCommand::Start);
+            break;
         case APP_CMD_INIT_WINDOW:
-            // The window is being shown, get it ready.
+            // The window is being shown: the first one brings everything up, later ones only
+            // rebuild the surface and swapchain.
             LOGI("Called - APP_CMD_INIT_WINDOW");
-            if (engine->app->window != nullptr) {
-                LOGI("Setting a new surface");
-                engine->app_backend->reset(app->window, app->activity->assetManager);
-                if (!engine->app_backend->initialized) {
-                    LOGI("Starting application");
-                    engine->app_backend->initVulkan();
-                }
-                engine->canRender = true;
-            }
+            renderThread->post(vkt::RenderCommand::WindowCreated, app->window);
             break;
         case APP_CMD_TERM_WINDOW:
-            // The window is being hidden or closed, clean it up.
-            engine->canRender = false;
+            // The window is being hidden or closed, drop what refers to it and keep the rest.
+            // The window goes away when we return, so wait until the render thread let go of it.
+            LOGI("Called - APP_CMD_TERM_WINDOW");
+            renderThread->postAndWait(vkt::RenderCommand::WindowDestroyed);
+            break;
+        case APP_CMD_STOP:
+            renderThread->post(vkt::RenderCommand::Stop);
+            if (RECORD_INPUT_TRACE) {
+                WriteInputTrace(app, engine->input_trace);
+            }
+            break;
+        case APP_CMD_WINDOW_RESIZED:
+        case APP_CMD_WINDOW_REDRAW_NEEDED:
+        case APP_CMD_CONTENT_RECT_CHANGED:
+        case APP_CMD_CONFIG_CHANGED:
+            // Nothing else presents while idle, so a rotation would go unnoticed
+            engine->app_backend->redrawScheduler().invalidate(vkt::REDRAW_LIFECYCLE);
             break;
         case APP_CMD_DESTROY:
-            // The window is being hidden or closed, clean it up.
             LOGI("Destroying");
-            engine->app_backend->cleanup();
+            renderThread->postAndWait(vkt::RenderCommand::Destroy);
+            break;
         default:
             break;
     }
 }
 
 /*
- * Key events filter to GameActivity's android_native_app_glue. This sample does not use/process any
- * input events, return false for all input events so system can still process them.
+ * Key events filter to GameActivity's android_native_app_glue. This sample does not use/process key
+ * events, return false for them so system can still process them. Motion events are kept for the
+ * camera.
  */
 extern "C" bool VulkanKeyEventFilter(const GameActivityKeyEvent *event) {
     return false;
 }
 extern "C" bool VulkanMotionEventFilter(const GameActivityMotionEvent *event) {
-    return false;
+    // The event loop blocks until something happens, have it look at the input buffers
+    if (inputLooper != nullptr) {
+        ALooper_wake(inputLooper);
+    }
+    return true;
+}
+
+/*
+ * Reduces a GameActivity motion event to the pointers the camera gestures use. Lifting one of
+ * several fingers drops it from the event and restarts the gesture from the fingers left.
+ */
+static vkt::TouchEvent ToTouchEvent(const GameActivityMotionEvent &motion) {
+    vkt::TouchEvent event;
+    event.timeNs = motion.eventTime;
+    int32_t action = motion.action & AMOTION_EVENT_ACTION_MASK;
+    uint32_t lifted = UINT32_MAX;
+    switch (action) {
+        case AMOTION_EVENT_ACTION_DOWN:
+        case AMOTION_EVENT_ACTION_POINTER_DOWN:
+            event.action = vkt::TouchAction::Down;
+            break;
+        case AMOTION_EVENT_ACTION_POINTER_UP:
+            event.action = vkt::TouchAction::Down;
+            lifted = (motion.action & AMOTION_EVENT_ACTION_POINTER_INDEX_MASK) >>
+                     AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT;
+            break;
+        case AMOTION_EVENT_ACTION_UP:
+            event.action = vkt::TouchAction::Up;
+            break;
+        case AMOTION_EVENT_ACTION_CANCEL:
+            event.action = vkt::TouchAction::Cancel;
+            break;
+        default:
+            event.action = vkt::TouchAction::Move;
+            break;
+    }
+    for (uint32_t i = 0; i < motion.pointerCount && event.pointerCount < vkt::MAX_TOUCH_POINTERS;
+         i++) {
+        if (i == lifted) {
+            continue;
+        }
+        event.x[event.pointerCount] = GameActivityPointerAxes_getX(&motion.pointers[i]);
+        event.y[event.pointerCount] = GameActivityPointerAxes_getY(&motion.pointers[i]);
+        event.pointerCount++;
+    }
+    return event;
 }
 
 /*
  * Process user touch and key events. GameActivity double buffers those events, applications can
  * process at any time. All of the buffered events have been reported "handled" to OS. For details,
  * refer to:  d.android.com/games/agdk/game-activity/get-started#handle-events
+ *
+ * Touch events become camera commands stamped with their event time, the render thread picks
+ * them up at its next frame.
  */
 static void HandleInputEvents(struct android_app *app) {
     auto inputBuf = android_app_swap_input_buffers(app);
@@ -84,26 +202,71 @@ static void HandleInputEvents(struct android_app *app) {
         return;
     }
 
-    // For the minimum, apps need to process the exit event (for example,  listening to
-    // AKEYCODE_BACK). This sample has done that in the Kotlin side and not processing other input
-    // events, we just reset the event counter inside the android_input_buffer to keep app glue code
-    // in a working state.
-    android_app_clear_motion_events(inputBuf);
+    auto *engine = (VulkanEngine *) app->userData;
+    if (app->window != nullptr) {
+        engine->gestures.setViewWidth(static_cast<float>(ANativeWindow_getWidth(app->window)));
+    }
+    engine->camera_commands.clear();
+    for (uint64_t i = 0; i < inputBuf->motionEventsCount; i++) {
+        vkt::TouchEvent event = ToTouchEvent(inputBuf->motionEvents[i]);
+        if (RECORD_INPUT_TRACE) {
+            engine->input_trace.push_back(event);
+        }
+        engine->gestures.process(event, engine->camera_commands);
+    }
     android_app_clear_motion_events(inputBuf);
+
+    if (!engine->camera_commands.empty()) {
+        engine->app_backend->cameraInput().push(engine->camera_commands);
+        engine->app_backend->redrawScheduler().invalidate(vkt::REDRAW_INPUT);
+    }
 }
 
 /*
  * Entry point required by the Android Glue library.
  * This can also be achieved more verbosely by manually declaring JNI functions and calling them
  * from the Android application layer.
+ *
+ * This thread only handles events. Frames are rendered on the render thread, which waits in the
+ * RedrawScheduler until one is due, and the cube's animation is stepped on the simulation thread.
  */
 void android_main(struct android_app *state) {
     VulkanEngine engine{};
     vkt::HelloVK vulkanBackend{};
+    vkt::Lifecycle lifecycle(vulkanBackend);
+    vkt::RedrawScheduler &redraw = vulkanBackend.redrawScheduler();
+    vkt::RenderThread renderThread(lifecycle, redraw, [&vulkanBackend]() {
+        return vulkanBackend.render();
+    });
+    vkt::SimulationThread simulation(vkt::DEFAULT_ANIMATION_INTERVAL,
+                                     [&vulkanBackend](double seconds) {
+                                         vulkanBackend.simulate(seconds);
+                                     });
 
     engine.app = state;
     engine.app_backend = &vulkanBackend;
+    engine.render_thread = &renderThread;
     state->userData = &engine;
+    vulkanBackend.setAssetManager(state->activity->assetManager);
+    ApplyMsaaProperty(vulkanBackend);
+
+    renderThread.setFirstFrameCallback([](const vkt::Lifecycle::Stats &stats) {
+        if (stats.lastWasColdStart) {
+            LOGI("First frame %.2f ms after the window", stats.coldStartMs);
+        } else {
+            LOGI("Resumed: first frame %.2f ms after the window, %.2f ms of it rebuilding "
+                 "the surface and swapchain", stats.lastResumeMs, stats.lastSurfaceMs);
+        }
+    });
+    // Nothing to animate for while there is nothing to show
+    simulation.setPaused(true);
+    renderThread.setRenderableCallback([&simulation](bool renderable) {
+        simulation.setPaused(!renderable);
+    });
+    renderThread.start();
+    simulation.start();
+
+    inputLooper = ALooper_forThread();
     state->onAppCmd = HandleCmd;
 
     android_app_set_key_event_filter(state, VulkanKeyEventFilter);
@@ -113,15 +276,19 @@ void android_main(struct android_app *state) {
         int ident;
         int events;
         android_poll_source *source;
-        while ((ident = ALooper_pollAll(engine.canRender ? 0 : -1, nullptr, &events,
-                                        (void **) &source)) >= 0) {
+        // Blocks until an event, or until the motion filter wakes it
+        while ((ident = ALooper_pollAll(-1, nullptr, &events, (void **) &source)) >= 0) {
             if (source != nullptr) {
                 source->process(state, source);
             }
+            if (state->destroyRequested) {
+                inputLooper = nullptr;
+                simulation.stop();
+                renderThread.stop();
+                return;
+            }
         }
 
         HandleInputEvents(state);
-
-        engine.app_backend->render();
     }
-}
\ No newline at end of file
+}
@@ -1,40 +1,102 @@
 #version 450
 
 layout(location = 0) in vec3 fragColor;// Color from vertex shader
-layout(location = 1) in vec3 lightPos;// Light position from vertex shader
-layout(location = 2) in vec3 lightColor;// Light color from vertex shader
-layout(location = 3) in vec3 fragPos;// Fragment position from vertex shader
+layout(location = 1) in vec3 fragPos;// View space position from vertex shader
 
-layout(location = 4) in vec2 vTexCoords;
+layout(location = 2) in vec2 vTexCoords;
 layout(set = 1, binding = 0) uniform sampler2D textureSampler;
 
+// Clustered lighting (light_clusters.h): the CPU bins the point lights into a grid of view space
+// froxels every frame, each fragment only walks the lights of its own cluster
+layout(set = 2, binding = 0) uniform LightingUBO {
+    vec4 ambient;
+    vec4 clusterParams;// xy: ndc = view.xy * xy / depth, zw: slice = log(depth) * z + w
+} lighting;
+
+struct PointLight {
+    vec4 positionRadius;// view space
+    vec4 colorIntensity;
+    vec4 attenuation;// constant, linear, quadratic
+};
+
+layout(std430, set = 2, binding = 1) readonly buffer PointLights {
+    PointLight lights[];
+};
+
+// Same numbers as light_clusters.h
+const uint CLUSTER_TILES_X = 16u;
+const uint CLUSTER_TILES_Y = 8u;
+const uint CLUSTER_SLICES = 24u;
+const uint CLUSTER_COUNT = CLUSTER_TILES_X * CLUSTER_TILES_Y * CLUSTER_SLICES;
+const float LIGHT_CUTOFF = 1.0 / 64.0;
+
+layout(std430, set = 2, binding = 2) readonly buffer Clusters {
+    uvec2 cells[CLUSTER_COUNT];// offset into indices, light count
+    uint indices[];
+};
+
 layout(location = 0) out vec4 outColor;// Final color of the fragment
 
-// Simplified lighting parameters
-const vec3 ambientColor = vec3(0.8, 0.8, 0.8);// Ambient light color
+// Shader features, set per pipeline variant (ShaderFeature in hellovk.h). The compiler folds the
+// branches on them away, each variant only contains its own path
+layout(constant_id = 0) const bool TEXTURED = false;
+layout(constant_id = 1) const bool LIT = false;
+// Fallback variant drawn while the others compile: picks the textured or the vertex color path
+// per fragment from the texture coordinates, negative ones meaning "no texture"
+layout(constant_id = 2) const bool DYNAMIC_BRANCH = false;
 
-void main() {
-    // Set final color of the fragment
-    // Apply texture if valid texture coordinates are provided
-    if (vTexCoords.x < 0.0 || vTexCoords.y < 0.0) {
-        // Calculate the light direction (from fragment to light)
-        vec3 lightDir = normalize(lightPos - fragPos);
+// LightClusters::clusterAt: from the view space position, so pre-rotation and render scale
+// don't matter
+uint clusterIndex(vec3 viewPos) {
+    float depth = max(-viewPos.z, 1e-4);
+    vec2 ndc = viewPos.xy * lighting.clusterParams.xy / depth;
+    uvec2 tile = uvec2(clamp((ndc * 0.5 + 0.5) * vec2(CLUSTER_TILES_X, CLUSTER_TILES_Y),
+                             vec2(0.0), vec2(CLUSTER_TILES_X - 1u, CLUSTER_TILES_Y - 1u)));
+    uint slice = uint(clamp(log(depth) * lighting.clusterParams.z + lighting.clusterParams.w,
+                            0.0, float(CLUSTER_SLICES - 1u)));
+    return (slice * CLUSTER_TILES_Y + tile.y) * CLUSTER_TILES_X + tile.x;
+}
+
+vec3 shadeVertexColor(vec3 normal) {
+    if (!LIT) {
+        return fragColor;
+    }
 
-        // Basic Lambertian Diffuse Reflection (without normal)
-        float diff = max(dot(lightDir, vec3(0.0, 0.0, 1.0)), 0.0);// Assuming a "flat" surface facing up
+    uvec2 cell = cells[clusterIndex(fragPos)];
+    vec3 light = lighting.ambient.rgb;
+    for (uint i = 0u; i < cell.y; i++) {
+        PointLight pointLight = lights[indices[cell.x + i]];
+        vec3 toLight = pointLight.positionRadius.xyz - fragPos;
+        float lightDistance = length(toLight);
+        float attenuation = pointLight.attenuation.x + pointLight.attenuation.y * lightDistance +
+                            pointLight.attenuation.z * lightDistance * lightDistance;
+        // Lowered by the cutoff so it reaches 0 at the radius the light was culled with
+        float strength = max(pointLight.colorIntensity.w / attenuation - LIGHT_CUTOFF, 0.0);
+        float diffuse = max(dot(normal, toLight / lightDistance), 0.0);// Lambert
+        light += pointLight.colorIntensity.rgb * (strength * diffuse);
+    }
+    return fragColor * light;
+}
 
-        // Combine ambient, diffuse, and the effect of light color
-        vec3 ambient = ambientColor * fragColor;
-        vec3 diffuse = diff * lightColor * fragColor;
+void main() {
+    // Face normal from the position derivatives, turned towards the camera. Taken before any
+    // per-fragment branch, derivatives need the whole quad
+    vec3 normal = vec3(0.0, 0.0, 1.0);
+    if (LIT) {
+        normal = normalize(cross(dFdx(fragPos), dFdy(fragPos)));
+        if (dot(normal, fragPos) > 0.0) {
+            normal = -normal;
+        }
+    }
 
-        // Final color calculation
-        vec3 finalColor = ambient + diffuse;
+    bool textured = TEXTURED;
+    if (DYNAMIC_BRANCH) {
+        textured = vTexCoords.x >= 0.0 && vTexCoords.y >= 0.0;
+    }
 
-        // If no valid texture coordinates, use the final color only
-        outColor = vec4(fragColor, 1.0);
-    } else {
-        // Sample the texture and combine it with the final color
+    if (textured) {
         outColor = texture(textureSampler, vTexCoords);
-        // outColor = vec4(vTexCoords, 0.0, 1.0);
+    } else {
+        outColor = vec4(shadeVertexColor(normal), 1.0);
     }
 }
@@ -0,0 +1,278 @@
+/*
+ * Host benchmark of the asset backends the app loads its shaders and textures through.
+ *
+ *   assetload <asset dir> [--repeat N] [--iterations N] [path ...]
+ *
+ * The set (by default the app's shaders and texture, repeated N times to make a realistic batch)
+ * is opened through DirectorySource, which reads a heap copy, and through MappedFileSource, which
+ * maps the files. Every byte is read, the way an upload would, with the whole set held at once.
+ * Each source runs in its own child process so the peak RSS (getrusage ru_maxrss) is its own; the
+ * anonymous part is what the kernel can't drop under memory pressure, mapped file pages are clean
+ * and can be.
+ *
+ * Before that the AssetData handle is checked: moves hand the backend resource over without
+ * releasing it, every resource is released exactly once, and a mapping is gone with its handle.
+ * Paths that aren't there (the SPIR-V is only built by Gradle) are skipped.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "asset_vfs.h"
+#include "check.h"
+
+using namespace vkt;
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+// What HelloVK opens at init
+const char *const DEFAULT_ASSETS[] = {
+        "shaders/shader.vert.spv",
+        "shaders/shader.frag.spv",
+        "img.png",
+};
+
+struct ReleaseLog {
+    int calls = 0;
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+};
+
+static void logRelease(void *context, const uint8_t *data, size_t size) {
+    auto *log = static_cast<ReleaseLog *>(context);
+    log->calls++;
+    log->data = data;
+    log->size = size;
+}
+
+static void checkHandle() {
+    printf("AssetData\n");
+    const uint8_t bytes[16] = {};
+
+    AssetData none;
+    check(!none.valid() && none.empty() && none.size() == 0 && !none.isZeroCopy(),
+          "default handle is empty");
+
+    ReleaseLog log;
+    {
+        AssetData first(bytes, sizeof(bytes), true, logRelease, &log);
+        AssetData second(std::move(first));
+        check(!first.valid() && first.size() == 0 && !first.isZeroCopy(),
+              "moved-from handle is empty");
+        check(second.data() == bytes && second.size() == sizeof(bytes) && second.isZeroCopy(),
+              "move keeps the view");
+        check(log.calls == 0, "move doesn't release");
+
+        AssetData &alias = second;
+        second = std::move(alias);
+        check(second.valid() && log.calls == 0, "self move assignment keeps the resource");
+    }
+    check(log.calls == 1 && log.data == bytes && log.size == sizeof(bytes),
+          "released once, with its view");
+
+    ReleaseLog held;
+    ReleaseLog incoming;
+    {
+        AssetData target(bytes, sizeof(bytes), true, logRelease, &held);
+        target = AssetData(bytes + 8, 8, false, logRelease, &incoming);
+        check(held.calls == 1 && incoming.calls == 0, "assignment releases the old resource");
+        check(target.data() == bytes + 8 && target.size() == 8 && !target.isZeroCopy(),
+              "assignment takes the new view");
+    }
+    check(held.calls == 1 && incoming.calls == 1, "assigned resource released once");
+
+    // Growing a vector moves the handles (the move is noexcept), nothing may be released early
+    ReleaseLog grown;
+    {
+        std::vector<AssetData> handles;
+        for (int i = 0; i < 9; i++) {
+            handles.emplace_back(bytes, sizeof(bytes), true, logRelease, &grown);
+        }
+        check(grown.calls == 0, "vector growth doesn't release");
+    }
+    check(grown.calls == 9, "every handle released once");
+
+    std::vector<uint8_t> buffer(1000, 7);
+    const uint8_t *owned = buffer.data();
+    AssetData copied = AssetData::fromBuffer(std::move(buffer));
+    check(copied.data() == owned && copied.size() == 1000 && !copied.isZeroCopy(),
+          "fromBuffer adopts the buffer without copying");
+    AssetData emptyFile = AssetData::fromBuffer({});
+    check(emptyFile.valid() && emptyFile.empty(), "empty file is valid");
+}
+
+// Mappings of 'path' in this process
+static int countMappings(const std::string &path) {
+    std::ifstream maps("/proc/self/maps");
+    int count = 0;
+    for (std::string line; std::getline(maps, line);) {
+        count += line.size() >= path.size() &&
+                 line.compare(line.size() - path.size(), path.size(), path) == 0;
+    }
+    return count;
+}
+
+static void checkSources(const std::string &root, const std::vector<std::string> &paths) {
+    printf("sources\n");
+    DirectorySource directory(root);
+    MappedFileSource mapped(root);
+    for (const std::string &path: paths) {
+        AssetData copy = directory.open(path.c_str());
+        AssetData view = mapped.open(path.c_str());
+        check(copy.valid() && !copy.isZeroCopy(), "directory source reads a copy");
+        check(view.valid() && view.isZeroCopy(), "mapped source doesn't copy");
+        check(copy.size() == view.size() && memcmp(copy.data(), view.data(), copy.size()) == 0,
+              "both sources read the same bytes");
+    }
+    check(!directory.open("no/such/asset").valid() && !mapped.open("no/such/asset").valid(),
+          "missing asset is not valid");
+
+    AssetVfs vfs;
+    vfs.mount(std::make_unique<MappedFileSource>(root + "/no/such/dir"));
+    vfs.mount(std::make_unique<MappedFileSource>(root));
+    vfs.mount(std::make_unique<DirectorySource>(root));
+    check(vfs.open(paths.front().c_str()).isZeroCopy(), "first source that has the path wins");
+
+    std::string file = fs::canonical(fs::path(root) / paths.front()).string();
+    int before = countMappings(file);
+    {
+        AssetData view = mapped.open(paths.front().c_str());
+        check(countMappings(file) == before + 1, "open maps the file");
+        AssetData moved = std::move(view);
+        check(countMappings(file) == before + 1, "move keeps the one mapping");
+    }
+    check(countMappings(file) == before, "mapping is gone with the handle");
+}
+
+static long anonymousKb() {
+    std::ifstream status("/proc/self/status");
+    for (std::string line; std::getline(status, line);) {
+        if (line.compare(0, 8, "RssAnon:") == 0) {
+            return atol(line.c_str() + 8);
+        }
+    }
+    return 0;
+}
+
+static long peakRssKb() {
+    struct rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;  // KB on Linux
+}
+
+// Runs in a child process, prints its line and returns the exit code
+static int measure(AssetSource &source, const std::vector<std::string> &paths, int repeat,
+                   int iterations) {
+    // Fault in what the loop itself touches (stdio, the pages the fork shares), so the baseline
+    // leaves only the assets
+    std::vector<AssetData> loaded;
+    std::vector<double> times;
+    loaded.reserve(paths.size() * repeat);
+    times.reserve(iterations);
+    source.open("no/such/asset");
+    anonymousKb();
+    Clock::now();
+
+    long baseRss = peakRssKb();
+    long baseAnonymous = anonymousKb();
+    long heldAnonymous = 0;
+    size_t bytes = 0;
+    unsigned checksum = 0;
+    for (int i = 0; i < iterations; i++) {
+        auto start = Clock::now();
+        loaded.clear();
+        bytes = 0;
+        for (int r = 0; r < repeat; r++) {
+            for (const std::string &path: paths) {
+                loaded.push_back(source.open(path.c_str()));
+                if (!loaded.back().valid()) {
+                    fprintf(stderr, "%s: can't open %s\n", source.name(), path.c_str());
+                    return 1;
+                }
+                // Read it all, as the upload would
+                for (size_t b = 0; b < loaded.back().size(); b++) {
+                    checksum += loaded.back().data()[b];
+                }
+                bytes += loaded.back().size();
+            }
+        }
+        times.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        heldAnonymous = std::max(heldAnonymous, anonymousKb() - baseAnonymous);
+    }
+    std::sort(times.begin(), times.end());
+    printf("%-10s %zu bytes in %.3f ms (median), peak RSS +%ld KB, %ld KB anonymous while held"
+           " (checksum %u)\n", source.name(), bytes, times[times.size() / 2],
+           peakRssKb() - baseRss, heldAnonymous, checksum);
+    return 0;
+}
+
+static void benchmark(AssetSource &source, const std::vector<std::string> &paths, int repeat,
+                      int iterations) {
+    fflush(stdout);  // or the child prints it again
+    pid_t child = fork();
+    if (child == 0) {
+        int result = measure(source, paths, repeat, iterations);
+        fflush(stdout);
+        _exit(result);
+    }
+    int status = 0;
+    check(child > 0 && waitpid(child, &status, 0) == child && WIFEXITED(status) &&
+          WEXITSTATUS(status) == 0, "benchmark ran");
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: assetload <asset dir> [--repeat N] [--iterations N] [path ...]\n");
+        return 2;
+    }
+
+    std::string root = argv[1];
+    int repeat = 16;
+    int iterations = 20;
+    std::vector<std::string> requested;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = std::max(1, atoi(argv[++i]));
+        } else {
+            requested.push_back(argv[i]);
+        }
+    }
+    if (requested.empty()) {
+        requested.assign(std::begin(DEFAULT_ASSETS), std::end(DEFAULT_ASSETS));
+    }
+
+    std::vector<std::string> paths;
+    for (const std::string &path: requested) {
+        if (fs::is_regular_file(fs::path(root) / path)) {
+            paths.push_back(path);
+        } else {
+            printf("%s: not found, skipped\n", path.c_str());
+        }
+    }
+    if (paths.empty()) {
+        fprintf(stderr, "nothing to load under %s\n", root.c_str());
+        return 2;
+    }
+
+    checkHandle();
+    checkSources(root, paths);
+
+    DirectorySource directory(root);
+    MappedFileSource mapped(root);
+    benchmark(directory, paths, repeat, iterations);
+    benchmark(mapped, paths, repeat, iterations);
+    return checkResult();
+}
@@ -0,0 +1,263 @@
+/*
+ * Host side packer for the app's asset packs.
+ *
+ *   assetpack pack <out.pak> <asset dir> [--compress none|lz4]
+ *   assetpack list <pack>
+ *   assetpack verify <pack> [asset dir]
+ *   assetpack bench <pack> <asset dir> [iterations]
+ *
+ * 'verify' checks every entry against its content hash, and against the loose file when a
+ * directory is given. 'bench' compares open latency and read throughput of the pack with the
+ * loose files, both read through the same mmap backend the app would use on desktop.
+ */
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "asset_pack.h"
+#include "asset_vfs.h"
+#include "thread_pool.h"
+
+using namespace vkt;
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+static const char *toStringCompression(uint32_t compression) {
+    switch (static_cast<PackCompression>(compression)) {
+        case PackCompression::None:
+            return "none";
+        case PackCompression::LZ4:
+            return "lz4";
+        case PackCompression::Zstd:
+            return "zstd";
+    }
+    return "?";
+}
+
+static std::vector<std::string> listFiles(const std::string &root) {
+    std::vector<std::string> files;
+    for (const auto &item: fs::recursive_directory_iterator(root)) {
+        if (item.is_regular_file()) {
+            files.push_back(fs::relative(item.path(), root).generic_string());
+        }
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+static bool openPack(const std::string &path, AssetPack &pack) {
+    fs::path packPath(path);
+    MappedFileSource source(packPath.parent_path().string());
+    if (!pack.open(source.open(packPath.filename().string().c_str()))) {
+        fprintf(stderr, "%s: not a valid asset pack\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+static int pack(int argc, char **argv) {
+    if (argc < 4) {
+        return 2;
+    }
+    const std::string root = argv[3];
+    PackCompression compression = PackCompression::LZ4;
+    if (argc >= 6 && strcmp(argv[4], "--compress") == 0) {
+        if (strcmp(argv[5], "none") == 0) {
+            compression = PackCompression::None;
+        } else if (strcmp(argv[5], "zstd") == 0) {
+            compression = PackCompression::Zstd;
+        } else if (strcmp(argv[5], "lz4") != 0) {
+            fprintf(stderr, "unknown compression %s\n", argv[5]);
+            return 2;
+        }
+    }
+
+    AssetPackWriter writer;
+    DirectorySource source(root);
+    uint64_t totalSize = 0;
+    for (const auto &path: listFiles(root)) {
+        if (path == fs::path(argv[2]).filename()) {
+            continue;  // don't pack a previous output written into the same directory
+        }
+        AssetData data = source.open(path.c_str());
+        if (!data.valid()) {
+            fprintf(stderr, "cannot read %s\n", path.c_str());
+            return 1;
+        }
+        writer.add(path, data.data(), data.size(), compression);
+        totalSize += data.size();
+    }
+
+    std::string error;
+    if (!writer.write(argv[2], &error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    printf("%s: %llu bytes of assets -> %llu bytes\n", argv[2],
+           static_cast<unsigned long long>(totalSize),
+           static_cast<unsigned long long>(fs::file_size(argv[2])));
+    return 0;
+}
+
+static int list(int argc, char **argv) {
+    AssetPack assetPack;
+    if (argc < 3 || !openPack(argv[2], assetPack)) {
+        return argc < 3 ? 2 : 1;
+    }
+    for (size_t i = 0; i < assetPack.entryCount(); i++) {
+        const PackEntry &entry = assetPack.entry(i);
+        printf("%10llu %10llu %-5s %4u chunks  %016llx  %s\n",
+               static_cast<unsigned long long>(entry.size),
+               static_cast<unsigned long long>(entry.storedSize),
+               toStringCompression(entry.compression), entry.chunkCount,
+               static_cast<unsigned long long>(entry.contentHash),
+               assetPack.entryName(entry).c_str());
+    }
+    return 0;
+}
+
+static int verify(int argc, char **argv) {
+    AssetPack assetPack;
+    if (argc < 3 || !openPack(argv[2], assetPack)) {
+        return argc < 3 ? 2 : 1;
+    }
+    std::unique_ptr<DirectorySource> loose;
+    if (argc >= 4) {
+        loose = std::make_unique<DirectorySource>(argv[3]);
+    }
+
+    ThreadPool pool;
+    int failures = 0;
+    for (size_t i = 0; i < assetPack.entryCount(); i++) {
+        const PackEntry &entry = assetPack.entry(i);
+        const std::string name = assetPack.entryName(entry);
+
+        AssetData data = assetPack.read(entry, &pool);
+        bool ok = data.valid() && data.size() == entry.size &&
+                  assetPack.verify(entry, data.data()) && assetPack.find(name.c_str()) == &entry;
+
+        // Streaming path, one chunk at a time
+        if (ok && entry.chunkCount > 0) {
+            std::vector<uint8_t> chunk(PACK_CHUNK_SIZE);
+            for (uint32_t c = 0; ok && c < entry.chunkCount; c++) {
+                ok = assetPack.readChunk(entry, c, chunk.data()) &&
+                     memcmp(chunk.data(), data.data() + size_t(c) * PACK_CHUNK_SIZE,
+                            assetPack.chunkSize(entry, c)) == 0;
+            }
+        }
+
+        if (ok && loose) {
+            AssetData file = loose->open(name.c_str());
+            ok = file.valid() && file.size() == data.size() &&
+                 memcmp(file.data(), data.data(), data.size()) == 0;
+        }
+
+        if (!ok) {
+            fprintf(stderr, "FAILED %s\n", name.c_str());
+            failures++;
+        }
+    }
+    if (assetPack.find("does/not/exist") != nullptr) {
+        fprintf(stderr, "FAILED lookup of a missing path\n");
+        failures++;
+    }
+    printf("%zu entries, %d failures\n", assetPack.entryCount(), failures);
+    return failures == 0 ? 0 : 1;
+}
+
+struct BenchResult {
+    double openMicros = 0;    // average time to get the first byte of an asset
+    double megabytesPerSecond = 0;
+};
+
+template<typename OpenFn>
+static BenchResult benchOpen(const std::vector<std::string> &paths, int iterations, OpenFn open) {
+    BenchResult result;
+    uint64_t bytes = 0;
+    double openSeconds = 0;
+    double totalSeconds = 0;
+    volatile uint8_t sink = 0;
+    for (int i = 0; i < iterations; i++) {
+        for (const auto &path: paths) {
+            auto start = Clock::now();
+            AssetData data = open(path.c_str());
+            auto opened = Clock::now();
+            // Touch every page so lazily mapped data is actually read
+            for (size_t offset = 0; offset < data.size(); offset += 4096) {
+                sink = sink + data.data()[offset];
+            }
+            auto end = Clock::now();
+            openSeconds += std::chrono::duration<double>(opened - start).count();
+            totalSeconds += std::chrono::duration<double>(end - start).count();
+            bytes += data.size();
+        }
+    }
+    size_t opens = paths.size() * iterations;
+    result.openMicros = opens > 0 ? openSeconds * 1e6 / opens : 0;
+    result.megabytesPerSecond = totalSeconds > 0 ? bytes / totalSeconds / 1e6 : 0;
+    return result;
+}
+
+static int bench(int argc, char **argv) {
+    if (argc < 4) {
+        return 2;
+    }
+    auto assetPack = std::make_shared<AssetPack>();
+    if (!openPack(argv[2], *assetPack)) {
+        return 1;
+    }
+    int iterations = argc >= 5 ? std::max(1, atoi(argv[4])) : 20;
+
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < assetPack->entryCount(); i++) {
+        paths.push_back(assetPack->entryName(assetPack->entry(i)));
+    }
+
+    ThreadPool pool;
+    PackAssetSource packSource(assetPack, &pool);
+    PackAssetSource packSerial(assetPack, nullptr);
+    MappedFileSource looseSource(argv[3]);
+
+    auto report = [](const char *label, const BenchResult &result) {
+        printf("%-16s open %8.2f us   read %9.1f MB/s\n", label, result.openMicros,
+               result.megabytesPerSecond);
+    };
+    report("loose (mmap)", benchOpen(paths, iterations, [&](const char *path) {
+        return looseSource.open(path);
+    }));
+    report("pack", benchOpen(paths, iterations, [&](const char *path) {
+        return packSerial.open(path);
+    }));
+    report("pack (parallel)", benchOpen(paths, iterations, [&](const char *path) {
+        return packSource.open(path);
+    }));
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int result = 2;
+    if (argc >= 2) {
+        if (strcmp(argv[1], "pack") == 0) {
+            result = pack(argc, argv);
+        } else if (strcmp(argv[1], "list") == 0) {
+            result = list(argc, argv);
+        } else if (strcmp(argv[1], "verify") == 0) {
+            result = verify(argc, argv);
+        } else if (strcmp(argv[1], "bench") == 0) {
+            result = bench(argc, argv);
+        }
+    }
+    if (result == 2) {
+        fprintf(stderr, "usage: assetpack pack <out.pak> <asset dir> [--compress none|lz4]\n"
+                        "       assetpack list <pack>\n"
+                        "       assetpack verify <pack> [asset dir]\n"
+                        "       assetpack bench <pack> <asset dir> [iterations]\n");
+    }
+    return result;
+}
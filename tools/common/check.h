@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdio.h>
+
+/*
+ * Pass/fail bookkeeping shared by the host checks under tools/. A failed check prints what was
+ * expected and the run carries on, so one run reports every failure; main() returns
+ * checkResult(), which ctest reads.
+ */
+
+inline int failures = 0;
+
+inline void check(bool condition, const char *what) {
+    if (!condition) {
+        fprintf(stderr, "FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+// Summary line and exit code
+inline int checkResult() {
+    if (failures != 0) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
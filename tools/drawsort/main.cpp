@@ -0,0 +1,156 @@
+/*
+ * Host check and benchmark of the app's draw list.
+ *
+ *   drawsort [draws] [transparent percent]
+ *
+ * Builds a random frame of 'draws' (default 100000) spread over 8 pipelines, 256 materials and
+ * 1024 meshes, a share of them (default 10%) transparent. The radix sort is checked against
+ * std::stable_sort on the same keys and the transparent layer for back-to-front order, then
+ * timed, and the binds a recording loop would emit are counted in submission and in key order.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "draw_list.h"
+
+using namespace vkt;
+using Clock = std::chrono::steady_clock;
+
+struct Draw {
+    DrawLayer layer;
+    uint32_t pipeline;
+    uint32_t material;
+    uint32_t mesh;
+    float depth;
+};
+
+static std::vector<Draw> makeFrame(size_t count, int transparentPercent) {
+    std::mt19937 random(42);
+    std::uniform_int_distribution<uint32_t> pipelines(0, 7);
+    std::uniform_int_distribution<uint32_t> materials(0, 255);
+    std::uniform_int_distribution<uint32_t> meshes(0, 1023);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::uniform_real_distribution<float> depths(0.0f, 1.0f);
+
+    std::vector<Draw> draws(count);
+    for (auto &draw: draws) {
+        draw.layer = percent(random) < transparentPercent ? DrawLayer::Transparent
+                                                          : DrawLayer::Opaque;
+        draw.pipeline = pipelines(random);
+        draw.material = materials(random);
+        draw.mesh = meshes(random);
+        draw.depth = depths(random);
+    }
+    return draws;
+}
+
+static void build(DrawList &list, const std::vector<Draw> &draws) {
+    list.clear();
+    for (uint32_t i = 0; i < draws.size(); i++) {
+        const Draw &draw = draws[i];
+        list.add(draw.layer, draw.pipeline, draw.material, draw.mesh, draw.depth, i);
+    }
+}
+
+template<typename Order>
+static DrawBinds countBinds(const std::vector<Draw> &draws, Order order) {
+    DrawBinds binds;
+    for (size_t i = 0; i < draws.size(); i++) {
+        const Draw &draw = draws[order(i)];
+        binds.pipeline(draw.pipeline);
+        binds.material(draw.material);
+        binds.mesh(draw.mesh);
+    }
+    return binds;
+}
+
+static double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+int main(int argc, char **argv) {
+    size_t count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+    int transparentPercent = argc > 2 ? atoi(argv[2]) : 10;
+    std::vector<Draw> draws = makeFrame(count, transparentPercent);
+
+    DrawList list;
+    list.reserve(count);
+    build(list, draws);
+    std::vector<DrawItem> expected(list.begin(), list.end());
+    std::stable_sort(expected.begin(), expected.end(),
+                     [](const DrawItem &a, const DrawItem &b) { return a.key < b.key; });
+    list.sort();
+
+    bool ok = true;
+    for (size_t i = 0; i < count; i++) {
+        if (list[i].key != expected[i].key || list[i].index != expected[i].index) {
+            fprintf(stderr, "radix sort differs from std::stable_sort at %zu\n", i);
+            ok = false;
+            break;
+        }
+    }
+    float lastDepth = 2.0f;
+    bool opaqueDone = false;
+    for (const DrawItem &item: list) {
+        const Draw &draw = draws[item.index];
+        if (draw.layer == DrawLayer::Opaque) {
+            if (opaqueDone) {
+                fprintf(stderr, "opaque draw after the transparent layer\n");
+                ok = false;
+                break;
+            }
+            continue;
+        }
+        opaqueDone = true;
+        // Keys quantize depth, allow for draws that landed in the same step
+        if (draw.depth > lastDepth + 1.0f / (1 << DRAW_KEY_DEPTH_BITS)) {
+            fprintf(stderr, "transparent draws not back to front\n");
+            ok = false;
+            break;
+        }
+        lastDepth = draw.depth;
+    }
+
+    const int runs = 21;
+    std::vector<double> buildMs, radixMs, stdMs;
+    for (int run = 0; run < runs; run++) {
+        auto start = Clock::now();
+        build(list, draws);
+        auto built = Clock::now();
+        list.sort();
+        auto sorted = Clock::now();
+        buildMs.push_back(std::chrono::duration<double, std::milli>(built - start).count());
+        radixMs.push_back(std::chrono::duration<double, std::milli>(sorted - built).count());
+
+        std::vector<DrawItem> items(expected.size());
+        build(list, draws);
+        std::copy(list.begin(), list.end(), items.begin());
+        start = Clock::now();
+        std::sort(items.begin(), items.end(),
+                  [](const DrawItem &a, const DrawItem &b) { return a.key < b.key; });
+        stdMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+    list.sort();
+
+    DrawBinds unsorted = countBinds(draws, [](size_t i) { return i; });
+    DrawBinds keyed = countBinds(draws, [&list](size_t i) { return list[i].index; });
+
+    printf("%zu draws, %d%% transparent\n", count, transparentPercent);
+    printf("keys %.3f ms, radix sort %.3f ms (%u byte passes), std::sort %.3f ms\n",
+           median(buildMs), median(radixMs), list.sortPasses, median(stdMs));
+    printf("%-12s %10s %10s %10s %10s\n", "order", "pipeline", "material", "mesh", "skipped");
+    printf("%-12s %10llu %10llu %10llu %10llu\n", "submission",
+           (unsigned long long) unsorted.pipelineBinds, (unsigned long long) unsorted.materialBinds,
+           (unsigned long long) unsorted.meshBinds, (unsigned long long) unsorted.skipped);
+    printf("%-12s %10llu %10llu %10llu %10llu\n", "sort key",
+           (unsigned long long) keyed.pipelineBinds, (unsigned long long) keyed.materialBinds,
+           (unsigned long long) keyed.meshBinds, (unsigned long long) keyed.skipped);
+    printf("%s\n", ok ? "checks passed" : "checks FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+/*
+ * Host check of the app's dynamic resolution controller.
+ *
+ * A simulated GPU takes a fixed cost plus a load proportional to the rendered area, with some
+ * noise, and reports each frame's time FRAMES_IN_FLIGHT frames late like the timestamp queries
+ * do. The load goes light, heavy, too heavy for even the lowest scale, and light again. Checks
+ * that the controller settles at the target within a second of each change, gets back to full
+ * resolution when it can, stays inside the scale bounds and doesn't keep changing the scale
+ * (every change re-records the command buffers).
+ */
+#include <stdio.h>
+
+#include <cmath>
+#include <deque>
+#include <random>
+
+#include "check.h"
+#include "resolution_scale.h"
+
+using namespace vkt;
+
+const double TARGET_MS = 14.0;       // 60 Hz with some headroom, as the app sets it
+const double FIXED_MS = 1.0;         // blit, clears: doesn't scale
+const int FRAMES_IN_FLIGHT = 2;
+const int FPS = 60;
+
+struct Phase {
+    const char *name;
+    double fullResolutionLoadMs;  // GPU time of the scaled work at scale 1
+    int frames;
+};
+
+int main() {
+    const Phase phases[] = {
+            {"light",      10.0, 2 * FPS},
+            {"heavy",      22.0, 4 * FPS},
+            {"too heavy",  60.0, 2 * FPS},
+            {"light",      10.0, 3 * FPS},
+    };
+
+    ResolutionController controller;
+    controller.setTargetMs(TARGET_MS);
+    std::mt19937 random(1);
+    std::normal_distribution<double> noise(1.0, 0.04);
+    std::deque<double> inFlight;
+
+    uint64_t changesBefore = 0;
+    for (const Phase &phase : phases) {
+        double settledTotal = 0;
+        int settledFrames = 0;
+        float settledMin = MAX_RESOLUTION_SCALE;
+        float settledMax = MIN_RESOLUTION_SCALE;
+        for (int frame = 0; frame < phase.frames; frame++) {
+            float scale = controller.scale();
+            check(scale >= MIN_RESOLUTION_SCALE && scale <= MAX_RESOLUTION_SCALE,
+                  "scale inside its bounds");
+            double gpuMs = (FIXED_MS + phase.fullResolutionLoadMs * scale * scale) * noise(random);
+            inFlight.push_back(gpuMs);
+            if (inFlight.size() > FRAMES_IN_FLIGHT) {
+                controller.update(inFlight.front());
+                inFlight.pop_front();
+            }
+            if (frame >= FPS) {  // a second to settle
+                settledTotal += gpuMs;
+                settledFrames++;
+                settledMin = std::min(settledMin, scale);
+                settledMax = std::max(settledMax, scale);
+            }
+        }
+        double settledMs = settledTotal / settledFrames;
+        uint64_t changes = controller.stats().changes - changesBefore;
+        changesBefore = controller.stats().changes;
+        printf("%-10s load %5.1f ms: settled at scale %.2f-%.2f, GPU %5.2f ms (target %.1f), "
+               "%llu scale changes\n", phase.name, phase.fullResolutionLoadMs, settledMin,
+               settledMax, settledMs, TARGET_MS, (unsigned long long) changes);
+
+        double fullMs = FIXED_MS + phase.fullResolutionLoadMs;
+        double lowestMs = FIXED_MS + phase.fullResolutionLoadMs * MIN_RESOLUTION_SCALE *
+                                     MIN_RESOLUTION_SCALE;
+        if (fullMs <= TARGET_MS) {
+            check(settledMin == MAX_RESOLUTION_SCALE, "full resolution when it fits");
+        } else if (lowestMs >= TARGET_MS) {
+            check(settledMax == MIN_RESOLUTION_SCALE, "lowest scale when nothing fits");
+        } else {
+            check(std::fabs(settledMs - TARGET_MS) < TARGET_MS * 0.1,
+                  "GPU time held at the target");
+            check(settledMax - settledMin <= RESOLUTION_SCALE_STEP * 2 + 1e-4f,
+                  "settled scale steady");
+        }
+        check(changes <= 20, "few scale changes per load change");
+    }
+    printf("%llu samples, %llu scale changes, lowest scale %.2f\n",
+           (unsigned long long) controller.stats().samples,
+           (unsigned long long) controller.stats().changes, controller.stats().lowestScale);
+
+    check(scaledSize(1080, 0.5f) == 540 && scaledSize(1, 0.5f) == 1, "scaled sizes");
+
+    return checkResult();
+}
@@ -0,0 +1,171 @@
+/*
+ * Host check of the per-frame arena.
+ *
+ *   framearena [draws] [frames]
+ *
+ * Runs the app's draw recording path (draw records, sort keys, per draw descriptor sets) for
+ * 'frames' frames (default 1000) of 'draws' draws (default 256) over three frame slots, counting
+ * every operator new. Once as the render loop used to do it with std::vector, once with the
+ * app's own code from draw_record.h on the slot arenas. After the warm-up frames the arena
+ * version must not allocate.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <vector>
+
+#include "check.h"
+#include "draw_list.h"
+#include "draw_record.h"
+#include "frame_arena.h"
+
+using namespace vkt;
+using Clock = std::chrono::steady_clock;
+
+static std::atomic<uint64_t> allocations{0};
+
+void *operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { free(p); }
+
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+void *operator new[](size_t size) { return operator new(size); }
+
+void operator delete[](void *p) noexcept { free(p); }
+
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+// The app's DrawObject, with descriptor set handles as integers
+using DrawObject = DrawRecord<uint64_t>;
+
+static const uint32_t FRAME_SLOTS = 3;
+static const uint32_t WARMUP_FRAMES = 2 * FRAME_SLOTS;
+
+static DrawObject makeDraw(uint32_t frame, uint32_t i) {
+    DrawObject object{};
+    object.indexCount = 36;
+    object.descriptorSet = i;
+    if (i % 4 == 0) {
+        object.textureDescriptorSet = 1000 + i;
+    }
+    object.features = i % 3;
+    object.mesh = i % 16;
+    object.material = i % 32;
+    object.layer = DrawLayer::Opaque;
+    object.depth = float((i * 7919 + frame) % 1000) / 1000.0f;
+    return object;
+}
+
+// What the draw loop consumes, so the work is not optimized away
+static uint64_t consume(uint64_t sum, const uint64_t *sets, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        sum = sum * 31 + sets[i];
+    }
+    return sum;
+}
+
+static uint64_t recordHeap(DrawList &list, uint32_t frame, uint32_t draws) {
+    std::vector<DrawObject> drawObjects;
+    for (uint32_t i = 0; i < draws; i++) {
+        drawObjects.push_back(makeDraw(frame, i));
+    }
+    sortDraws(drawObjects, list);
+    uint64_t sum = 0;
+    for (const DrawItem &item: list) {
+        const DrawObject &object = drawObjects[item.index];
+        std::vector<uint64_t> descriptorSets = {object.descriptorSet};
+        if (object.textureDescriptorSet) {
+            descriptorSets.push_back(*object.textureDescriptorSet);
+        }
+        sum = consume(sum, descriptorSets.data(), descriptorSets.size());
+    }
+    return sum;
+}
+
+static uint64_t recordArena(DrawList &list, FrameArena &arena, uint32_t frame, uint32_t draws) {
+    FrameVector<DrawObject> drawObjects{ArenaAllocator<DrawObject>(arena)};
+    drawObjects.reserve(draws);
+    for (uint32_t i = 0; i < draws; i++) {
+        drawObjects.push_back(makeDraw(frame, i));
+    }
+    sortDraws(drawObjects, list);
+    uint64_t sum = 0;
+    for (const DrawItem &item: list) {
+        uint64_t descriptorSets[2];
+        uint32_t setCount = drawObjects[item.index].descriptorSets(descriptorSets);
+        sum = consume(sum, descriptorSets, setCount);
+    }
+    return sum;
+}
+
+struct Result {
+    uint64_t steadyAllocations = 0;
+    double frameUs = 0;
+    uint64_t checksum = 0;
+};
+
+template<typename Record>
+static Result run(uint32_t frames, Record record) {
+    Result result;
+    auto start = Clock::now();
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        if (frame == WARMUP_FRAMES) {
+            allocations = 0;
+            start = Clock::now();
+        }
+        result.checksum ^= record(frame, frame % FRAME_SLOTS);
+    }
+    result.steadyAllocations = allocations.load();
+    result.frameUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() /
+                     (frames - WARMUP_FRAMES);
+    return result;
+}
+
+int main(int argc, char **argv) {
+    uint32_t draws = argc > 1 ? strtoul(argv[1], nullptr, 10) : 256;
+    uint32_t frames = argc > 2 ? strtoul(argv[2], nullptr, 10) : 1000;
+    if (frames <= WARMUP_FRAMES) {
+        frames = WARMUP_FRAMES + 1;
+    }
+
+    DrawList heapList;
+    Result heap = run(frames, [&](uint32_t frame, uint32_t) {
+        return recordHeap(heapList, frame, draws);
+    });
+
+    // A small first block, so the warm-up frames exercise the heap fallback and regrowth
+    DrawList arenaList;
+    std::array<FrameArena, FRAME_SLOTS> arenas{FrameArena(1024), FrameArena(1024),
+                                               FrameArena(1024)};
+    Result arena = run(frames, [&](uint32_t frame, uint32_t slot) {
+        arenas[slot].reset();
+        return recordArena(arenaList, arenas[slot], frame, draws);
+    });
+
+    uint64_t steadyFrames = frames - WARMUP_FRAMES;
+    printf("%u draws, %llu steady frames\n", draws, (unsigned long long) steadyFrames);
+    printf("%-12s %16s %10s\n", "frame path", "allocs/frame", "us/frame");
+    printf("%-12s %16.1f %10.2f\n", "std::vector", double(heap.steadyAllocations) / steadyFrames,
+           heap.frameUs);
+    printf("%-12s %16.1f %10.2f\n", "FrameArena", double(arena.steadyAllocations) / steadyFrames,
+           arena.frameUs);
+    printf("arena block %zu bytes, peak %zu bytes, %llu heap fallbacks during warm-up\n",
+           arenas[0].capacity(), arenas[0].highWater(),
+           (unsigned long long) (arenas[0].overflowAllocations + arenas[1].overflowAllocations +
+                                 arenas[2].overflowAllocations));
+
+    check(arena.steadyAllocations == 0, "steady state frames don't allocate");
+    check(arena.checksum == heap.checksum, "arena and heap frame paths agree");
+    return checkResult();
+}
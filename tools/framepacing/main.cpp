@@ -0,0 +1,193 @@
+/*
+ * Host check of the frame pacer, driven the way the render loop drives it: beginFrame(), then the
+ * wait on the frame slot's fence, recording, submit. The GPU and the display are simulated: frames
+ * run on the GPU one after another, each slot's fence signals when its frame is done, and a done
+ * frame is shown at the next vsync.
+ *
+ * Checks that in steady state the pacer sleeps instead of blocking in the fence and puts one frame
+ * on every vsync, that after a stall it restarts the schedule rather than bursting to catch up,
+ * that restartSchedule() doesn't count the stall as a miss, that with a GPU slower than the
+ * display the fence wait moves the schedule to the GPU's rate, and that a 0 interval never sleeps.
+ */
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "check.h"
+#include "frame_pacer.h"
+
+using namespace vkt;
+using namespace std::chrono_literals;
+
+using Duration = FramePacer::Duration;
+using TimePoint = FramePacer::TimePoint;
+
+const Duration REFRESH_PERIOD = 16666667ns;  // 60 Hz
+const uint32_t FRAMES_IN_FLIGHT = 2;
+
+struct Frame {
+    Duration sleep{0};      // beginFrame() start minus 'now'
+    Duration fenceWait{0};  // blocked in the slot's fence
+    TimePoint start{};
+    int64_t vsync = 0;      // index of the vsync the frame is shown at
+};
+
+class Simulation {
+public:
+    Simulation(Duration cpuTime, Duration gpuTime)
+            : cpuTime(cpuTime), gpuTime(gpuTime), fences(FRAMES_IN_FLIGHT) {}
+
+    Frame step(FramePacer &pacer) {
+        Frame frame;
+        frame.start = pacer.beginFrame(now);
+        frame.sleep = frame.start - now;
+        now = frame.start;
+
+        TimePoint &fence = fences[slot];
+        frame.fenceWait = std::max(fence - now, Duration(0));
+        now += frame.fenceWait;
+        pacer.reportFenceWait(frame.fenceWait);
+
+        now += cpuTime;  // record and submit
+        gpuDone = std::max(now, gpuDone) + gpuTime;
+        fence = gpuDone;
+        frame.vsync = (gpuDone.time_since_epoch() + REFRESH_PERIOD - 1ns) / REFRESH_PERIOD;
+
+        slot = (slot + 1) % FRAMES_IN_FLIGHT;
+        return frame;
+    }
+
+    // The loop stands still, e.g. the app was in the background
+    void stall(Duration duration) { now += duration; }
+
+    TimePoint now{};
+
+private:
+    Duration cpuTime;
+    Duration gpuTime;
+    std::vector<TimePoint> fences;
+    TimePoint gpuDone{};
+    uint32_t slot = 0;
+};
+
+static std::vector<Frame> run(Simulation &simulation, FramePacer &pacer, int count) {
+    std::vector<Frame> frames;
+    for (int i = 0; i < count; i++) {
+        frames.push_back(simulation.step(pacer));
+    }
+    return frames;
+}
+
+static void checkSteadyState() {
+    printf("steady state\n");
+    FramePacer pacer;
+    pacer.setTargetInterval(REFRESH_PERIOD);
+    Simulation simulation(4ms, 8ms);
+    std::vector<Frame> frames = run(simulation, pacer, 120);
+
+    bool sleeps = true;
+    bool neverBlocks = true;
+    bool spaced = true;
+    bool everyVsync = true;
+    for (size_t i = 1; i < frames.size(); i++) {
+        sleeps = sleeps && frames[i].sleep == REFRESH_PERIOD - 4ms;
+        neverBlocks = neverBlocks && frames[i].fenceWait == Duration(0);
+        spaced = spaced && frames[i].start - frames[i - 1].start == REFRESH_PERIOD;
+        everyVsync = everyVsync && frames[i].vsync == frames[i - 1].vsync + 1;
+    }
+    check(sleeps, "sleeps the rest of the interval every frame");
+    check(neverBlocks, "fence already signaled when the frame starts");
+    check(spaced, "frames start one interval apart");
+    check(everyVsync, "one frame on every vsync");
+    check(pacer.pacedFrames == 120, "every frame paced");
+    check(pacer.missedFrames == 0, "no missed frames");
+    check(pacer.totalSleep == 119 * (REFRESH_PERIOD - 4ms), "sleep is accounted");
+}
+
+static void checkStall(bool restart) {
+    printf(restart ? "stall after restartSchedule\n" : "stall\n");
+    FramePacer pacer;
+    pacer.setTargetInterval(REFRESH_PERIOD);
+    Simulation simulation(4ms, 8ms);
+    run(simulation, pacer, 30);
+
+    simulation.stall(100ms);
+    if (restart) {
+        pacer.restartSchedule();
+    }
+    TimePoint resumed = simulation.now;
+    std::vector<Frame> frames = run(simulation, pacer, 30);
+
+    check(pacer.missedFrames == (restart ? 0u : 1u),
+          restart ? "restarted schedule is not a miss" : "stall counted as one miss");
+    check(pacer.pacedFrames == 60, "frames after the stall are still paced");
+    check(frames[0].start == resumed && frames[0].sleep == Duration(0),
+          "first frame after the stall starts at once");
+    // No burst of short frames to make up for the lost time
+    bool spaced = true;
+    for (size_t i = 1; i < frames.size(); i++) {
+        spaced = spaced && frames[i].start - frames[i - 1].start == REFRESH_PERIOD;
+    }
+    check(spaced, "schedule restarts from the late frame");
+}
+
+static void checkGpuBound() {
+    printf("gpu bound\n");
+    // The GPU takes longer than a refresh, so the frame rate is the GPU's. Each fence wait moves
+    // the next start by half of it: the schedule settles where that makes up the difference
+    // between the interval and the GPU time, at a wait of twice the difference.
+    const Duration gpuTime = 20ms;
+    FramePacer pacer;
+    pacer.setTargetInterval(REFRESH_PERIOD);
+    Simulation simulation(4ms, gpuTime);
+    std::vector<Frame> frames = run(simulation, pacer, 600);
+
+    const Duration tolerance = REFRESH_PERIOD / 32;
+    const Duration settledWait = 2 * (gpuTime - REFRESH_PERIOD);
+    bool settled = true;
+    bool gpuRate = true;
+    for (size_t i = frames.size() - 60; i < frames.size(); i++) {
+        Duration period = frames[i].start - frames[i - 1].start;
+        settled = settled && frames[i].fenceWait >= settledWait - tolerance &&
+                  frames[i].fenceWait <= settledWait + tolerance;
+        gpuRate = gpuRate && period >= gpuTime - tolerance && period <= gpuTime + tolerance;
+    }
+    printf("  fence wait %.3f ms/frame\n",
+           std::chrono::duration<double, std::milli>(frames.back().fenceWait).count());
+    check(settled, "fence wait settles at twice the GPU's overrun");
+    check(gpuRate, "frames start at the GPU's rate");
+    check(pacer.missedFrames == 0, "a slow GPU is not a missed frame");
+}
+
+static void checkUnpaced() {
+    printf("unpaced\n");
+    FramePacer pacer;
+    pacer.setTargetInterval(0ns);
+    Simulation simulation(4ms, 8ms);
+    std::vector<Frame> frames = run(simulation, pacer, 30);
+
+    bool noSleep = true;
+    for (const Frame &frame : frames) {
+        noSleep = noSleep && frame.sleep == Duration(0);
+    }
+    check(noSleep, "0 interval never sleeps");
+    check(pacer.pacedFrames == 0 && pacer.totalSleep == Duration(0), "nothing counted");
+
+    // Switching pacing on later starts a fresh schedule
+    pacer.setTargetInterval(REFRESH_PERIOD);
+    frames = run(simulation, pacer, 2);
+    check(frames[0].sleep == Duration(0) && pacer.missedFrames == 0,
+          "first paced frame starts at once");
+    check(frames[1].start - frames[0].start >= REFRESH_PERIOD, "then at least one interval apart");
+}
+
+int main() {
+    checkSteadyState();
+    checkStall(false);
+    checkStall(true);
+    checkGpuBound();
+    checkUnpaced();
+    return checkResult();
+}
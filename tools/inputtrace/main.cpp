@@ -0,0 +1,190 @@
+/*
+ * Host replay of touch input traces through the app's camera input pipeline.
+ *
+ * Without arguments, synthesizes a session (a one finger drag, then a pinch), checks that the
+ * trace format reads back what it wrote and that the gestures move the camera as far as they
+ * should. Then replays it against a simulated 60 fps render thread twice, latching the input at
+ * the start of the frame and late, just before submit, and reports input-to-submit and
+ * input-to-present latency for both.
+ *
+ * With a path, replays an input.trace recorded on the device (RECORD_INPUT_TRACE in vk_main.cpp).
+ */
+#include <stdio.h>
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+#include "camera_input.h"
+#include "check.h"
+
+using namespace vkt;
+
+const int64_t MS = 1000000;
+const int64_t FRAME_NS = 16666667;
+const int64_t SUBMIT_OFFSET_NS = 12 * MS;   // CPU work of a frame before vkQueueSubmit
+const int64_t PRESENT_OFFSET_NS = 14 * MS;  // and before vkQueuePresentKHR returns
+const float VIEW_WIDTH = 1080.0f;
+
+static TouchEvent touch(int64_t timeNs, TouchAction action, uint32_t pointerCount,
+                        float x0, float y0, float x1 = 0.0f, float y1 = 0.0f) {
+    TouchEvent event;
+    event.timeNs = timeNs;
+    event.action = action;
+    event.pointerCount = pointerCount;
+    event.x[0] = x0;
+    event.y[0] = y0;
+    event.x[1] = x1;
+    event.y[1] = y1;
+    return event;
+}
+
+// 540 px to the left in 300 ms, then two fingers spreading from 200 to 400 px apart, touch
+// sampled at 120 Hz with an odd offset so events don't line up with frames
+static std::vector<TouchEvent> syntheticSession(int64_t start) {
+    const int64_t step = 8333333;
+    std::vector<TouchEvent> events;
+    int64_t time = start + 3 * MS;
+    events.push_back(touch(time, TouchAction::Down, 1, 800.0f, 1000.0f));
+    for (int i = 1; i <= 36; i++) {
+        events.push_back(touch(time + i * step, TouchAction::Move, 1, 800.0f - 15.0f * i, 1000.0f));
+    }
+    time += 40 * step;
+    events.push_back(touch(time, TouchAction::Up, 0, 0.0f, 0.0f));
+
+    time += 20 * step;
+    events.push_back(touch(time, TouchAction::Down, 1, 440.0f, 1200.0f));
+    events.push_back(touch(time + step, TouchAction::Down, 2, 440.0f, 1200.0f, 640.0f, 1200.0f));
+    for (int i = 1; i <= 36; i++) {
+        float half = 100.0f + 100.0f * i / 36.0f;
+        events.push_back(touch(time + (i + 1) * step, TouchAction::Move, 2, 540.0f - half, 1200.0f,
+                               540.0f + half, 1200.0f));
+    }
+    events.push_back(touch(time + 40 * step, TouchAction::Down, 1, 640.0f, 1200.0f));
+    events.push_back(touch(time + 41 * step, TouchAction::Up, 0, 0.0f, 0.0f));
+    return events;
+}
+
+struct Replay {
+    OrbitCamera camera;
+    LatencyStats toSubmit;
+    LatencyStats toPresent;
+    uint64_t commands = 0;
+};
+
+/*
+ * The event loop hands each event over at its event time; the render thread starts a frame every
+ * FRAME_NS and latches what was handed over 'latchOffset' into the frame.
+ */
+static Replay replay(const std::vector<TouchEvent> &events, int64_t latchOffset) {
+    Replay result;
+    result.camera = OrbitCamera::lookingAt(glm::vec3(2.0f, 2.0f, 6.0f), glm::vec3(0.0f));
+    if (events.empty()) {
+        return result;
+    }
+    TouchGestures gestures;
+    gestures.setViewWidth(VIEW_WIDTH);
+    CameraInput input;
+    std::vector<CameraCommand> pushed;
+    std::vector<CameraCommand> latched;
+
+    size_t next = 0;
+    int64_t end = events.back().timeNs + 4 * FRAME_NS;
+    for (int64_t frame = events.front().timeNs - events.front().timeNs % FRAME_NS; frame < end;
+         frame += FRAME_NS) {
+        int64_t latchTime = frame + latchOffset;
+        for (; next < events.size() && events[next].timeNs <= latchTime; next++) {
+            pushed.clear();
+            gestures.process(events[next], pushed);
+            input.push(pushed);
+        }
+        int64_t frameInputTime = input.latch(latched);
+        for (const CameraCommand &command : latched) {
+            result.camera.apply(command);
+        }
+        result.commands += latched.size();
+        if (frameInputTime != 0) {
+            result.toSubmit.add(frameInputTime, frame + SUBMIT_OFFSET_NS);
+            result.toPresent.add(frameInputTime, frame + PRESENT_OFFSET_NS);
+        }
+    }
+    return result;
+}
+
+static void print(const char *name, const Replay &result) {
+    printf("%-26s %3llu frames with input, to submit %5.2f ms (max %5.2f), "
+           "to present %5.2f ms (max %5.2f)\n", name,
+           (unsigned long long) result.toSubmit.frames, result.toSubmit.averageMs(),
+           result.toSubmit.maxMs, result.toPresent.averageMs(), result.toPresent.maxMs);
+}
+
+static int replayFile(const char *path) {
+    std::ifstream file(path);
+    if (!file) {
+        fprintf(stderr, "can't read %s\n", path);
+        return 1;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+    std::vector<TouchEvent> events;
+    if (!parseInputTrace(text.str(), events)) {
+        fprintf(stderr, "%s: malformed line after %zu events\n", path, events.size());
+        return 1;
+    }
+    Replay late = replay(events, SUBMIT_OFFSET_NS - MS);
+    printf("%s: %zu events, %llu camera commands, camera ends at yaw %.2f pitch %.2f "
+           "distance %.2f\n", path, events.size(), (unsigned long long) late.commands,
+           late.camera.yaw, late.camera.pitch, late.camera.distance);
+    print("latched at frame start", replay(events, 0));
+    print("latched before submit", late);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        return replayFile(argv[1]);
+    }
+
+    std::vector<TouchEvent> events = syntheticSession(1000 * FRAME_NS);
+    std::string text = formatInputTrace(events);
+    std::vector<TouchEvent> parsed;
+    check(parseInputTrace(text, parsed), "trace parses");
+    bool same = parsed.size() == events.size();
+    for (size_t i = 0; same && i < events.size(); i++) {
+        same = parsed[i].timeNs == events[i].timeNs && parsed[i].action == events[i].action &&
+               parsed[i].pointerCount == events[i].pointerCount;
+        for (uint32_t p = 0; same && p < events[i].pointerCount; p++) {
+            same = std::fabs(parsed[i].x[p] - events[i].x[p]) < 0.01f &&
+                   std::fabs(parsed[i].y[p] - events[i].y[p]) < 0.01f;
+        }
+    }
+    check(same, "trace reads back what was written");
+    std::vector<TouchEvent> broken;
+    check(!parseInputTrace("1 M 1 2\n", broken), "truncated line rejected");
+    check(!parseInputTrace("1 X 0\n", broken), "unknown action rejected");
+
+    Replay early = replay(parsed, 0);
+    Replay late = replay(parsed, SUBMIT_OFFSET_NS - MS);
+    printf("%zu events, %zu trace bytes, %llu camera commands\n", parsed.size(), text.size(),
+           (unsigned long long) late.commands);
+    print("latched at frame start", early);
+    print("latched before submit", late);
+
+    OrbitCamera start = OrbitCamera::lookingAt(glm::vec3(2.0f, 2.0f, 6.0f), glm::vec3(0.0f));
+    // Dragged left by half the view width: a quarter turn
+    float expectedYaw = std::remainder(start.yaw + 3.14159265f / 2.0f, 2.0f * 3.14159265f);
+    check(std::fabs(late.camera.yaw - expectedYaw) < 1e-3f, "drag orbits a quarter turn");
+    check(std::fabs(late.camera.pitch - start.pitch) < 1e-4f, "horizontal drag keeps the pitch");
+    check(std::fabs(late.camera.distance - start.distance / 2.0f) < 1e-3f,
+          "pinching to twice the span halves the distance");
+    check(std::fabs(early.camera.yaw - late.camera.yaw) < 1e-5f &&
+          std::fabs(early.camera.distance - late.camera.distance) < 1e-5f,
+          "latch time changes latency, not where the camera ends up");
+    check(late.toSubmit.averageMs() < early.toSubmit.averageMs(),
+          "late latch lowers input-to-submit latency");
+    // The oldest input a frame takes came in after the previous frame's latch
+    check(late.toSubmit.maxMs <= (FRAME_NS + MS) / 1e6 + 0.01,
+          "late latch takes input at most a frame old");
+
+    return checkResult();
+}
@@ -0,0 +1,153 @@
+/*
+ * Host check of the app's lifecycle state machine.
+ *
+ * Plays the command sequences Android sends (launch, background, foreground, a window replaced
+ * without being terminated, destroy from either state, a repeated APP_CMD_START) against a mock
+ * renderer that fails on any call its current state doesn't allow, such as a second full init
+ * or a surface built twice, and checks what was created and destroyed and the resume latency.
+ */
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "lifecycle.h"
+
+using namespace vkt;
+using namespace std::chrono_literals;
+
+// Never dereferenced, only compared
+static ANativeWindow *mockWindow(int id) {
+    static char windows[8];
+    return reinterpret_cast<ANativeWindow *>(&windows[id]);
+}
+
+class MockRenderer : public LifecycleHost {
+public:
+    void createDevice(ANativeWindow *newWindow) override {
+        expect(!device, "createDevice with a device alive");
+        device = true;
+        window = newWindow;
+        calls.push_back("createDevice");
+    }
+
+    void attachSurface(ANativeWindow *newWindow) override {
+        expect(device, "attachSurface without a device");
+        expect(window == nullptr, "attachSurface with a surface alive");
+        window = newWindow;
+        calls.push_back("attachSurface");
+    }
+
+    void detachSurface() override {
+        expect(window != nullptr, "detachSurface without a surface");
+        window = nullptr;
+        calls.push_back("detachSurface");
+    }
+
+    void destroyDevice() override {
+        expect(device, "destroyDevice without a device");
+        expect(window == nullptr, "destroyDevice with a surface alive");
+        device = false;
+        calls.push_back("destroyDevice");
+    }
+
+    std::string takeCalls() {
+        std::string joined;
+        for (const auto &call: calls) {
+            joined += (joined.empty() ? "" : " ") + call;
+        }
+        calls.clear();
+        return joined;
+    }
+
+    bool device = false;
+    ANativeWindow *window = nullptr;
+    int failures = 0;
+
+private:
+    void expect(bool condition, const char *message) {
+        if (!condition) {
+            fprintf(stderr, "renderer: %s\n", message);
+            failures++;
+        }
+    }
+
+    std::vector<std::string> calls;
+};
+
+static void checkCalls(MockRenderer &renderer, const char *expected, const char *step) {
+    std::string calls = renderer.takeCalls();
+    if (calls != expected) {
+        fprintf(stderr, "FAILED: %s: expected [%s], got [%s]\n", step, expected, calls.c_str());
+        failures++;
+    }
+}
+
+int main() {
+    MockRenderer renderer;
+    Lifecycle lifecycle(renderer);
+    Lifecycle::Clock::time_point t0{};
+
+    // Launch: START then INIT_WINDOW, START alone never initializes anything
+    lifecycle.onStart();
+    lifecycle.onStart();
+    checkCalls(renderer, "", "START without a window");
+    check(!lifecycle.canRender(), "no rendering before the window");
+    lifecycle.onWindowCreated(mockWindow(0), t0);
+    checkCalls(renderer, "createDevice", "first window");
+    check(lifecycle.canRender(), "rendering after the first window");
+    check(lifecycle.framePresented(t0 + 120ms), "first frame measured");
+    check(!lifecycle.framePresented(t0 + 140ms), "second frame not measured");
+    check(lifecycle.stats().lastWasColdStart && lifecycle.stats().coldStartMs == 120.0,
+          "cold start latency");
+
+    // Background: TERM_WINDOW then STOP, the device stays
+    lifecycle.onWindowDestroyed();
+    lifecycle.onStop();
+    checkCalls(renderer, "detachSurface", "background");
+    check(renderer.device, "device alive in the background");
+    check(!lifecycle.canRender(), "no rendering in the background");
+    lifecycle.onWindowDestroyed();
+    checkCalls(renderer, "", "second TERM_WINDOW");
+    lifecycle.onWindowCreated(nullptr, t0);
+    checkCalls(renderer, "", "INIT_WINDOW without a window");
+
+    // Foreground: START then INIT_WINDOW, only the surface level comes back
+    lifecycle.onStart();
+    checkCalls(renderer, "", "START in the background");
+    lifecycle.onWindowCreated(mockWindow(1), t0 + 1s);
+    checkCalls(renderer, "attachSurface", "foreground");
+    check(renderer.window == mockWindow(1), "new window attached");
+    check(lifecycle.framePresented(t0 + 1s + 16ms), "resume frame measured");
+    check(!lifecycle.stats().lastWasColdStart && lifecycle.stats().lastResumeMs == 16.0,
+          "resume latency");
+
+    // A window replaced without TERM_WINDOW in between
+    lifecycle.onWindowCreated(mockWindow(2), t0 + 2s);
+    checkCalls(renderer, "detachSurface attachSurface", "window replaced");
+
+    // Surface lost and never shown again before the window being destroyed
+    lifecycle.onWindowDestroyed();
+    lifecycle.onStop();
+    check(!lifecycle.framePresented(t0 + 3s), "no frame measured for a lost window");
+    lifecycle.onDestroy();
+    checkCalls(renderer, "detachSurface destroyDevice", "destroy in the background");
+    check(lifecycle.state() == LifecycleState::NoDevice, "no device after destroy");
+
+    // Same process brought up again, then destroyed while showing
+    lifecycle.onStart();
+    lifecycle.onWindowCreated(mockWindow(3), t0 + 4s);
+    checkCalls(renderer, "createDevice", "second launch");
+    lifecycle.onDestroy();
+    checkCalls(renderer, "detachSurface destroyDevice", "destroy while showing");
+    lifecycle.onDestroy();
+    checkCalls(renderer, "", "second destroy");
+
+    const Lifecycle::Stats &stats = lifecycle.stats();
+    check(stats.deviceCreates == 2 && stats.surfaceAttaches == 2 && stats.surfaceDetaches == 4,
+          "counters");
+
+    failures += renderer.failures;
+    return checkResult();
+}
@@ -0,0 +1,245 @@
+/*
+ * Host checks and benchmark of the app's clustered light culling.
+ *
+ *   lightcull [repetitions]
+ *
+ * Random point lights fill the view frustum of a portrait phone screen, in front of a floor and
+ * a back wall. For 16, 256 and 1024 lights:
+ *
+ *  - every kernel this CPU supports bins the lights into exactly the same clusters as the scalar
+ *    reference, and the cull is timed with each (median of 'repetitions', default 50);
+ *  - at a grid of fragments on the floor and the wall, every light that reaches the fragment is
+ *    in the list of the cluster the shader picks, and shading with that list gives the same color
+ *    as shading with all the lights;
+ *  - the fragment loop of shader.frag, run on the CPU, is timed with the cluster lists and with
+ *    every light, along with the lights it evaluates per fragment. The GPU time of the real
+ *    shader is the lit variant's entry in the app's "GPU" log line.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "check.h"
+#include "light_clusters.h"
+
+using namespace vkt;
+
+const float FOV_Y = 1.134464f;          // 65 degrees, as the app
+const float ASPECT = 1080.0f / 2400.0f;
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
+const uint32_t FRAGMENTS_X = 135;       // an eighth of the screen's pixels along each axis
+const uint32_t FRAGMENTS_Y = 300;
+const float FLOOR_Y = -2.0f;
+const float WALL_Z = -35.0f;
+const glm::vec3 ATTENUATION(1.0f, 2.0f, 12.0f);
+
+struct Fragment {
+    glm::vec3 position;  // view space
+    glm::vec3 normal;
+};
+
+static std::vector<PointLight> randomLights(uint32_t count, std::mt19937 &random) {
+    std::uniform_real_distribution<float> depth(1.0f, 30.0f);
+    std::uniform_real_distribution<float> ndc(-1.1f, 1.1f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    float scaleX = 1.0f / (ASPECT * std::tan(FOV_Y / 2.0f));
+    float scaleY = 1.0f / std::tan(FOV_Y / 2.0f);
+    std::vector<PointLight> lights(count);
+    for (PointLight &light : lights) {
+        float d = depth(random);
+        float intensity = 0.5f + 1.5f * unit(random);
+        light.positionRadius = glm::vec4(ndc(random) * d / scaleX, ndc(random) * d / scaleY, -d,
+                                         lightRadius(intensity, ATTENUATION));
+        light.colorIntensity = glm::vec4(unit(random), unit(random), unit(random), intensity);
+        light.attenuation = glm::vec4(ATTENUATION, 0.0f);
+    }
+    return lights;
+}
+
+// One fragment per cell of the grid: where its ray hits the floor, or the wall behind it
+static std::vector<Fragment> sceneFragments() {
+    std::vector<Fragment> fragments;
+    float tanY = std::tan(FOV_Y / 2.0f);
+    float tanX = tanY * ASPECT;
+    for (uint32_t y = 0; y < FRAGMENTS_Y; y++) {
+        for (uint32_t x = 0; x < FRAGMENTS_X; x++) {
+            glm::vec3 ray((2.0f * (x + 0.5f) / FRAGMENTS_X - 1.0f) * tanX,
+                          (2.0f * (y + 0.5f) / FRAGMENTS_Y - 1.0f) * tanY, -1.0f);
+            float floorDistance = ray.y < 0.0f ? FLOOR_Y / ray.y : INFINITY;
+            if (floorDistance < -WALL_Z) {
+                fragments.push_back({ray * floorDistance, glm::vec3(0.0f, 1.0f, 0.0f)});
+            } else {
+                fragments.push_back({ray * -WALL_Z, glm::vec3(0.0f, 0.0f, 1.0f)});
+            }
+        }
+    }
+    return fragments;
+}
+
+// The light loop of shader.frag
+static glm::vec3 shadeLight(const Fragment &fragment, const PointLight &light) {
+    glm::vec3 toLight = glm::vec3(light.positionRadius) - fragment.position;
+    float distance = glm::length(toLight);
+    float attenuation = light.attenuation.x + light.attenuation.y * distance +
+                        light.attenuation.z * distance * distance;
+    float strength = std::max(light.colorIntensity.w / attenuation - LIGHT_CUTOFF, 0.0f);
+    float diffuse = std::max(glm::dot(fragment.normal, toLight / distance), 0.0f);
+    return glm::vec3(light.colorIntensity) * (strength * diffuse);
+}
+
+static glm::vec3 shadeClustered(const LightClusters &clusters, const std::vector<PointLight> &lights,
+                                const Fragment &fragment, uint32_t &evaluated) {
+    const ClusterCell &cell = clusters.cells()[clusters.clusterAt(fragment.position)];
+    glm::vec3 color(0.0f);
+    for (uint32_t i = 0; i < cell.count; i++) {
+        color += shadeLight(fragment, lights[clusters.indices()[cell.offset + i]]);
+    }
+    evaluated += cell.count;
+    return color;
+}
+
+static glm::vec3 shadeAll(const std::vector<PointLight> &lights, const Fragment &fragment) {
+    glm::vec3 color(0.0f);
+    for (const PointLight &light : lights) {
+        color += shadeLight(fragment, light);
+    }
+    return color;
+}
+
+static double median(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+static void checkKernels(const LightClusters &clusters, std::mt19937 &random) {
+    std::uniform_real_distribution<float> position(-20.0f, 20.0f);
+    std::uniform_real_distribution<float> radius(0.0f, 6.0f);
+    std::uniform_int_distribution<uint32_t> first(0, CLUSTER_COUNT - 32);
+    for (const LightCullKernels *kernels : supportedLightCullKernels()) {
+        bool same = true;
+        for (int i = 0; i < 20000 && same; i++) {
+            glm::vec4 sphere(position(random), position(random), -std::fabs(position(random)) * 2,
+                             radius(random));
+            uint32_t start = first(random);
+            uint32_t count = 1 + i % 32;
+            same = kernels->overlapMask(clusters.bounds(), start, count, sphere) ==
+                   scalarLightCullKernels().overlapMask(clusters.bounds(), start, count, sphere);
+        }
+        check(same, "kernel masks match the scalar reference");
+    }
+}
+
+static void run(uint32_t lightCount, int repetitions, const std::vector<Fragment> &fragments,
+                std::mt19937 &random) {
+    std::vector<PointLight> lights = randomLights(lightCount, random);
+    LightClusters clusters;
+    clusters.setProjection(FOV_Y, ASPECT, NEAR_PLANE, FAR_PLANE);
+
+    printf("%4u lights:", lightCount);
+    LightClusters reference;
+    reference.setProjection(FOV_Y, ASPECT, NEAR_PLANE, FAR_PLANE);
+    reference.cull(lights.data(), lightCount, scalarLightCullKernels());
+    for (const LightCullKernels *kernels : supportedLightCullKernels()) {
+        std::vector<double> times;
+        for (int i = 0; i < repetitions; i++) {
+            auto start = std::chrono::steady_clock::now();
+            clusters.cull(lights.data(), lightCount, *kernels);
+            times.push_back(std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start).count());
+        }
+        bool same = clusters.indices() == reference.indices();
+        for (uint32_t c = 0; same && c < CLUSTER_COUNT; c++) {
+            same = clusters.cells()[c].offset == reference.cells()[c].offset &&
+                   clusters.cells()[c].count == reference.cells()[c].count;
+        }
+        check(same, "cull output matches the scalar reference");
+        printf(" cull %s %.3f ms,", kernels->name, median(times));
+    }
+    const LightClusters::Stats &stats = clusters.stats();
+    printf(" %u visible, %u indices, %u lit clusters, max %u per cluster\n", stats.visibleLights,
+           stats.indices, stats.litClusters, stats.maxPerCluster);
+    check(stats.dropped == 0, "index list large enough");
+
+    // Every light reaching a fragment is in its cluster, and the cluster lists shade the same
+    uint32_t missing = 0;
+    uint32_t wrongColor = 0;
+    uint32_t evaluated = 0;
+    for (const Fragment &fragment : fragments) {
+        const ClusterCell &cell = clusters.cells()[clusters.clusterAt(fragment.position)];
+        for (uint32_t light = 0; light < lightCount; light++) {
+            glm::vec3 center(lights[light].positionRadius);
+            if (glm::length(center - fragment.position) >= lights[light].positionRadius.w) {
+                continue;
+            }
+            const uint32_t *begin = clusters.indices().data() + cell.offset;
+            if (std::find(begin, begin + cell.count, light) == begin + cell.count) {
+                missing++;
+            }
+        }
+        glm::vec3 clustered = shadeClustered(clusters, lights, fragment, evaluated);
+        glm::vec3 all = shadeAll(lights, fragment);
+        if (glm::length(clustered - all) > 1e-4f * std::max(1.0f, glm::length(all))) {
+            wrongColor++;
+        }
+    }
+    check(missing == 0, "every light reaching a fragment is in its cluster");
+    check(wrongColor == 0, "clustered shading matches shading with every light");
+
+    // The fragment loop, with the cluster lists and with every light
+    glm::vec3 sink(0.0f);
+    uint32_t unused = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const Fragment &fragment : fragments) {
+        sink += shadeClustered(clusters, lights, fragment, unused);
+    }
+    double clusteredNs = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start).count() / fragments.size();
+    start = std::chrono::steady_clock::now();
+    for (const Fragment &fragment : fragments) {
+        sink += shadeAll(lights, fragment);
+    }
+    double allNs = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start).count() / fragments.size();
+    printf("            shading: %.1f lights/fragment, %.1f ns/fragment clustered; "
+           "%u lights/fragment, %.1f ns/fragment with every light (%.0f)\n",
+           static_cast<double>(evaluated) / fragments.size(), clusteredNs, lightCount, allNs,
+           sink.x * 0.0);
+}
+
+int main(int argc, char **argv) {
+    int repetitions = argc > 1 ? std::max(1, atoi(argv[1])) : 50;
+    std::mt19937 random(7);
+
+    float intensity = 1.5f;
+    float radius = lightRadius(intensity, ATTENUATION);
+    float atRadius = intensity / (ATTENUATION.x + ATTENUATION.y * radius +
+                                  ATTENUATION.z * radius * radius);
+    check(std::fabs(atRadius - LIGHT_CUTOFF) < 1e-5f, "light radius at the cutoff");
+    check(lightRadius(LIGHT_CUTOFF / 2.0f, ATTENUATION) == 0.0f, "dim light has no radius");
+
+    LightClusters clusters;
+    clusters.setProjection(FOV_Y, ASPECT, NEAR_PLANE, FAR_PLANE);
+    check(clusters.clusterAt(glm::vec3(0.0f, 0.0f, -NEAR_PLANE)) ==
+          (CLUSTER_TILES_Y / 2) * CLUSTER_TILES_X + CLUSTER_TILES_X / 2, "center of the near plane");
+    check(clusters.clusterAt(glm::vec3(0.0f, 0.0f, -FAR_PLANE * 0.999f)) /
+          (CLUSTER_TILES_X * CLUSTER_TILES_Y) == CLUSTER_SLICES - 1, "far plane in the last slice");
+    checkKernels(clusters, random);
+
+    std::vector<Fragment> fragments = sceneFragments();
+    printf("%u clusters, %zu fragments, kernels:", CLUSTER_COUNT, fragments.size());
+    for (const LightCullKernels *kernels : supportedLightCullKernels()) {
+        printf(" %s", kernels->name);
+    }
+    printf("\n");
+    for (uint32_t count : {16u, 256u, 1024u}) {
+        run(count, repetitions, fragments, random);
+    }
+
+    return checkResult();
+}
@@ -0,0 +1,109 @@
+/*
+ * Host benchmark of the app's logger.
+ *
+ *   logbench [threads] [bursts]
+ *
+ * Each of 'threads' producers (default 1, then 4) logs 'bursts' (default 2000) bursts of 128
+ * records with an int, a double and a string, as the frame stats do. The time spent in the
+ * calls is compared with formatting the same record and writing it to /dev/null on the caller,
+ * which is the least a synchronous __android_log_print costs. The logger's own thread formats
+ * and discards (no sink), waiting for it between bursts is not timed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "logger.h"
+
+using namespace vkt;
+using Clock = std::chrono::steady_clock;
+
+// Four producers' bursts together fit the ring
+static const int BURST = 128;
+
+struct Result {
+    double asyncNs;
+    double syncNs;
+};
+
+static Result run(Logger &logger, FILE *devNull, int threads, int bursts) {
+    std::vector<double> asyncNs(threads), syncNs(threads);
+    std::vector<std::thread> producers;
+    for (int t = 0; t < threads; t++) {
+        producers.emplace_back([&, t]() {
+            const char *name = t % 2 ? "cube" : "plane";
+            Clock::duration asyncTime{}, syncTime{};
+            char line[1024];
+            for (int burst = 0; burst < bursts; burst++) {
+                auto start = Clock::now();
+                for (int i = 0; i < BURST; i++) {
+                    logger.log(LogLevel::Info, "Draw %d of %s: %.3f ms", i, name, i * 0.01);
+                }
+                asyncTime += Clock::now() - start;
+                logger.flush();
+
+                start = Clock::now();
+                for (int i = 0; i < BURST; i++) {
+                    snprintf(line, sizeof(line), "Draw %d of %s: %.3f ms", i, name, i * 0.01);
+                    fputs(line, devNull);
+                    fflush(devNull);
+                }
+                syncTime += Clock::now() - start;
+            }
+            double calls = double(bursts) * BURST;
+            asyncNs[t] = std::chrono::duration<double, std::nano>(asyncTime).count() / calls;
+            syncNs[t] = std::chrono::duration<double, std::nano>(syncTime).count() / calls;
+        });
+    }
+    for (auto &producer: producers) {
+        producer.join();
+    }
+    logger.flush();
+    return {*std::max_element(asyncNs.begin(), asyncNs.end()),
+            *std::max_element(syncNs.begin(), syncNs.end())};
+}
+
+int main(int argc, char **argv) {
+    int bursts = argc > 2 ? atoi(argv[2]) : 2000;
+    FILE *devNull = fopen("/dev/null", "w");
+    if (devNull == nullptr) {
+        return 1;
+    }
+
+    // A few records through the stdout sink, strings copied and cut to the slot
+    Logger &logger = Logger::instance();
+    std::vector<char> longText(2 * Logger::PAYLOAD_SIZE, 'x');
+    longText.back() = 0;
+    {
+        char transient[32];
+        snprintf(transient, sizeof(transient), "transient %d", 42);
+        VKT_LOG(LogLevel::Info, "logbench: %s, %u, %.2f, %s", transient, 7u, 3.5, "literal");
+        transient[0] = 0;  // already copied
+    }
+    VKT_LOG(LogLevel::Info, "logbench: long string cut to %zu bytes: %.16s...",
+            strlen(longText.data()), longText.data());
+    VKT_LOG(LogLevel::Error, "logbench: null string [%s]", (const char *) nullptr);
+    logger.flush();
+
+    logger.setSinks(0);
+    std::vector<int> threadCounts;
+    if (argc > 1) {
+        threadCounts.push_back(atoi(argv[1]));
+    } else {
+        threadCounts = {1, 4};
+    }
+    printf("%-8s %14s %14s %10s\n", "threads", "async ns/call", "sync ns/call", "dropped");
+    for (int threads: threadCounts) {
+        uint64_t droppedBefore = logger.dropped();
+        Result result = run(logger, devNull, threads, bursts);
+        printf("%-8d %14.1f %14.1f %10llu\n", threads, result.asyncNs, result.syncNs,
+               (unsigned long long) (logger.dropped() - droppedBefore));
+    }
+    fclose(devNull);
+    return 0;
+}
@@ -0,0 +1,138 @@
+/*
+ * Host checks and microbenchmark of the app's pixel conversion kernels.
+ *
+ *   pixelbench [megapixels]
+ *
+ * Every kernel of every implementation this CPU supports is first compared byte for byte with
+ * the scalar reference, on random pixels and on every length up to a few vectors so the tails
+ * are covered, then timed on a buffer of 'megapixels' (default 4) and reported in GB/s of output.
+ */
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "pixel_convert.h"
+
+using namespace vkt;
+using Kernel = void (*)(const uint8_t *, uint8_t *, size_t);
+
+struct KernelInfo {
+    const char *name;
+    int srcChannels;
+    Kernel PixelKernels::*kernel;
+};
+
+static const KernelInfo KERNELS[] = {
+        {"expandRgbToRgba",  3, &PixelKernels::expandRgbToRgba},
+        {"swapRedBlue",      4, &PixelKernels::swapRedBlue},
+        {"premultiplyAlpha", 4, &PixelKernels::premultiplyAlpha},
+        {"srgbToLinear",     4, &PixelKernels::srgbToLinear},
+        {"linearToSrgb",     4, &PixelKernels::linearToSrgb},
+};
+
+static bool verify(const PixelKernels &kernels, const std::vector<uint8_t> &input) {
+    const PixelKernels &reference = scalarPixelKernels();
+    bool ok = true;
+    for (const auto &info: KERNELS) {
+        for (size_t pixels = 0; pixels <= 67; pixels++) {
+            // Offset the source so unaligned starts are covered as well
+            const uint8_t *src = input.data() + pixels % 7;
+            std::vector<uint8_t> expected(pixels * 4, 0xcd);
+            std::vector<uint8_t> actual(pixels * 4, 0xcd);
+            (reference.*info.kernel)(src, expected.data(), pixels);
+            (kernels.*info.kernel)(src, actual.data(), pixels);
+            if (expected != actual) {
+                fprintf(stderr, "%s %s: mismatch with %zu pixels\n", kernels.name, info.name,
+                        pixels);
+                ok = false;
+                break;
+            }
+        }
+
+        // Every alpha and color pair once, for the premultiplication rounding
+        std::vector<uint8_t> pairs(256 * 256 * 4);
+        for (size_t i = 0; i < 256 * 256; i++) {
+            pairs[i * 4 + 0] = pairs[i * 4 + 1] = pairs[i * 4 + 2] = static_cast<uint8_t>(i);
+            pairs[i * 4 + 3] = static_cast<uint8_t>(i >> 8);
+        }
+        std::vector<uint8_t> expected(pairs.size()), actual(pairs.size());
+        (reference.*info.kernel)(pairs.data(), expected.data(), 256 * 256);
+        (kernels.*info.kernel)(pairs.data(), actual.data(), 256 * 256);
+        if (expected != actual) {
+            fprintf(stderr, "%s %s: mismatch on the exhaustive input\n", kernels.name, info.name);
+            ok = false;
+        }
+    }
+
+    // In place conversion, which convertPixels relies on
+    std::vector<uint8_t> expected(input.begin(), input.begin() + 1000 * 4);
+    std::vector<uint8_t> actual = expected;
+    reference.premultiplyAlpha(expected.data(), expected.data(), 1000);
+    kernels.premultiplyAlpha(actual.data(), actual.data(), 1000);
+    reference.swapRedBlue(expected.data(), expected.data(), 1000);
+    kernels.swapRedBlue(actual.data(), actual.data(), 1000);
+    if (expected != actual) {
+        fprintf(stderr, "%s: in place mismatch\n", kernels.name);
+        ok = false;
+    }
+    return ok;
+}
+
+static double bench(Kernel kernel, const uint8_t *src, uint8_t *dst, size_t pixels) {
+    double best = 1e9;
+    for (int i = 0; i < 10; i++) {
+        auto start = std::chrono::steady_clock::now();
+        kernel(src, dst, pixels);
+        best = std::min(best, std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count());
+    }
+    return pixels * 4 / best / 1e9;
+}
+
+int main(int argc, char **argv) {
+    size_t pixels = size_t((argc >= 2 ? std::max(0.001, atof(argv[1])) : 4.0) * 1e6);
+
+    std::mt19937 random(1234);
+    std::vector<uint8_t> input(pixels * 4 + 64);
+    for (auto &byte: input) {
+        byte = static_cast<uint8_t>(random());
+    }
+    std::vector<uint8_t> output(pixels * 4);
+
+    std::vector<const PixelKernels *> implementations = supportedPixelKernels();
+    printf("dispatch picks: %s\n", pixelKernels().name);
+
+    bool ok = true;
+    for (const PixelKernels *kernels: implementations) {
+        ok = verify(*kernels, input) && ok;
+    }
+    printf("bit-exact check: %s\n", ok ? "passed" : "FAILED");
+
+    printf("%-18s", "GB/s");
+    for (const PixelKernels *kernels: implementations) {
+        printf("%10s", kernels->name);
+    }
+    printf("\n");
+    for (const auto &info: KERNELS) {
+        printf("%-18s", info.name);
+        for (const PixelKernels *kernels: implementations) {
+            printf("%10.2f", bench(kernels->*info.kernel, input.data(), output.data(), pixels));
+        }
+        printf("\n");
+    }
+
+    // The whole texture path, to a buffer that is only written
+    PixelConversion conversion;
+    conversion.premultiplyAlpha = true;
+    conversion.swapRedBlue = true;
+    auto start = std::chrono::steady_clock::now();
+    convertPixels(conversion, input.data(), 3, output.data(), pixels);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("convertPixels rgb -> premultiplied bgra: %.2f GB/s\n", pixels * 4 / seconds / 1e9);
+
+    return ok ? 0 : 1;
+}
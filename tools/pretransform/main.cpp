@@ -0,0 +1,145 @@
+/*
+ * Host check of the app's surface pre-rotation math, for all four surface transforms.
+ *
+ * The rotation matrices must hold exact 0/±1 entries and agree with glm::rotate, undo each other
+ * and carry the clip space corners onto each other exactly. The aspect ratio must be the one the
+ * user sees. Rects mapped by preRotateRect() must come back through the inverse rotation, cover
+ * the whole identity framebuffer when they cover the screen, and land on the pixels the rotated
+ * projection draws them to.
+ */
+#include <stdio.h>
+
+#include <cmath>
+#include <initializer_list>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "check.h"
+#include "pretransform.h"
+
+using namespace vkt;
+
+// A portrait phone panel, the identity (native) size of its swapchain
+const uint32_t IDENTITY_WIDTH = 1080;
+const uint32_t IDENTITY_HEIGHT = 2400;
+
+struct Rotation {
+    SurfaceRotation rotation;
+    const char *name;
+    float degrees;
+    float c;  // expected cos and sin entries
+    float s;
+    SurfaceRotation inverse;
+};
+
+const Rotation ROTATIONS[] = {
+        {SurfaceRotation::Identity,  "identity", 0.0f,   1.0f,  0.0f,  SurfaceRotation::Identity},
+        {SurfaceRotation::Rotate90,  "90",       90.0f,  0.0f,  1.0f,  SurfaceRotation::Rotate270},
+        {SurfaceRotation::Rotate180, "180",      180.0f, -1.0f, 0.0f,  SurfaceRotation::Rotate180},
+        {SurfaceRotation::Rotate270, "270",      270.0f, 0.0f,  -1.0f, SurfaceRotation::Rotate90},
+};
+
+// Smaller than the screen in either orientation
+const PreRotatedRect RECTS[] = {
+        {0,   0,   100, 50},
+        {200, 300, 400, 120},
+        {17,  981, 99,  99},
+        {0,   0,   1,   1},
+};
+
+static bool sameRect(const PreRotatedRect &a, const PreRotatedRect &b) {
+    return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+}
+
+static void checkMatrix(const Rotation &r) {
+    glm::mat4 expected(1.0f);
+    expected[0][0] = r.c;
+    expected[0][1] = r.s;
+    expected[1][0] = -r.s;
+    expected[1][1] = r.c;
+    glm::mat4 matrix = getPreRotationMatrix(r.rotation);
+    glm::mat4 reference = glm::rotate(glm::mat4(1.0f), glm::radians(r.degrees),
+                                      glm::vec3(0.0f, 0.0f, 1.0f));
+    bool exact = true;
+    bool close = true;
+    for (int column = 0; column < 4; column++) {
+        for (int row = 0; row < 4; row++) {
+            exact = exact && matrix[column][row] == expected[column][row];
+            close = close && std::fabs(matrix[column][row] - reference[column][row]) < 1e-6f;
+        }
+    }
+    check(exact, "exact 0/±1 entries");
+    check(close, "matches glm::rotate");
+    check(getPreRotationMatrix(r.inverse) * matrix == glm::mat4(1.0f),
+          "inverse rotation gives the identity exactly");
+
+    // The clip space corners go round onto each other, and back
+    const glm::vec4 corners[] = {{-1, -1, 0.5f, 1}, {1, -1, 0.5f, 1}, {1, 1, 0.5f, 1},
+                                 {-1, 1, 0.5f, 1}};
+    int steps = static_cast<int>(r.rotation);  // quarter turns
+    for (int i = 0; i < 4; i++) {
+        glm::vec4 rotated = matrix * corners[i];
+        // Counterclockwise in the matrix's x right, y up sense: each quarter turn is the next
+        // corner in the list
+        check(rotated == corners[(i + steps) % 4], "corner lands on a corner");
+        check(getPreRotationMatrix(r.inverse) * rotated == corners[i], "corner round trips");
+    }
+}
+
+static void checkAspectRatio(const Rotation &r) {
+    float aspect = getPreRotatedAspectRatio(IDENTITY_WIDTH, IDENTITY_HEIGHT, r.rotation);
+    float expected = swapsAxes(r.rotation) ? 2400.0f / 1080.0f : 1080.0f / 2400.0f;
+    check(aspect == expected, "aspect ratio of the visible screen");
+}
+
+// Identity framebuffer pixel the rotated projection draws a visible pixel's center to
+static glm::ivec2 identityPixel(const Rotation &r, int32_t x, int32_t y) {
+    float visibleWidth = static_cast<float>(swapsAxes(r.rotation) ? IDENTITY_HEIGHT
+                                                                   : IDENTITY_WIDTH);
+    float visibleHeight = static_cast<float>(swapsAxes(r.rotation) ? IDENTITY_WIDTH
+                                                                    : IDENTITY_HEIGHT);
+    glm::vec4 ndc(2.0f * (x + 0.5f) / visibleWidth - 1.0f,
+                  2.0f * (y + 0.5f) / visibleHeight - 1.0f, 0.5f, 1.0f);
+    glm::vec4 rotated = getPreRotationMatrix(r.rotation) * ndc;
+    return glm::ivec2(std::floor((rotated.x + 1.0f) / 2.0f * IDENTITY_WIDTH),
+                      std::floor((rotated.y + 1.0f) / 2.0f * IDENTITY_HEIGHT));
+}
+
+static void checkRects(const Rotation &r) {
+    uint32_t visibleWidth = swapsAxes(r.rotation) ? IDENTITY_HEIGHT : IDENTITY_WIDTH;
+    uint32_t visibleHeight = swapsAxes(r.rotation) ? IDENTITY_WIDTH : IDENTITY_HEIGHT;
+    PreRotatedRect screen{0, 0, visibleWidth, visibleHeight};
+    check(sameRect(preRotateRect(screen, IDENTITY_WIDTH, IDENTITY_HEIGHT, r.rotation),
+                   {0, 0, IDENTITY_WIDTH, IDENTITY_HEIGHT}),
+          "full screen covers the identity framebuffer");
+
+    for (const PreRotatedRect &rect : RECTS) {
+        PreRotatedRect mapped = preRotateRect(rect, IDENTITY_WIDTH, IDENTITY_HEIGHT, r.rotation);
+        // The inverse rotation's visible screen is this rotation's identity framebuffer
+        PreRotatedRect back = preRotateRect(mapped, visibleWidth, visibleHeight, r.inverse);
+        check(sameRect(back, rect), "rect round trips through the inverse rotation");
+
+        bool inside = true;
+        for (int32_t x : {rect.x, rect.x + static_cast<int32_t>(rect.width) - 1}) {
+            for (int32_t y : {rect.y, rect.y + static_cast<int32_t>(rect.height) - 1}) {
+                glm::ivec2 pixel = identityPixel(r, x, y);
+                inside = inside && pixel.x >= mapped.x &&
+                         pixel.x < mapped.x + static_cast<int32_t>(mapped.width) &&
+                         pixel.y >= mapped.y &&
+                         pixel.y < mapped.y + static_cast<int32_t>(mapped.height);
+            }
+        }
+        check(inside, "rect corners are where the rotated projection draws them");
+    }
+}
+
+int main() {
+    for (const Rotation &r : ROTATIONS) {
+        printf("%s\n", r.name);
+        fflush(stdout);  // ahead of any failure on stderr
+        checkMatrix(r);
+        checkAspectRatio(r);
+        checkRects(r);
+    }
+    return checkResult();
+}
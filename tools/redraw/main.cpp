@@ -0,0 +1,106 @@
+/*
+ * Host check of the app's render-on-demand scheduler.
+ *
+ * First with simulated time: a static scene renders once and then never, an animation renders at
+ * its capped rate, invalidations render right away whatever the cap. Then a desktop style loop
+ * blocked in waitUntilDue() for one second of wall time, with a producer thread invalidating in
+ * bursts, compared with the frames a loop rendering continuously at 60 fps would have drawn.
+ */
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "check.h"
+#include "redraw.h"
+
+using namespace vkt;
+using namespace std::chrono_literals;
+using Clock = RedrawScheduler::Clock;
+
+// Ticks a simulated loop every millisecond for 'duration', returns the frames rendered
+static uint64_t simulate(RedrawScheduler &redraw, Clock::time_point &now,
+                         Clock::duration duration) {
+    uint64_t frames = 0;
+    for (Clock::time_point end = now + duration; now < end; now += 1ms) {
+        if (redraw.beginFrame(now)) {
+            frames++;
+        }
+    }
+    return frames;
+}
+
+static void simulatedTime() {
+    Clock::time_point now = Clock::now();
+
+    RedrawScheduler still;
+    check(still.timeUntilDue(now) == RedrawScheduler::Duration::zero(), "first frame due");
+    check(simulate(still, now, 1s) == 1, "static scene renders once");
+    check(still.timeUntilDue(now) == RedrawScheduler::FOREVER, "static scene blocks forever");
+    still.invalidate(REDRAW_INPUT);
+    still.invalidate(REDRAW_INPUT | REDRAW_PIPELINE);
+    check(simulate(still, now, 100ms) == 1, "invalidations merge into one frame");
+    check(still.stats().framesByReason[1] == 1 && still.stats().framesByReason[3] == 1,
+          "frames counted by reason");
+
+    RedrawScheduler animated;
+    animated.setAnimating(true);
+    uint64_t frames = simulate(animated, now, 1s);
+    check(frames >= 30 && frames <= 31, "animation capped at 30 fps");
+    check(animated.resumedFromIdle(), "animation frames come after idle time");
+    animated.invalidate(REDRAW_INPUT);
+    check(animated.timeUntilDue(now) == RedrawScheduler::Duration::zero(),
+          "input not held back by the cap");
+    check(animated.beginFrame(now) && !animated.beginFrame(now + 1ms), "one frame per input");
+
+    RedrawScheduler continuous;
+    continuous.setOnDemand(false);
+    check(simulate(continuous, now, 100ms) == 100, "on demand off renders every iteration");
+    check(!continuous.resumedFromIdle(), "continuous frames are back to back");
+}
+
+static void wallClock() {
+    RedrawScheduler redraw;
+    redraw.setAnimating(false);
+    std::atomic<bool> running{true};
+    std::atomic<uint64_t> invalidations{0};
+
+    // Input in bursts: 10 events 5 ms apart, then 200 ms of nothing
+    std::thread producer([&]() {
+        while (running) {
+            for (int i = 0; i < 10 && running; i++) {
+                redraw.invalidate(REDRAW_INPUT);
+                invalidations++;
+                std::this_thread::sleep_for(5ms);
+            }
+            std::this_thread::sleep_for(200ms);
+        }
+    });
+
+    auto start = Clock::now();
+    uint64_t loops = 0;
+    while (Clock::now() - start < 1s) {
+        redraw.waitUntilDue();
+        redraw.beginFrame(Clock::now());
+        loops++;
+    }
+    running = false;
+    producer.join();
+
+    const RedrawScheduler::Stats &stats = redraw.stats();
+    uint64_t continuous = 60;
+    printf("1 s of bursty input: %llu invalidations, %llu frames rendered, %llu idle wakeups, "
+           "%llu loop iterations (continuous at 60 fps: %llu frames)\n",
+           (unsigned long long) invalidations.load(), (unsigned long long) stats.renderedFrames,
+           (unsigned long long) stats.idleWakeups, (unsigned long long) loops,
+           (unsigned long long) continuous);
+    check(stats.renderedFrames <= invalidations + 1, "no frame without a reason");
+    check(stats.renderedFrames >= 10, "input frames rendered");
+}
+
+int main() {
+    simulatedTime();
+    wallClock();
+    return checkResult();
+}
@@ -0,0 +1,230 @@
+/*
+ * Host check of the app's render thread.
+ *
+ * A mock renderer whose frames take SLOW_FRAME (a GPU that can't keep up, the time lands in the
+ * fence wait) gets a stream of events every EVENT_INTERVAL, and the window is torn down and
+ * brought back in the middle. Measures how late each event got handled, against the single
+ * thread loop the app had before: there an event arriving during a frame waits for it to finish.
+ * Also checks that no frame touches the surface after APP_CMD_TERM_WINDOW returned, and that the
+ * snapshots the simulation thread publishes reach the frames whole and in order.
+ */
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "render_thread.h"
+
+using namespace vkt;
+using namespace std::chrono_literals;
+using Clock = std::chrono::steady_clock;
+
+const auto SLOW_FRAME = 50ms;
+const auto EVENT_INTERVAL = 5ms;
+const auto RUN_TIME = 2s;
+const auto SIMULATION_INTERVAL = 4ms;
+const int SNAPSHOT_WORDS = 256;
+
+// Never dereferenced, only compared
+static ANativeWindow *mockWindow() {
+    static char window;
+    return reinterpret_cast<ANativeWindow *>(&window);
+}
+
+// Large enough that a torn read would show as words that disagree
+struct Snapshot {
+    uint64_t words[SNAPSHOT_WORDS] = {};
+};
+
+class SlowRenderer : public LifecycleHost {
+public:
+    void createDevice(ANativeWindow *window) override {
+        std::this_thread::sleep_for(20ms);
+        surface = true;
+    }
+
+    void attachSurface(ANativeWindow *window) override {
+        std::this_thread::sleep_for(5ms);
+        surface = true;
+    }
+
+    void detachSurface() override {
+        std::this_thread::sleep_for(5ms);  // vkDeviceWaitIdle
+        surface = false;
+    }
+
+    void destroyDevice() override {}
+
+    // Render thread
+    bool render() {
+        if (!surface) {
+            framesWithoutSurface++;
+        }
+        const Snapshot &snapshot = snapshots.latest();
+        for (int i = 1; i < SNAPSHOT_WORDS; i++) {
+            if (snapshot.words[i] != snapshot.words[0]) {
+                tornSnapshots++;
+                break;
+            }
+        }
+        if (snapshot.words[0] < lastSnapshot) {
+            snapshotsOutOfOrder++;
+        }
+        lastSnapshot = snapshot.words[0];
+        std::this_thread::sleep_for(SLOW_FRAME);
+        frames++;
+        return true;
+    }
+
+    // Simulation thread
+    void simulate(double) {
+        Snapshot &snapshot = snapshots.back();
+        published++;
+        std::fill(std::begin(snapshot.words), std::end(snapshot.words), published);
+        snapshots.publish();
+    }
+
+    std::atomic<bool> surface{false};
+    std::atomic<uint64_t> frames{0};
+    uint64_t framesWithoutSurface = 0;
+    uint64_t tornSnapshots = 0;
+    uint64_t snapshotsOutOfOrder = 0;
+    uint64_t lastSnapshot = 0;
+    uint64_t published = 0;
+    SnapshotBuffer<Snapshot> snapshots;
+};
+
+struct Latencies {
+    std::vector<double> lateMs;
+
+    double percentile(double p) {
+        std::sort(lateMs.begin(), lateMs.end());
+        return lateMs[std::min(lateMs.size() - 1, static_cast<size_t>(p * lateMs.size()))];
+    }
+
+    void print(const char *name) {
+        printf("%-14s %5zu events, late by p50 %6.2f ms, p99 %6.2f ms, max %6.2f ms\n", name,
+               lateMs.size(), percentile(0.5), percentile(0.99), percentile(1.0));
+    }
+};
+
+static double msSince(Clock::time_point time) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - time).count();
+}
+
+// What android_main did before: events are only looked at between frames
+static Latencies singleThread() {
+    SlowRenderer renderer;
+    Lifecycle lifecycle(renderer);
+    lifecycle.onStart();
+    lifecycle.onWindowCreated(mockWindow());
+
+    Latencies latencies;
+    Clock::time_point start = Clock::now();
+    Clock::time_point nextEvent = start;
+    while (Clock::now() - start < RUN_TIME) {
+        for (; nextEvent <= Clock::now(); nextEvent += EVENT_INTERVAL) {
+            latencies.lateMs.push_back(msSince(nextEvent));
+        }
+        renderer.render();
+    }
+    lifecycle.onDestroy();
+    return latencies;
+}
+
+static Latencies renderThread() {
+    SlowRenderer renderer;
+    Lifecycle lifecycle(renderer);
+    RedrawScheduler redraw;
+    RenderThread thread(lifecycle, redraw, [&renderer]() { return renderer.render(); });
+    SimulationThread simulation(SIMULATION_INTERVAL, [&renderer, &redraw](double seconds) {
+        renderer.simulate(seconds);
+        redraw.invalidate(REDRAW_ANIMATION);
+    });
+    std::atomic<int> firstFrames{0};
+    thread.setFirstFrameCallback([&firstFrames](const Lifecycle::Stats &) { firstFrames++; });
+    simulation.setPaused(true);
+    thread.setRenderableCallback([&simulation](bool renderable) {
+        simulation.setPaused(!renderable);
+    });
+    thread.start();
+    simulation.start();
+
+    thread.post(RenderCommand::Start);
+    thread.post(RenderCommand::WindowCreated, mockWindow());
+
+    Latencies latencies;
+    double worstTeardownMs = 0;
+    double worstPostUs = 0;
+    bool resized = false;
+    Clock::time_point start = Clock::now();
+    Clock::time_point nextEvent = start;
+    while (Clock::now() - start < RUN_TIME) {
+        std::this_thread::sleep_until(nextEvent);
+        latencies.lateMs.push_back(msSince(nextEvent));
+        nextEvent += EVENT_INTERVAL;
+
+        // An input event, and now and then a lifecycle command that doesn't change anything
+        Clock::time_point postStart = Clock::now();
+        redraw.invalidate(REDRAW_INPUT);
+        thread.post(RenderCommand::Start);
+        worstPostUs = std::max(worstPostUs, msSince(postStart) * 1000.0);
+
+        if (!resized && Clock::now() - start > RUN_TIME / 2) {
+            // APP_CMD_TERM_WINDOW: may only return once the render thread let go of the window,
+            // which can take the rest of the frame it is in
+            Clock::time_point teardownStart = Clock::now();
+            thread.postAndWait(RenderCommand::WindowDestroyed);
+            worstTeardownMs = std::max(worstTeardownMs, msSince(teardownStart));
+            check(!renderer.surface, "surface detached when APP_CMD_TERM_WINDOW returns");
+            std::this_thread::sleep_for(20ms);
+            thread.post(RenderCommand::WindowCreated, mockWindow());
+            resized = true;
+            nextEvent = Clock::now();
+        }
+    }
+    Clock::time_point teardownStart = Clock::now();
+    thread.postAndWait(RenderCommand::WindowDestroyed);
+    worstTeardownMs = std::max(worstTeardownMs, msSince(teardownStart));
+    check(!renderer.surface, "surface detached when the last APP_CMD_TERM_WINDOW returns");
+    thread.postAndWait(RenderCommand::Destroy);
+    simulation.stop();
+    thread.stop();
+
+    printf("render thread: %llu frames, worst post %.1f us, worst window teardown %.1f ms, "
+           "%llu snapshots published\n", (unsigned long long) renderer.frames.load(),
+           worstPostUs, worstTeardownMs, (unsigned long long) renderer.published);
+    check(renderer.framesWithoutSurface == 0, "no frame without a surface");
+    check(renderer.tornSnapshots == 0, "snapshots read whole");
+    check(renderer.snapshotsOutOfOrder == 0, "snapshots read in order");
+    check(renderer.lastSnapshot > 0, "frames saw the simulation's snapshots");
+    check(firstFrames == 2, "first frame of both windows reported");
+    check(lifecycle.stats().deviceCreates == 1 && lifecycle.stats().surfaceAttaches == 1,
+          "device kept across the window change");
+    check(renderer.frames >= static_cast<uint64_t>(RUN_TIME / SLOW_FRAME / 2),
+          "render thread kept rendering");
+    // At most the frame the render thread is in, plus the detach
+    check(worstTeardownMs < std::chrono::duration<double, std::milli>(SLOW_FRAME).count() + 30,
+          "window teardown waits at most one frame");
+    return latencies;
+}
+
+int main() {
+    printf("frames take %lld ms, an event every %lld ms\n",
+           (long long) std::chrono::milliseconds(SLOW_FRAME).count(),
+           (long long) std::chrono::milliseconds(EVENT_INTERVAL).count());
+    Latencies before = singleThread();
+    before.print("single thread");
+    Latencies after = renderThread();
+    after.print("render thread");
+
+    // Medians: the tails also carry the host's scheduling noise, on a single core a lot of it
+    check(before.percentile(0.5) > 10.0, "single thread loop holds events up for frames");
+    check(after.percentile(0.5) < 2.0, "event loop stays responsive under a slow GPU");
+
+    return checkResult();
+}
@@ -0,0 +1,94 @@
+/*
+ * Host benchmark of the app's texture batch decoder.
+ *
+ *   texturebench <asset dir> [--repeat N] [--iterations N] <image> ...
+ *
+ * The images (repeated N times to make a realistic batch) are decoded into one arena with
+ * 1, 2, 4 ... threads up to the core count, and the decode throughput is reported in MP/s.
+ */
+#include <stdio.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "asset_vfs.h"
+#include "texture_loader.h"
+#include "thread_pool.h"
+
+using namespace vkt;
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: texturebench <asset dir> [--repeat N] [--iterations N] <image> ...\n");
+        return 2;
+    }
+
+    int repeat = 16;
+    int iterations = 3;
+    std::vector<std::string> images;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = std::max(1, atoi(argv[++i]));
+        } else {
+            images.push_back(argv[i]);
+        }
+    }
+
+    std::vector<std::string> paths;
+    for (int r = 0; r < repeat; r++) {
+        paths.insert(paths.end(), images.begin(), images.end());
+    }
+
+    AssetVfs assets;
+    assets.mount(std::make_unique<MappedFileSource>(argv[1]));
+
+    TextureBatch batch;
+    if (!batch.probe(assets, paths)) {
+        for (const auto &texture: batch.textures()) {
+            if (texture.error != nullptr) {
+                fprintf(stderr, "%s: %s\n", texture.path.c_str(), texture.error);
+            }
+        }
+        return 1;
+    }
+    std::vector<uint8_t> arena(batch.arenaSize());
+    printf("%zu images, %.1f MB arena\n", paths.size(), arena.size() / 1e6);
+
+    // 1, 2, 4 ... threads, ending with all cores
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < cores; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(cores);
+
+    double singleThread = 0;
+    for (unsigned threads: threadCounts) {
+        // The calling thread decodes too, so the pool gets one thread fewer
+        std::unique_ptr<ThreadPool> pool;
+        if (threads > 1) {
+            pool = std::make_unique<ThreadPool>(threads - 1);
+        }
+
+        double best = 0;
+        for (int i = 0; i < iterations; i++) {
+            if (!batch.decode(arena.data(), pool.get())) {
+                fprintf(stderr, "decode failed\n");
+                return 1;
+            }
+            best = std::max(best, batch.megapixelsPerSecond());
+        }
+        if (threads == 1) {
+            singleThread = best;
+        }
+        printf("%3u threads  %8.1f MP/s  %5.2fx\n", threads, best,
+               singleThread > 0 ? best / singleThread : 0);
+    }
+    return 0;
+}